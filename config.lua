@@ -17,6 +17,7 @@ audio =
     music_volume = 0.90;
     use_effects = 1;
     listener_is_player = 0;
+    use_pcm_cache = 1;
 }
 
 render =
@@ -29,8 +30,10 @@ render =
     antialias_samples = 4;
     z_depth = 24;
     texture_border = 16;
+    texture_cache = 0;
     fog_color = {r = 255, g = 255, b = 255};
     show_fps = 1;
+    occlusion_culling = 1;
 }
 
 controls =
@@ -28,6 +28,45 @@ function efuncs_EraseEntity(index)
         entity_funcs[index].onLoad           = nil;
         entity_funcs[index]                  = nil;
     end;
+    proximity_watch[index] = nil;
+end;
+
+-- Entities waiting for the player to come close. All of them are checked with
+-- one queryEntities call per frame, instead of a distance call in every onLoop.
+-- As with onLoop, only enabled and active entities are checked. A watch fires
+-- once and is dropped, the task ends with the last one.
+proximity_watch = {};
+proximity_query = {};
+proximity_radius = 0.0;
+proximity_task = nil;
+
+local function efuncs_CheckProximity()
+    local n = queryEntities(proximity_query, {from = player, exclude = player, radius = proximity_radius, state = ENTITY_STATE_ENABLED + ENTITY_STATE_ACTIVE});
+    for i = 1, n do
+        local id = proximity_query.id[i];
+        local w = proximity_watch[id];
+        if((w ~= nil) and (proximity_query.dist[i] < w.radius)) then
+            proximity_watch[id] = nil;      -- the callback may watch the entity again
+            w.func(id);
+        end;
+    end;
+
+    if(next(proximity_watch) == nil) then
+        proximity_task = nil;
+        proximity_radius = 0.0;
+        return false;
+    end;
+    return true;
+end;
+
+function efuncs_WatchProximity(id, radius, func)
+    proximity_watch[id] = {radius = radius, func = func};
+    if(radius > proximity_radius) then
+        proximity_radius = radius;
+    end;
+    if(proximity_task == nil) then
+        proximity_task = addTask(efuncs_CheckProximity);
+    end;
 end;
 
 -- Clear whole entity functions array. Must be called on each level loading.
@@ -35,6 +74,9 @@ function entfuncs_Clear()
     for k,v in pairs(entity_funcs) do
         efuncs_EraseEntity(k);
     end;
+    proximity_watch = {};
+    proximity_radius = 0.0;
+    proximity_task = nil;     -- tasks are cleared together with entity functions
     print("entity_functions->entity_cleared !");
 end;
 
@@ -85,18 +85,22 @@ function doorbell_init(id)    -- Lara's Home doorbell (TR2)
     setEntityTypeFlag(id, ENTITY_TYPE_GENERIC);
     setEntityActivity(id, false);
 
+    local function ring(object_id)
+        playSound(334, object_id);
+        setEntityActivity(object_id, false);
+    end;
+
     entity_funcs[id].onActivate = function(object_id, activator_id)
-        return swapEntityActivity(object_id);
+        local ret = swapEntityActivity(object_id);
+        if(getEntityActivity(object_id)) then
+            efuncs_WatchProximity(object_id, 4096.0, ring);    -- the watch is dropped once it rings
+        end;
+        return ret;
     end;
 
     entity_funcs[id].onDeactivate = entity_funcs[id].onActivate;
 
-    entity_funcs[id].onLoop = function(object_id, tick_state)
-        if(getEntityDistance(player, object_id) < 4096.0) then
-            playSound(334, object_id);
-            setEntityActivity(object_id, false);
-        end;
-    end;
+    efuncs_WatchProximity(id, 4096.0, ring);
 end;
 
 function heli_rig_TR2_init(id)    -- Helicopter in Offshore Rig (TR2)
@@ -175,13 +179,11 @@ function crystal_TR3_init(id)   -- "Savegame" crystal (TR3 version)
     setEntityTypeFlag(id, ENTITY_TYPE_GENERIC);
     setEntityActivity(id, true);
 
-    entity_funcs[id].onLoop = function(object_id, tick_state)
-        if(getEntityDistance(player, object_id) < 512.0) then
-            playSound(SOUND_MEDIPACK);
-            changeCharacterParam(player, PARAM_HEALTH, 200);
-            disableEntity(object_id);
-        end;
-    end;
+    efuncs_WatchProximity(id, 512.0, function(object_id)
+        playSound(SOUND_MEDIPACK);
+        changeCharacterParam(player, PARAM_HEALTH, 200);
+        disableEntity(object_id);
+    end);
 end;
 
 function cleaner_init(id)      -- Thames Wharf machine (aka cleaner)
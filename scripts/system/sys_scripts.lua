@@ -51,39 +51,9 @@ function printTable(tbl)
     end;
 end;
 
--- Task manager functions
-
-engine_tasks = {};  -- task struct: {functions array}
-
-function addTask(f)
-    local i = 0;
-    while(engine_tasks[i] ~= nil) do
-        i = i + 1;  -- find first empty task index.
-    end
-    engine_tasks[i] = f;    -- put the task into free element.
-end
-
-function doTasks()
-    local i = 0;
-    while(engine_tasks[i] ~= nil) do
-        local t = engine_tasks[i]();
-        if(t == false or t == nil) then     -- remove task, if it returns nil or false.
-            local j = i;
-            while(engine_tasks[j] ~= nil) do
-                engine_tasks[j] = engine_tasks[j + 1];
-                j = j + 1;
-            end
-        end
-        i = i + 1;
-    end
-end
-
-function clearTasks()
-    local i = 0;
-    while(engine_tasks[i] ~= nil) do
-        engine_tasks[i] = nil;
-        i = i + 1;
-    end
-end
+-- Task manager functions are engine side:
+-- addTask(f, (delay)) returns a task handle; f is called every frame while it returns true,
+-- a number puts it to sleep for that many seconds, nil or false ends it.
+-- removeTask(handle), clearTasks(), getTasksCount() -> alive, sleeping.
 
 print("System_scripts.lua loaded");
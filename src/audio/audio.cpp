@@ -30,10 +30,18 @@ extern "C" {
 #include "audio.h"
 #include "audio_stream.h"
 #include "audio_fx.h"
+#include "audio_voice_rank.h"
 
 #define STB_VORBIS_HEADER_ONLY
 #include "stb_vorbis.c"
 
+#define TR_AUDIO_VOICE_HASH_SIZE        (256)           // Power of two.
+#define TR_AUDIO_VOICE_STEAL_MARGIN     (1.25f)         // Virtual voice must score that much higher to take a playing voice source.
+#define TR_AUDIO_VOICE_UNUSED           (0xFFFFFFFF)    // Effect index of a free voice.
+#define TR_AUDIO_POSITION_EPSILON       (8.0f)          // Source moves less than that are not sent to OpenAL.
+#define TR_AUDIO_DECODE_MAX_THREADS     (16)
+#define TR_AUDIO_PCM_CACHE_MAGIC        (0x304D4350)    // "PCM0"
+
 static ALCdevice              *al_device      = NULL;
 static ALCcontext             *al_context     = NULL;
 
@@ -101,19 +109,28 @@ public:
     void SetRange(ALfloat range_value);     // Set max. audible distance.
 
     bool IsActive();            // Check if source is active.
+    ALfloat GetOffset();        // Playback position in seconds.
+    void SetOffset(ALfloat offset);
 
     int32_t     emitter_ID;     // Entity of origin. -1 means no entity (hence - empty source).
     uint32_t    emitter_type;   // 0 - ordinary entity, 1 - sound source, 2 - global sound.
     uint32_t    effect_index;   // Effect index. Used to associate effect with entity for R/W flags.
     uint32_t    sample_index;   // OpenAL sample (buffer) index. May be the same for different sources.
     uint32_t    sample_count;   // How many buffers to use, beginning with sample_index.
+    int32_t     voice;          // Voice playing on this source, -1 if none.
+    bool        in_free_list;   // Source index is on the free sources stack.
 
     friend int Audio_IsEffectPlaying(int effect_ID, int entity_type, int entity_ID);
 
 private:
     bool        active;         // Source gets autostopped and destroyed on next frame, if it's not set.
     bool        is_water;       // Marker to define if sample is in underwater state or not.
+    bool        link_valid;     // Position and velocity below are what OpenAL has.
     ALuint      source_index;   // Source index. Should be unique for each source.
+    ALfloat     gain;           // Gain and range as sent to OpenAL, so they
+    ALfloat     range;          // are not queried back every frame.
+    ALfloat     position[3];
+    ALfloat     velocity[3];
 
     void LinkEmitter();                             // Link source to parent emitter.
     void SetPosition(const ALfloat pos_vector[]);   // Set source position.
@@ -121,6 +138,40 @@ private:
 };
 
 
+// Sound sources grouped by room, with the box around their positions and the
+// distance they can be heard from; a group far from listener is skipped whole.
+
+typedef struct audio_emitter_group_s
+{
+    uint32_t    first;          // First index in emitter_order.
+    uint32_t    count;
+    ALfloat     bb_min[3];
+    ALfloat     bb_max[3];
+    ALfloat     radius;
+}audio_emitter_group_t, *audio_emitter_group_p;
+
+
+// Voice is one playing effect instance. It either holds a real source, or it is
+// virtual: it keeps its playback position running without a source, and takes
+// a source back once one is free or it scores higher than a playing one.
+
+typedef struct audio_voice_s
+{
+    int32_t     emitter_ID;
+    uint32_t    emitter_type;
+    uint32_t    effect_index;
+    int32_t     source;         // Source index, -1 for virtual voice.
+    int32_t     next;           // Next voice in the same hash bucket, or in free list.
+    uint32_t    buffer_index;
+    ALfloat     pitch;
+    ALfloat     gain;           // Effect gain, before sound volume is applied.
+    ALfloat     range;
+    ALfloat     offset;         // Seconds played; only kept up to date for virtual voices.
+    ALfloat     length;         // Sample length in seconds.
+    ALboolean   looped;
+}audio_voice_t, *audio_voice_p;
+
+
 class StreamTrackBuffer
 {
 public:
@@ -157,6 +208,11 @@ int  Audio_LoadALbufferFromWAV_File(ALuint buf_number, const char *fname);
 void Audio_LoadOverridedSamples();
 
 int  Audio_GetFreeSource();
+void Audio_OnSourceStopped(AudioSource *source);    // Releases source voice and returns source to free stack.
+int  Audio_GetEmitterPosition(int entity_type, int entity_ID, ALfloat pos[3]);
+audio_voice_p Audio_FindVoice(int effect_ID, int entity_type, int entity_ID);
+void Audio_ReleaseVoice(audio_voice_p voice);
+void Audio_UpdateVoices(float time);
 int  Audio_GetFreeStream();                         // Get free (stopped) stream.
 int  Audio_TrackAlreadyPlayed(uint32_t track_index, int8_t mask = 0);     // Check if track played with given activation mask.
 void Audio_UpdateStreams(float time);               // Update all streams.
@@ -237,7 +293,7 @@ bool StreamTrackBuffer::Load_Ogg(const char *path)
 
     if(!ov)
     {
-        Sys_DebugLog(SYS_LOG_FILENAME, "OGG: Couldn't open file: %s.", path);
+        Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "OGG: Couldn't open file: %s.", path);
         Sys_ReturnTempMem(alloc.alloc_buffer_length_in_bytes);
         return false;
     }
@@ -344,7 +400,7 @@ bool StreamTrackBuffer::Load_WavRW(SDL_RWops *file)
     uint32_t      wav_length;
     if(SDL_LoadWAV_RW(file, 1, &wav_spec, &wav_buffer, &wav_length) == NULL)
     {
-        Sys_DebugLog(SYS_LOG_FILENAME, "Error: can't load track");
+        Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "can't load track");
         return false;
     }
 
@@ -354,7 +410,7 @@ bool StreamTrackBuffer::Load_WavRW(SDL_RWops *file)
 
     if(wav_spec.channels > 2)   // We can't use non-mono and barely can use stereo samples.
     {
-        Sys_DebugLog(SYS_LOG_FILENAME, "Error: track has more than 2 channels!");
+        Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "track has more than 2 channels!");
         return false;
     }
 
@@ -362,7 +418,7 @@ bool StreamTrackBuffer::Load_WavRW(SDL_RWops *file)
     // We rarely encounter samples with exotic bitsizes, but just in case...
     if((sample_bitsize != 32) && (sample_bitsize != 16) && (sample_bitsize != 8))
     {
-        Sys_DebugLog(SYS_LOG_FILENAME, "Can't load sample - wrong bitsize (%d)", sample_bitsize);
+        Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "Can't load sample - wrong bitsize (%d)", sample_bitsize);
         return false;
     }
 
@@ -406,12 +462,17 @@ bool StreamTrackBuffer::Load_WavRW(SDL_RWops *file)
 // ========== GLOBALS ==============
 ALfloat                     listener_position[3];
 struct audio_settings_s     audio_settings = {0};
+struct audio_update_stats_s audio_update_stats = {0};
 
 
 struct audio_world_data_s
 {
     uint32_t                        audio_emitters_count;   // Amount of audio emitters in level.
     struct audio_emitter_s         *audio_emitters;         // Audio emitters.
+    uint32_t                        emitter_groups_count;   // Emitters by room.
+    struct audio_emitter_group_s   *emitter_groups;
+    uint32_t                       *emitter_order;          // Emitter indexes, group after group.
+    bool                            emitter_culling;
 
     uint32_t                        audio_map_count;        // Amount of overall effects in engine.
     int16_t                        *audio_map;              // Effect indexes.
@@ -422,6 +483,18 @@ struct audio_world_data_s
     ALuint                         *audio_buffers;          // Samples.
     uint32_t                        audio_sources_count;    // Amount of runtime channels.
     AudioSource                    *audio_sources;          // Channels.
+    uint32_t                        free_sources_count;     // Stack of idle channels.
+    int32_t                        *free_sources;
+
+    uint32_t                        audio_voices_count;     // Channels plus virtual voices.
+    struct audio_voice_s           *audio_voices;
+    int32_t                         free_voice;             // Head of unused voices list.
+    int32_t                         voice_hash[TR_AUDIO_VOICE_HASH_SIZE];   // Voices by effect ID and emitter.
+    struct audio_voice_rank_s      *voice_ranks;            // Voices by score, made once per frame.
+    uint32_t                        voice_ranks_count;
+    uint32_t                        weakest_rank;           // Where to look for the next source to steal.
+    struct audio_voice_move_s      *voice_moves;
+    ALfloat                        *audio_buffer_lengths;   // Sample lengths in seconds, 0 - not known yet.
 
     bool                            damp_active;            // Global flag for damping BGM tracks.
     uint32_t                        stream_tracks_count;    // Amount of stream track channels.
@@ -446,7 +519,12 @@ AudioSource::AudioSource()
     effect_index = 0;
     sample_index = 0;
     sample_count = 0;
+    voice        = -1;
+    in_free_list = false;
     is_water     = false;
+    link_valid   = false;
+    gain         = 0.0f;
+    range        = 0.0f;
     alGenSources(1, &source_index);
 
     if(alIsSource(source_index))
@@ -505,6 +583,7 @@ void AudioSource::Play()
         else
         {
             alSourcei(source_index, AL_SOURCE_RELATIVE, AL_FALSE);
+            link_valid = false;
             LinkEmitter();
 
             if(audio_settings.use_effects)
@@ -534,22 +613,50 @@ void AudioSource::Stop()
     if(alIsSource(source_index))
     {
         alSourceStop(source_index);
-        active = false;
+        if(active)
+        {
+            active = false;
+            Audio_OnSourceStopped(this);
+        }
     }
 }
 
 
+ALfloat AudioSource::GetOffset()
+{
+    ALfloat offset = 0.0f;
+    alGetSourcef(source_index, AL_SEC_OFFSET, &offset);
+    return offset;
+}
+
+
+void AudioSource::SetOffset(ALfloat offset)
+{
+    alSourcef(source_index, AL_SEC_OFFSET, offset);
+}
+
+
 void AudioSource::Update()
 {
     ALint   state;
-    ALfloat range, gain;
+
+    // Inactive source was stopped already, nothing to ask OpenAL about.
+    if(!active)
+    {
+        return;
+    }
 
     alGetSourcei(source_index, AL_SOURCE_STATE, &state);
+    audio_update_stats.al_calls++;
 
     // Disable and bypass source, if it is stopped.
     if(state == AL_STOPPED)
     {
-        active = false;
+        if(active)
+        {
+            active = false;
+            Audio_OnSourceStopped(this);
+        }
         return;
     }
 
@@ -566,9 +673,6 @@ void AudioSource::Update()
         return;
     }
 
-    alGetSourcef(source_index, AL_GAIN, &gain);
-    alGetSourcef(source_index, AL_MAX_DISTANCE, &range);
-
     // Check if source is in listener's range, and if so, update position,
     // else stop and disable it.
     if(Audio_IsInRange(emitter_type, emitter_ID, range, gain))
@@ -608,7 +712,7 @@ void AudioSource::SetBuffer(ALint buffer)
             alGetBufferi(buffer_index, AL_BITS,      &bits);
             alGetBufferi(buffer_index, AL_FREQUENCY, &freq);
 
-            Sys_DebugLog(SYS_LOG_FILENAME, "Erroneous buffer %d info: CH%d, B%d, F%d", buffer_index, channels, bits, freq);
+            Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "Erroneous buffer %d info: CH%d, B%d, F%d", buffer_index, channels, bits, freq);
         }
         */
     }
@@ -627,7 +731,8 @@ void AudioSource::SetGain(ALfloat gain_value)
     gain_value = (gain_value > 1.0) ? (1.0) : (gain_value);
     gain_value = (gain_value < 0.0) ? (0.0) : (gain_value);
 
-    alSourcef(source_index, AL_GAIN, gain_value * audio_settings.sound_volume);
+    gain = gain_value * audio_settings.sound_volume;
+    alSourcef(source_index, AL_GAIN, gain);
 }
 
 
@@ -644,6 +749,7 @@ void AudioSource::SetPitch(ALfloat pitch_value)
 void AudioSource::SetRange(ALfloat range_value)
 {
     // Source will become fully audible on 1/6 of overall position.
+    range = range_value;
     alSourcef(source_index, AL_REFERENCE_DISTANCE, range_value / 6.0);
     alSourcef(source_index, AL_MAX_DISTANCE, range_value);
 }
@@ -651,13 +757,23 @@ void AudioSource::SetRange(ALfloat range_value)
 
 void AudioSource::SetPosition(const ALfloat pos_vector[])
 {
-    alSourcefv(source_index, AL_POSITION, pos_vector);
+    if(!link_valid || (vec3_dist_sq(position, pos_vector) > TR_AUDIO_POSITION_EPSILON * TR_AUDIO_POSITION_EPSILON))
+    {
+        vec3_copy(position, pos_vector);
+        alSourcefv(source_index, AL_POSITION, pos_vector);
+        audio_update_stats.al_calls++;
+    }
 }
 
 
 void AudioSource::SetVelocity(const ALfloat vel_vector[])
 {
-    alSourcefv(source_index, AL_VELOCITY, vel_vector);
+    if(!link_valid || (vec3_dist_sq(velocity, vel_vector) > TR_AUDIO_POSITION_EPSILON * TR_AUDIO_POSITION_EPSILON))
+    {
+        vec3_copy(velocity, vel_vector);
+        alSourcefv(source_index, AL_VELOCITY, vel_vector);
+        audio_update_stats.al_calls++;
+    }
 }
 
 
@@ -676,11 +792,13 @@ void AudioSource::LinkEmitter()
                 SetPosition(vec);
                 vec3_copy(vec, ent->speed);
                 SetVelocity(vec);
+                link_valid = true;
             }
             return;
 
         case TR_AUDIO_EMITTER_SOUNDSOURCE:
             SetPosition(audio_world_data.audio_emitters[emitter_ID].position);
+            link_valid = true;
             return;
     }
 }
@@ -696,14 +814,14 @@ void Audio_CoreInit()
     al_device = alcOpenDevice(NULL);
     if (!al_device)
     {
-        Sys_DebugLog(SYS_LOG_FILENAME, "InitAL: No AL audio devices!");
+        Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "InitAL: No AL audio devices!");
         return;
     }
 
     al_context = alcCreateContext(al_device, paramList);
     if(!alcMakeContextCurrent(al_context))
     {
-        Sys_DebugLog(SYS_LOG_FILENAME, "InitAL: AL context is not current!");
+        Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "InitAL: AL context is not current!");
         return;
     }
 
@@ -1002,9 +1120,8 @@ int  Audio_ResumeStreams(int stream_type)
 
 
 // ======== Audio source global methods ========
-int  Audio_IsInRange(int entity_type, int entity_ID, float range, float gain)
+int  Audio_GetEmitterPosition(int entity_type, int entity_ID, ALfloat pos[3])
 {
-    ALfloat  vec[3] = {0.0, 0.0, 0.0}, dist;
     entity_p ent;
 
     switch(entity_type)
@@ -1015,22 +1132,38 @@ int  Audio_IsInRange(int entity_type, int entity_ID, float range, float gain)
             {
                 return 0;
             }
-            vec3_copy(vec, ent->transform.M4x4 + 12);
-            break;
+            vec3_copy(pos, ent->transform.M4x4 + 12);
+            return 1;
 
         case TR_AUDIO_EMITTER_SOUNDSOURCE:
             if((uint32_t)entity_ID + 1 > audio_world_data.audio_emitters_count)
             {
                 return 0;
             }
-            vec3_copy(vec, audio_world_data.audio_emitters[entity_ID].position);
-            break;
+            vec3_copy(pos, audio_world_data.audio_emitters[entity_ID].position);
+            return 1;
 
         case TR_AUDIO_EMITTER_GLOBAL:
+            vec3_copy(pos, listener_position);
             return 1;
+    }
 
-        default:
-            return 0;
+    return 0;
+}
+
+
+int  Audio_IsInRange(int entity_type, int entity_ID, float range, float gain)
+{
+    ALfloat  vec[3] = {0.0, 0.0, 0.0}, dist;
+
+    if(entity_type == TR_AUDIO_EMITTER_GLOBAL)
+    {
+        return 1;
+    }
+
+    if(!Audio_GetEmitterPosition(entity_type, entity_ID, vec))
+    {
+        return 0;
     }
 
     dist = vec3_dist_sq(listener_position, vec);
@@ -1052,10 +1185,40 @@ void Audio_UpdateSources()
     }
 
     alGetListenerfv(AL_POSITION, listener_position);
+    audio_update_stats.al_calls++;
+    audio_update_stats.frames++;
 
-    for(uint32_t i = 0; i < audio_world_data.audio_emitters_count; i++)
+    if(audio_world_data.emitter_culling)
+    {
+        audio_emitter_group_p g = audio_world_data.emitter_groups;
+        for(uint32_t i = 0; i < audio_world_data.emitter_groups_count; i++, g++)
+        {
+            // Distance from listener to the group box.
+            ALfloat d, dist = 0.0f;
+            for(int j = 0; j < 3; j++)
+            {
+                d = (listener_position[j] < g->bb_min[j]) ? (g->bb_min[j] - listener_position[j]) :
+                    ((listener_position[j] > g->bb_max[j]) ? (listener_position[j] - g->bb_max[j]) : (0.0f));
+                dist += d * d;
+            }
+            if(dist < g->radius * g->radius)
+            {
+                for(uint32_t j = g->first; j < g->first + g->count; j++)
+                {
+                    uint32_t emitter = audio_world_data.emitter_order[j];
+                    Audio_Send(audio_world_data.audio_emitters[emitter].sound_index, TR_AUDIO_EMITTER_SOUNDSOURCE, emitter);
+                }
+                audio_update_stats.emitters_sent += g->count;
+            }
+        }
+    }
+    else
     {
-        Audio_Send(audio_world_data.audio_emitters[i].sound_index, TR_AUDIO_EMITTER_SOUNDSOURCE, i);
+        for(uint32_t i = 0; i < audio_world_data.audio_emitters_count; i++)
+        {
+            Audio_Send(audio_world_data.audio_emitters[i].sound_index, TR_AUDIO_EMITTER_SOUNDSOURCE, i);
+        }
+        audio_update_stats.emitters_sent += audio_world_data.audio_emitters_count;
     }
 
     for(uint32_t i = 0; i < audio_world_data.audio_sources_count; i++)
@@ -1083,6 +1246,16 @@ void Audio_StopAllSources()
     {
         audio_world_data.audio_sources[i].Stop();
     }
+
+    // Virtual voices have no sources, drop them too.
+    for(uint32_t i = 0; i < audio_world_data.audio_voices_count; i++)
+    {
+        audio_voice_p v = audio_world_data.audio_voices + i;
+        if(v->effect_index != TR_AUDIO_VOICE_UNUSED)
+        {
+            Audio_ReleaseVoice(v);
+        }
+    }
 }
 
 
@@ -1098,10 +1271,13 @@ void Audio_ResumeAllSources()
 }
 
 
-int Audio_GetFreeSource()   ///@FIXME: add condition (compare max_dist with new source dist)
+int Audio_GetFreeSource()
 {
-    for(uint32_t i = 0; i < audio_world_data.audio_sources_count; i++)
+    // Stack may hold sources which were restarted meanwhile, skip them.
+    while(audio_world_data.free_sources_count > 0)
     {
+        int32_t i = audio_world_data.free_sources[--audio_world_data.free_sources_count];
+        audio_world_data.audio_sources[i].in_free_list = false;
         if(audio_world_data.audio_sources[i].IsActive() == false)
         {
             return i;
@@ -1112,21 +1288,208 @@ int Audio_GetFreeSource()   ///@FIXME: add condition (compare max_dist with new
 }
 
 
-int Audio_IsEffectPlaying(int effect_ID, int entity_type, int entity_ID)
+void Audio_OnSourceStopped(AudioSource *source)
 {
-    for(uint32_t i = 0; i < audio_world_data.audio_sources_count; i++)
+    if(source->voice >= 0)
+    {
+        audio_voice_p v = audio_world_data.audio_voices + source->voice;
+        v->source = -1;
+        source->voice = -1;
+        Audio_ReleaseVoice(v);
+    }
+
+    if(!source->in_free_list)
+    {
+        source->in_free_list = true;
+        audio_world_data.free_sources[audio_world_data.free_sources_count++] = source - audio_world_data.audio_sources;
+    }
+}
+
+
+static uint32_t Audio_VoiceHash(int effect_ID, int entity_type, int entity_ID)
+{
+    uint32_t h = (uint32_t)effect_ID * 2654435761u;
+    h ^= ((uint32_t)entity_ID * 40503u) + (uint32_t)entity_type;
+    return (h ^ (h >> 16)) & (TR_AUDIO_VOICE_HASH_SIZE - 1);
+}
+
+
+audio_voice_p Audio_FindVoice(int effect_ID, int entity_type, int entity_ID)
+{
+    int32_t i = audio_world_data.voice_hash[Audio_VoiceHash(effect_ID, entity_type, entity_ID)];
+    while(i >= 0)
+    {
+        audio_voice_p v = audio_world_data.audio_voices + i;
+        if((v->effect_index == (uint32_t)effect_ID) && (v->emitter_type == (uint32_t)entity_type) && (v->emitter_ID == entity_ID))
+        {
+            return v;
+        }
+        i = v->next;
+    }
+
+    return NULL;
+}
+
+
+static audio_voice_p Audio_AllocVoice(int effect_ID, int entity_type, int entity_ID)
+{
+    audio_voice_p v;
+    uint32_t hash;
+
+    if(audio_world_data.free_voice < 0)
+    {
+        return NULL;
+    }
+
+    v = audio_world_data.audio_voices + audio_world_data.free_voice;
+    audio_world_data.free_voice = v->next;
+    hash = Audio_VoiceHash(effect_ID, entity_type, entity_ID);
+    v->effect_index = effect_ID;
+    v->emitter_type = entity_type;
+    v->emitter_ID = entity_ID;
+    v->source = -1;
+    v->offset = 0.0f;
+    v->next = audio_world_data.voice_hash[hash];
+    audio_world_data.voice_hash[hash] = v - audio_world_data.audio_voices;
+
+    return v;
+}
+
+
+void Audio_ReleaseVoice(audio_voice_p voice)
+{
+    int32_t index = voice - audio_world_data.audio_voices;
+    int32_t *link = audio_world_data.voice_hash + Audio_VoiceHash(voice->effect_index, voice->emitter_type, voice->emitter_ID);
+
+    while(*link >= 0)
     {
-        if( (audio_world_data.audio_sources[i].emitter_type == (uint32_t)entity_type) &&
-            (audio_world_data.audio_sources[i].emitter_ID   == ( int32_t)entity_ID  ) &&
-            (audio_world_data.audio_sources[i].effect_index == (uint32_t)effect_ID  ) &&
-            audio_world_data.audio_sources[i].IsActive())
+        if(*link == index)
+        {
+            *link = voice->next;
+            break;
+        }
+        link = &audio_world_data.audio_voices[*link].next;
+    }
+
+    if(voice->source >= 0)
+    {
+        AudioSource *source = audio_world_data.audio_sources + voice->source;
+        voice->source = -1;
+        source->voice = -1;
+        source->Stop();
+    }
+
+    voice->effect_index = TR_AUDIO_VOICE_UNUSED;
+    voice->next = audio_world_data.free_voice;
+    audio_world_data.free_voice = index;
+}
+
+
+static ALfloat Audio_GetBufferLength(uint32_t buffer_index)
+{
+    ALfloat *len = audio_world_data.audio_buffer_lengths + buffer_index;
+    if(*len <= 0.0f)
+    {
+        ALint size = 0, bits = 8, channels = 1, freq = 0;
+        ALuint buffer = audio_world_data.audio_buffers[buffer_index];
+        alGetBufferi(buffer, AL_SIZE, &size);
+        alGetBufferi(buffer, AL_BITS, &bits);
+        alGetBufferi(buffer, AL_CHANNELS, &channels);
+        alGetBufferi(buffer, AL_FREQUENCY, &freq);
+        if((bits > 0) && (channels > 0) && (freq > 0))
         {
-            ALint state;
-            alGetSourcei(audio_world_data.audio_sources[i].source_index, AL_SOURCE_STATE, &state);
-            if(state == AL_PLAYING)
+            *len = (ALfloat)size / (ALfloat)(channels * (bits / 8) * freq);
+        }
+    }
+    return *len;
+}
+
+
+/**
+ * Voice score is its priority times audibility (distance attenuation times gain),
+ * one-shot voices lose half of their weight as they get older.
+ */
+static ALfloat Audio_GetVoiceScore(audio_voice_p v)
+{
+    ALfloat pos[3], score = v->gain;
+
+    switch(v->emitter_type)
+    {
+        case TR_AUDIO_EMITTER_GLOBAL:
+            score *= 2.0f;
+            break;
+
+        case TR_AUDIO_EMITTER_ENTITY:
+            score *= 1.5f;
+            // no break, entities and sound sources are attenuated the same way
+        default:
+            if(Audio_GetEmitterPosition(v->emitter_type, v->emitter_ID, pos))
+            {
+                // Same as AL_LINEAR_DISTANCE_CLAMPED with reference distance of 1/6 range.
+                ALfloat dist = vec3_dist(listener_position, pos);
+                ALfloat ref = v->range / 6.0f;
+                if(dist >= v->range)
+                {
+                    return 0.0f;
+                }
+                score *= (dist > ref) ? ((v->range - dist) / (v->range - ref)) : (1.0f);
+            }
+            else
             {
-                return i;
+                return 0.0f;
             }
+            break;
+    }
+
+    if(!v->looped && (v->length > 0.0f))
+    {
+        ALfloat played = (v->source >= 0) ? (audio_world_data.audio_sources[v->source].GetOffset()) : (v->offset);
+        ALfloat left = 1.0f - played / v->length;
+        score *= 0.5f + 0.5f * ((left > 0.0f) ? (left) : (0.0f));
+    }
+
+    return score;
+}
+
+
+/**
+ * Makes the voice of given rank virtual and returns its source, or -1 if the
+ * voice lost its source since the ranks were made.
+ */
+static int Audio_TakeRankSource(audio_voice_rank_p rank)
+{
+    audio_voice_p v = audio_world_data.audio_voices + rank->voice;
+    AudioSource *source;
+
+    if((rank->source < 0) || (v->source != rank->source))
+    {
+        return -1;
+    }
+
+    source = audio_world_data.audio_sources + v->source;
+    v->offset = source->GetOffset();
+    v->source = -1;
+    source->voice = -1;
+    source->Stop();
+    rank->source = -1;
+    return Audio_GetFreeSource();
+}
+
+
+/**
+ * Makes the weakest real voice virtual, if its score is below given one; returns freed source.
+ * Scores are the ones of the last voices update, nothing is asked from OpenAL.
+ */
+static int Audio_StealSource(ALfloat score)
+{
+    int32_t r;
+
+    while((r = Audio_FindWeakestRank(audio_world_data.voice_ranks, &audio_world_data.weakest_rank, score)) >= 0)
+    {
+        int source_number = Audio_TakeRankSource(audio_world_data.voice_ranks + r);
+        if(source_number >= 0)
+        {
+            return source_number;
         }
     }
 
@@ -1134,13 +1497,132 @@ int Audio_IsEffectPlaying(int effect_ID, int entity_type, int entity_ID)
 }
 
 
+static void Audio_StartVoice(audio_voice_p v, int source_number)
+{
+    AudioSource *source = audio_world_data.audio_sources + source_number;
+
+    source->SetBuffer(v->buffer_index);
+    source->SetLooping(v->looped);
+    source->emitter_ID   = v->emitter_ID;
+    source->emitter_type = v->emitter_type;
+    source->effect_index = v->effect_index;
+    source->SetPitch(v->pitch);
+    source->SetGain(v->gain);
+    source->SetRange(v->range);
+    source->Play();
+    if(v->offset > 0.0f)
+    {
+        source->SetOffset(v->offset);
+    }
+
+    if(source->IsActive())
+    {
+        source->voice = v - audio_world_data.audio_voices;
+        v->source = source_number;
+    }
+    else
+    {
+        Audio_OnSourceStopped(source);
+    }
+}
+
+
+/**
+ * Advances virtual voices, scores every voice once and gives sources to the best of them.
+ */
+void Audio_UpdateVoices(float time)
+{
+    audio_voice_rank_p ranks = audio_world_data.voice_ranks;
+    audio_voice_move_p moves = audio_world_data.voice_moves;
+    uint32_t ranks_count = 0;
+    uint32_t moves_count;
+
+    for(uint32_t i = 0; i < audio_world_data.audio_voices_count; i++)
+    {
+        audio_voice_p v = audio_world_data.audio_voices + i;
+        if(v->effect_index == TR_AUDIO_VOICE_UNUSED)
+        {
+            continue;
+        }
+
+        if(v->source < 0)
+        {
+            v->offset += time * v->pitch;
+            if((v->length > 0.0f) && (v->offset >= v->length))
+            {
+                if(!v->looped)
+                {
+                    Audio_ReleaseVoice(v);
+                    continue;
+                }
+                v->offset = fmodf(v->offset, v->length);
+            }
+
+            if(!Audio_IsInRange(v->emitter_type, v->emitter_ID, v->range, v->gain))
+            {
+                Audio_ReleaseVoice(v);
+                continue;
+            }
+        }
+
+        ranks[ranks_count].voice = i;
+        ranks[ranks_count].source = v->source;
+        ranks[ranks_count].score = Audio_GetVoiceScore(v);
+        ranks_count++;
+    }
+
+    Audio_SortVoiceRanks(ranks, ranks_count);
+    audio_world_data.voice_ranks_count = ranks_count;
+    audio_world_data.weakest_rank = ranks_count;
+
+    // Free stack may hold restarted sources, then the planned move steals instead.
+    moves_count = Audio_PlanVoiceMoves(ranks, ranks_count, audio_world_data.free_sources_count, TR_AUDIO_VOICE_STEAL_MARGIN, moves);
+    for(uint32_t i = 0; i < moves_count; i++)
+    {
+        audio_voice_rank_p rank = ranks + moves[i].rank;
+        int source_number = (moves[i].victim >= 0) ? (Audio_TakeRankSource(ranks + moves[i].victim)) : (Audio_GetFreeSource());
+
+        if(source_number == -1)
+        {
+            source_number = Audio_StealSource(rank->score / TR_AUDIO_VOICE_STEAL_MARGIN);
+        }
+        if(source_number == -1)
+        {
+            break;
+        }
+        Audio_StartVoice(audio_world_data.audio_voices + rank->voice, source_number);
+        rank->source = audio_world_data.audio_voices[rank->voice].source;
+    }
+}
+
+
+int Audio_IsEffectPlaying(int effect_ID, int entity_type, int entity_ID)
+{
+    audio_voice_p v = Audio_FindVoice(effect_ID, entity_type, entity_ID);
+
+    if(v && (v->source >= 0))
+    {
+        ALint state;
+        alGetSourcei(audio_world_data.audio_sources[v->source].source_index, AL_SOURCE_STATE, &state);
+        audio_update_stats.al_calls++;
+        if(state != AL_PLAYING)
+        {
+            return -1;
+        }
+    }
+
+    return (v) ? (v - audio_world_data.audio_voices) : (-1);
+}
+
+
 int Audio_Send(int effect_ID, int entity_type, int entity_ID)
 {
     int32_t         source_number;
+    int32_t         voice_number;
     uint16_t        random_value;
     ALfloat         random_float;
     audio_effect_p  effect = NULL;
-    AudioSource    *source = NULL;
+    audio_voice_p   voice = NULL;
 
     // If there are no audio buffers or effect index is wrong, don't process.
     if((audio_world_data.audio_buffers_count < 1) || (effect_ID < 0))
@@ -1190,111 +1672,144 @@ int Audio_Send(int effect_ID, int entity_type, int entity_ID)
     }
 
     // Pre-step 4: check if R (Rewind) flag is set for this effect, if so,
-    // find any effect with similar ID playing for this entity, and stop it.
+    // find any effect with similar ID playing for this entity, and restart it.
     // Otherwise, if W (Wait) or L (Looped) flag is set, and same effect is
-    // playing for current entity, don't send it and exit function.
+    // playing (or is virtual) for current entity, don't send it and exit function.
 
-    source_number = Audio_IsEffectPlaying(effect_ID, entity_type, entity_ID);
+    voice_number = Audio_IsEffectPlaying(effect_ID, entity_type, entity_ID);
+    voice = Audio_FindVoice(effect_ID, entity_type, entity_ID);
 
-    if(source_number != -1)
+    if(voice_number != -1)
     {
-        if(effect->loop == TR_AUDIO_LOOP_REWIND)
+        if((effect->loop != TR_AUDIO_LOOP_REWIND) && effect->loop) // Any other looping case (Wait / Loop).
         {
-            audio_world_data.audio_sources[source_number].Stop();
+            return TR_AUDIO_SEND_IGNORED;
         }
-        else if(effect->loop) // Any other looping case (Wait / Loop).
+    }
+
+    if(voice)
+    {
+        // Restart on the same source: it is the last one pushed to free stack.
+        if(voice->source >= 0)
         {
-            return TR_AUDIO_SEND_IGNORED;
+            AudioSource *source = audio_world_data.audio_sources + voice->source;
+            voice->source = -1;
+            source->voice = -1;
+            source->Stop();
         }
+        voice->offset = 0.0f;
     }
     else
     {
-        source_number = Audio_GetFreeSource();  // Get free source.
+        voice = Audio_AllocVoice(effect_ID, entity_type, entity_ID);
+        if(!voice)
+        {
+            return TR_AUDIO_SEND_NOCHANNEL;
+        }
     }
 
-    if(source_number != -1)  // Everything is OK, we're sending audio to channel.
-    {
-        int buffer_index;
+    // Step 1. Select buffer.
 
-        // Step 1. Assign buffer to source.
+    if(effect->sample_count > 1)
+    {
+        // Select random buffer, if effect info contains more than 1 assigned samples.
+        random_value = rand() % (effect->sample_count);
+        voice->buffer_index = random_value + effect->sample_index;
+    }
+    else
+    {
+        // Just assign buffer to source, if there is only one assigned sample.
+        voice->buffer_index = effect->sample_index;
+    }
+    voice->length = Audio_GetBufferLength(voice->buffer_index);
 
-        if(effect->sample_count > 1)
-        {
-            // Select random buffer, if effect info contains more than 1 assigned samples.
-            random_value = rand() % (effect->sample_count);
-            buffer_index = random_value + effect->sample_index;
-        }
-        else
-        {
-            // Just assign buffer to source, if there is only one assigned sample.
-            buffer_index = effect->sample_index;
-        }
+    // Step 2. Check looped flag, and if so, set voice type to looped.
 
-        source = &audio_world_data.audio_sources[source_number];
+    voice->looped = (effect->loop == TR_AUDIO_LOOP_LOOPED) ? (AL_TRUE) : (AL_FALSE);
 
-        source->SetBuffer(buffer_index);
+    // Step 3. Apply sound effect properties.
 
-        // Step 2. Check looped flag, and if so, set source type to looped.
+    if(effect->rand_pitch)  // Vary pitch, if flag is set.
+    {
+        random_float = rand() % effect->rand_pitch_var;
+        voice->pitch = effect->pitch + ((random_float - 25.0) / 200.0);
+    }
+    else
+    {
+        voice->pitch = effect->pitch;
+    }
 
-        if(effect->loop == TR_AUDIO_LOOP_LOOPED)
-        {
-            source->SetLooping(AL_TRUE);
-        }
-        else
-        {
-            source->SetLooping(AL_FALSE);
-        }
+    if(effect->rand_gain)   // Vary gain, if flag is set.
+    {
+        random_float = rand() % effect->rand_gain_var;
+        voice->gain = effect->gain + (random_float - 25.0) / 200.0;
+    }
+    else
+    {
+        voice->gain = effect->gain;
+    }
 
-        // Step 3. Apply internal sound parameters.
+    voice->range = effect->range;
 
-        source->emitter_ID   = entity_ID;
-        source->emitter_type = entity_type;
-        source->effect_index = effect_ID;
+    // Step 4. Get free source, or take one from the voice that scores lower;
+    // otherwise the voice stays virtual until some source is available.
 
-        // Step 4. Apply sound effect properties.
+    source_number = Audio_GetFreeSource();
+    if(source_number == -1)
+    {
+        source_number = Audio_StealSource(Audio_GetVoiceScore(voice));
+    }
 
-        if(effect->rand_pitch)  // Vary pitch, if flag is set.
-        {
-            random_float = rand() % effect->rand_pitch_var;
-            random_float = effect->pitch + ((random_float - 25.0) / 200.0);
-            source->SetPitch(random_float);
-        }
-        else
-        {
-            source->SetPitch(effect->pitch);
-        }
+    if(source_number != -1)
+    {
+        Audio_StartVoice(voice, source_number);
+    }
 
-        if(effect->rand_gain)   // Vary gain, if flag is set.
-        {
-            random_float = rand() % effect->rand_gain_var;
-            random_float = effect->gain + (random_float - 25.0) / 200.0;
-            source->SetGain(random_float);
-        }
-        else
-        {
-            source->SetGain(effect->gain);
-        }
+    return TR_AUDIO_SEND_PROCESSED;
+}
 
-        source->SetRange(effect->range);    // Set audible range.
 
-        source->Play();                     // Everything is OK, play sound now!
+void Audio_GetVoiceStats(struct audio_voice_stats_s *stats)
+{
+    stats->real_voices = 0;
+    stats->virtual_voices = 0;
+    stats->free_sources = 0;
+    stats->min_real_score = 0.0f;
+    stats->max_virtual_score = 0.0f;
 
-        return TR_AUDIO_SEND_PROCESSED;
+    for(uint32_t i = 0; i < audio_world_data.audio_sources_count; i++)
+    {
+        stats->free_sources += (audio_world_data.audio_sources[i].IsActive()) ? (0) : (1);
     }
-    else
+
+    for(uint32_t i = 0; i < audio_world_data.audio_voices_count; i++)
     {
-        return TR_AUDIO_SEND_NOCHANNEL;
+        audio_voice_p v = audio_world_data.audio_voices + i;
+        if(v->effect_index != TR_AUDIO_VOICE_UNUSED)
+        {
+            ALfloat score = Audio_GetVoiceScore(v);
+            if(v->source >= 0)
+            {
+                stats->min_real_score = (!stats->real_voices || (score < stats->min_real_score)) ? (score) : (stats->min_real_score);
+                stats->real_voices++;
+            }
+            else
+            {
+                stats->max_virtual_score = (score > stats->max_virtual_score) ? (score) : (stats->max_virtual_score);
+                stats->virtual_voices++;
+            }
+        }
     }
 }
 
 
 int Audio_Kill(int effect_ID, int entity_type, int entity_ID)
 {
-    int playing_sound = Audio_IsEffectPlaying(effect_ID, entity_type, entity_ID);
+    audio_voice_p voice = Audio_FindVoice(effect_ID, entity_type, entity_ID);
 
-    if(playing_sound != -1)
+    if(voice)
     {
-        audio_world_data.audio_sources[playing_sound].Stop();
+        Audio_ReleaseVoice(voice);
         return TR_AUDIO_SEND_PROCESSED;
     }
 
@@ -1343,10 +1858,25 @@ void Audio_InitGlobals()
     audio_settings.music_volume = 0.7;
     audio_settings.sound_volume = 0.8;
     audio_settings.use_effects  = true;
+    audio_settings.use_pcm_cache = true;
     audio_settings.listener_is_player = false;
 
     audio_world_data.audio_sources = NULL;
     audio_world_data.audio_sources_count = 0;
+    audio_world_data.free_sources = NULL;
+    audio_world_data.free_sources_count = 0;
+    audio_world_data.emitter_groups = NULL;
+    audio_world_data.emitter_groups_count = 0;
+    audio_world_data.emitter_order = NULL;
+    audio_world_data.emitter_culling = true;
+    audio_world_data.audio_voices = NULL;
+    audio_world_data.audio_voices_count = 0;
+    audio_world_data.free_voice = -1;
+    audio_world_data.voice_ranks = NULL;
+    audio_world_data.voice_ranks_count = 0;
+    audio_world_data.weakest_rank = 0;
+    audio_world_data.voice_moves = NULL;
+    audio_world_data.audio_buffer_lengths = NULL;
     audio_world_data.audio_buffers = NULL;
     audio_world_data.audio_buffers_count = 0;
     audio_world_data.audio_effects = NULL;
@@ -1371,6 +1901,34 @@ void Audio_Init(uint32_t num_Sources)
     num_Sources -= TR_AUDIO_STREAM_NUMSOURCES;          // Subtract sources reserved for music.
     audio_world_data.audio_sources_count = num_Sources;
     audio_world_data.audio_sources = new AudioSource[num_Sources];
+    audio_world_data.free_sources = (int32_t*)malloc(num_Sources * sizeof(int32_t));
+    audio_world_data.free_sources_count = 0;
+    for(uint32_t i = num_Sources; i > 0; --i)
+    {
+        audio_world_data.audio_sources[i - 1].in_free_list = true;
+        audio_world_data.free_sources[audio_world_data.free_sources_count++] = i - 1;
+    }
+
+    // Generate voices: one per source plus virtual ones.
+    audio_world_data.audio_voices_count = num_Sources + TR_AUDIO_MAX_VIRTUAL_VOICES;
+    audio_world_data.audio_voices = (audio_voice_p)malloc(audio_world_data.audio_voices_count * sizeof(audio_voice_t));
+    for(uint32_t i = 0; i < audio_world_data.audio_voices_count; ++i)
+    {
+        audio_world_data.audio_voices[i].effect_index = TR_AUDIO_VOICE_UNUSED;
+        audio_world_data.audio_voices[i].source = -1;
+        audio_world_data.audio_voices[i].next = i + 1;
+    }
+    audio_world_data.audio_voices[audio_world_data.audio_voices_count - 1].next = -1;
+    audio_world_data.free_voice = 0;
+    audio_world_data.voice_ranks = (audio_voice_rank_p)malloc(audio_world_data.audio_voices_count * sizeof(audio_voice_rank_t));
+    audio_world_data.voice_ranks_count = 0;
+    audio_world_data.weakest_rank = 0;
+    audio_world_data.voice_moves = (audio_voice_move_p)malloc(audio_world_data.audio_voices_count * sizeof(audio_voice_move_t));
+    for(uint32_t i = 0; i < TR_AUDIO_VOICE_HASH_SIZE; ++i)
+    {
+        audio_world_data.voice_hash[i] = -1;
+    }
+    audio_world_data.audio_buffer_lengths = (ALfloat*)calloc(audio_world_data.audio_buffers_count + 1, sizeof(ALfloat));
 
     // Generate stream tracks array.
     audio_world_data.stream_tracks_count = TR_AUDIO_STREAM_NUMSOURCES - 1;
@@ -1399,12 +1957,405 @@ void Audio_CacheTrack(int id)
 }
 
 
+// ======== Level samples decoding ========
+// One sample of the level sample block: where its WAV data lies and what it decodes to.
+
+typedef struct audio_sample_job_s
+{
+    const uint8_t  *data;
+    uint32_t        size;
+    uint32_t        uncomp_size;    // Raw sample length to keep, 0 - all of it.
+    uint8_t        *pcm;            // NULL if decoding failed.
+    uint32_t        pcm_size;
+    int             bits;
+    int             channels;
+    int             freq;
+    int             cached;
+}audio_sample_job_t, *audio_sample_job_p;
+
+typedef struct audio_sample_decode_s
+{
+    audio_sample_job_p  jobs;
+    uint32_t            count;
+    SDL_atomic_t        next;
+    const char         *cache_path;
+}audio_sample_decode_t, *audio_sample_decode_p;
+
+typedef struct audio_pcm_cache_header_s
+{
+    uint32_t    magic;
+    uint32_t    bits;
+    uint32_t    channels;
+    uint32_t    freq;
+    uint32_t    size;
+}audio_pcm_cache_header_t, *audio_pcm_cache_header_p;
+
+
+/**
+ * Splits level sample block into samples. Different TR versions have different ways of storing samples.
+ * TR1:     sample block size, sample block, num samples, sample offsets.
+ * TR2/TR3: num samples, sample offsets. (Sample block is in MAIN.SFX.)
+ * TR4/TR5: num samples, (uncomp_size-comp_size-sample_data) chain.
+ */
+static audio_sample_job_p Audio_GetSampleJobs(class VT_Level *tr, uint32_t *jobs_count)
+{
+    audio_sample_job_p jobs = (audio_sample_job_p)calloc(tr->samples_count + 1, sizeof(audio_sample_job_t));
+    uint8_t *pointer = tr->samples_data;
+    uint32_t ind1, ind2, i = 0;
+    int8_t flag;
+
+    switch(tr->game_version)
+    {
+        case TR_I:
+        case TR_I_DEMO:
+        case TR_I_UB:
+            for(i = 0; i < tr->samples_count; i++)
+            {
+                uint32_t end = (i + 1 < tr->samples_count) ? (tr->sample_indices[i + 1]) : (tr->samples_data_size);
+                jobs[i].data = tr->samples_data + tr->sample_indices[i];
+                jobs[i].size = end - tr->sample_indices[i];
+            }
+            break;
+
+        case TR_II:
+        case TR_II_DEMO:
+        case TR_III:
+            ind1 = 0;
+            ind2 = 0;
+            flag = 0;
+            while(pointer < tr->samples_data + tr->samples_data_size - 4)
+            {
+                pointer = tr->samples_data + ind2;
+                if(!memcmp(pointer, "RIFF", 4))
+                {
+                    if(flag == 0x00)
+                    {
+                        ind1 = ind2;
+                        flag = 0x01;
+                    }
+                    else
+                    {
+                        jobs[i].data = tr->samples_data + ind1;
+                        jobs[i].size = ind2 - ind1;
+                        i++;
+                        if(i > tr->samples_count - 1)
+                        {
+                            break;
+                        }
+                        ind1 = ind2;
+                    }
+                }
+                ind2++;
+            }
+            if(i < tr->samples_count)
+            {
+                jobs[i].data = tr->samples_data + ind1;
+                jobs[i].size = tr->samples_data_size - ind1;
+                i++;
+            }
+            break;
+
+        case TR_IV:
+        case TR_IV_DEMO:
+        case TR_V:
+            for(i = 0; i < tr->samples_count; i++)
+            {
+                // Always use comp_size as block length, as uncomp_size is used to cut raw sample data.
+                jobs[i].uncomp_size = *((uint32_t*)pointer);
+                pointer += 4;
+                jobs[i].size = *((uint32_t*)pointer);
+                pointer += 4;
+                jobs[i].data = pointer;
+                pointer += jobs[i].size;
+            }
+            break;
+
+        default:
+            i = 0;
+            break;
+    }
+
+    *jobs_count = i;
+    return jobs;
+}
+
+
+static uint64_t Audio_SampleHash(audio_sample_job_p job)
+{
+    uint64_t hash = 0xCBF29CE484222325;             // FNV-1a
+    for(uint32_t i = 0; i < job->size; i++)
+    {
+        hash = (hash ^ job->data[i]) * 0x100000001B3;
+    }
+    return (hash ^ job->uncomp_size) * 0x100000001B3;
+}
+
+
+static void Audio_DecodeSample(audio_sample_job_p job, const char *cache_path)
+{
+    char path[1024];
+    FILE *f;
+    audio_pcm_cache_header_t header;
+    SDL_AudioSpec wav_spec;
+    Uint8 *wav_buffer;
+    Uint32 wav_length;
+
+    if(!job->data || !job->size)
+    {
+        return;
+    }
+
+    if(cache_path)
+    {
+        snprintf(path, sizeof(path), "%spcm_%016llx.bin", cache_path, (unsigned long long)Audio_SampleHash(job));
+        f = fopen(path, "rb");
+        if(f)
+        {
+            long file_size = -1;
+            if(fseek(f, 0, SEEK_END) == 0)
+            {
+                file_size = ftell(f);
+                fseek(f, 0, SEEK_SET);
+            }
+
+            // A cut or foreign file must not make us allocate whatever its header says.
+            if((file_size >= (long)sizeof(header)) && (fread(&header, sizeof(header), 1, f) == 1) &&
+               (header.magic == TR_AUDIO_PCM_CACHE_MAGIC) && (header.size <= (unsigned long)file_size - sizeof(header)) &&
+               (job->pcm = (uint8_t*)malloc(header.size + 1)))
+            {
+                if(fread(job->pcm, 1, header.size, f) == header.size)
+                {
+                    job->pcm_size = header.size;
+                    job->bits = header.bits;
+                    job->channels = header.channels;
+                    job->freq = header.freq;
+                    job->cached = 1;
+                    fclose(f);
+                    return;
+                }
+                free(job->pcm);
+                job->pcm = NULL;
+            }
+            fclose(f);
+        }
+    }
+
+    // SDL automatically defines file format (PCM/ADPCM), so we shouldn't bother
+    // about if it is TR4 compressed samples or TRLE uncompressed samples.
+    if(SDL_LoadWAV_RW(SDL_RWFromConstMem(job->data, job->size), 1, &wav_spec, &wav_buffer, &wav_length) == NULL)
+    {
+        return;
+    }
+
+    // Full-sized TR4/5 ADPCM sample contains a bit of silence at the end, which uncomp_size
+    // cuts off; many TR5 uncomp sizes are more than actual sample size, so those are ignored.
+    job->pcm_size = ((job->uncomp_size == 0) || (wav_length < job->uncomp_size)) ? (wav_length) : (job->uncomp_size);
+    job->pcm = (uint8_t*)malloc(job->pcm_size + 1);
+    if(!job->pcm)
+    {
+        job->pcm_size = 0;
+        SDL_FreeWAV(wav_buffer);
+        return;
+    }
+    memcpy(job->pcm, wav_buffer, job->pcm_size);
+    job->bits = wav_spec.format & SDL_AUDIO_MASK_BITSIZE;
+    job->channels = wav_spec.channels;
+    job->freq = wav_spec.freq;
+    SDL_FreeWAV(wav_buffer);
+
+    // Written aside and moved in place, so a reader never sees a half written file;
+    // same samples of one level may be decoded at once, hence the thread in the name.
+    if(cache_path)
+    {
+        char tmp_path[1056];
+        snprintf(tmp_path, sizeof(tmp_path), "%s.%lu.tmp", path, (unsigned long)SDL_ThreadID());
+        if((f = fopen(tmp_path, "wb")))
+        {
+            int written;
+            header.magic = TR_AUDIO_PCM_CACHE_MAGIC;
+            header.bits = job->bits;
+            header.channels = job->channels;
+            header.freq = job->freq;
+            header.size = job->pcm_size;
+            written = (fwrite(&header, sizeof(header), 1, f) == 1) && (fwrite(job->pcm, 1, job->pcm_size, f) == job->pcm_size);
+            written = (fclose(f) == 0) && written;
+            if(!written || !Sys_ReplaceFile(tmp_path, path))
+            {
+                remove(tmp_path);
+            }
+        }
+    }
+}
+
+
+static int Audio_DecodeThread(void *data)
+{
+    audio_sample_decode_p decode = (audio_sample_decode_p)data;
+    int i;
+    while((i = SDL_AtomicAdd(&decode->next, 1)) < (int)decode->count)
+    {
+        Audio_DecodeSample(decode->jobs + i, decode->cache_path);
+    }
+    return 0;
+}
+
+
+static void Audio_DecodeSampleJobs(audio_sample_job_p jobs, uint32_t count, const char *cache_path, int threads_count = -1)
+{
+    SDL_Thread *threads[TR_AUDIO_DECODE_MAX_THREADS];
+    audio_sample_decode_t decode;
+
+    decode.jobs = jobs;
+    decode.count = count;
+    decode.cache_path = cache_path;
+    SDL_AtomicSet(&decode.next, 0);
+
+    threads_count = (threads_count < 0) ? (SDL_GetCPUCount() - 1) : (threads_count);
+    threads_count = (threads_count > (int)count - 1) ? ((int)count - 1) : (threads_count);
+    threads_count = (threads_count > TR_AUDIO_DECODE_MAX_THREADS) ? (TR_AUDIO_DECODE_MAX_THREADS) : (threads_count);
+    for(int i = 0; i < threads_count; i++)
+    {
+        threads[i] = SDL_CreateThread(Audio_DecodeThread, "audio", &decode);
+    }
+    Audio_DecodeThread(&decode);
+    for(int i = 0; i < threads_count; i++)
+    {
+        if(threads[i])
+        {
+            SDL_WaitThread(threads[i], NULL);
+        }
+    }
+}
+
+
+static void Audio_FreeSampleJobs(audio_sample_job_p jobs, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        free(jobs[i].pcm);
+    }
+    free(jobs);
+}
+
+
+double Audio_BenchSampleDecode(class VT_Level *tr, int threads_count, int use_cache, uint32_t *samples, uint32_t *cached)
+{
+    uint64_t t0 = SDL_GetPerformanceCounter();
+    uint32_t jobs_count = 0;
+    audio_sample_job_p jobs = Audio_GetSampleJobs(tr, &jobs_count);
+    char *cache_path = (use_cache) ? (SDL_GetPrefPath("OpenTomb", "cache")) : (NULL);
+    double ms;
+
+    Audio_DecodeSampleJobs(jobs, jobs_count, cache_path, threads_count);
+    ms = 1000.0 * (double)(SDL_GetPerformanceCounter() - t0) / (double)SDL_GetPerformanceFrequency();
+    *samples = 0;
+    *cached = 0;
+    for(uint32_t i = 0; i < jobs_count; i++)
+    {
+        *samples += (jobs[i].pcm) ? (1) : (0);
+        *cached += jobs[i].cached;
+    }
+    Audio_FreeSampleJobs(jobs, jobs_count);
+    if(cache_path)
+    {
+        SDL_free(cache_path);
+    }
+
+    return ms;
+}
+
+
+/**
+ * Groups sound sources by room they are in; emitters without an effect are left out,
+ * as Audio_Send would refuse them anyway.
+ */
+static void Audio_GenEmitterGroups()
+{
+    room_p    rooms;
+    uint32_t  rooms_count;
+    uint32_t *emitter_room, *starts;
+    uint32_t  buckets_count;
+
+    audio_world_data.emitter_groups_count = 0;
+    audio_world_data.emitter_groups = NULL;
+    audio_world_data.emitter_order = NULL;
+    if(audio_world_data.audio_emitters_count == 0)
+    {
+        return;
+    }
+
+    World_GetRoomInfo(&rooms, &rooms_count);
+    buckets_count = rooms_count + 1;                    // Last one is for emitters outside of rooms.
+    emitter_room = (uint32_t*)malloc(audio_world_data.audio_emitters_count * sizeof(uint32_t));
+    starts = (uint32_t*)calloc(buckets_count + 1, sizeof(uint32_t));
+
+    for(uint32_t i = 0; i < audio_world_data.audio_emitters_count; i++)
+    {
+        audio_emitter_p em = audio_world_data.audio_emitters + i;
+        emitter_room[i] = buckets_count;                // No effect - no bucket.
+        if((em->sound_index < audio_world_data.audio_map_count) && (audio_world_data.audio_map[em->sound_index] >= 0))
+        {
+            room_p room = World_FindRoomByPos(em->position);
+            emitter_room[i] = (room) ? (room->id) : (rooms_count);
+            starts[emitter_room[i] + 1]++;
+        }
+    }
+
+    for(uint32_t i = 0; i < buckets_count; i++)
+    {
+        audio_world_data.emitter_groups_count += (starts[i + 1] > 0) ? (1) : (0);
+        starts[i + 1] += starts[i];
+    }
+
+    audio_world_data.emitter_order = (uint32_t*)malloc((starts[buckets_count] + 1) * sizeof(uint32_t));
+    audio_world_data.emitter_groups = (audio_emitter_group_p)malloc((audio_world_data.emitter_groups_count + 1) * sizeof(audio_emitter_group_t));
+    audio_world_data.emitter_groups_count = 0;
+    for(uint32_t b = 0; b < buckets_count; b++)
+    {
+        audio_emitter_group_p g = audio_world_data.emitter_groups + audio_world_data.emitter_groups_count;
+        g->first = starts[b];
+        g->count = 0;
+        g->radius = 0.0f;
+        for(uint32_t i = 0; i < audio_world_data.audio_emitters_count; i++)
+        {
+            if(emitter_room[i] == b)
+            {
+                audio_emitter_p em = audio_world_data.audio_emitters + i;
+                audio_effect_p effect = audio_world_data.audio_effects + audio_world_data.audio_map[em->sound_index];
+                // Audio_IsInRange scales squared distance by 1 / (gain + 1.25).
+                ALfloat radius = effect->range * sqrtf(effect->gain + 1.25f);
+                if(g->count == 0)
+                {
+                    vec3_copy(g->bb_min, em->position);
+                    vec3_copy(g->bb_max, em->position);
+                }
+                for(int j = 0; j < 3; j++)
+                {
+                    g->bb_min[j] = (em->position[j] < g->bb_min[j]) ? (em->position[j]) : (g->bb_min[j]);
+                    g->bb_max[j] = (em->position[j] > g->bb_max[j]) ? (em->position[j]) : (g->bb_max[j]);
+                }
+                g->radius = (radius > g->radius) ? (radius) : (g->radius);
+                audio_world_data.emitter_order[g->first + g->count++] = i;
+            }
+        }
+        audio_world_data.emitter_groups_count += (g->count > 0) ? (1) : (0);
+    }
+
+    free(starts);
+    free(emitter_room);
+}
+
+
+int Audio_SetEmitterCulling(int enabled)
+{
+    int ret = audio_world_data.emitter_culling;
+    audio_world_data.emitter_culling = (enabled != 0);
+    return ret;
+}
+
+
 void Audio_GenSamples(class VT_Level *tr)
 {
-    uint8_t      *pointer = tr->samples_data;
-    int8_t        flag;
-    uint32_t      ind1, ind2;
-    uint32_t      comp_size, uncomp_size;
     uint32_t      i;
 
     // Generate stream tracks buffers
@@ -1453,94 +2404,62 @@ void Audio_GenSamples(class VT_Level *tr)
     //
     // Hence, we specify certain parse method for each game version.
 
-    if(pointer)
+    switch(tr->game_version)
     {
-        switch(tr->game_version)
-        {
-            case TR_I:
-            case TR_I_DEMO:
-            case TR_I_UB:
-                audio_world_data.audio_map_count = TR_AUDIO_MAP_SIZE_TR1;
+        case TR_I:
+        case TR_I_DEMO:
+        case TR_I_UB:
+            audio_world_data.audio_map_count = TR_AUDIO_MAP_SIZE_TR1;
+            break;
 
-                for(i = 0; i < audio_world_data.audio_buffers_count-1; i++)
-                {
-                    pointer = tr->samples_data + tr->sample_indices[i];
-                    uint32_t size = tr->sample_indices[i + 1] - tr->sample_indices[i];
-                    Audio_LoadALbufferFromWAV_Mem(audio_world_data.audio_buffers[i], pointer, size);
-                }
-                i = audio_world_data.audio_buffers_count-1;
-                Audio_LoadALbufferFromWAV_Mem(audio_world_data.audio_buffers[i], pointer, (tr->samples_count - tr->sample_indices[i]));
-                break;
+        case TR_II:
+        case TR_II_DEMO:
+        case TR_III:
+            audio_world_data.audio_map_count = (tr->game_version == TR_III) ? (TR_AUDIO_MAP_SIZE_TR3) : (TR_AUDIO_MAP_SIZE_TR2);
+            break;
 
-            case TR_II:
-            case TR_II_DEMO:
-            case TR_III:
-                audio_world_data.audio_map_count = (tr->game_version == TR_III) ? (TR_AUDIO_MAP_SIZE_TR3) : (TR_AUDIO_MAP_SIZE_TR2);
-                ind1 = 0;
-                ind2 = 0;
-                flag = 0;
-                i = 0;
-                while(pointer < tr->samples_data + tr->samples_data_size - 4)
-                {
-                    pointer = tr->samples_data + ind2;
-                    if(!memcmp(pointer, "RIFF", 4))
-                    {
-                        if(flag == 0x00)
-                        {
-                            ind1 = ind2;
-                            flag = 0x01;
-                        }
-                        else
-                        {
-                            uncomp_size = ind2 - ind1;
-                            Audio_LoadALbufferFromWAV_Mem(audio_world_data.audio_buffers[i], tr->samples_data + ind1, uncomp_size);
-                            i++;
-                            if(i > audio_world_data.audio_buffers_count - 1)
-                            {
-                                break;
-                            }
-                            ind1 = ind2;
-                        }
-                    }
-                    ind2++;
-                }
-                uncomp_size = tr->samples_data_size - ind1;
-                pointer = tr->samples_data + ind1;
-                if(i < audio_world_data.audio_buffers_count)
-                {
-                    Audio_LoadALbufferFromWAV_Mem(audio_world_data.audio_buffers[i], pointer, uncomp_size);
-                }
-                break;
+        case TR_IV:
+        case TR_IV_DEMO:
+        case TR_V:
+            audio_world_data.audio_map_count = (tr->game_version == TR_V) ? (TR_AUDIO_MAP_SIZE_TR5) : (TR_AUDIO_MAP_SIZE_TR4);
+            break;
 
-            case TR_IV:
-            case TR_IV_DEMO:
-            case TR_V:
-                audio_world_data.audio_map_count = (tr->game_version == TR_V) ? (TR_AUDIO_MAP_SIZE_TR5) : (TR_AUDIO_MAP_SIZE_TR4);
+        default:
+            audio_world_data.audio_map_count = TR_AUDIO_MAP_SIZE_NONE;
+            free(tr->samples_data);
+            tr->samples_data = NULL;
+            tr->samples_data_size = 0;
+            return;
+    }
 
-                for(i = 0; i < tr->samples_count; i++)
-                {
-                    // Parse sample sizes.
-                    // Always use comp_size as block length, as uncomp_size is used to cut raw sample data.
-                    uncomp_size = *((uint32_t*)pointer);
-                    pointer += 4;
-                    comp_size   = *((uint32_t*)pointer);
-                    pointer += 4;
-
-                    // Load WAV sample into OpenAL buffer.
-                    Audio_LoadALbufferFromWAV_Mem(audio_world_data.audio_buffers[i], pointer, comp_size, uncomp_size);
-
-                    // Now we can safely move pointer through current sample data.
-                    pointer += comp_size;
-                }
-                break;
+    if(tr->samples_data)
+    {
+        // Decode on all cores, upload here: buffers belong to this thread's context.
+        uint64_t t0 = SDL_GetPerformanceCounter();
+        uint32_t jobs_count = 0, cached = 0;
+        audio_sample_job_p jobs = Audio_GetSampleJobs(tr, &jobs_count);
+        char *cache_path = (audio_settings.use_pcm_cache) ? (SDL_GetPrefPath("OpenTomb", "cache")) : (NULL);
 
-            default:
-                audio_world_data.audio_map_count = TR_AUDIO_MAP_SIZE_NONE;
-                free(tr->samples_data);
-                tr->samples_data = NULL;
-                tr->samples_data_size = 0;
-                return;
+        Audio_DecodeSampleJobs(jobs, jobs_count, cache_path);
+        for(i = 0; (i < jobs_count) && (i < audio_world_data.audio_buffers_count); i++)
+        {
+            if(jobs[i].pcm)
+            {
+                Audio_FillALBuffer(audio_world_data.audio_buffers[i], jobs[i].pcm, jobs[i].pcm_size, jobs[i].bits, jobs[i].channels, jobs[i].freq);
+                cached += jobs[i].cached;
+            }
+            else
+            {
+                Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "can't load sample #%03d from sample block!", audio_world_data.audio_buffers[i]);
+            }
         }
+        Audio_FreeSampleJobs(jobs, jobs_count);
+        if(cache_path)
+        {
+            SDL_free(cache_path);
+        }
+        Sys_Log(SYS_LOG_DEBUG, SYS_LOG_CAT_AUDIO, "%d samples loaded in %.1f ms, %d from cache", jobs_count,
+                1000.0 * (double)(SDL_GetPerformanceCounter() - t0) / (double)SDL_GetPerformanceFrequency(), cached);
 
         free(tr->samples_data);
         tr->samples_data = NULL;
@@ -1662,6 +2581,8 @@ void Audio_GenSamples(class VT_Level *tr)
         audio_world_data.audio_emitters[i].position[2]   = -tr->sound_sources[i].y;
         audio_world_data.audio_emitters[i].flags         =  tr->sound_sources[i].flags;
     }
+
+    Audio_GenEmitterGroups();
 }
 
 
@@ -1677,6 +2598,33 @@ int Audio_DeInit()
         audio_world_data.audio_sources = NULL;
     }
 
+    if(audio_world_data.free_sources)
+    {
+        audio_world_data.free_sources_count = 0;
+        free(audio_world_data.free_sources);
+        audio_world_data.free_sources = NULL;
+    }
+
+    if(audio_world_data.audio_voices)
+    {
+        audio_world_data.audio_voices_count = 0;
+        free(audio_world_data.audio_voices);
+        audio_world_data.audio_voices = NULL;
+        audio_world_data.free_voice = -1;
+        free(audio_world_data.voice_ranks);
+        audio_world_data.voice_ranks = NULL;
+        audio_world_data.voice_ranks_count = 0;
+        audio_world_data.weakest_rank = 0;
+        free(audio_world_data.voice_moves);
+        audio_world_data.voice_moves = NULL;
+    }
+
+    if(audio_world_data.audio_buffer_lengths)
+    {
+        free(audio_world_data.audio_buffer_lengths);
+        audio_world_data.audio_buffer_lengths = NULL;
+    }
+
     if(audio_world_data.audio_emitters)
     {
         audio_world_data.audio_emitters_count = 0;
@@ -1684,6 +2632,15 @@ int Audio_DeInit()
         audio_world_data.audio_emitters = NULL;
     }
 
+    if(audio_world_data.emitter_groups)
+    {
+        audio_world_data.emitter_groups_count = 0;
+        free(audio_world_data.emitter_groups);
+        free(audio_world_data.emitter_order);
+        audio_world_data.emitter_groups = NULL;
+        audio_world_data.emitter_order = NULL;
+    }
+
     if(audio_world_data.stream_tracks)
     {
         for(uint32_t i = 0; i < audio_world_data.stream_tracks_count; ++i)
@@ -1752,7 +2709,7 @@ int  Audio_LogALError(int error_marker)
     ALenum err = alGetError();
     if(err != AL_NO_ERROR)
     {
-        Sys_DebugLog(SYS_LOG_FILENAME, "OpenAL error: %s / %d", alGetString(err), error_marker);
+        Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "OpenAL error: %s / %d", alGetString(err), error_marker);
     }
     return err;
 }
@@ -1763,22 +2720,22 @@ int  Audio_LogALError(int error_marker)
     switch(code)
     {
         case OV_EREAD:
-            Sys_DebugLog(SYS_LOG_FILENAME, "OGG error: Read from media.");
+            Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "OGG error: Read from media.");
             break;
         case OV_ENOTVORBIS:
-            Sys_DebugLog(SYS_LOG_FILENAME, "OGG error: Not Vorbis data.");
+            Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "OGG error: Not Vorbis data.");
             break;
         case OV_EVERSION:
-            Sys_DebugLog(SYS_LOG_FILENAME, "OGG error: Vorbis version mismatch.");
+            Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "OGG error: Vorbis version mismatch.");
             break;
         case OV_EBADHEADER:
-            Sys_DebugLog(SYS_LOG_FILENAME, "OGG error: Invalid Vorbis header.");
+            Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "OGG error: Invalid Vorbis header.");
             break;
         case OV_EFAULT:
-            Sys_DebugLog(SYS_LOG_FILENAME, "OGG error: Internal logic fault (bug or heap/stack corruption.");
+            Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "OGG error: Internal logic fault (bug or heap/stack corruption.");
             break;
         default:
-            Sys_DebugLog(SYS_LOG_FILENAME, "OGG error: Unknown Ogg error.");
+            Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "OGG error: Unknown Ogg error.");
             break;
     }
 }*/
@@ -1798,7 +2755,7 @@ int Audio_LoadALbufferFromWAV_Mem(ALuint buf_number, uint8_t *sample_pointer, ui
 
     if(SDL_LoadWAV_RW(src, 1, &wav_spec, &wav_buffer, &wav_length) == NULL)
     {
-        Sys_DebugLog(SYS_LOG_FILENAME, "Error: can't load sample #%03d from sample block!", buf_number);
+        Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "can't load sample #%03d from sample block!", buf_number);
         return -1;
     }
 
@@ -1862,7 +2819,7 @@ bool Audio_FillALBuffer(ALuint buf_number, Uint8* buffer_data, Uint32 buffer_siz
 {
     if(channels > 2)   // We can't use non-mono and barely can use stereo samples.
     {
-        Sys_DebugLog(SYS_LOG_FILENAME, "Error: sample %03d has more than 2 channels!", buf_number);
+        Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "sample %03d has more than 2 channels!", buf_number);
         return false;
     }
 
@@ -1870,7 +2827,7 @@ bool Audio_FillALBuffer(ALuint buf_number, Uint8* buffer_data, Uint32 buffer_siz
     // We rarely encounter samples with exotic bitsizes, but just in case...
     if((sample_bitsize != 32) && (sample_bitsize != 16) && (sample_bitsize != 8))
     {
-        Sys_DebugLog(SYS_LOG_FILENAME, "Can't load sample - wrong bitsize (%d)", sample_bitsize);
+        Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_AUDIO, "Can't load sample - wrong bitsize (%d)", sample_bitsize);
         return false;
     }
 
@@ -1978,6 +2935,7 @@ void Audio_UpdateListenerByEntity(struct entity_s *ent)
 void Audio_Update(float time)
 {
     Audio_UpdateSources();
+    Audio_UpdateVoices(time);
     Audio_UpdateStreams(time);
     Audio_UpdateListenerByCamera(&engine_camera, time);
 }
@@ -24,6 +24,13 @@
 
 #define TR_AUDIO_STREAM_NUMSOURCES 6
 
+// MAX_VIRTUAL_VOICES is how many effects can wait without a source when
+// all channels are busy. Virtual voice keeps its playback position running
+// and gets a channel back when one frees up or it becomes louder than
+// some playing effect.
+
+#define TR_AUDIO_MAX_VIRTUAL_VOICES 64
+
 
 // Sound flags are found at offset 7 of SoundDetail unit and specify
 // certain sound modifications.
@@ -168,11 +175,34 @@ typedef struct audio_settings_s
     float       sound_volume;
     uint32_t    use_effects : 1;
     uint32_t    listener_is_player : 1; // RESERVED FOR FUTURE USE
+    uint32_t    use_pcm_cache : 1;      // Keep decoded level samples between runs.
 }audio_settings_t, *audio_settings_p;
 
 
 extern struct audio_settings_s audio_settings;
 
+// Voice allocation state, for debugging and benchmarks.
+
+typedef struct audio_voice_stats_s
+{
+    uint32_t    real_voices;
+    uint32_t    virtual_voices;
+    uint32_t    free_sources;
+    float       min_real_score;         // Weakest voice that has a source...
+    float       max_virtual_score;      // ...should not be below the strongest one waiting.
+}audio_voice_stats_t, *audio_voice_stats_p;
+
+// OpenAL calls and sound source sends made by per-frame updates.
+
+typedef struct audio_update_stats_s
+{
+    uint32_t    frames;
+    uint32_t    emitters_sent;
+    uint32_t    al_calls;
+}audio_update_stats_t, *audio_update_stats_p;
+
+extern struct audio_update_stats_s audio_update_stats;
+
 // General audio routines.
 
 void Audio_InitGlobals();
@@ -181,6 +211,7 @@ void Audio_CoreInit();
 void Audio_CoreDeinit();
 void Audio_Init(uint32_t num_Sources = TR_AUDIO_MAX_CHANNELS);
 void Audio_GenSamples(class VT_Level *tr);
+double Audio_BenchSampleDecode(class VT_Level *tr, int threads_count, int use_cache, uint32_t *samples, uint32_t *cached);   // Decode only, returns ms.
 void Audio_CacheTrack(int id);
 int  Audio_DeInit();
 void Audio_Update(float time);
@@ -190,6 +221,8 @@ int  Audio_IsEffectPlaying(int effect_ID, int entity_type = TR_AUDIO_EMITTER_GLO
 
 int  Audio_Send(int effect_ID, int entity_type = TR_AUDIO_EMITTER_GLOBAL, int entity_ID = 0);    // Send to play effect with given parameters.
 int  Audio_Kill(int effect_ID, int entity_type = TR_AUDIO_EMITTER_GLOBAL, int entity_ID = 0);    // If exist, immediately stop and destroy all effects with given parameters.
+void Audio_GetVoiceStats(struct audio_voice_stats_s *stats);
+int  Audio_SetEmitterCulling(int enabled);     // Skip sound sources far from listener; returns previous state.
 
 // Stream tracks (music / BGM) routines.
 int  Audio_EndStreams(int stream_type = -1);        // End ALL streams (with crossfade).
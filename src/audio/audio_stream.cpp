@@ -31,6 +31,7 @@ void StreamTrack_Init(stream_track_p s)
     s->state = TR_AUDIO_STREAM_STOPPED;
     s->linked_buffers = 0;
     s->buffer_offset = 0;
+    s->samples_unqueued = 0;
     s->current_volume = 0.0f;
     s->track = -1;
     s->internal = (struct stream_internal_s*)malloc(sizeof(struct stream_internal_s));
@@ -50,6 +51,7 @@ void StreamTrack_Init(stream_track_p s)
 void StreamTrack_Clear(stream_track_p s)
 {
     s->buffer_offset = 0;
+    s->samples_unqueued = 0;
     s->linked_buffers = 0;
     if(alIsSource(s->internal->source))
     {
@@ -105,7 +107,15 @@ int StreamTrack_UpdateBuffer(stream_track_p s, uint8_t *buff, size_t size, int s
             if(processed > 0)
             {
                 ALuint buffer_index = 0;
+                ALint buffer_size = 0, buffer_bits = 0, buffer_channels = 0;
                 alSourceUnqueueBuffers(s->internal->source, 1, &buffer_index);
+                alGetBufferi(buffer_index, AL_SIZE, &buffer_size);
+                alGetBufferi(buffer_index, AL_BITS, &buffer_bits);
+                alGetBufferi(buffer_index, AL_CHANNELS, &buffer_channels);
+                if((buffer_bits > 0) && (buffer_channels > 0))
+                {
+                    s->samples_unqueued += buffer_size * 8 / (buffer_bits * buffer_channels);
+                }
                 if(Audio_FillALBuffer(buffer_index, buff, size, sample_bitsize, channels, frequency))
                 {
                     s->buffer_offset += size;
@@ -133,6 +143,24 @@ int StreamTrack_UpdateBuffer(stream_track_p s, uint8_t *buff, size_t size, int s
 }
 
 
+int64_t StreamTrack_GetPlayedSamples(stream_track_p s)
+{
+    if(s->internal && alIsSource(s->internal->source))
+    {
+        ALint state = AL_STOPPED;
+        ALint offset = 0;
+        alGetSourcei(s->internal->source, AL_SOURCE_STATE, &state);
+        if(state == AL_PLAYING)
+        {
+            // offset counts from the first buffer still in the queue
+            alGetSourcei(s->internal->source, AL_SAMPLE_OFFSET, &offset);
+            return s->samples_unqueued + offset;
+        }
+    }
+    return -1;
+}
+
+
 int StreamTrack_Play(stream_track_p s)
 {
     if(alIsSource(s->internal->source))
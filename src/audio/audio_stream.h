@@ -73,6 +73,7 @@ typedef struct stream_track_s
     uint16_t                    state;
     uint32_t                    linked_buffers;
     uint32_t                    buffer_offset;
+    uint64_t                    samples_unqueued;   // Samples of the buffers already played and taken back.
     float                       current_volume;     // Stream volume, considering fades.
     struct stream_internal_s   *internal;
 }stream_track_t, *stream_track_p;
@@ -89,6 +90,7 @@ int StreamTrack_CheckForEnd(stream_track_p s);
 int StreamTrack_IsNeedUpdateBuffer(stream_track_p s);
 int StreamTrack_UpdateBuffer(stream_track_p s, uint8_t *buff, size_t size, int sample_bitsize, int channels, int frequency);
 int StreamTrack_UpdateState(stream_track_p s, float time, float volume);
+int64_t StreamTrack_GetPlayedSamples(stream_track_p s);  // -1 if the source does not play now
 
 
 #endif // AUDIO_STREAM_H
@@ -0,0 +1,84 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "audio_voice_rank.h"
+
+
+static int Audio_VoiceRankCompare(const void *a, const void *b)
+{
+    const audio_voice_rank_t *ra = (const audio_voice_rank_t*)a;
+    const audio_voice_rank_t *rb = (const audio_voice_rank_t*)b;
+    if(ra->score != rb->score)
+    {
+        return (ra->score < rb->score) ? (1) : (-1);
+    }
+    return (ra->voice > rb->voice) - (ra->voice < rb->voice);
+}
+
+
+void Audio_SortVoiceRanks(audio_voice_rank_p ranks, uint32_t count)
+{
+    if(count > 1)
+    {
+        qsort(ranks, count, sizeof(audio_voice_rank_t), Audio_VoiceRankCompare);
+    }
+}
+
+
+uint32_t Audio_PlanVoiceMoves(const audio_voice_rank_t *ranks, uint32_t count, uint32_t free_sources, float steal_margin, audio_voice_move_p moves)
+{
+    uint32_t moves_count = 0;
+    uint32_t cursor = count;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        int32_t victim = -1;
+        if(ranks[i].source >= 0)
+        {
+            continue;
+        }
+        if(ranks[i].score <= 0.0f)
+        {
+            break;                                  // Not heard, neither is anything after it.
+        }
+
+        if(free_sources > 0)
+        {
+            free_sources--;
+        }
+        else
+        {
+            // Victims only ever come from below, the cursor never meets this voice.
+            victim = Audio_FindWeakestRank(ranks, &cursor, ranks[i].score / steal_margin);
+            if((victim < 0) || ((uint32_t)victim <= i))
+            {
+                break;
+            }
+        }
+        moves[moves_count].rank = i;
+        moves[moves_count].victim = victim;
+        moves_count++;
+    }
+
+    return moves_count;
+}
+
+
+int32_t Audio_FindWeakestRank(const audio_voice_rank_t *ranks, uint32_t *cursor, float score)
+{
+    while(*cursor > 0)
+    {
+        const audio_voice_rank_t *r = ranks + *cursor - 1;
+        if(r->source >= 0)
+        {
+            if(r->score < score)
+            {
+                (*cursor)--;
+                return *cursor;
+            }
+            return -1;
+        }
+        (*cursor)--;
+    }
+    return -1;
+}
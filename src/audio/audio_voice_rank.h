@@ -0,0 +1,40 @@
+#ifndef AUDIO_VOICE_RANK_H
+#define AUDIO_VOICE_RANK_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Per frame order of the voices. Every voice is scored once, the ranks are
+ * sorted strongest first; then the strongest virtual voices take the free
+ * sources, and the sources of the weakest real voices they beat by the
+ * margin. Planning makes no OpenAL calls, the caller carries out the moves.
+ */
+
+typedef struct audio_voice_rank_s
+{
+    uint32_t    voice;          // Index in caller voices array.
+    int32_t     source;         // Source index, -1 for virtual voice.
+    float       score;
+}audio_voice_rank_t, *audio_voice_rank_p;
+
+typedef struct audio_voice_move_s
+{
+    uint32_t    rank;           // Virtual voice that gets a source...
+    int32_t     victim;         // ...from the free ones (-1), or the one of this rank.
+}audio_voice_move_t, *audio_voice_move_p;
+
+void Audio_SortVoiceRanks(audio_voice_rank_p ranks, uint32_t count);
+// Ranks must be sorted; moves needs room for count entries. Returns moves count.
+uint32_t Audio_PlanVoiceMoves(const audio_voice_rank_t *ranks, uint32_t count, uint32_t free_sources, float steal_margin, audio_voice_move_p moves);
+// Weakest real voice below score, searched down from *cursor and left there; -1 if none.
+int32_t Audio_FindWeakestRank(const audio_voice_rank_t *ranks, uint32_t *cursor, float score);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif  /* AUDIO_VOICE_RANK_H */
@@ -214,11 +214,6 @@ void Character_Update(struct entity_s *ent)
             Character_FixByBox(ent);
         }
 
-        for(int h = 0; h < ent->character->hair_count; h++)
-        {
-            Hair_Update(ent->character->hairs[h], ent->physics);
-        }
-
         if(ent->character->state.ragdoll && ent->character->ragdoll &&
            !(ent->type_flags & ENTITY_TYPE_DYNAMIC) &&
             Ragdoll_Create(ent->physics, ent->bf, ent->character->ragdoll))
@@ -229,6 +224,20 @@ void Character_Update(struct entity_s *ent)
 }
 
 
+// after the entity got its pose for the frame, or the hair root lags behind the head
+void Character_UpdateHair(struct entity_s *ent, float time)
+{
+    const uint16_t mask = ENTITY_STATE_ENABLED | ENTITY_STATE_ACTIVE;
+    if(ent->character && (mask == (ent->state_flags & mask)))
+    {
+        for(int h = 0; h < ent->character->hair_count; h++)
+        {
+            Hair_Update(ent->character->hairs[h], ent, time);
+        }
+    }
+}
+
+
 void Character_UpdatePath(struct entity_s *ent, struct room_sector_s *target)
 {
     if(ent->character && ent->self->sector && ent->self->sector->box && target && target->box)
@@ -317,6 +317,7 @@ typedef struct character_s
 void Character_Create(struct entity_s *ent);
 void Character_Delete(struct entity_s *ent);
 void Character_Update(struct entity_s *ent);
+void Character_UpdateHair(struct entity_s *ent, float time);
 void Character_UpdatePath(struct entity_s *ent, struct room_sector_s *target);
 void Character_GoByPathToTarget(struct entity_s *ent, struct entity_s *target);
 void Character_UpdateAI(struct entity_s *ent);
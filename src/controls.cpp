@@ -83,14 +83,14 @@ void Controls_Key(int32_t button, int state, int memu_mode)
         case ACT_SAVEGAME:
             if(!state)
             {
-                Game_Save("qsave.lua");
+                Game_QuickSave("qsave.sav");
             }
             break;
 
         case ACT_LOADGAME:
             if(!state)
             {
-                Game_Load("qsave.lua");
+                Game_Load("qsave.sav");
             }
             break;
 
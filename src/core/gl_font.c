@@ -22,7 +22,13 @@
 //T4Larson <t4larson@gmail.com>: fixed font construction and destruction!
 #define vec4_copy(x, y) {(x)[0] = (y)[0]; (x)[1] = (y)[1]; (x)[2] = (y)[2]; (x)[3] = (y)[3];}
 
+#define GLF_CHAR_MAP_SIZE   (0x10000)
+#define GLF_CHAR_UNKNOWN    (0xFFFF)
+
 static FT_Library g_ft_library = NULL;
+static uint32_t   g_font_generation = 0;
+static GLfloat   *g_render_buffer = NULL;
+static size_t     g_render_buffer_size = 0;
 
 typedef struct char_info_s
 {
@@ -56,6 +62,39 @@ void glf_destroy()
         FT_Done_FreeType(g_ft_library);
         g_ft_library = NULL;
     }
+    free(g_render_buffer);
+    g_render_buffer = NULL;
+    g_render_buffer_size = 0;
+}
+
+
+static uint32_t glf_get_char_index(gl_tex_font_p glf, uint32_t utf32)
+{
+    if(utf32 < GLF_CHAR_MAP_SIZE)
+    {
+        uint16_t *ind = glf->char_map + utf32;
+        if(*ind == GLF_CHAR_UNKNOWN)
+        {
+            *ind = FT_Get_Char_Index(glf->ft_face, utf32);
+        }
+        return *ind;
+    }
+    return FT_Get_Char_Index(glf->ft_face, utf32);
+}
+
+
+static __inline void glf_get_kerning(gl_tex_font_p glf, uint32_t left, uint32_t right, FT_Vector *kern)
+{
+    FT_Face face = (FT_Face)glf->ft_face;
+    if(FT_HAS_KERNING(face))
+    {
+        FT_Get_Kerning(glf->ft_face, left, right, FT_KERNING_UNSCALED, kern);   // kern in 1/64 pixel
+    }
+    else
+    {
+        kern->x = 0;
+        kern->y = 0;
+    }
 }
 
 gl_tex_font_p glf_create_font(const char *file_name, uint16_t font_size)
@@ -73,6 +112,8 @@ gl_tex_font_p glf_create_font(const char *file_name, uint16_t font_size)
 
         glf->glyphs_count = ((FT_Face)glf->ft_face)->num_glyphs;
         glf->glyphs = (char_info_p)malloc(glf->glyphs_count * sizeof(char_info_t));
+        glf->char_map = (uint16_t*)malloc(GLF_CHAR_MAP_SIZE * sizeof(uint16_t));
+        memset(glf->char_map, 0xFF, GLF_CHAR_MAP_SIZE * sizeof(uint16_t));
 
         qglGetIntegerv(GL_MAX_TEXTURE_SIZE, &glf->gl_max_tex_width);
         glf->gl_tex_width = glf->gl_max_tex_width;
@@ -116,6 +157,8 @@ gl_tex_font_p glf_create_font_mem(void *face_data, size_t face_data_size, uint16
 
         glf->glyphs_count = ((FT_Face)glf->ft_face)->num_glyphs;
         glf->glyphs = (char_info_p)malloc(glf->glyphs_count * sizeof(char_info_t));
+        glf->char_map = (uint16_t*)malloc(GLF_CHAR_MAP_SIZE * sizeof(uint16_t));
+        memset(glf->char_map, 0xFF, GLF_CHAR_MAP_SIZE * sizeof(uint16_t));
 
         qglGetIntegerv(GL_MAX_TEXTURE_SIZE, &glf->gl_max_tex_width);
         glf->gl_tex_width = glf->gl_max_tex_width;
@@ -147,6 +190,11 @@ void glf_free_font(gl_tex_font_p glf)
             free(glf->glyphs);
             glf->glyphs = NULL;
         }
+        if(glf->char_map != NULL)
+        {
+            free(glf->char_map);
+            glf->char_map = NULL;
+        }
         glf->glyphs_count = 0;
 
         glf->gl_real_tex_indexes_count = 0;
@@ -252,6 +300,7 @@ void glf_resize(gl_tex_font_p glf, uint16_t font_size)
 
         // resize base font
         glf->font_size = font_size;
+        glf->generation = ++g_font_generation;
         FT_Set_Char_Size(glf->ft_face, font_size << 6, font_size << 6, 0, 0);
 
         // calculate texture atlas size
@@ -403,14 +452,14 @@ int32_t glf_get_string_len(gl_tex_font_p glf, const char *text, int n)
         FT_Vector kern;
 
         ch = utf8_to_utf32(ch, &curr_utf32);
-        curr_utf32 = FT_Get_Char_Index(glf->ft_face, curr_utf32);
+        curr_utf32 = glf_get_char_index(glf, curr_utf32);
         for(int i = 0; (n < 0) || (i < n); ++i)
         {
             n = (*ch) ? (n) : (0);
             ch = utf8_to_utf32(ch, &next_utf32);
-            next_utf32 = FT_Get_Char_Index(glf->ft_face, next_utf32);
+            next_utf32 = glf_get_char_index(glf, next_utf32);
 
-            FT_Get_Kerning(glf->ft_face, curr_utf32, next_utf32, FT_KERNING_UNSCALED, &kern);   // kern in 1/64 pixel
+            glf_get_kerning(glf, curr_utf32, next_utf32, &kern);
             x += kern.x + glf->glyphs[curr_utf32].advance_x_pt;
             curr_utf32 = next_utf32;
         }
@@ -433,16 +482,16 @@ char *glf_get_string_for_width(gl_tex_font_p glf, char *text, int32_t w_pt, int
         FT_Vector kern;
 
         ch = utf8_to_utf32(ch, &curr_utf32);
-        curr_utf32 = FT_Get_Char_Index(glf->ft_face, curr_utf32);
+        curr_utf32 = glf_get_char_index(glf, curr_utf32);
         do
         {
             ret = (char*)ch;
             (*n_sym)++;
             w_pt = (*ch) ? (w_pt) : (0);
             ch = utf8_to_utf32(ch, &next_utf32);
-            next_utf32 = FT_Get_Char_Index(glf->ft_face, next_utf32);
+            next_utf32 = glf_get_char_index(glf, next_utf32);
 
-            FT_Get_Kerning(glf->ft_face, curr_utf32, next_utf32, FT_KERNING_UNSCALED, &kern);   // kern in 1/64 pixel
+            glf_get_kerning(glf, curr_utf32, next_utf32, &kern);
             x += kern.x + glf->glyphs[curr_utf32].advance_x_pt;
             curr_utf32 = next_utf32;
         }
@@ -470,15 +519,15 @@ void glf_get_string_bb(gl_tex_font_p glf, const char *text, int n, int32_t *x0,
         uint32_t curr_utf32, next_utf32;
 
         ch = utf8_to_utf32(ch, &curr_utf32);
-        curr_utf32 = FT_Get_Char_Index(glf->ft_face, curr_utf32);
+        curr_utf32 = glf_get_char_index(glf, curr_utf32);
         for(int i = 0; (n < 0) || (i < n); ++i)
         {
             char_info_p g = glf->glyphs + curr_utf32;
             n = (*ch) ? (n) : (0);
 
             ch = utf8_to_utf32(ch, &next_utf32);
-            next_utf32 = FT_Get_Char_Index(glf->ft_face, next_utf32);
-            FT_Get_Kerning(glf->ft_face, curr_utf32, next_utf32, FT_KERNING_UNSCALED, &kern);   // kern in 1/64 pixel
+            next_utf32 = glf_get_char_index(glf, next_utf32);
+            glf_get_kerning(glf, curr_utf32, next_utf32, &kern);
             curr_utf32 = next_utf32;
 
             xx0 = x_pt + g->left * 64;
@@ -494,6 +543,68 @@ void glf_get_string_bb(gl_tex_font_p glf, const char *text, int n, int32_t *x0,
 }
 
 
+/**
+ * Lays out the string once: fills glyph quads relative to the string origin
+ * (px) and returns their count; quads must hold one entry per symbol.
+ * x0, x1 - horizontal bounding box, same as glf_get_string_bb gives.
+ */
+uint32_t glf_shape_str(gl_tex_font_p glf, const char *text, int n, gl_glyph_quad_p quads, int32_t *x0, int32_t *x1)
+{
+    uint8_t *ch = (uint8_t*)text;
+    uint32_t ret = 0;
+    *x0 = 0;
+    *x1 = 0;
+
+    if(glf && glf->ft_face && ch && *ch)
+    {
+        FT_Vector kern;
+        int32_t x_pt = 0;
+        int32_t y_pt = 0;
+        int32_t y0 = 0, y1 = 0;
+        int32_t xx0, xx1, yy0, yy1;
+        uint32_t curr_utf32, next_utf32;
+
+        ch = utf8_to_utf32(ch, &curr_utf32);
+        curr_utf32 = glf_get_char_index(glf, curr_utf32);
+        for(int i = 0; (n < 0) || (i < n); ++i)
+        {
+            char_info_p g = glf->glyphs + curr_utf32;
+            n = (*ch) ? (n) : (0);
+
+            ch = utf8_to_utf32(ch, &next_utf32);
+            next_utf32 = glf_get_char_index(glf, next_utf32);
+            glf_get_kerning(glf, curr_utf32, next_utf32, &kern);
+            curr_utf32 = next_utf32;
+
+            xx0 = x_pt + g->left * 64;
+            xx1 = xx0 + g->width * 64;
+            yy0 = y_pt + g->top * 64;
+            yy1 = yy0 - g->height * 64;
+            bbox_add(&xx0, &xx1, &yy0, &yy1, x0, x1, &y0, &y1);
+
+            if(g->tex_index != 0)
+            {
+                gl_glyph_quad_p q = quads + ret++;
+                q->x0 = g->left + x_pt / 64.0f;
+                q->x1 = q->x0 + g->width;
+                q->y0 = g->top + y_pt / 64.0f;
+                q->y1 = q->y0 - g->height;
+                q->tex_x0 = g->tex_x0;
+                q->tex_y0 = g->tex_y0;
+                q->tex_x1 = g->tex_x1;
+                q->tex_y1 = g->tex_y1;
+                q->tex_index = g->tex_index;
+            }
+
+            x_pt += kern.x + g->advance_x_pt;
+            y_pt += kern.y + g->advance_y_pt;
+        }
+    }
+
+    return ret;
+}
+
+
 void glf_render_str(gl_tex_font_p glf, GLfloat x, GLfloat y, const char *text, int32_t n_sym)
 {
     if(glf && glf->ft_face && text && (text[0] != 0))
@@ -508,9 +619,16 @@ void glf_render_str(gl_tex_font_p glf, GLfloat x, GLfloat y, const char *text, i
             uint32_t curr_utf32, next_utf32;
             GLfloat *p, *buffer;
 
-            buffer = (GLfloat*)malloc(48 * utf8_strlen(text) * sizeof(GLfloat));
+            size_t buffer_size = 48 * utf8_strlen(text);
+            if(buffer_size > g_render_buffer_size)
+            {
+                free(g_render_buffer);
+                g_render_buffer = (GLfloat*)malloc(buffer_size * sizeof(GLfloat));
+                g_render_buffer_size = buffer_size;
+            }
+            buffer = g_render_buffer;
             nch = utf8_to_utf32(ch, &curr_utf32);
-            curr_utf32 = FT_Get_Char_Index(glf->ft_face, curr_utf32);
+            curr_utf32 = glf_get_char_index(glf, curr_utf32);
 
             qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
             for(p = buffer; *ch && n_sym--;)
@@ -518,12 +636,12 @@ void glf_render_str(gl_tex_font_p glf, GLfloat x, GLfloat y, const char *text, i
                 char_info_p g;
                 uint8_t *nch2 = utf8_to_utf32(nch, &next_utf32);
 
-                next_utf32 = FT_Get_Char_Index(glf->ft_face, next_utf32);
+                next_utf32 = glf_get_char_index(glf, next_utf32);
                 ch = nch;
                 nch = nch2;
 
                 g = glf->glyphs + curr_utf32;
-                FT_Get_Kerning(glf->ft_face, curr_utf32, next_utf32, FT_KERNING_UNSCALED, &kern);   // kern in 1/64 pixel
+                glf_get_kerning(glf, curr_utf32, next_utf32, &kern);
                 curr_utf32 = next_utf32;
 
                 if(g->tex_index != 0)
@@ -584,7 +702,6 @@ void glf_render_str(gl_tex_font_p glf, GLfloat x, GLfloat y, const char *text, i
                 qglDrawArrays(GL_TRIANGLES, 0, elements_count * 3);
             }
             qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
-            free(buffer);
         }
         else
         {
@@ -592,19 +709,19 @@ void glf_render_str(gl_tex_font_p glf, GLfloat x, GLfloat y, const char *text, i
             GLuint active_texture = 0;
             uint32_t curr_utf32, next_utf32;
             nch = utf8_to_utf32(ch, &curr_utf32);
-            curr_utf32 = FT_Get_Char_Index(glf->ft_face, curr_utf32);
+            curr_utf32 = glf_get_char_index(glf, curr_utf32);
             qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
             for(; *ch && n_sym--;)
             {
                 char_info_p g;
                 uint8_t *nch2 = utf8_to_utf32(nch, &next_utf32);
 
-                next_utf32 = FT_Get_Char_Index(glf->ft_face, next_utf32);
+                next_utf32 = glf_get_char_index(glf, next_utf32);
                 ch = nch;
                 nch = nch2;
 
                 g = glf->glyphs + curr_utf32;
-                FT_Get_Kerning(glf->ft_face, curr_utf32, next_utf32, FT_KERNING_UNSCALED, &kern);   // kern in 1/64 pixel
+                glf_get_kerning(glf, curr_utf32, next_utf32, &kern);
                 curr_utf32 = next_utf32;
 
                 if(g->tex_index != 0)
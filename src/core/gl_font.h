@@ -22,6 +22,8 @@ typedef struct gl_tex_font_s
 {
     void                    *ft_face;  // for internal usage only
     struct char_info_s      *glyphs;   // for internal usage only
+    uint16_t                *char_map; // for internal usage only: utf32 -> glyph index cache
+    uint32_t                 generation;   // changes on every atlas rebuild
     uint16_t                 font_size;
     uint16_t                 glyphs_count;
     uint16_t                 gl_tex_indexes_count;
@@ -51,6 +53,20 @@ typedef struct gl_fontstyle_s
     uint32_t                    shadowed : 1;
 } gl_fontstyle_t, *gl_fontstyle_p;
 
+// Shaped glyph: quad relative to the string origin, in px.
+typedef struct gl_glyph_quad_s
+{
+    GLfloat                     x0;
+    GLfloat                     y0;
+    GLfloat                     x1;
+    GLfloat                     y1;
+    GLfloat                     tex_x0;
+    GLfloat                     tex_y0;
+    GLfloat                     tex_x1;
+    GLfloat                     tex_y1;
+    GLuint                      tex_index;
+} gl_glyph_quad_t, *gl_glyph_quad_p;
+
 #define GUI_FONT_FADE_SPEED             1.0                 // Global fading style speed.
 #define GUI_FONT_FADE_MIN               0.3                 // Minimum fade multiplier.
 
@@ -74,6 +90,7 @@ int32_t  glf_get_descender(gl_tex_font_p glf);  // size in 1 / 64 px
 uint32_t glf_get_font_height(gl_tex_font_p glf);
 void     glf_get_string_bb(gl_tex_font_p glf, const char *text, int n, int32_t *x0, int32_t *y0, int32_t *x1, int32_t *y1);  // size in 1 / 64 px
 
+uint32_t glf_shape_str(gl_tex_font_p glf, const char *text, int n, gl_glyph_quad_p quads, int32_t *x0, int32_t *x1);  // returns quads count, bb in 1 / 64 px
 void     glf_render_str(gl_tex_font_p glf, GLfloat x, GLfloat y, const char *text, int32_t n_sym);     // UTF-8
 
 
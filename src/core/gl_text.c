@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "gl_text.h"
 #include "gl_font.h"
@@ -16,9 +17,24 @@
 
 
 #define vec4_copy(x, y) {(x)[0] = (y)[0]; (x)[1] = (y)[1]; (x)[2] = (y)[2]; (x)[3] = (y)[3];}
+#define GLTEXT_VERTEX_SIZE      (8)                 // pos[2], tex[2], color[4]
+
+typedef struct gl_text_batch_s
+{
+    GLuint                   tex_index;
+    uint32_t                 vertex_count;
+    uint32_t                 vertex_size;
+    GLfloat                 *vertices;
+} gl_text_batch_t, *gl_text_batch_p;
 
 static struct
 {
+    // all lines of the frame are collected here and drawn with one call per run of quads on the same font atlas
+    gl_text_batch_t          batches[GLTEXT_MAX_BATCHES];
+    uint16_t                 batches_count;
+    GLuint                   vbo;
+    size_t                   vbo_size;
+
     gl_text_line_p           gl_base_lines;
     gl_text_line_t           gl_temp_lines[GLTEXT_MAX_TEMP_LINES];
     uint16_t                 temp_lines_used;
@@ -61,6 +77,7 @@ void GLText_Init()
         font_data.gl_temp_lines[i].text[0] = 0;
         font_data.gl_temp_lines[i].show = 0;
 
+        font_data.gl_temp_lines[i].run = NULL;
         font_data.gl_temp_lines[i].next = NULL;
         font_data.gl_temp_lines[i].prev = NULL;
 
@@ -69,6 +86,30 @@ void GLText_Init()
     }
 
     font_data.temp_lines_used = 0;
+
+    font_data.batches_count = 0;
+    for(i = 0; i < GLTEXT_MAX_BATCHES; i++)
+    {
+        font_data.batches[i].tex_index = 0;
+        font_data.batches[i].vertex_count = 0;
+        font_data.batches[i].vertex_size = 0;
+        font_data.batches[i].vertices = NULL;
+    }
+    font_data.vbo = 0;
+    font_data.vbo_size = 0;
+}
+
+
+static void GLText_FreeRun(gl_text_line_p line)
+{
+    if(line->run)
+    {
+        free(line->run->lines);
+        free(line->run->quads);
+        free(line->run->text);
+        free(line->run);
+        line->run = NULL;
+    }
 }
 
 
@@ -79,6 +120,7 @@ void GLText_Destroy()
     font_data.gl_base_lines = NULL;
     for(i = 0; i < GLTEXT_MAX_TEMP_LINES ; i++)
     {
+        GLText_FreeRun(font_data.gl_temp_lines + i);
         font_data.gl_temp_lines[i].show = 0;
         font_data.gl_temp_lines[i].text_size = 0;
         free(font_data.gl_temp_lines[i].text);
@@ -87,6 +129,21 @@ void GLText_Destroy()
 
     font_data.temp_lines_used = GLTEXT_MAX_TEMP_LINES;
 
+    for(i = 0; i < GLTEXT_MAX_BATCHES; i++)
+    {
+        free(font_data.batches[i].vertices);
+        font_data.batches[i].vertices = NULL;
+        font_data.batches[i].vertex_size = 0;
+        font_data.batches[i].vertex_count = 0;
+    }
+    font_data.batches_count = 0;
+    if(font_data.vbo)
+    {
+        qglDeleteBuffersARB(1, &font_data.vbo);
+        font_data.vbo = 0;
+        font_data.vbo_size = 0;
+    }
+
     for(i = 0; i < font_data.max_fonts; i++)
     {
         glf_free_font(font_data.fonts[i].gl_font);
@@ -116,43 +173,273 @@ void GLText_UpdateResize(float scale)
 }
 
 
-void GLText_RenderStringLine(gl_text_line_p l)
+static void GLText_UpdateRun(gl_text_line_p l, gl_tex_font_p gl_font)
+{
+    gl_text_run_p run = l->run;
+    int32_t w_pt = (l->line_width > 0.0f) ? ((int32_t)(l->line_width * 64.0f + 0.5f)) : (-1);
+    uint32_t hash = 2166136261u;
+    uint32_t len = 0;
+    uint32_t n_lines = 1;
+    uint32_t quads_count = 0;
+    char *begin = l->text;
+
+    for(uint8_t *ch = (uint8_t*)l->text; *ch; ++ch, ++len)
+    {
+        hash = (hash ^ *ch) * 16777619u;
+    }
+
+    if(run && (run->font == gl_font) && (run->font_generation == gl_font->generation) &&
+       (run->text_hash == hash) && (run->text_len == len) && (run->w_pt == w_pt) &&
+       !memcmp(run->text, l->text, len))
+    {
+        return;
+    }
+
+    if(!run)
+    {
+        run = l->run = (gl_text_run_p)calloc(1, sizeof(gl_text_run_t));
+    }
+    if(run->text_size < len + 1)
+    {
+        free(run->text);
+        run->text_size = len + 1;
+        run->text = (char*)malloc(run->text_size);
+    }
+    memcpy(run->text, l->text, len + 1);
+    run->font = gl_font;
+    run->font_generation = gl_font->generation;
+    run->text_hash = hash;
+    run->text_len = len;
+    run->w_pt = w_pt;
+
+    if(w_pt > 0)
+    {
+        int n_sym = 0;
+        n_lines = 0;
+        for(char *ch = glf_get_string_for_width(gl_font, l->text, w_pt, &n_sym); *begin; ch = glf_get_string_for_width(gl_font, ch, w_pt, &n_sym))
+        {
+            ++n_lines;
+            begin = ch;
+        }
+        begin = l->text;
+    }
+
+    if(run->lines_size < n_lines)
+    {
+        free(run->lines);
+        run->lines_size = n_lines;
+        run->lines = (gl_text_run_line_p)malloc(n_lines * sizeof(gl_text_run_line_t));
+    }
+    if(run->quads_size < len + 1)
+    {
+        free(run->quads);
+        run->quads_size = len + 1;
+        run->quads = (gl_glyph_quad_p)malloc(run->quads_size * sizeof(gl_glyph_quad_t));
+    }
+
+    for(uint32_t i = 0; i < n_lines; ++i)
+    {
+        gl_text_run_line_p line = run->lines + i;
+        int n_sym = -1;
+        char *end = begin;
+        if(n_lines > 1)
+        {
+            end = glf_get_string_for_width(gl_font, begin, w_pt, &n_sym);
+        }
+        line->first_quad = quads_count;
+        line->quads_count = glf_shape_str(gl_font, begin, n_sym, run->quads + quads_count, &line->x0, &line->x1);
+        quads_count += line->quads_count;
+        begin = end;
+    }
+    run->lines_count = n_lines;
+}
+
+
+static void GLText_FlushBatches()
+{
+    size_t total_size = 0;
+    GLint first = 0;
+
+    for(uint16_t i = 0; i < font_data.batches_count; i++)
+    {
+        total_size += font_data.batches[i].vertex_count * GLTEXT_VERTEX_SIZE * sizeof(GLfloat);
+    }
+
+    if(total_size > 0)
+    {
+        size_t offset = 0;
+        if(!font_data.vbo)
+        {
+            qglGenBuffersARB(1, &font_data.vbo);
+        }
+        qglBindBufferARB(GL_ARRAY_BUFFER_ARB, font_data.vbo);
+        if(total_size > font_data.vbo_size)
+        {
+            font_data.vbo_size = total_size;
+        }
+        // orphan the previous frame storage, so we do not wait for the GPU
+        qglBufferDataARB(GL_ARRAY_BUFFER_ARB, font_data.vbo_size, NULL, GL_STREAM_DRAW_ARB);
+        for(uint16_t i = 0; i < font_data.batches_count; i++)
+        {
+            size_t size = font_data.batches[i].vertex_count * GLTEXT_VERTEX_SIZE * sizeof(GLfloat);
+            qglBufferSubDataARB(GL_ARRAY_BUFFER_ARB, offset, size, font_data.batches[i].vertices);
+            offset += size;
+        }
+
+        qglVertexPointer(2, GL_FLOAT, GLTEXT_VERTEX_SIZE * sizeof(GLfloat), (void*)0);
+        qglTexCoordPointer(2, GL_FLOAT, GLTEXT_VERTEX_SIZE * sizeof(GLfloat), (void*)(2 * sizeof(GLfloat)));
+        qglColorPointer(4, GL_FLOAT, GLTEXT_VERTEX_SIZE * sizeof(GLfloat), (void*)(4 * sizeof(GLfloat)));
+        for(uint16_t i = 0; i < font_data.batches_count; i++)
+        {
+            qglBindTexture(GL_TEXTURE_2D, font_data.batches[i].tex_index);
+            qglDrawArrays(GL_TRIANGLES, first, font_data.batches[i].vertex_count);
+            first += font_data.batches[i].vertex_count;
+        }
+        qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+    }
+
+    for(uint16_t i = 0; i < font_data.batches_count; i++)
+    {
+        font_data.batches[i].vertex_count = 0;
+    }
+    font_data.batches_count = 0;
+}
+
+
+/*
+ * Quads only join the last batch, so the strings are drawn in the order they
+ * were added and the later one stays on top where they overlap.
+ */
+static gl_text_batch_p GLText_GetBatch(GLuint tex_index, uint32_t quads_count)
+{
+    gl_text_batch_p batch = NULL;
+    uint32_t need;
+
+    if(font_data.batches_count && (font_data.batches[font_data.batches_count - 1].tex_index == tex_index))
+    {
+        batch = font_data.batches + font_data.batches_count - 1;
+    }
+
+    if(!batch)
+    {
+        if(font_data.batches_count >= GLTEXT_MAX_BATCHES)
+        {
+            GLText_FlushBatches();
+        }
+        batch = font_data.batches + font_data.batches_count++;
+        batch->tex_index = tex_index;
+        batch->vertex_count = 0;
+    }
+
+    need = batch->vertex_count + 6 * quads_count;
+    if(need > batch->vertex_size)
+    {
+        uint32_t new_size = (batch->vertex_size) ? (batch->vertex_size) : (6 * 256);
+        GLfloat *new_vertices;
+        while(new_size < need)
+        {
+            new_size *= 2;
+        }
+        new_vertices = (GLfloat*)realloc(batch->vertices, new_size * GLTEXT_VERTEX_SIZE * sizeof(GLfloat));
+        if(!new_vertices)
+        {
+            return NULL;
+        }
+        batch->vertices = new_vertices;
+        batch->vertex_size = new_size;
+    }
+
+    return batch;
+}
+
+
+static void GLText_AppendQuads(gl_glyph_quad_p q, uint32_t quads_count, GLfloat x, GLfloat y, const GLfloat color[4])
+{
+    gl_text_batch_p batch = NULL;
+
+    for(uint32_t i = 0; i < quads_count; i++, q++)
+    {
+        GLfloat *p;
+        GLfloat x0 = x + q->x0;
+        GLfloat x1 = x + q->x1;
+        GLfloat y0 = y + q->y0;
+        GLfloat y1 = y + q->y1;
+
+        if(!batch || (batch->tex_index != q->tex_index))
+        {
+            batch = GLText_GetBatch(q->tex_index, quads_count - i);
+            if(!batch)
+            {
+                return;
+            }
+        }
+
+        p = batch->vertices + batch->vertex_count * GLTEXT_VERTEX_SIZE;
+        batch->vertex_count += 6;
+
+        *p = x0;            p++;
+        *p = y0;            p++;
+        *p = q->tex_x0;     p++;
+        *p = q->tex_y0;     p++;
+        vec4_copy(p, color);    p += 4;
+
+        *p = x1;            p++;
+        *p = y0;            p++;
+        *p = q->tex_x1;     p++;
+        *p = q->tex_y0;     p++;
+        vec4_copy(p, color);    p += 4;
+
+        *p = x1;            p++;
+        *p = y1;            p++;
+        *p = q->tex_x1;     p++;
+        *p = q->tex_y1;     p++;
+        vec4_copy(p, color);    p += 4;
+
+        *p = x0;            p++;
+        *p = y0;            p++;
+        *p = q->tex_x0;     p++;
+        *p = q->tex_y0;     p++;
+        vec4_copy(p, color);    p += 4;
+
+        *p = x1;            p++;
+        *p = y1;            p++;
+        *p = q->tex_x1;     p++;
+        *p = q->tex_y1;     p++;
+        vec4_copy(p, color);    p += 4;
+
+        *p = x0;            p++;
+        *p = y1;            p++;
+        *p = q->tex_x0;     p++;
+        *p = q->tex_y1;     p++;
+        vec4_copy(p, color);
+    }
+}
+
+
+static void GLText_AppendStringLine(gl_text_line_p l)
 {
     gl_tex_font_p gl_font = NULL;
     gl_fontstyle_p style = NULL;
-    
-    if(l->show && (gl_font = GLText_GetFont(l->font_id)) && (style = GLText_GetFontStyle(l->style_id)))
+
+    if(l->show && l->text && (gl_font = GLText_GetFont(l->font_id)) && (style = GLText_GetFontStyle(l->style_id)))
     {
+        gl_text_run_p run;
         GLfloat real_x = 0.0f, real_y = 0.0f;
-        int32_t x0, y0, x1, y1;
         GLfloat shadow_color[4];
-        int32_t w_pt = (l->line_width * 64.0f + 0.5f);
         GLfloat ascender = glf_get_ascender(gl_font) / 64.0f;
         GLfloat descender = glf_get_descender(gl_font) / 64.0f;
         GLfloat dy = l->line_height * (ascender - descender);
-        int n_lines = 1;
-        char *begin = l->text;
-        char *end = begin;
-        
+        int n_lines;
+
+        GLText_UpdateRun(l, gl_font);
+        run = l->run;
+        n_lines = run->lines_count;
+
         shadow_color[0] = 0.0f;
         shadow_color[1] = 0.0f;
         shadow_color[2] = 0.0f;
         shadow_color[3] = (float)style->font_color[3] * GUI_FONT_SHADOW_TRANSPARENCY;
 
-        if(l->line_width > 0.0f)
-        {
-            int n_sym = 0;
-            n_lines = 0;
-            for(char *ch = glf_get_string_for_width(gl_font, l->text, w_pt, &n_sym); *begin; ch = glf_get_string_for_width(gl_font, ch, w_pt, &n_sym))
-            {
-                ++n_lines;
-                begin = ch;
-            }
-            begin = l->text;
-            x1 = x0 + w_pt;
-            y1 = y0 + n_lines * dy * 64.0f;
-        }
-        
         real_y = l->y - descender;
         switch(l->y_align)
         {
@@ -166,41 +453,40 @@ void GLText_RenderStringLine(gl_text_line_p l)
 
         for(int line = n_lines - 1; line >= 0; --line)
         {
-            int n_sym = -1;
-            if(n_lines > 1)
-            {
-                end = glf_get_string_for_width(gl_font, begin, w_pt, &n_sym);
-            }
-            
-            glf_get_string_bb(gl_font, begin, n_sym, &x0, &y0, &x1, &y1);
-            
-            real_x = l->x - x0 / 64.0f;
+            gl_text_run_line_p rl = run->lines + (n_lines - 1 - line);
+            gl_glyph_quad_p quads = run->quads + rl->first_quad;
+
+            real_x = l->x - rl->x0 / 64.0f;
             switch(l->x_align)
             {
                 case GLTEXT_ALIGN_RIGHT:
-                    real_x = l->x - x1 / 64.0f;
+                    real_x = l->x - rl->x1 / 64.0f;
                     break;
                 case GLTEXT_ALIGN_CENTER:
-                    real_x = l->x - (x1 + x0) / 128.0f;
+                    real_x = l->x - (rl->x1 + rl->x0) / 128.0f;
                     break;
             }
-        
+
             if(style->shadowed)
             {
-                vec4_copy(gl_font->gl_font_color, shadow_color);
-                glf_render_str(gl_font,
-                               (real_x + GUI_FONT_SHADOW_HORIZONTAL_SHIFT),
-                               (real_y + line * dy + GUI_FONT_SHADOW_VERTICAL_SHIFT),
-                               begin, n_sym);
+                GLText_AppendQuads(quads, rl->quads_count,
+                                   (real_x + GUI_FONT_SHADOW_HORIZONTAL_SHIFT),
+                                   (real_y + line * dy + GUI_FONT_SHADOW_VERTICAL_SHIFT),
+                                   shadow_color);
             }
-            vec4_copy(gl_font->gl_font_color, style->font_color);
-            glf_render_str(gl_font, real_x, real_y + line * dy, begin, n_sym);
-            begin = end;
+            GLText_AppendQuads(quads, rl->quads_count, real_x, real_y + line * dy, style->font_color);
         }
     }
 }
 
 
+void GLText_RenderStringLine(gl_text_line_p l)
+{
+    GLText_AppendStringLine(l);
+    GLText_FlushBatches();
+}
+
+
 void GLText_RenderStrings()
 {
     gl_text_line_p l = font_data.gl_base_lines;
@@ -210,7 +496,7 @@ void GLText_RenderStrings()
 
     while(l)
     {
-        GLText_RenderStringLine(l);
+        GLText_AppendStringLine(l);
         l = l->next;
     }
 
@@ -219,11 +505,12 @@ void GLText_RenderStrings()
     {
         if(l->show)
         {
-            GLText_RenderStringLine(l);
+            GLText_AppendStringLine(l);
             l->show = 0;
         }
     }
 
+    GLText_FlushBatches();
     font_data.temp_lines_used = 0;
 }
 
@@ -251,6 +538,7 @@ void GLText_AddLine(gl_text_line_p line)
 // line must be in the list, otherway You crash engine!
 void GLText_DeleteLine(gl_text_line_p line)
 {
+    GLText_FreeRun(line);
     if(font_data.gl_base_lines)
     {
         if(line == font_data.gl_base_lines)
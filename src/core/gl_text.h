@@ -24,6 +24,7 @@ extern "C" {
 #define GLTEXT_MAX_FONTS      8
     
 #define GLTEXT_MAX_TEMP_LINES   (256)
+#define GLTEXT_MAX_BATCHES      (16)
 
 // Horizontal alignment is simple side alignment, like in original TRs.
 // It means that X coordinate will be either used for left, right or
@@ -75,6 +76,34 @@ enum font_Style
 };
 
 
+// Shaped glyphs of the line, split by word wrap; positions are relative
+// to the line origin, so moving the line or changing its style does not
+// invalidate it. Rebuilt only when text, font (size) or line width changes;
+// the hash only rejects quickly, the kept text decides.
+typedef struct gl_text_run_line_s
+{
+    uint32_t                    first_quad;
+    uint32_t                    quads_count;
+    int32_t                     x0;                 // 1 / 64 px
+    int32_t                     x1;                 // 1 / 64 px
+} gl_text_run_line_t, *gl_text_run_line_p;
+
+typedef struct gl_text_run_s
+{
+    struct gl_tex_font_s       *font;
+    uint32_t                    font_generation;
+    uint32_t                    text_hash;
+    uint32_t                    text_len;
+    uint32_t                    text_size;
+    char                       *text;
+    int32_t                     w_pt;
+    uint32_t                    lines_count;
+    uint32_t                    lines_size;
+    uint32_t                    quads_size;
+    struct gl_text_run_line_s  *lines;
+    struct gl_glyph_quad_s     *quads;
+} gl_text_run_t, *gl_text_run_p;
+
 typedef struct gl_text_line_s
 {
     char                       *text;
@@ -90,6 +119,7 @@ typedef struct gl_text_line_s
     GLfloat                     x;
     GLfloat                     y;
 
+    struct gl_text_run_s       *run;                // must be NULL on init
     struct gl_text_line_s     *next;
     struct gl_text_line_s     *prev;
 } gl_text_line_t, *gl_text_line_p;
@@ -106,7 +136,7 @@ void GLText_RenderStringLine(gl_text_line_p l);
 void GLText_RenderStrings();
 
 void GLText_AddLine(gl_text_line_p line);
-void GLText_DeleteLine(gl_text_line_p line);
+void GLText_DeleteLine(gl_text_line_p line);            // also frees line's glyph run cache
 gl_text_line_p GLText_OutTextXY(GLfloat x, GLfloat y, const char *fmt, ...);
 gl_text_line_p GLText_VOutTextXY(GLfloat x, GLfloat y, const char *fmt, va_list argptr);
 
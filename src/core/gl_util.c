@@ -271,6 +271,23 @@ PFNGLISVERTEXARRAYPROC                  qglIsVertexArray = NULL;
 
 PFNGLGENERATEMIPMAPEXTPROC              qglGenerateMipmap = NULL;
 
+PFNGLGENFRAMEBUFFERSEXTPROC             qglGenFramebuffersEXT = NULL;
+PFNGLDELETEFRAMEBUFFERSEXTPROC          qglDeleteFramebuffersEXT = NULL;
+PFNGLBINDFRAMEBUFFEREXTPROC             qglBindFramebufferEXT = NULL;
+PFNGLFRAMEBUFFERTEXTURE2DEXTPROC        qglFramebufferTexture2DEXT = NULL;
+PFNGLCHECKFRAMEBUFFERSTATUSEXTPROC      qglCheckFramebufferStatusEXT = NULL;
+PFNGLGENRENDERBUFFERSEXTPROC            qglGenRenderbuffersEXT = NULL;
+PFNGLDELETERENDERBUFFERSEXTPROC         qglDeleteRenderbuffersEXT = NULL;
+PFNGLBINDRENDERBUFFEREXTPROC            qglBindRenderbufferEXT = NULL;
+PFNGLRENDERBUFFERSTORAGEEXTPROC         qglRenderbufferStorageEXT = NULL;
+PFNGLFRAMEBUFFERRENDERBUFFEREXTPROC     qglFramebufferRenderbufferEXT = NULL;
+
+/* ARB_get_program_binary, NULL if not supported */
+PFNGLGETPROGRAMBINARYPROC               qglGetProgramBinary = NULL;
+PFNGLPROGRAMBINARYPROC                  qglProgramBinary = NULL;
+PFNGLPROGRAMPARAMETERIPROC              qglProgramParameteri = NULL;
+PFNGLGETPROGRAMIVPROC                   qglGetProgramiv = NULL;
+
 static char *engine_gl_ext_str = NULL;
 static GLuint whiteTexture = 0;
 
@@ -526,6 +543,26 @@ void InitGLExtFuncs()
         fprintf(stderr, "VBOs not supported");
         abort();
     }
+    if(IsGLExtensionSupported("GL_EXT_framebuffer_object"))
+    {
+        qglGenFramebuffersEXT = (PFNGLGENFRAMEBUFFERSEXTPROC)SDL_GL_GetProcAddress("glGenFramebuffersEXT");
+        qglDeleteFramebuffersEXT = (PFNGLDELETEFRAMEBUFFERSEXTPROC)SDL_GL_GetProcAddress("glDeleteFramebuffersEXT");
+        qglBindFramebufferEXT = (PFNGLBINDFRAMEBUFFEREXTPROC)SDL_GL_GetProcAddress("glBindFramebufferEXT");
+        qglFramebufferTexture2DEXT = (PFNGLFRAMEBUFFERTEXTURE2DEXTPROC)SDL_GL_GetProcAddress("glFramebufferTexture2DEXT");
+        qglCheckFramebufferStatusEXT = (PFNGLCHECKFRAMEBUFFERSTATUSEXTPROC)SDL_GL_GetProcAddress("glCheckFramebufferStatusEXT");
+        qglGenRenderbuffersEXT = (PFNGLGENRENDERBUFFERSEXTPROC)SDL_GL_GetProcAddress("glGenRenderbuffersEXT");
+        qglDeleteRenderbuffersEXT = (PFNGLDELETERENDERBUFFERSEXTPROC)SDL_GL_GetProcAddress("glDeleteRenderbuffersEXT");
+        qglBindRenderbufferEXT = (PFNGLBINDRENDERBUFFEREXTPROC)SDL_GL_GetProcAddress("glBindRenderbufferEXT");
+        qglRenderbufferStorageEXT = (PFNGLRENDERBUFFERSTORAGEEXTPROC)SDL_GL_GetProcAddress("glRenderbufferStorageEXT");
+        qglFramebufferRenderbufferEXT = (PFNGLFRAMEBUFFERRENDERBUFFEREXTPROC)SDL_GL_GetProcAddress("glFramebufferRenderbufferEXT");
+    }
+    if(IsGLExtensionSupported("GL_ARB_get_program_binary"))
+    {
+        qglGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glGetProgramBinary");
+        qglProgramBinary = (PFNGLPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glProgramBinary");
+        qglProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)SDL_GL_GetProcAddress("glProgramParameteri");
+        qglGetProgramiv = (PFNGLGETPROGRAMIVPROC)SDL_GL_GetProcAddress("glGetProgramiv");
+    }
     if(IsGLExtensionSupported("GL_ARB_shading_language_100"))
     {
         qglDeleteObjectARB = (PFNGLDELETEOBJECTARBPROC)SDL_GL_GetProcAddress("glDeleteObjectARB");
@@ -711,18 +748,18 @@ int loadShaderFromBuff(GLhandleARB ShaderObj, const char *source, const char *ad
 }
 
 
-int loadShaderFromFile(GLhandleARB ShaderObj, const char *fileName, const char *additionalDefines)
+char *loadShaderSource(const char *fileName)
 {
     FILE *file;
     GLint size = 0;
-    int ret = 0;
+    char *buf;
 
     //Sys_DebugLog(GL_LOG_FILENAME, "GL_Loading %s", fileName);
     file = fopen (fileName, "rb");
     if (file == NULL)
     {
         Sys_DebugLog(GL_LOG_FILENAME, "Error opening %s", fileName);
-        return ret;
+        return NULL;
     }
 
     fseek(file, 0, SEEK_END);
@@ -732,10 +769,10 @@ int loadShaderFromFile(GLhandleARB ShaderObj, const char *fileName, const char *
     {
         fclose(file);
         Sys_DebugLog(GL_LOG_FILENAME, "Error loading file %s: size < 1", fileName);
-        return ret;
+        return NULL;
     }
 
-    char *buf = (char*)malloc(size + 1);
+    buf = (char*)malloc(size + 1);
     fseek(file, 0, SEEK_SET);
     if(size != fread(buf, 1, size, file))
     {
@@ -744,8 +781,20 @@ int loadShaderFromFile(GLhandleARB ShaderObj, const char *fileName, const char *
     buf[size] = 0;
     fclose(file);
 
-    ret = loadShaderFromBuff(ShaderObj, buf, additionalDefines);
-    free(buf);
+    return buf;
+}
+
+
+int loadShaderFromFile(GLhandleARB ShaderObj, const char *fileName, const char *additionalDefines)
+{
+    char *buf = loadShaderSource(fileName);
+    int ret = 0;
+
+    if(buf)
+    {
+        ret = loadShaderFromBuff(ShaderObj, buf, additionalDefines);
+        free(buf);
+    }
     return ret;
 }
 
@@ -428,11 +428,30 @@ extern PFNGLISVERTEXARRAYPROC qglIsVertexArray;
 
 extern PFNGLGENERATEMIPMAPPROC qglGenerateMipmap;
 
+/* FBO EXT, NULL if not supported */
+extern PFNGLGENFRAMEBUFFERSEXTPROC qglGenFramebuffersEXT;
+extern PFNGLDELETEFRAMEBUFFERSEXTPROC qglDeleteFramebuffersEXT;
+extern PFNGLBINDFRAMEBUFFEREXTPROC qglBindFramebufferEXT;
+extern PFNGLFRAMEBUFFERTEXTURE2DEXTPROC qglFramebufferTexture2DEXT;
+extern PFNGLCHECKFRAMEBUFFERSTATUSEXTPROC qglCheckFramebufferStatusEXT;
+extern PFNGLGENRENDERBUFFERSEXTPROC qglGenRenderbuffersEXT;
+extern PFNGLDELETERENDERBUFFERSEXTPROC qglDeleteRenderbuffersEXT;
+extern PFNGLBINDRENDERBUFFEREXTPROC qglBindRenderbufferEXT;
+extern PFNGLRENDERBUFFERSTORAGEEXTPROC qglRenderbufferStorageEXT;
+extern PFNGLFRAMEBUFFERRENDERBUFFEREXTPROC qglFramebufferRenderbufferEXT;
+
+/* ARB_get_program_binary, NULL if not supported */
+extern PFNGLGETPROGRAMBINARYPROC qglGetProgramBinary;
+extern PFNGLPROGRAMBINARYPROC qglProgramBinary;
+extern PFNGLPROGRAMPARAMETERIPROC qglProgramParameteri;
+extern PFNGLGETPROGRAMIVPROC qglGetProgramiv;
+
 void InitGLExtFuncs();
 int IsGLExtensionSupported(const char *ext);
 
 int checkOpenGLError();
 void printInfoLog (GLhandleARB object);
+char *loadShaderSource(const char *fileName);   // malloc'ed, NULL on error
 int loadShaderFromBuff(GLhandleARB ShaderObj, const char *source, const char *additionalDefines);
 int loadShaderFromFile(GLhandleARB ShaderObj, const char *fileName, const char *additionalDefines);
 
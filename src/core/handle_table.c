@@ -0,0 +1,347 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "handle_table.h"
+
+#define HANDLE_TABLE_MIN_SIZE       (64)
+
+
+static handle_slot_p HandleTable_FindSlot(handle_table_p table, uint32_t key);
+static handle_slot_p HandleTable_AddSlot(handle_table_p table, uint32_t key);
+static uint32_t HandleTable_FarSlotPosition(handle_table_p table, uint32_t key);
+static int HandleTable_GrowDense(handle_table_p table);
+static void HandleTable_Compact(handle_table_p table);
+
+
+void HandleTable_Init(handle_table_p table)
+{
+    table->data = NULL;
+    table->keys = NULL;
+    table->count = 0;
+    table->holes = 0;
+    table->capacity = 0;
+    table->iterations = 0;
+    table->slots = NULL;
+    table->slots_count = 0;
+    table->far_slots = NULL;
+    table->far_slots_count = 0;
+    table->far_slots_capacity = 0;
+    table->free_data = NULL;
+}
+
+
+void HandleTable_MakeEmpty(handle_table_p table)
+{
+    /* free from the newest to the oldest one, as the old avl list did */
+    HandleTable_BeginIteration(table);
+    for(uint32_t i = table->count; i > 0; --i)
+    {
+        HandleTable_RemoveAt(table, i - 1);
+    }
+    table->iterations--;
+    table->count = 0;
+    table->holes = 0;
+}
+
+
+void HandleTable_Destroy(handle_table_p table)
+{
+    HandleTable_MakeEmpty(table);
+    free(table->data);
+    free(table->keys);
+    free(table->slots);
+    free(table->far_slots);
+    HandleTable_Init(table);
+}
+
+
+void *HandleTable_Get(handle_table_p table, uint32_t key)
+{
+    handle_slot_p slot = HandleTable_FindSlot(table, key);
+    return (slot && (slot->index != HANDLE_TABLE_NONE)) ? (table->data[slot->index]) : (NULL);
+}
+
+
+void *HandleTable_GetByHandle(handle_table_p table, uint64_t handle)
+{
+    handle_slot_p slot = HandleTable_FindSlot(table, HANDLE_TABLE_HANDLE_KEY(handle));
+    if(slot && (slot->index != HANDLE_TABLE_NONE) && (slot->generation == HANDLE_TABLE_HANDLE_GEN(handle)))
+    {
+        return table->data[slot->index];
+    }
+    return NULL;
+}
+
+
+uint64_t HandleTable_GetHandle(handle_table_p table, uint32_t key)
+{
+    handle_slot_p slot = HandleTable_FindSlot(table, key);
+    if(slot && (slot->index != HANDLE_TABLE_NONE))
+    {
+        return HANDLE_TABLE_MAKE_HANDLE(key, slot->generation);
+    }
+    return HANDLE_TABLE_NO_HANDLE;
+}
+
+
+uint32_t HandleTable_GetMaxKey(handle_table_p table)
+{
+    for(uint32_t i = table->far_slots_count; i > 0; --i)
+    {
+        if(table->far_slots[i - 1].slot.index != HANDLE_TABLE_NONE)
+        {
+            return table->far_slots[i - 1].key;
+        }
+    }
+    for(uint32_t key = table->slots_count; key > 0; --key)
+    {
+        if(table->slots[key - 1].index != HANDLE_TABLE_NONE)
+        {
+            return key - 1;
+        }
+    }
+    return HANDLE_TABLE_NONE;
+}
+
+
+int HandleTable_InsertReplace(handle_table_p table, uint32_t key, void *data)
+{
+    handle_slot_p slot;
+
+    if((key == HANDLE_TABLE_NONE) || !data)
+    {
+        return 0;
+    }
+
+    slot = HandleTable_FindSlot(table, key);
+    if(slot && (slot->index != HANDLE_TABLE_NONE))
+    {
+        void *old_data = table->data[slot->index];
+        table->data[slot->index] = data;
+        slot->generation++;
+        if(table->free_data && (old_data != data))
+        {
+            table->free_data(old_data);
+        }
+        return 1;
+    }
+
+    if((table->count >= table->capacity) && table->holes && !table->iterations)
+    {
+        HandleTable_Compact(table);
+    }
+    if((table->count >= table->capacity) && !HandleTable_GrowDense(table))
+    {
+        return 0;
+    }
+
+    /* adding a far slot moves the others, so it goes after the dense part is ready */
+    slot = (slot) ? (slot) : (HandleTable_AddSlot(table, key));
+    if(!slot)
+    {
+        return 0;
+    }
+
+    slot->index = table->count;
+    table->data[table->count] = data;
+    table->keys[table->count] = key;
+    table->count++;
+
+    return 1;
+}
+
+
+int HandleTable_Remove(handle_table_p table, uint32_t key)
+{
+    handle_slot_p slot = HandleTable_FindSlot(table, key);
+    if(slot && (slot->index != HANDLE_TABLE_NONE))
+    {
+        HandleTable_RemoveAt(table, slot->index);
+        return 1;
+    }
+    return 0;
+}
+
+
+/*
+ * Removes object by its dense index and leaves a hole there; holes are
+ * squeezed out once they are half of the table and nobody iterates it.
+ */
+void HandleTable_RemoveAt(handle_table_p table, uint32_t index)
+{
+    if((index < table->count) && (table->keys[index] != HANDLE_TABLE_NONE))
+    {
+        void *data = table->data[index];
+        handle_slot_p slot = HandleTable_FindSlot(table, table->keys[index]);
+
+        slot->index = HANDLE_TABLE_NONE;
+        slot->generation++;
+        table->data[index] = NULL;
+        table->keys[index] = HANDLE_TABLE_NONE;
+        table->holes++;
+        if(!table->iterations && (2 * table->holes > table->count))
+        {
+            HandleTable_Compact(table);
+        }
+
+        if(table->free_data)
+        {
+            table->free_data(data);
+        }
+    }
+}
+
+
+void HandleTable_BeginIteration(handle_table_p table)
+{
+    table->iterations++;
+}
+
+
+void HandleTable_EndIteration(handle_table_p table)
+{
+    if(table->iterations > 0)
+    {
+        table->iterations--;
+        if(!table->iterations && (2 * table->holes > table->count))
+        {
+            HandleTable_Compact(table);
+        }
+    }
+}
+
+
+static handle_slot_p HandleTable_FindSlot(handle_table_p table, uint32_t key)
+{
+    if(key < HANDLE_TABLE_DIRECT_KEYS)
+    {
+        return (key < table->slots_count) ? (table->slots + key) : (NULL);
+    }
+    else
+    {
+        uint32_t pos = HandleTable_FarSlotPosition(table, key);
+        if((pos < table->far_slots_count) && (table->far_slots[pos].key == key))
+        {
+            return &table->far_slots[pos].slot;
+        }
+    }
+    return NULL;
+}
+
+
+static handle_slot_p HandleTable_AddSlot(handle_table_p table, uint32_t key)
+{
+    if(key < HANDLE_TABLE_DIRECT_KEYS)
+    {
+        if(key >= table->slots_count)
+        {
+            uint32_t new_count = (table->slots_count) ? (table->slots_count) : (HANDLE_TABLE_MIN_SIZE);
+            handle_slot_p new_slots;
+            while(new_count <= key)
+            {
+                new_count *= 2;
+            }
+            new_slots = (handle_slot_p)realloc(table->slots, new_count * sizeof(handle_slot_t));
+            if(!new_slots)
+            {
+                return NULL;
+            }
+            for(uint32_t i = table->slots_count; i < new_count; ++i)
+            {
+                new_slots[i].index = HANDLE_TABLE_NONE;
+                new_slots[i].generation = 0;
+            }
+            table->slots = new_slots;
+            table->slots_count = new_count;
+        }
+        return table->slots + key;
+    }
+    else
+    {
+        /* spawned and scripted IDs only, a sorted array is enough for them */
+        uint32_t pos = HandleTable_FarSlotPosition(table, key);
+        handle_far_slot_p far_slot;
+        if((pos < table->far_slots_count) && (table->far_slots[pos].key == key))
+        {
+            return &table->far_slots[pos].slot;
+        }
+        if(table->far_slots_count >= table->far_slots_capacity)
+        {
+            uint32_t new_capacity = (table->far_slots_capacity) ? (table->far_slots_capacity * 2) : (HANDLE_TABLE_MIN_SIZE);
+            handle_far_slot_p new_far_slots = (handle_far_slot_p)realloc(table->far_slots, new_capacity * sizeof(handle_far_slot_t));
+            if(!new_far_slots)
+            {
+                return NULL;
+            }
+            table->far_slots = new_far_slots;
+            table->far_slots_capacity = new_capacity;
+        }
+        far_slot = table->far_slots + pos;
+        memmove(far_slot + 1, far_slot, (table->far_slots_count - pos) * sizeof(handle_far_slot_t));
+        table->far_slots_count++;
+        far_slot->key = key;
+        far_slot->slot.index = HANDLE_TABLE_NONE;
+        far_slot->slot.generation = 0;
+        return &far_slot->slot;
+    }
+}
+
+
+/* the first far slot with key not less than the given one */
+static uint32_t HandleTable_FarSlotPosition(handle_table_p table, uint32_t key)
+{
+    uint32_t begin = 0;
+    uint32_t end = table->far_slots_count;
+    while(begin < end)
+    {
+        uint32_t mid = begin + (end - begin) / 2;
+        if(table->far_slots[mid].key < key)
+        {
+            begin = mid + 1;
+        }
+        else
+        {
+            end = mid;
+        }
+    }
+    return begin;
+}
+
+
+static int HandleTable_GrowDense(handle_table_p table)
+{
+    uint32_t new_capacity = (table->capacity) ? (table->capacity * 2) : (HANDLE_TABLE_MIN_SIZE);
+    void **new_data = (void**)realloc(table->data, new_capacity * sizeof(void*));
+    uint32_t *new_keys;
+    if(!new_data)
+    {
+        return 0;
+    }
+    table->data = new_data;
+    new_keys = (uint32_t*)realloc(table->keys, new_capacity * sizeof(uint32_t));
+    if(!new_keys)
+    {
+        return 0;
+    }
+    table->keys = new_keys;
+    table->capacity = new_capacity;
+    return 1;
+}
+
+
+static void HandleTable_Compact(handle_table_p table)
+{
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < table->count; ++i)
+    {
+        if(table->keys[i] != HANDLE_TABLE_NONE)
+        {
+            table->data[count] = table->data[i];
+            table->keys[count] = table->keys[i];
+            HandleTable_FindSlot(table, table->keys[i])->index = count;
+            count++;
+        }
+    }
+    table->count = count;
+    table->holes = 0;
+}
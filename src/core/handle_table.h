@@ -0,0 +1,82 @@
+#ifndef HANDLE_TABLE_H
+#define HANDLE_TABLE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+ * Dense table of objects addressed by integer keys (entity IDs).
+ * Small keys index the slot array directly, bigger ones are kept in a
+ * sorted array and searched. Objects are kept packed in insertion order
+ * for iteration; a removed object leaves a NULL hole that is squeezed out
+ * later, so removal is O(1) and never moves the others while an iteration
+ * is open. Every slot has a generation counter, handles made from
+ * (key, generation) become invalid after the object under the key was
+ * removed or replaced.
+ */
+
+#define HANDLE_TABLE_DIRECT_KEYS    (1 << 16)         /* keys below index the slots directly */
+#define HANDLE_TABLE_NONE           (0xFFFFFFFF)      /* never a valid key */
+
+#define HANDLE_TABLE_MAKE_HANDLE(key, gen)  (((uint64_t)(gen) << 32) | (uint64_t)(uint32_t)(key))
+#define HANDLE_TABLE_HANDLE_KEY(handle)     ((uint32_t)(handle))
+#define HANDLE_TABLE_HANDLE_GEN(handle)     ((uint32_t)((uint64_t)(handle) >> 32))
+#define HANDLE_TABLE_NO_HANDLE              HANDLE_TABLE_MAKE_HANDLE(HANDLE_TABLE_NONE, 0)
+
+typedef struct handle_slot_s
+{
+    uint32_t                    index;                /* dense index or HANDLE_TABLE_NONE */
+    uint32_t                    generation;
+} handle_slot_t, *handle_slot_p;
+
+typedef struct handle_far_slot_s
+{
+    uint32_t                    key;
+    struct handle_slot_s        slot;
+} handle_far_slot_t, *handle_far_slot_p;
+
+typedef struct handle_table_s
+{
+    void                      **data;                 /* dense objects array, NULL for holes */
+    uint32_t                   *keys;                 /* dense keys array, HANDLE_TABLE_NONE for holes */
+    uint32_t                    count;                /* holes included */
+    uint32_t                    holes;
+    uint32_t                    capacity;
+    uint32_t                    iterations;           /* open iterations, holes stay until the last one ends */
+    struct handle_slot_s       *slots;                /* key indexed slots */
+    uint32_t                    slots_count;
+    struct handle_far_slot_s   *far_slots;            /* sorted by key, never shrinks to keep generations */
+    uint32_t                    far_slots_count;
+    uint32_t                    far_slots_capacity;
+    void (*free_data)(void *data);
+} handle_table_t, *handle_table_p;
+
+void HandleTable_Init(handle_table_p table);
+void HandleTable_MakeEmpty(handle_table_p table);
+void HandleTable_Destroy(handle_table_p table);
+
+void *HandleTable_Get(handle_table_p table, uint32_t key);
+void *HandleTable_GetByHandle(handle_table_p table, uint64_t handle);
+uint64_t HandleTable_GetHandle(handle_table_p table, uint32_t key);
+uint32_t HandleTable_GetMaxKey(handle_table_p table);
+
+int  HandleTable_InsertReplace(handle_table_p table, uint32_t key, void *data);
+int  HandleTable_Remove(handle_table_p table, uint32_t key);
+void HandleTable_RemoveAt(handle_table_p table, uint32_t index);
+
+/*
+ * Between these calls data[0 .. count) keeps every object at its index:
+ * removed ones become NULL and new ones are appended. Calls may nest.
+ */
+void HandleTable_BeginIteration(handle_table_p table);
+void HandleTable_EndIteration(handle_table_p table);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif  /* HANDLE_TABLE_H */
@@ -22,6 +22,10 @@
 #include "gl_util.h"
 
 #define INIT_TEMP_MEM_SIZE          (4096 * 1024)
+#define LOG_RING_SIZE               (256)                   // must be power of 2
+#define LOG_RECORD_TEXT_SIZE        (1024 - 80)
+#define LOG_TARGET_NAME_SIZE        (64)
+#define LOG_FLUSH_INTERVAL_MS       (200)
 
 // stupid broken defines checking in internal stat.h
 #ifndef S_IFMT
@@ -32,6 +36,36 @@
 #define S_IFDIR __S_IFDIR
 #endif
 
+typedef struct log_record_s
+{
+    SDL_atomic_t        sequence;
+    uint8_t             level;
+    uint8_t             category;
+    uint16_t            length;
+    uint32_t            hash;
+    char                target[LOG_TARGET_NAME_SIZE];
+    char                text[LOG_RECORD_TEXT_SIZE];
+} log_record_t, *log_record_p;
+
+typedef struct log_state_s
+{
+    log_record_t        ring[LOG_RING_SIZE];
+    SDL_atomic_t        enqueue_pos;
+    uint32_t            dequeue_pos;
+    SDL_atomic_t        dropped;
+    SDL_atomic_t        stop;
+    SDL_Thread         *thread;
+    SDL_sem            *wakeup;
+    SDL_mutex          *write_lock;
+
+    uint32_t            last_hash;
+    uint32_t            last_repeats;
+    uint16_t            last_length;
+    char                last_target[LOG_TARGET_NAME_SIZE];
+    char                last_text[LOG_RECORD_TEXT_SIZE];
+    uint8_t             levels[SYS_LOG_CAT_COUNT];
+} log_state_t, *log_state_p;
+
 screen_info_t           screen_info;
 
 extern lua_State       *engine_lua;
@@ -40,6 +74,14 @@ static uint8_t         *engine_mem_buffer             = NULL;
 static size_t           engine_mem_buffer_size        = 0;
 static size_t           engine_mem_buffer_size_left   = 0;
 
+static log_state_t      sys_log;
+static const char      *sys_log_level_names[]         = {"debug", "info", "warning", "error"};
+static const char      *sys_log_category_names[]      = {"sys", "gl", "audio", "level", "script"};
+
+static void Sys_LogStart();
+static void Sys_LogStop();
+static void Sys_LogLevel(int level, const char *file, const char *fmt, ...);
+
 // =======================================================================
 // General routines
 // =======================================================================
@@ -49,6 +91,7 @@ void Sys_Init()
     engine_mem_buffer               = (uint8_t*)malloc(INIT_TEMP_MEM_SIZE);
     engine_mem_buffer_size          = INIT_TEMP_MEM_SIZE;
     engine_mem_buffer_size_left     = INIT_TEMP_MEM_SIZE;
+    Sys_LogStart();
 }
 
 
@@ -64,11 +107,17 @@ void Sys_InitGlobals()
     screen_info.fov = 75.0;
     screen_info.scale_factor = 1.0f;
     screen_info.fps = 0.0f;
+
+    for(int i = 0; i < SYS_LOG_CAT_COUNT; ++i)
+    {
+        sys_log.levels[i] = SYS_LOG_DEBUG;
+    }
 }
 
 
 void Sys_Destroy()
 {
+    Sys_LogStop();
     if(engine_mem_buffer)
     {
         free(engine_mem_buffer);
@@ -284,7 +333,8 @@ void Sys_Error(const char *error, ...)
     vsnprintf(string, sizeof(string), error, argptr);
     va_end(argptr);
 
-    Sys_DebugLog(SYS_LOG_FILENAME, "System error: %s", string);
+    Sys_LogLevel(SYS_LOG_ERROR, SYS_LOG_FILENAME, "System error: %s", string);
+    Sys_LogStop();
     //Engine_Shutdown(1);
     exit(1);
 }
@@ -298,43 +348,341 @@ void Sys_Warn(const char *warning, ...)
     va_start (argptr, warning);
     vsnprintf (string, sizeof(string), warning, argptr);
     va_end (argptr);
-    Sys_DebugLog(SYS_LOG_FILENAME, "Warning: %s", string);
+    Sys_LogLevel(SYS_LOG_WARNING, SYS_LOG_FILENAME, "Warning: %s", string);
     Con_Warning("Warning: %s", string);
 }
 
+/*
+ * Log messages are formatted on the caller side and pushed into a lock-free
+ * ring (bounded MPMC queue with per-record sequence numbers), the log thread
+ * drains it every LOG_FLUSH_INTERVAL_MS or on warnings / errors, so the file
+ * is opened once per batch, not once per message. Identical consecutive
+ * messages are collapsed into a "repeated N times" line.
+ * Without the log thread (before Sys_Init, after Sys_Destroy) or for messages
+ * too long for the record, the write is done in place, as before.
+ */
+static uint32_t Sys_LogHash(const char *target, const char *text, int length)
+{
+    uint32_t h = 2166136261u;
+    for(; *target; ++target)
+    {
+        h = (h ^ (uint8_t)*target) * 16777619u;
+    }
+    for(int i = 0; i < length; ++i)
+    {
+        h = (h ^ (uint8_t)text[i]) * 16777619u;
+    }
+    return h;
+}
+
 
-void Sys_DebugLog(const char *file, const char *fmt, ...)
+static void Sys_LogWriteFile(const char *target, const char *data, size_t size)
 {
-    va_list argptr;
-    static char data[4096];
-    int32_t written;
+    SDL_RWops *fp = SDL_RWFromFile(target, "a");
+    if(fp == NULL)
+    {
+        fp = SDL_RWFromFile(target, "w");
+    }
+    if(fp != NULL)
+    {
+        SDL_RWwrite(fp, data, size, 1);
+        SDL_RWclose(fp);
+    }
+    fwrite(data, size, 1, stderr);
+}
 
-    va_start(argptr, fmt);
-    written = vsnprintf(data, sizeof(data), fmt, argptr);
-    va_end(argptr);
 
-    if(written > 0)
+static void Sys_LogFlushRepeats()
+{
+    if(sys_log.last_repeats > 0)
+    {
+        char buf[64];
+        int len = snprintf(buf, sizeof(buf), "(last message repeated %d times)\n", sys_log.last_repeats);
+        Sys_LogWriteFile(sys_log.last_target, buf, len);
+        sys_log.last_repeats = 0;
+    }
+}
+
+
+/*
+ * Must be called with write_lock held: it is the only consumer of the ring.
+ */
+static void Sys_LogDrain()
+{
+    static char batch[LOG_RING_SIZE * 64];
+    size_t batch_size = 0;
+    char batch_target[LOG_TARGET_NAME_SIZE] = {0};
+    int dropped;
+
+    for(;;)
+    {
+        log_record_p rec = sys_log.ring + (sys_log.dequeue_pos & (LOG_RING_SIZE - 1));
+        int seq = SDL_AtomicGet(&rec->sequence);
+        if((int)((uint32_t)seq - (sys_log.dequeue_pos + 1)) < 0)
+        {
+            break;                                                              // empty
+        }
+        SDL_MemoryBarrierAcquire();
+
+        // the hash only saves the text compare for most of different messages
+        if((rec->hash == sys_log.last_hash) && (rec->length == sys_log.last_length) &&
+           !strncmp(rec->target, sys_log.last_target, LOG_TARGET_NAME_SIZE) &&
+           !memcmp(rec->text, sys_log.last_text, rec->length))
+        {
+            sys_log.last_repeats++;
+        }
+        else
+        {
+            if((batch_size > 0) && ((batch_size + rec->length > sizeof(batch)) || strncmp(batch_target, rec->target, LOG_TARGET_NAME_SIZE)))
+            {
+                Sys_LogWriteFile(batch_target, batch, batch_size);
+                batch_size = 0;
+            }
+            if(sys_log.last_repeats > 0)
+            {
+                if(batch_size > 0)
+                {
+                    Sys_LogWriteFile(batch_target, batch, batch_size);
+                    batch_size = 0;
+                }
+                Sys_LogFlushRepeats();
+            }
+            strncpy(batch_target, rec->target, LOG_TARGET_NAME_SIZE);
+            strncpy(sys_log.last_target, rec->target, LOG_TARGET_NAME_SIZE);
+            sys_log.last_hash = rec->hash;
+            sys_log.last_length = rec->length;
+            memcpy(sys_log.last_text, rec->text, rec->length);
+            memcpy(batch + batch_size, rec->text, rec->length);
+            batch_size += rec->length;
+        }
+
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&rec->sequence, (int)(sys_log.dequeue_pos + LOG_RING_SIZE));
+        sys_log.dequeue_pos++;
+    }
+
+    if(batch_size > 0)
+    {
+        Sys_LogWriteFile(batch_target, batch, batch_size);
+    }
+    Sys_LogFlushRepeats();
+
+    dropped = SDL_AtomicSet(&sys_log.dropped, 0);
+    if(dropped > 0)
+    {
+        char buf[64];
+        int len = snprintf(buf, sizeof(buf), "(log ring overflow: %d messages dropped)\n", dropped);
+        Sys_LogWriteFile(SYS_LOG_FILENAME, buf, len);
+    }
+}
+
+
+static int Sys_LogThread(void *data)
+{
+    while(!SDL_AtomicGet(&sys_log.stop))
+    {
+        SDL_SemWaitTimeout(sys_log.wakeup, LOG_FLUSH_INTERVAL_MS);
+        SDL_LockMutex(sys_log.write_lock);
+        Sys_LogDrain();
+        SDL_UnlockMutex(sys_log.write_lock);
+    }
+    return 0;
+}
+
+
+static void Sys_LogStart()
+{
+    if(!sys_log.thread)
+    {
+        for(uint32_t i = 0; i < LOG_RING_SIZE; ++i)
+        {
+            SDL_AtomicSet(&sys_log.ring[i].sequence, (int)i);
+        }
+        SDL_AtomicSet(&sys_log.enqueue_pos, 0);
+        SDL_AtomicSet(&sys_log.dropped, 0);
+        SDL_AtomicSet(&sys_log.stop, 0);
+        sys_log.dequeue_pos = 0;
+        sys_log.last_hash = 0;
+        sys_log.last_repeats = 0;
+        sys_log.last_length = 0;
+        sys_log.last_target[0] = 0;
+        sys_log.wakeup = SDL_CreateSemaphore(0);
+        sys_log.write_lock = SDL_CreateMutex();
+        if(sys_log.wakeup && sys_log.write_lock)
+        {
+            sys_log.thread = SDL_CreateThread(Sys_LogThread, "log", NULL);
+        }
+    }
+}
+
+
+static void Sys_LogStop()
+{
+    if(sys_log.thread)
+    {
+        SDL_AtomicSet(&sys_log.stop, 1);
+        SDL_SemPost(sys_log.wakeup);
+        SDL_WaitThread(sys_log.thread, NULL);
+        sys_log.thread = NULL;
+        SDL_LockMutex(sys_log.write_lock);
+        Sys_LogDrain();
+        SDL_UnlockMutex(sys_log.write_lock);
+        SDL_DestroySemaphore(sys_log.wakeup);
+        sys_log.wakeup = NULL;
+        SDL_DestroyMutex(sys_log.write_lock);
+        sys_log.write_lock = NULL;
+    }
+}
+
+
+static void Sys_LogPush(int level, const char *target, const char *text, int length)
+{
+    if(sys_log.thread && (length < LOG_RECORD_TEXT_SIZE))
     {
-        SDL_RWops *fp;
-        // Add newline at end (if possible)
-        if((written + 1) < sizeof(data))
+        uint32_t pos = (uint32_t)SDL_AtomicGet(&sys_log.enqueue_pos);
+        log_record_p rec;
+        for(;;)
+        {
+            int dif;
+            rec = sys_log.ring + (pos & (LOG_RING_SIZE - 1));
+            dif = (int)((uint32_t)SDL_AtomicGet(&rec->sequence) - pos);
+            if(dif == 0)
+            {
+                if(SDL_AtomicCAS(&sys_log.enqueue_pos, (int)pos, (int)(pos + 1)))
+                {
+                    break;
+                }
+            }
+            else if(dif < 0)
+            {
+                rec = NULL;                                                     // full
+                break;
+            }
+            pos = (uint32_t)SDL_AtomicGet(&sys_log.enqueue_pos);
+        }
+
+        if(!rec && (level < SYS_LOG_WARNING))
+        {
+            SDL_AtomicAdd(&sys_log.dropped, 1);
+            SDL_SemPost(sys_log.wakeup);
+            return;
+        }
+        else if(!rec)
         {
-            data[written + 0] = '\n';
-            data[written + 1] = 0;
-            written += 1;
+            // warnings and errors are never dropped, they are written here, after what is queued
+            SDL_LockMutex(sys_log.write_lock);
+            Sys_LogDrain();
+            Sys_LogWriteFile(target, text, length);
+            SDL_UnlockMutex(sys_log.write_lock);
+            return;
         }
 
-        fp = SDL_RWFromFile(file, "a");
-        if(fp == NULL)
+        SDL_MemoryBarrierAcquire();
+        rec->level = level;
+        rec->length = length;
+        rec->hash = Sys_LogHash(target, text, length);
+        strncpy(rec->target, target, LOG_TARGET_NAME_SIZE - 1);
+        rec->target[LOG_TARGET_NAME_SIZE - 1] = 0;
+        memcpy(rec->text, text, length);
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&rec->sequence, (int)(pos + 1));
+
+        if((level >= SYS_LOG_WARNING) || ((pos & (LOG_RING_SIZE / 2 - 1)) == 0))
         {
-            fp = SDL_RWFromFile(file, "w");
+            SDL_SemPost(sys_log.wakeup);
         }
-        if(fp != NULL)
+    }
+    else if(sys_log.thread)
+    {
+        SDL_LockMutex(sys_log.write_lock);
+        Sys_LogDrain();
+        Sys_LogWriteFile(target, text, length);
+        SDL_UnlockMutex(sys_log.write_lock);
+    }
+    else
+    {
+        Sys_LogWriteFile(target, text, length);
+    }
+}
+
+
+static void Sys_LogV(int level, const char *target, const char *prefix, const char *fmt, va_list argptr)
+{
+    char data[4096];
+    int32_t written = 0;
+
+    if(prefix)
+    {
+        written = snprintf(data, sizeof(data), "%s", prefix);
+    }
+    written += vsnprintf(data + written, sizeof(data) - written, fmt, argptr);
+
+    if(written > 0)
+    {
+        if(written >= sizeof(data) - 1)
         {
-            SDL_RWwrite(fp, data, written, 1);
-            SDL_RWclose(fp);
+            written = sizeof(data) - 2;
         }
-        fwrite(data, written, 1, stderr);
+        // Add newline at end
+        data[written + 0] = '\n';
+        data[written + 1] = 0;
+        written += 1;
+        Sys_LogPush(level, target, data, written);
+    }
+}
+
+
+void Sys_DebugLog(const char *file, const char *fmt, ...)
+{
+    va_list argptr;
+
+    va_start(argptr, fmt);
+    Sys_LogV(SYS_LOG_DEBUG, file, NULL, fmt, argptr);
+    va_end(argptr);
+}
+
+
+static void Sys_LogLevel(int level, const char *file, const char *fmt, ...)
+{
+    va_list argptr;
+
+    va_start(argptr, fmt);
+    Sys_LogV(level, file, NULL, fmt, argptr);
+    va_end(argptr);
+}
+
+
+void Sys_Log(int level, int category, const char *fmt, ...)
+{
+    if((category >= 0) && (category < SYS_LOG_CAT_COUNT) && (level >= sys_log.levels[category]) && (level < SYS_LOG_NONE))
+    {
+        va_list argptr;
+        char prefix[32];
+
+        snprintf(prefix, sizeof(prefix), "[%s] %s: ", sys_log_category_names[category], sys_log_level_names[level]);
+        va_start(argptr, fmt);
+        Sys_LogV(level, SYS_LOG_FILENAME, prefix, fmt, argptr);
+        va_end(argptr);
+    }
+}
+
+
+void Sys_LogSetLevel(int category, int level)
+{
+    if((category >= 0) && (category < SYS_LOG_CAT_COUNT))
+    {
+        sys_log.levels[category] = level;
+    }
+}
+
+
+void Sys_LogFlush()
+{
+    if(sys_log.thread)
+    {
+        SDL_LockMutex(sys_log.write_lock);
+        Sys_LogDrain();
+        SDL_UnlockMutex(sys_log.write_lock);
     }
 }
 
@@ -447,3 +795,20 @@ int Sys_FileFound(const char *name, int checkWrite)
     }
     return 0;
 }
+
+// puts a fully written temp file in place of name, the old file stays whole if anything fails
+int Sys_ReplaceFile(const char *tmp_name, const char *name)
+{
+    if(rename(tmp_name, name) == 0)
+    {
+        return 1;
+    }
+    // rename does not replace an existing file on every platform
+    remove(name);
+    if(rename(tmp_name, name) == 0)
+    {
+        return 1;
+    }
+    remove(tmp_name);
+    return 0;
+}
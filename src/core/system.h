@@ -12,6 +12,25 @@ extern "C" {
 
 #define SYS_LOG_FILENAME            "d_log.txt"
 
+enum sys_log_level_e
+{
+    SYS_LOG_DEBUG = 0,
+    SYS_LOG_INFO,
+    SYS_LOG_WARNING,
+    SYS_LOG_ERROR,
+    SYS_LOG_NONE
+};
+
+enum sys_log_category_e
+{
+    SYS_LOG_CAT_SYSTEM = 0,
+    SYS_LOG_CAT_GL,
+    SYS_LOG_CAT_AUDIO,
+    SYS_LOG_CAT_LEVEL,
+    SYS_LOG_CAT_SCRIPT,
+    SYS_LOG_CAT_COUNT
+};
+
 enum debug_view_state_e
 {
     no_debug = 0,
@@ -67,11 +86,15 @@ void Sys_Init(void);
 void Sys_Error(const char *error, ...);
 void Sys_Warn(const char *warning, ...);
 void Sys_DebugLog(const char *file, const char *fmt, ...);
+void Sys_Log(int level, int category, const char *fmt, ...);
+void Sys_LogSetLevel(int category, int level);
+void Sys_LogFlush();
 
 void Sys_WriteTGAfile(const char *filename, const uint8_t *data, const int width, const int height, int bpp, char invY);
 void Sys_TakeScreenShot();
 
 int Sys_FileFound(const char *name, int checkWrite);
+int Sys_ReplaceFile(const char *tmp_name, const char *name);
 
 #define Sys_LogCurrPlace Sys_DebugLog(SYS_LOG_FILENAME, "\"%s\" str = %d\n", __FILE__, __LINE__);
 #define Sys_extError(...) {Sys_LogCurrPlace Sys_Error(__VA_ARGS__);}
@@ -27,12 +27,14 @@ extern "C" {
 #include "script/script.h"
 #include "physics/physics.h"
 #include "fmv/tiny_codec.h"
+#include "fmv/stream_codec.h"
 #include "gui/gui.h"
 #include "gui/gui_inventory.h"
 #include "vt/vt_level.h"
 #include "audio/audio.h"
 #include "audio/audio_stream.h"
 #include "game.h"
+#include "save_state.h"
 #include "mesh.h"
 #include "skeletal_model.h"
 #include "entity.h"
@@ -54,7 +56,7 @@ static SDL_GameController      *sdl_controller = NULL;
 static SDL_Haptic              *sdl_haptic     = NULL;
 static SDL_GLContext            sdl_gl_context = 0;
 
-static tiny_codec_t             engine_video;
+static stream_codec_t           engine_video;
 int                             video_state;
 
 static char                     base_path[1024] = {0};
@@ -92,6 +94,26 @@ void Test_SecondaryMouseDown();
 void SetTestModel(int index);
 void ShowModelView(float time);
 void ShowDebugInfo();
+void Bench_EntityLookup(int iterations);
+void Bench_EntityQuery(int iterations);
+void Bench_TextileConvert(int iterations);
+void Bench_VideoDecode(const char *name, int frame_ms);
+void Bench_VideoColorConvert(int iterations);
+void Bench_RplDemux(const char *name);
+void Bench_SaveState();
+void Bench_AudioVoices(int count);
+void Bench_AudioEmitters(int frames);
+void Bench_AudioSamples();
+void Bench_LuaTasks(int count);
+void Bench_LuaGC(const char *level, int frames);
+void Bench_BvhCache(const char *level);
+void Bench_FrustumCull(int count);
+void Bench_EntityLights(int frames);
+void Bench_Hair(int frames);
+void Bench_Ragdolls(const char *level, int count);
+void Bench_Inventory(int frames);
+void Bench_Shaders();
+void Bench_Occlusion(const char *level, int views);
 
 void Engine_Start(int argc, char **argv)
 {
@@ -202,7 +224,7 @@ void Engine_Shutdown(int val)
     ClearTestModel();
     World_Clear();
 
-    codec_clear(&engine_video);
+    stream_codec_stop(&engine_video);
     video_state = 0;
 
     if(engine_lua)
@@ -217,6 +239,7 @@ void Engine_Shutdown(int val)
     Con_Destroy();
     GLText_Destroy();
     glf_destroy();
+    renderer.DeleteShaders();
     Sys_Destroy();
 
     /* no more renderings */
@@ -276,7 +299,7 @@ void Engine_InitDefaultGlobals()
 // First stage of initialization.
 void Engine_Init_Pre()
 {
-    codec_init(&engine_video, NULL);
+    stream_codec_init(&engine_video);
     video_state = 0;
 
     Sys_Init();
@@ -418,7 +441,7 @@ void Engine_InitSDLSubsystems()
         NumJoysticks = SDL_NumJoysticks();
         if((NumJoysticks < 1) || ((NumJoysticks - 1) < control_settings.joy_number))
         {
-            Sys_DebugLog(SYS_LOG_FILENAME, "Error: there is no joystick #%d present.", control_settings.joy_number);
+            Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_SYSTEM, "there is no joystick #%d present.", control_settings.joy_number);
             return;
         }
 
@@ -429,7 +452,7 @@ void Engine_InitSDLSubsystems()
 
             if(!sdl_controller)
             {
-                Sys_DebugLog(SYS_LOG_FILENAME, "Error: can't open game controller #%d.", control_settings.joy_number);
+                Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_SYSTEM, "can't open game controller #%d.", control_settings.joy_number);
                 SDL_GameControllerEventState(SDL_DISABLE);                      // If controller init failed, close state.
                 control_settings.use_joy = 0;
             }
@@ -438,7 +461,7 @@ void Engine_InitSDLSubsystems()
                 sdl_haptic = SDL_HapticOpenFromJoystick(SDL_GameControllerGetJoystick(sdl_controller));
                 if(!sdl_haptic)
                 {
-                    Sys_DebugLog(SYS_LOG_FILENAME, "Error: can't initialize haptic from game controller #%d.", control_settings.joy_number);
+                    Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_SYSTEM, "can't initialize haptic from game controller #%d.", control_settings.joy_number);
                 }
             }
         }
@@ -449,7 +472,7 @@ void Engine_InitSDLSubsystems()
 
             if(!sdl_joystick)
             {
-                Sys_DebugLog(SYS_LOG_FILENAME, "Error: can't open joystick #%d.", control_settings.joy_number);
+                Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_SYSTEM, "can't open joystick #%d.", control_settings.joy_number);
                 SDL_JoystickEventState(SDL_DISABLE);                            // If joystick init failed, close state.
                 control_settings.use_joy = 0;
             }
@@ -458,7 +481,7 @@ void Engine_InitSDLSubsystems()
                 sdl_haptic = SDL_HapticOpenFromJoystick(sdl_joystick);
                 if(!sdl_haptic)
                 {
-                    Sys_DebugLog(SYS_LOG_FILENAME, "Error: can't initialize haptic from joystick #%d.", control_settings.joy_number);
+                    Sys_Log(SYS_LOG_ERROR, SYS_LOG_CAT_SYSTEM, "can't initialize haptic from joystick #%d.", control_settings.joy_number);
                 }
             }
         }
@@ -796,32 +819,40 @@ void Engine_JoyRumble(float power, int time)
 }
 
 
-static int Engine_HandleVideo(uint64_t time_ns)
+static int Engine_FeedVideoAudio(stream_track_p s)
 {
-    stream_track_p s = Audio_GetStreamExternal();
-    if(StreamTrack_IsNeedUpdateBuffer(s))
-    {
-        codec_decode_audio(&engine_video);
-    }
-    if(engine_video.audio.buff && (engine_video.audio.buff_offset >= s->buffer_offset))
+    int ret = 0;
+    stream_codec_audio_block_p block;
+
+    while(StreamTrack_IsNeedUpdateBuffer(s) && (block = stream_codec_peek_audio(&engine_video)))
     {
-        s->current_volume = audio_settings.sound_volume;
-        StreamTrack_UpdateBuffer(s, engine_video.audio.buff, engine_video.audio.buff_size,
-            engine_video.audio.bits_per_sample, engine_video.audio.channels, engine_video.audio.sample_rate);
+        StreamTrack_UpdateBuffer(s, block->data, block->size, engine_video.audio_bits_per_sample, engine_video.audio_channels, engine_video.audio_sample_rate);
+        stream_codec_pop_audio(&engine_video);
+        ++ret;
     }
+    return ret;
+}
+
+
+static int Engine_HandleVideo(uint64_t time_ns)
+{
+    stream_track_p s = Audio_GetStreamExternal();
+    stream_codec_video_frame_p frame;
+
+    s->current_volume = audio_settings.sound_volume;
+    Engine_FeedVideoAudio(s);
     StreamTrack_Play(s);
 
-    uint64_t frame = engine_video.frame;
-    codec_inc_time(&engine_video, time_ns);
-    while (frame < engine_video.frame)
+    // decoding runs on the worker thread, here we only pick the frame due by now;
+    // the sound sets the pace while it plays, the frame time only when it does not
+    frame = stream_codec_get_video(&engine_video, time_ns, StreamTrack_GetPlayedSamples(s));
+    if(frame)
     {
-        frame++;
-        video_state = (codec_decode_video(&engine_video)) ? (1) : (0);
+        Gui_SetScreenTexture(frame->rgba, frame->width, frame->height, 32);
     }
-
-    if(engine_video.video.rgba)
+    else if(stream_codec_is_finished(&engine_video))
     {
-        Gui_SetScreenTexture(engine_video.video.rgba, engine_video.video.width, engine_video.video.height, 32);
+        video_state = 0;
     }
     Gui_DrawLoadScreen(-1);
 
@@ -841,7 +872,14 @@ static int Engine_HandleVideo(uint64_t time_ns)
         StreamTrack_Stop(s);
         Audio_StopStreams(-1);
 
-        codec_clear(&engine_video);
+        {
+            uint32_t tex_image_calls, sub_image_calls;
+            float upload_ms;
+            Gui_GetScreenTextureStats(&tex_image_calls, &sub_image_calls, &upload_ms);
+            Sys_Log(SYS_LOG_INFO, SYS_LOG_CAT_GL, "video: %d frames shown, %d dropped; %d glTexImage2D, %d glTexSubImage2D, %.3f ms upload per frame",
+                    engine_video.frames_shown, engine_video.frames_dropped, tex_image_calls, sub_image_calls, upload_ms);
+        }
+        stream_codec_stop(&engine_video);
     }
     
     return video_state;
@@ -917,13 +955,14 @@ void Engine_MainLoop()
         Sys_ResetTempMem();
         Engine_PollSDLEvents();
         
-        if(!engine_video.input)
+        if(!stream_codec_is_open(&engine_video))
         {
             if(!g_menu_mode && (screen_info.debug_view_state != debug_view_state_e::model_view))
             {
                 Gameflow_ProcessCommands();
                 Game_Frame(time);
             }
+            Script_FrameEnd(engine_lua);
             Audio_Update(time);
             Engine_Display(time);
             
@@ -1131,6 +1170,7 @@ int Engine_LoadMap(const char *name)
     if(is_success_load)
     {
         Game_Prepare();
+        SaveState_SetBaseline();
 
         room_p rooms;
         uint32_t rooms_count;
@@ -1154,28 +1194,22 @@ int  Engine_PlayVideo(const char *name)
 {
     if(video_state == 0)
     {
-        codec_init(&engine_video, SDL_RWFromFile(name, "rb"));
-        if(engine_video.input)
+        if(0 == stream_codec_open_rpl(&engine_video, SDL_RWFromFile(name, "rb")))
         {
-            if(0 == codec_open_rpl(&engine_video))
-            {
-                stream_track_p s = Audio_GetStreamExternal();
-                Gui_ConShow(0);
+            stream_track_p s = Audio_GetStreamExternal();
+            Gui_ConShow(0);
+            Gui_ResetScreenTextureStats();
 
-                s->current_volume = audio_settings.sound_volume;
-                while(StreamTrack_IsNeedUpdateBuffer(s))
+            // fill all stream buffers before the first frame, the worker is already decoding
+            s->current_volume = audio_settings.sound_volume;
+            while(StreamTrack_IsNeedUpdateBuffer(s) && !(SDL_AtomicGet(&engine_video.audio_end) && !stream_codec_peek_audio(&engine_video)))
+            {
+                if(!Engine_FeedVideoAudio(s))
                 {
-                    codec_decode_audio(&engine_video);
-                    if(engine_video.audio.buff && (engine_video.audio.buff_offset >= s->buffer_offset))
-                    {
-                        StreamTrack_UpdateBuffer(s, engine_video.audio.buff, engine_video.audio.buff_size,
-                            engine_video.audio.bits_per_sample, engine_video.audio.channels, engine_video.audio.sample_rate);
-                    }
+                    SDL_Delay(1);
                 }
-                codec_decode_video(&engine_video);
-                return (video_state = 1);
             }
-            codec_clear(&engine_video);
+            return (video_state = 1);
         }
     }
     return 0;
@@ -1214,6 +1248,28 @@ extern "C" int Engine_ExecCmd(char *ch)
             Con_AddLine("r_wireframe, r_portals, r_frustums, r_room_boxes, r_boxes, r_normals, r_skip_room, r_flyby, r_cinematics, r_triggers, r_ai_boxes, r_cameras - render modes, r_path - show character path\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("playsound(id) - play specified sound\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("stopsound(id) - stop specified sound\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_entities [count] - measure entity lookup and iteration time\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_entity_query [frames] - script entity loop with single bindings and with queryEntities\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_textiles [count] - measure textile conversion kernels on the test levels\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_fmv file [frame_ms] - decode a video without output, check frame order and drops\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_fmv_color [count] - measure video colour conversion kernels, compare them to scalar\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_rpl file - read all video packets with and without read-ahead, count file reads\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_save - save and load the current level in full, delta and Lua formats, compare the state\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_voices [count] - fire many effects at once, check which ones got audio sources\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_emitters [frames] - count sound source sends and OpenAL calls per audio update\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_samples - time level sample decoding, serial / parallel / cached\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_tasks [count] - run script tasks with mixed delays, check order and frame cost\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_lua_gc [frames] [level] - worst frame Lua time with the collector paced and not\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_bvh [level] - level load with the collision BVH cache cold and warm\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_frustum [count] - frustum box culling against the polygon clip test, random and level boxes\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_lights [frames] - entity light setup time on the loaded level\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_hair [frames] - hair solver time for 1, 10 and 50 chains\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_ragdolls [count] [level] - peak frame time when a wave of enemies dies in one second\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_inventory [frames] - open inventory frame time and draw calls, models against impostors\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_shaders - time to make every shader program without, with a cold and with a warm binary cache\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_occlusion [views] [level] - rooms, draw calls and frame time with occlusion culling off and on, hidden rooms checked\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("lua_profile [reset | csv file] - Lua time and allocations by callback type and model\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("lua_gc [ms] - Lua collector time per frame, 0 - collect as Lua does by itself\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("Watch out for case sensitive commands!\0", FONTSTYLE_CONSOLE_WARNING);
         }
         else if(!strcmp(token, "goto"))
@@ -1379,6 +1435,188 @@ extern "C" int Engine_ExecCmd(char *ch)
             }
             return 1;
         }
+        else if(!strcmp(token, "bench_entity_query"))
+        {
+            int iterations = SC_ParseInt(&ch);
+            Bench_EntityQuery((iterations > 0) ? (iterations) : (1000));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_entities"))
+        {
+            int iterations = SC_ParseInt(&ch);
+            Bench_EntityLookup((iterations > 0) ? (iterations) : (1000000));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_textiles"))
+        {
+            int iterations = SC_ParseInt(&ch);
+            Bench_TextileConvert((iterations > 0) ? (iterations) : (16));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_fmv_color"))
+        {
+            int iterations = SC_ParseInt(&ch);
+            Bench_VideoColorConvert((iterations > 0) ? (iterations) : (100));
+            return 1;
+        }
+        else if(!strcmp(token, "lua_profile"))
+        {
+            char arg[1024];
+            char *next = SC_ParseToken(ch, arg, sizeof(arg));
+            if(next && !strcmp(arg, "reset"))
+            {
+                Script_ProfileReset();
+            }
+            else if(next && !strcmp(arg, "csv"))
+            {
+                if(SC_ParseToken(next, arg, sizeof(arg)) && Script_ProfileDumpCSV(arg))
+                {
+                    Con_Printf("Lua profile saved to \"%s\"", arg);
+                }
+                else
+                {
+                    Con_Warning("lua_profile: can not write csv file");
+                }
+            }
+            else
+            {
+                Script_ProfilePrint(8);
+            }
+            return 1;
+        }
+        else if(!strcmp(token, "lua_gc"))
+        {
+            char *next = ch;
+            float ms = SC_ParseFloat(&next);
+            if(next)
+            {
+                Script_SetGCBudget(engine_lua, ms);
+            }
+            Con_Printf("Lua collector budget = %.2f ms", Script_GetGCBudget());
+            return 1;
+        }
+        else if(!strcmp(token, "bench_lua_gc"))
+        {
+            char level[1024];
+            int frames = SC_ParseInt(&ch);
+            if(!ch || !SC_ParseToken(ch, level, sizeof(level)))
+            {
+                strncpy(level, "tests/heavy1/LEVEL1.PHD", sizeof(level));
+            }
+            Bench_LuaGC(level, (frames > 0) ? (frames) : (1800));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_frustum"))
+        {
+            int count = SC_ParseInt(&ch);
+            Bench_FrustumCull((count > 0) ? (count) : (100000));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_lights"))
+        {
+            int frames = SC_ParseInt(&ch);
+            Bench_EntityLights((frames > 0) ? (frames) : (600));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_hair"))
+        {
+            int frames = SC_ParseInt(&ch);
+            Bench_Hair((frames > 0) ? (frames) : (600));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_ragdolls"))
+        {
+            char level[1024];
+            int count = SC_ParseInt(&ch);
+            if(!ch || !SC_ParseToken(ch, level, sizeof(level)))
+            {
+                strncpy(level, "tests/heavy1/LEVEL1.PHD", sizeof(level));
+            }
+            Bench_Ragdolls(level, (count > 0) ? (count) : (20));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_inventory"))
+        {
+            int frames = SC_ParseInt(&ch);
+            Bench_Inventory((frames > 0) ? (frames) : (300));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_shaders"))
+        {
+            Bench_Shaders();
+            return 1;
+        }
+        else if(!strcmp(token, "bench_occlusion"))
+        {
+            char level[1024];
+            int views = SC_ParseInt(&ch);
+            if(!ch || !SC_ParseToken(ch, level, sizeof(level)))
+            {
+                strncpy(level, "tests/heavy1/LEVEL1.PHD", sizeof(level));
+            }
+            Bench_Occlusion(level, (views > 0) ? (views) : (64));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_bvh"))
+        {
+            char level[1024];
+            if(!ch || !SC_ParseToken(ch, level, sizeof(level)))
+            {
+                strncpy(level, "tests/heavy1/LEVEL1.PHD", sizeof(level));
+            }
+            Bench_BvhCache(level);
+            return 1;
+        }
+        else if(!strcmp(token, "bench_tasks"))
+        {
+            int count = SC_ParseInt(&ch);
+            Bench_LuaTasks((count > 0) ? (count) : (10000));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_samples"))
+        {
+            Bench_AudioSamples();
+            return 1;
+        }
+        else if(!strcmp(token, "bench_emitters"))
+        {
+            int frames = SC_ParseInt(&ch);
+            Bench_AudioEmitters((frames > 0) ? (frames) : (600));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_voices"))
+        {
+            int count = SC_ParseInt(&ch);
+            Bench_AudioVoices((count > 0) ? (count) : (500));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_save"))
+        {
+            Bench_SaveState();
+            return 1;
+        }
+        else if(!strcmp(token, "bench_rpl"))
+        {
+            char name[1024];
+            ch = SC_ParseToken(ch, name, sizeof(name));
+            if(NULL != ch)
+            {
+                Bench_RplDemux(name);
+            }
+            return 1;
+        }
+        else if(!strcmp(token, "bench_fmv"))
+        {
+            char name[1024];
+            int frame_ms;
+            ch = SC_ParseToken(ch, name, sizeof(name));
+            if(NULL != ch)
+            {
+                frame_ms = SC_ParseInt(&ch);
+                Bench_VideoDecode(name, (frame_ms > 0) ? (frame_ms) : (16));
+            }
+            return 1;
+        }
         else if(!strcmp(token, "xxx"))
         {
             Con_SetLinesHistorySize(18);
@@ -6,16 +6,30 @@
 #include <stdlib.h>
 #include <string.h>
 
+extern "C" {
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+}
+
 #include "core/system.h"
 #include "core/gl_util.h"
 #include "core/gl_font.h"
 #include "core/gl_text.h"
 #include "core/console.h"
 #include "core/vmath.h"
+#include "core/obb.h"
 #include "render/camera.h"
 #include "render/render.h"
 #include "render/shader_manager.h"
 #include "render/bsp_tree.h"
+#include "render/frustum.h"
+#include "render/occlusion.h"
+#include "vt/vt_level.h"
+#include "vt/textile_convert.h"
+#include "fmv/stream_codec.h"
+#include "fmv/codecs/color_convert.h"
+#include "audio/audio.h"
 #include "physics/physics.h"
 #include "engine.h"
 #include "controls.h"
@@ -26,6 +40,11 @@
 #include "room.h"
 #include "trigger.h"
 #include "world.h"
+#include "game.h"
+#include "gui/gui.h"
+#include "gui/gui_inventory.h"
+#include "save_state.h"
+#include "script/script.h"
 
 
 static ss_bone_frame_t  g_test_model = {0};
@@ -522,3 +541,1571 @@ void ShowDebugInfo()
             break;
     };
 }
+
+
+static int Bench_EntityIterator(struct entity_s *ent, void *data)
+{
+    *((uint32_t*)data) += ent->id;
+    return 0;
+}
+
+
+void Bench_EntityLookup(int iterations)
+{
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    uint64_t t0, t1, t2;
+    uint32_t max_id = 0, found = 0, sum = 0;
+    entity_p player = World_GetPlayer();
+
+    World_IterateAllEntities(Bench_EntityIterator, &sum);
+    for(uint32_t id = 0; id < 65536; ++id)
+    {
+        if(World_GetEntityByID(id))
+        {
+            max_id = id + 1;
+        }
+    }
+    if(!max_id || (iterations <= 0))
+    {
+        Con_Warning("bench_entities: no entities or wrong iterations count");
+        return;
+    }
+
+    t0 = SDL_GetPerformanceCounter();
+    for(int i = 0; i < iterations; ++i)
+    {
+        found += (World_GetEntityByID(i % max_id)) ? (1) : (0);
+    }
+    t1 = SDL_GetPerformanceCounter();
+    for(int i = 0; i < iterations / (int)max_id + 1; ++i)
+    {
+        World_IterateAllEntities(Bench_EntityIterator, &sum);
+    }
+    t2 = SDL_GetPerformanceCounter();
+
+    Con_Printf("entities: %d, lookups: %d (found %d), %.2f ns per lookup", max_id, iterations, found,
+               1.0e9 * (double)(t1 - t0) / ((double)freq * (double)iterations));
+    Con_Printf("iterate all: %.2f ns per entity (check = %d, player = %d)",
+               1.0e9 * (double)(t2 - t1) / ((double)freq * (double)(iterations / max_id + 1) * (double)max_id),
+               sum, (player) ? (player->id) : (-1));
+}
+
+
+static const char *bench_textile_levels[] =
+{
+    "tests/altroom1/LEVEL1.PHD",
+    "tests/altroom2/LEVEL1.PHD",
+    "tests/altroom3/LEVEL1.PHD",
+    "tests/altroom4/LEVEL1.PHD",
+    "tests/heavy1/LEVEL1.PHD",
+    NULL
+};
+
+static void Bench_TextileJob(uint32_t i, void *data)
+{
+    VT_Level *tr = (VT_Level*)data;
+    uint32_t palette32[256];
+    Textile_MakePalette32(&tr->palette, palette32);
+    Textile_Palette8To32(&tr->textile8[i].pixels[0][0], palette32, &tr->textile32[i].pixels[0][0], 256 * 256);
+}
+
+void Bench_TextileConvert(int iterations)
+{
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    int best_kernel = Textile_SetKernel(TEXTILE_KERNEL_AUTO);
+    char path[1024];
+
+    for(const char **level = bench_textile_levels; *level; ++level)
+    {
+        VT_Level *tr;
+        uint32_t count, *reference;
+        uint16_t *pixels16;
+        uint32_t palette32[256];
+        uint64_t t0;
+
+        snprintf(path, sizeof(path), "%s%s", Engine_GetBasePath(), *level);
+        if(!Sys_FileFound(path, 0) || (VT_Level::get_PC_level_version(path) == TR_UNKNOWN))
+        {
+            Con_Warning("bench_textiles: can not open \"%s\"", path);
+            continue;
+        }
+
+        tr = new VT_Level();
+        tr->read_level(path, VT_Level::get_PC_level_version(path));
+        tr->prepare_level();
+        count = tr->textile32_count * 256 * 256;
+        if(!tr->textile8 || !count)
+        {
+            delete tr;
+            continue;
+        }
+
+        reference = (uint32_t*)malloc(count * sizeof(uint32_t));
+        pixels16 = (uint16_t*)malloc(count * sizeof(uint16_t));
+        Textile_MakePalette32(&tr->palette, palette32);
+        Textile_SetKernel(TEXTILE_KERNEL_SCALAR);
+        Textile_Palette8To32(&tr->textile8[0].pixels[0][0], palette32, reference, count);
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            // the same pixels packed back to 1555, transparent ones keep no alpha bit
+            uint32_t p = reference[i];
+            pixels16[i] = ((p & 0xf8) << 7) | ((p >> 6) & 0x03e0) | ((p >> 19) & 0x001f) | ((p >> 16) & 0x8000);
+        }
+
+        Con_Printf("%s: %d textiles", *level, tr->textile32_count);
+        for(int kernel = TEXTILE_KERNEL_SCALAR; kernel <= best_kernel; ++kernel)
+        {
+            uint32_t *dst = &tr->textile32[0].pixels[0][0];
+            double t_pal, t_1555, t_swap;
+            int errors = 0;
+
+            Textile_SetKernel(kernel);
+            t0 = SDL_GetPerformanceCounter();
+            for(int i = 0; i < iterations; ++i)
+            {
+                Textile_Palette8To32(&tr->textile8[0].pixels[0][0], palette32, dst, count);
+            }
+            t_pal = (double)(SDL_GetPerformanceCounter() - t0);
+            errors += memcmp(dst, reference, count * sizeof(uint32_t)) ? 1 : 0;
+
+            t0 = SDL_GetPerformanceCounter();
+            for(int i = 0; i < iterations; ++i)
+            {
+                Textile_1555To8888(pixels16, dst, count);
+            }
+            t_1555 = (double)(SDL_GetPerformanceCounter() - t0);
+
+            t0 = SDL_GetPerformanceCounter();
+            for(int i = 0; i < iterations; ++i)
+            {
+                Textile_SwapRB(dst, count);
+            }
+            t_swap = (double)(SDL_GetPerformanceCounter() - t0);
+
+            Con_Printf("  %s: palette %.3f ms, 1555 %.3f ms, swap %.3f ms per level%s", Textile_GetKernelName(kernel),
+                       1000.0 * t_pal / ((double)freq * iterations), 1000.0 * t_1555 / ((double)freq * iterations),
+                       1000.0 * t_swap / ((double)freq * iterations), (errors) ? (" MISMATCH") : (""));
+        }
+
+        Textile_SetKernel(best_kernel);
+        t0 = SDL_GetPerformanceCounter();
+        for(int i = 0; i < iterations; ++i)
+        {
+            Textile_ParallelFor(tr->textile32_count, Bench_TextileJob, tr);
+        }
+        Con_Printf("  %s parallel: palette %.3f ms per level", Textile_GetKernelName(best_kernel),
+                   1000.0 * (double)(SDL_GetPerformanceCounter() - t0) / ((double)freq * iterations));
+
+        free(pixels16);
+        free(reference);
+        delete tr;
+    }
+    Textile_SetKernel(best_kernel);
+}
+
+
+/*
+ * Colour conversion of the escape decoders on random full screen frames:
+ * every kernel must give the same bytes as the scalar one.
+ */
+void Bench_VideoColorConvert(int iterations)
+{
+    static const uint8_t chroma_vals[32] = {
+         20,  28,  36,  44,  52,  60,  68,  76,  84,  92, 100, 106, 112, 116, 120, 124,
+        128, 132, 136, 140, 144, 150, 156, 164, 172, 180, 188, 196, 204, 212, 220, 228
+    };
+    const uint32_t width = 640, height = 480, count = width * height;
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    int best_kernel = color_convert_set_kernel(COLOR_KERNEL_AUTO);
+    uint16_t *rgb555 = (uint16_t*)malloc(count * sizeof(uint16_t));
+    uint8_t *y = (uint8_t*)malloc(count + count / 2);
+    uint8_t *cb = y + count, *cr = y + count + count / 4;
+    uint8_t *reference = (uint8_t*)malloc(8 * count);
+    uint8_t *reference_yuv = reference + 4 * count;
+    uint8_t *dst = (uint8_t*)malloc(4 * count);
+    color_yuv_table_t yuv;
+
+    color_convert_yuv_table_init(&yuv, chroma_vals, 2);
+    srand(0x1234);
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        rgb555[i] = rand() & 0xFFFF;
+    }
+    for(uint32_t i = 0; i < count + count / 2; ++i)
+    {
+        y[i] = rand() & 0xFF;
+    }
+
+    for(int kernel = COLOR_KERNEL_SCALAR; kernel <= best_kernel; ++kernel)
+    {
+        uint8_t *out = (kernel == COLOR_KERNEL_SCALAR) ? (reference) : (dst);
+        uint8_t *out_yuv = (kernel == COLOR_KERNEL_SCALAR) ? (reference_yuv) : (dst);
+        double t_rgb, t_yuv;
+        int errors = 0;
+        uint64_t t0;
+
+        color_convert_set_kernel(kernel);
+        t0 = SDL_GetPerformanceCounter();
+        for(int i = 0; i < iterations; ++i)
+        {
+            color_convert_rgb555_to_rgba(rgb555, out, count);
+        }
+        t_rgb = (double)(SDL_GetPerformanceCounter() - t0) / (double)freq;
+        errors += memcmp(out, reference, 4 * count) ? 1 : 0;
+
+        t0 = SDL_GetPerformanceCounter();
+        for(int i = 0; i < iterations; ++i)
+        {
+            for(uint32_t row = 0; row < height; ++row)
+            {
+                uint32_t c = (row / 2) * (width / 2);
+                color_convert_yuv_to_rgba(&yuv, y + row * width, cb + c, cr + c, out_yuv + 4 * row * width, width);
+            }
+        }
+        t_yuv = (double)(SDL_GetPerformanceCounter() - t0) / (double)freq;
+        errors += memcmp(out_yuv, reference_yuv, 4 * count) ? 1 : 0;
+
+        Con_Printf("%s: rgb555 %.1f MP/s, yuv %.1f MP/s%s", color_convert_kernel_name(kernel),
+                   (double)count * iterations / (1.0e6 * t_rgb), (double)count * iterations / (1.0e6 * t_yuv),
+                   (errors) ? (" MISMATCH") : (""));
+    }
+
+    color_convert_set_kernel(best_kernel);
+    free(dst);
+    free(reference);
+    free(y);
+    free(rgb555);
+}
+
+
+/*
+ * Counts the calls that reach the file, so the demuxer read pattern can be compared.
+ */
+typedef struct bench_rw_s
+{
+    SDL_RWops  *rw;
+    uint32_t    reads;
+    uint32_t    seeks;
+} bench_rw_t, *bench_rw_p;
+
+static Sint64 SDLCALL Bench_RWSize(SDL_RWops *context)
+{
+    return SDL_RWsize(((bench_rw_p)context->hidden.unknown.data1)->rw);
+}
+
+static Sint64 SDLCALL Bench_RWSeek(SDL_RWops *context, Sint64 offset, int whence)
+{
+    bench_rw_p b = (bench_rw_p)context->hidden.unknown.data1;
+    b->seeks++;
+    return SDL_RWseek(b->rw, offset, whence);
+}
+
+static size_t SDLCALL Bench_RWRead(SDL_RWops *context, void *ptr, size_t size, size_t maxnum)
+{
+    bench_rw_p b = (bench_rw_p)context->hidden.unknown.data1;
+    b->reads++;
+    return SDL_RWread(b->rw, ptr, size, maxnum);
+}
+
+static size_t SDLCALL Bench_RWWrite(SDL_RWops *context, const void *ptr, size_t size, size_t num)
+{
+    return 0;
+}
+
+static int SDLCALL Bench_RWClose(SDL_RWops *context)
+{
+    bench_rw_p b = (bench_rw_p)context->hidden.unknown.data1;
+    int ret = SDL_RWclose(b->rw);
+    SDL_FreeRW(context);
+    return ret;
+}
+
+/*
+ * Reads every packet of a video in the order the decoder thread does and hashes it,
+ * returns the number of packets; hashes are stored video first, then audio.
+ */
+static uint32_t Bench_RplPackets(const char *name, uint32_t read_ahead, uint64_t *hashes, uint32_t max_hashes, bench_rw_p counter)
+{
+    tiny_codec_t codec;
+    SDL_RWops *rw = SDL_AllocRW();
+    uint32_t count = 0, old_read_ahead;
+    int video_end = 0, audio_end = 0;
+
+    counter->rw = SDL_RWFromFile(name, "rb");
+    counter->reads = 0;
+    counter->seeks = 0;
+    if(!counter->rw || !rw)
+    {
+        if(counter->rw)
+        {
+            SDL_RWclose(counter->rw);
+        }
+        if(rw)
+        {
+            SDL_FreeRW(rw);
+        }
+        return 0;
+    }
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->size = Bench_RWSize;
+    rw->seek = Bench_RWSeek;
+    rw->read = Bench_RWRead;
+    rw->write = Bench_RWWrite;
+    rw->close = Bench_RWClose;
+    rw->hidden.unknown.data1 = counter;
+
+    old_read_ahead = codec_set_rpl_read_ahead(read_ahead);
+    codec_init(&codec, rw);
+    if(0 == codec_open_rpl(&codec))
+    {
+        counter->reads = 0;
+        counter->seeks = 0;
+        while(!video_end || !audio_end)
+        {
+            for(int stream = 0; stream < 2; ++stream)
+            {
+                AVPacket *pkt = (stream) ? (&codec.audio.pkt) : (&codec.video.pkt);
+                int *end = (stream) ? (&audio_end) : (&video_end);
+                if(!*end)
+                {
+                    if(codec.packet(&codec, pkt) >= 0)
+                    {
+                        uint64_t hash = 0xcbf29ce484222325 ^ (uint64_t)pkt->pts ^ ((uint64_t)stream << 63);
+                        for(int i = 0; i < pkt->size; ++i)
+                        {
+                            hash = (hash ^ pkt->data[i]) * 0x100000001b3;
+                        }
+                        if(count < max_hashes)
+                        {
+                            hashes[count] = hash;
+                        }
+                        count++;
+                    }
+                    else
+                    {
+                        *end = 1;
+                    }
+                }
+            }
+        }
+    }
+    codec_clear(&codec);
+    codec_set_rpl_read_ahead(old_read_ahead);
+
+    return count;
+}
+
+
+/*
+ * Compares the buffered demuxer against reading every packet with its own seek.
+ */
+void Bench_RplDemux(const char *name)
+{
+    const uint32_t max_hashes = 65536;
+    uint64_t *direct = (uint64_t*)malloc(2 * max_hashes * sizeof(uint64_t));
+    uint64_t *buffered = direct + max_hashes;
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    uint64_t t0, t_direct, t_buffered;
+    bench_rw_t rw_direct, rw_buffered;
+    uint32_t n_direct, n_buffered;
+
+    t0 = SDL_GetPerformanceCounter();
+    n_direct = Bench_RplPackets(name, 0, direct, max_hashes, &rw_direct);
+    t_direct = SDL_GetPerformanceCounter() - t0;
+    t0 = SDL_GetPerformanceCounter();
+    n_buffered = Bench_RplPackets(name, RPL_READ_AHEAD_SIZE, buffered, max_hashes, &rw_buffered);
+    t_buffered = SDL_GetPerformanceCounter() - t0;
+
+    if(!n_direct)
+    {
+        Con_Warning("bench_rpl: can not read \"%s\"", name);
+    }
+    else
+    {
+        uint32_t n = (n_direct < max_hashes) ? (n_direct) : (max_hashes);
+        int same = (n_direct == n_buffered) && !memcmp(direct, buffered, n * sizeof(uint64_t));
+        Con_Printf("%d packets, %s", n_direct, (same) ? ("identical") : ("MISMATCH"));
+        Con_Printf("seek per packet: %d reads, %d seeks, %.3f ms", rw_direct.reads, rw_direct.seeks, 1000.0 * (double)t_direct / (double)freq);
+        Con_Printf("read-ahead: %d reads, %d seeks, %.3f ms", rw_buffered.reads, rw_buffered.seeks, 1000.0 * (double)t_buffered / (double)freq);
+    }
+    free(direct);
+}
+
+
+/*
+ * Plays a video without output: the clock advances by frame_ms per step and only
+ * waits when the decoder runs dry, like the main loop would on a slow machine.
+ */
+void Bench_VideoDecode(const char *name, int frame_ms)
+{
+    stream_codec_t video;
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    uint64_t step_ns = (uint64_t)frame_ms * 1000000;
+    uint64_t main_ticks = 0, max_ticks = 0, t_start;
+    int64_t last_pts = -1;
+    uint32_t steps = 0, order_errors = 0, underruns = 0, audio_blocks = 0;
+
+    stream_codec_init(&video);
+    if(0 != stream_codec_open_rpl(&video, SDL_RWFromFile(name, "rb")))
+    {
+        Con_Warning("bench_fmv: can not open \"%s\"", name);
+        return;
+    }
+
+    t_start = SDL_GetPerformanceCounter();
+    while(!stream_codec_is_finished(&video))
+    {
+        stream_codec_video_frame_p frame;
+        uint64_t t0, dt;
+        int queued = SDL_AtomicGet(&video.video_head) - SDL_AtomicGet(&video.video_tail);
+
+        if((queued <= video.video_hold) && !SDL_AtomicGet(&video.video_end))
+        {
+            underruns++;
+            SDL_Delay(1);
+            continue;
+        }
+
+        t0 = SDL_GetPerformanceCounter();
+        while(stream_codec_peek_audio(&video))
+        {
+            stream_codec_pop_audio(&video);
+            audio_blocks++;
+        }
+        frame = stream_codec_get_video(&video, (steps) ? (step_ns) : (0), -1);
+        dt = SDL_GetPerformanceCounter() - t0;
+        main_ticks += dt;
+        max_ticks = (dt > max_ticks) ? (dt) : (max_ticks);
+        steps++;
+
+        if(frame)
+        {
+            order_errors += ((int64_t)frame->pts <= last_pts) ? (1) : (0);
+            last_pts = frame->pts;
+        }
+    }
+
+    Con_Printf("bench_fmv: %d frames shown, %d dropped, %d out of order, %d audio blocks, %d underruns",
+               video.frames_shown, video.frames_dropped, order_errors, audio_blocks, underruns);
+    Con_Printf("main thread: %.2f us avg, %.2f us max per step; %.1f ms total",
+               1.0e6 * (double)main_ticks / ((double)freq * (double)((steps) ? (steps) : (1))),
+               1.0e6 * (double)max_ticks / (double)freq,
+               1.0e3 * (double)(SDL_GetPerformanceCounter() - t_start) / (double)freq);
+    stream_codec_stop(&video);
+}
+
+
+/*
+ * Saves and loads the current level through every format; the snapshot taken
+ * after each load is compared against the one taken before the first save.
+ * Run it right after a level load and again after playing for a while.
+ */
+static double Bench_SaveRoundTrip(const char *name, int delta, save_state_p before, int *same)
+{
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    uint64_t t0 = SDL_GetPerformanceCounter();
+    double ms;
+    save_state_t after;
+
+    if(delta)
+    {
+        Game_QuickSave(name);
+    }
+    else
+    {
+        Game_Save(name);
+    }
+    Game_Load(name);
+    ms = 1000.0 * (double)(SDL_GetPerformanceCounter() - t0) / (double)freq;
+
+    SaveState_Init(&after);
+    SaveState_Capture(&after);
+    *same = (after.size == before->size) && !memcmp(after.data, before->data, after.size);
+    SaveState_Clear(&after);
+
+    return ms;
+}
+
+
+void Bench_SaveState()
+{
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    uint64_t t0;
+    save_state_t before, delta;
+    double ms_full, ms_delta, ms_binary, ms_quick, ms_lua;
+    int same_binary, same_quick, same_lua;
+
+    SaveState_Init(&before);
+    SaveState_Init(&delta);
+    t0 = SDL_GetPerformanceCounter();
+    SaveState_Capture(&before);
+    ms_full = 1000.0 * (double)(SDL_GetPerformanceCounter() - t0) / (double)freq;
+    t0 = SDL_GetPerformanceCounter();
+    SaveState_CaptureDelta(&delta);
+    ms_delta = 1000.0 * (double)(SDL_GetPerformanceCounter() - t0) / (double)freq;
+    Con_Printf("bench_save: full snapshot %d bytes in %.3f ms, delta %d bytes in %.3f ms (baseline %d bytes)",
+               before.size, ms_full, delta.size, ms_delta, SaveState_GetBaselineSize());
+
+    ms_binary = Bench_SaveRoundTrip("bench.sav", 0, &before, &same_binary);
+    ms_quick = Bench_SaveRoundTrip("bench_quick.sav", 1, &before, &same_quick);
+    ms_lua = Bench_SaveRoundTrip("bench.lua", 0, &before, &same_lua);
+    Con_Printf("binary: %.3f ms save + load, state %s", ms_binary, (same_binary) ? ("identical") : ("DIFFERS"));
+    Con_Printf("delta: %.3f ms save + load, state %s", ms_quick, (same_quick) ? ("identical") : ("DIFFERS"));
+    Con_Printf("lua: %.3f ms save + load, state %s", ms_lua, (same_lua) ? ("identical") : ("differs (text rounding)"));
+    SaveState_Clear(&before);
+    SaveState_Clear(&delta);
+}
+
+
+/*
+ * Fires many effects at once, from global emitters and from entities around the
+ * listener, and shows how the voices were shared out; tests/test_audio_voices.c
+ * checks the order itself.
+ */
+void Bench_AudioVoices(int count)
+{
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    uint64_t t0;
+    uint32_t max_id = 0, results[4] = {0, 0, 0, 0};
+    audio_voice_stats_t stats;
+
+    for(uint32_t id = 0; id < 65536; ++id)
+    {
+        if(World_GetEntityByID(id))
+        {
+            max_id = id + 1;
+        }
+    }
+
+    t0 = SDL_GetPerformanceCounter();
+    for(int i = 0; i < count; ++i)
+    {
+        int ret = (i % 3) ? (Audio_Send(i % 512, TR_AUDIO_EMITTER_ENTITY, (max_id) ? (i % max_id) : (0))) :
+                            (Audio_Send(i % 512, TR_AUDIO_EMITTER_GLOBAL, i));
+        results[ret - TR_AUDIO_SEND_NOSAMPLE]++;
+    }
+    t0 = SDL_GetPerformanceCounter() - t0;
+    Audio_GetVoiceStats(&stats);
+
+    Con_Printf("bench_voices: %d sends in %.3f ms: %d processed, %d ignored, %d no channel, %d no sample", count,
+               1000.0 * (double)t0 / (double)freq, results[TR_AUDIO_SEND_PROCESSED - TR_AUDIO_SEND_NOSAMPLE],
+               results[TR_AUDIO_SEND_IGNORED - TR_AUDIO_SEND_NOSAMPLE], results[TR_AUDIO_SEND_NOCHANNEL - TR_AUDIO_SEND_NOSAMPLE],
+               results[0]);
+    Con_Printf("voices: %d real, %d virtual, %d free sources; weakest real %.3f, strongest virtual %.3f",
+               stats.real_voices, stats.virtual_voices, stats.free_sources, stats.min_real_score, stats.max_virtual_score);
+
+    for(int i = 0; i < count; ++i)
+    {
+        if(i % 3)
+        {
+            Audio_Kill(i % 512, TR_AUDIO_EMITTER_ENTITY, (max_id) ? (i % max_id) : (0));
+        }
+        else
+        {
+            Audio_Kill(i % 512, TR_AUDIO_EMITTER_GLOBAL, i);
+        }
+    }
+}
+
+
+/*
+ * Runs audio updates with and without sound source culling and counts the work
+ * done per frame; the listener stays where the camera is.
+ */
+void Bench_AudioEmitters(int frames)
+{
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    uint64_t t0;
+    int culling = Audio_SetEmitterCulling(0);
+
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        Audio_SetEmitterCulling(pass);
+        audio_update_stats.frames = 0;
+        audio_update_stats.emitters_sent = 0;
+        audio_update_stats.al_calls = 0;
+        t0 = SDL_GetPerformanceCounter();
+        for(int i = 0; i < frames; ++i)
+        {
+            Audio_Update(1.0f / 60.0f);
+        }
+        t0 = SDL_GetPerformanceCounter() - t0;
+        Con_Printf("%s: %.1f sound sources sent, %.1f AL calls, %.2f us per frame", (pass) ? ("culled") : ("all emitters"),
+                   (double)audio_update_stats.emitters_sent / (double)frames, (double)audio_update_stats.al_calls / (double)frames,
+                   1.0e6 * (double)t0 / ((double)freq * (double)frames));
+    }
+    Audio_SetEmitterCulling(culling);
+}
+
+
+/*
+ * Level sample decoding: one thread, all threads, and all threads with the
+ * PCM cache (the first cached pass fills it, the second one reads it).
+ */
+void Bench_AudioSamples()
+{
+    char path[1024];
+
+    for(const char **level = bench_textile_levels; *level; ++level)
+    {
+        VT_Level *tr;
+        uint32_t samples, cached;
+        double t_serial, t_parallel, t_fill, t_cached;
+
+        snprintf(path, sizeof(path), "%s%s", Engine_GetBasePath(), *level);
+        if(!Sys_FileFound(path, 0) || (VT_Level::get_PC_level_version(path) == TR_UNKNOWN))
+        {
+            Con_Warning("bench_samples: can not open \"%s\"", path);
+            continue;
+        }
+
+        tr = new VT_Level();
+        tr->read_level(path, VT_Level::get_PC_level_version(path));
+        if(!tr->samples_data)
+        {
+            delete tr;
+            continue;
+        }
+
+        t_serial = Audio_BenchSampleDecode(tr, 0, 0, &samples, &cached);
+        t_parallel = Audio_BenchSampleDecode(tr, -1, 0, &samples, &cached);
+        t_fill = Audio_BenchSampleDecode(tr, -1, 1, &samples, &cached);
+        t_cached = Audio_BenchSampleDecode(tr, -1, 1, &samples, &cached);
+        Con_Printf("%s: %d samples, serial %.2f ms, parallel %.2f ms, cache fill %.2f ms, cached %.2f ms (%d hits)",
+                   *level, samples, t_serial, t_parallel, t_fill, t_cached, cached);
+        delete tr;
+    }
+}
+
+
+/*
+ * Task scheduler on its own Lua state: tasks with mixed delays, some of them
+ * sleeping again after they run; tests/test_script_tasks.cpp checks the times
+ * they run at.
+ */
+static const char *bench_tasks_script =
+    "bench_runs = 0;\n"
+    "for i = 1, bench_count do\n"
+    "    local d = ((i * 7919) % 1500) / 60.0;\n"
+    "    if(i % 10 == 0) then d = d + 300.0; end;\n"
+    "    local k = (i % 7 == 0) and 3 or 0;\n"
+    "    addTask(function()\n"
+    "        bench_runs = bench_runs + 1;\n"
+    "        if(k > 0) then k = k - 1; return 0.5; end;\n"
+    "    end, d);\n"
+    "end;\n";
+
+void Bench_LuaTasks(int count)
+{
+    lua_State *lua = luaL_newstate();
+    script_task_stats_t stats;
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    uint64_t t_total = 0, t_max = 0, t_idle;
+    uint32_t frames = 0, run_max = 0;
+
+    luaL_openlibs(lua);
+    Script_LuaRegisterTaskFuncs(lua);
+    lua_pushinteger(lua, count);
+    lua_setglobal(lua, "bench_count");
+    if(luaL_dostring(lua, bench_tasks_script) != LUA_OK)
+    {
+        Con_Warning("bench_tasks: %s", lua_tostring(lua, -1));
+        lua_close(lua);
+        return;
+    }
+
+    do
+    {
+        uint64_t t0 = SDL_GetPerformanceCounter();
+        Script_DoTasks(lua, 1.0f / 60.0f);
+        t0 = SDL_GetPerformanceCounter() - t0;
+        t_total += t0;
+        t_max = (t0 > t_max) ? (t0) : (t_max);
+        frames++;
+        Script_GetTaskStats(lua, &stats);
+        run_max = (stats.run > run_max) ? (stats.run) : (run_max);
+    }
+    while(stats.tasks && (frames < 60 * 60 * 60));
+
+    // a frame with nothing due, with all tasks asleep
+    luaL_dostring(lua, "for i = 1, bench_count do addTask(function() end, 1000.0); end;");
+    t_idle = SDL_GetPerformanceCounter();
+    for(int i = 0; i < 1000; ++i)
+    {
+        Script_DoTasks(lua, 1.0f / 60.0f);
+    }
+    t_idle = SDL_GetPerformanceCounter() - t_idle;
+
+    lua_getglobal(lua, "bench_runs");
+    Con_Printf("tasks: %d runs in %d frames, %d cascaded", (int)lua_tointeger(lua, -1), frames, stats.cascaded);
+    lua_pop(lua, 1);
+    Con_Printf("  frame avg %.3f us, max %.3f us (%d tasks due), idle with %d asleep %.3f us",
+               1.0e6 * (double)t_total / ((double)freq * frames), 1.0e6 * (double)t_max / (double)freq, run_max,
+               count, 1.0e6 * (double)t_idle / ((double)freq * 1000.0));
+    lua_close(lua);
+}
+
+
+/*
+ * The level is played without rendering, once with the Lua collector left
+ * alone and once stepped for the budget time at the end of every frame;
+ * the level is loaded again for each pass.
+ */
+void Bench_LuaGC(const char *level, int frames)
+{
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    float budget = (Script_GetGCBudget() > 0.0f) ? (Script_GetGCBudget()) : (SCRIPT_GC_BUDGET_MS);
+    float old_budget = Script_GetGCBudget();
+
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        script_frame_stats_t stats;
+
+        Script_SetGCBudget(engine_lua, (pass) ? (budget) : (0.0f));
+        if(!Engine_LoadMap(level))
+        {
+            Con_Warning("bench_lua_gc: can not load \"%s\"", level);
+            break;
+        }
+        Script_FrameEnd(engine_lua);
+        Script_ProfileReset();
+        for(int i = 0; i < frames; ++i)
+        {
+            Game_Frame(1.0f / 60.0f);
+            Script_FrameEnd(engine_lua);
+        }
+        Script_GetFrameStats(&stats);
+        Con_Printf("%s: Lua worst frame %.3f ms, avg %.3f ms, %d KB", (pass) ? ("paced") : ("default gc"),
+                   ms * stats.worst_ticks, ms * stats.total_ticks / stats.frames, stats.memory_kb);
+        if(pass)
+        {
+            Con_Printf("  %d collector cycles in %d frames", stats.gc_cycles, stats.frames);
+        }
+    }
+    Script_SetGCBudget(engine_lua, old_budget);
+}
+
+
+/*
+ * Frustum box test against the polygon clip test it replaced: random boxes
+ * around random cameras, then the static meshes of the rooms the camera sees,
+ * through their portal frustums. tests/test_frustum.cpp checks that the box
+ * test never drops a box the clip test keeps.
+ */
+typedef struct bench_frustum_s
+{
+    uint64_t    t_clip;
+    uint64_t    t_box;
+    int         count;
+    int         visible;
+    int         box_visible;
+    int         differ;             // box and clip tests disagree
+}bench_frustum_t, *bench_frustum_p;
+
+static float Bench_Rand(float min, float max)
+{
+    return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+static void Bench_FrustumCompare(bench_frustum_p b, obb_p *obbs, frustum_p *frustums, int count)
+{
+    uint64_t t;
+
+    t = SDL_GetPerformanceCounter();
+    for(int i = 0; i < count; ++i)
+    {
+        for(frustum_p f = frustums[i]; f; f = f->next)
+        {
+            if(Frustum_IsOBBVisibleClip(obbs[i], f))
+            {
+                b->visible++;
+                break;
+            }
+        }
+    }
+    b->t_clip += SDL_GetPerformanceCounter() - t;
+
+    t = SDL_GetPerformanceCounter();
+    for(int i = 0; i < count; ++i)
+    {
+        if(Frustum_IsOBBVisibleInFrustumList(obbs[i], frustums[i]))
+        {
+            b->box_visible++;
+        }
+    }
+    b->t_box += SDL_GetPerformanceCounter() - t;
+
+    for(int i = 0; i < count; ++i)
+    {
+        bool clip = false;
+        for(frustum_p f = frustums[i]; f; f = f->next)
+        {
+            clip = clip || Frustum_IsOBBVisibleClip(obbs[i], f);
+        }
+        b->differ += (clip != Frustum_IsOBBVisibleInFrustumList(obbs[i], frustums[i])) ? (1) : (0);
+    }
+    b->count += count;
+}
+
+static void Bench_FrustumPrint(bench_frustum_p b, const char *name)
+{
+    double us = 1.0e6 / (double)SDL_GetPerformanceFrequency();
+    int culled = b->count - b->visible;
+    int box_culled = b->count - b->box_visible;
+
+    Con_Printf("%s: %d boxes; clip test %d culled, %.2f per us; box test %d culled, %.2f per us",
+               name, b->count, culled, culled / (us * b->t_clip + 1.0e-6), box_culled, box_culled / (us * b->t_box + 1.0e-6));
+    Con_Printf("  %d differ from the clip test", b->differ);
+}
+
+void Bench_FrustumCull(int count)
+{
+    camera_t cam;
+    obb_p *obbs = (obb_p*)malloc(count * sizeof(obb_p));
+    frustum_p *frustums = (frustum_p*)malloc(count * sizeof(frustum_p));
+    float *transforms = (float*)malloc(count * 16 * sizeof(float));
+    bench_frustum_t bench;
+    room_p rooms;
+    uint32_t rooms_count;
+    int n;
+
+    srand(count);
+    memset(&bench, 0, sizeof(bench));
+    memset(&cam, 0, sizeof(cam));
+    Cam_Init(&cam);
+    for(int i = 0; i < count; ++i)
+    {
+        float ang[3], bb_min[3], bb_max[3];
+        float *tr = transforms + 16 * i;
+
+        obbs[i] = OBB_Create();
+        bb_max[0] = Bench_Rand(8.0f, 1024.0f);
+        bb_max[1] = Bench_Rand(8.0f, 1024.0f);
+        bb_max[2] = Bench_Rand(8.0f, 1024.0f);
+        vec3_mul_scalar(bb_min, bb_max, -Bench_Rand(0.0f, 1.0f));
+        OBB_Rebuild(obbs[i], bb_min, bb_max);
+        ang[0] = Bench_Rand(0.0f, 360.0f);
+        ang[1] = Bench_Rand(0.0f, 360.0f);
+        ang[2] = Bench_Rand(0.0f, 360.0f);
+        Mat4_E(tr);
+        Mat4_SetAnglesZXY(tr, ang);
+        tr[12] = Bench_Rand(-8192.0f, 8192.0f);
+        tr[13] = Bench_Rand(-8192.0f, 8192.0f);
+        tr[14] = Bench_Rand(-8192.0f, 8192.0f);
+        obbs[i]->transform = tr;
+        OBB_Transform(obbs[i]);
+        frustums[i] = cam.frustum;
+    }
+
+    // one camera per batch of boxes, the planes are packed once per camera as in a frame
+    for(int i = 0; i < count; i += 256)
+    {
+        float ang[3] = {Bench_Rand(0.0f, 360.0f), Bench_Rand(0.0f, 360.0f), Bench_Rand(0.0f, 360.0f)};
+        vec3_set_zero(cam.transform.M4x4 + 12);
+        Cam_SetRotation(&cam, ang);
+        Cam_RecalcClipPlanes(&cam);
+        Bench_FrustumCompare(&bench, obbs + i, frustums + i, (count - i < 256) ? (count - i) : (256));
+    }
+    Bench_FrustumPrint(&bench, "random");
+
+    for(int i = 0; i < count; ++i)
+    {
+        obbs[i]->transform = NULL;
+        OBB_Delete(obbs[i]);
+    }
+    free(transforms);
+    free(cam.frustum->vertex);
+    free(cam.frustum);
+
+    // static meshes of the visible rooms, as the renderer tests them
+    World_GetRoomInfo(&rooms, &rooms_count);
+    if(rooms && engine_camera.frustum)
+    {
+        renderer.GenWorldList(&engine_camera);
+        n = 0;
+        for(uint32_t i = 0; i < rooms_count; ++i)
+        {
+            room_p r = rooms + i;
+            if(r->is_in_r_list && r->content)
+            {
+                for(uint32_t j = 0; (j < r->content->static_mesh_count) && (n < count); ++j)
+                {
+                    obbs[n] = r->content->static_mesh[j].obb;
+                    frustums[n++] = (r->frustum) ? (r->frustum) : (engine_camera.frustum);
+                }
+            }
+        }
+        if(n > 0)
+        {
+            memset(&bench, 0, sizeof(bench));
+            Bench_FrustumCompare(&bench, obbs, frustums, n);
+            Bench_FrustumPrint(&bench, "level");
+        }
+    }
+
+    free(obbs);
+    free(frustums);
+}
+
+
+/*
+ * The same level loaded twice: once with its BVH cache file removed, so every
+ * room and static mesh BVH is built, and once attaching them from the file.
+ */
+void Bench_BvhCache(const char *level)
+{
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    char path[1024];
+
+    snprintf(path, sizeof(path), "%s%s", Engine_GetBasePath(), level);
+    Physics_BvhCacheRemove(path);
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        physics_bvh_cache_stats_t stats;
+        uint64_t t0 = SDL_GetPerformanceCounter();
+
+        if(!Engine_LoadMap(level))
+        {
+            Con_Warning("bench_bvh: can not load \"%s\"", level);
+            break;
+        }
+        t0 = SDL_GetPerformanceCounter() - t0;
+        Physics_GetBvhCacheStats(&stats);
+        Con_Printf("%s cache: BVHs %.2f ms (%d built, %d from file, %d shared), level load %.1f ms", (pass) ? ("warm") : ("cold"),
+                   stats.time_ms, stats.built, stats.attached, stats.shared, ms * t0);
+    }
+}
+
+
+/*
+ * One frame of a script that looks at every entity: a binding call per
+ * entity and value, against one queryEntities call for all of them.
+ */
+static const char *bench_query_single =
+    "for i = 1, #bench_query_ids do\n"
+    "    local id = bench_query_ids[i];\n"
+    "    local x, y, z = getEntityPos(id);\n"
+    "    local d = (player ~= nil) and getEntityDistance(player, id) or 0.0;\n"
+    "    local a = getEntityActivity(id);\n"
+    "end;\n";
+
+static const char *bench_query_bulk =
+    "local n = queryEntities(bench_query, {from = player});\n"
+    "for i = 1, n do\n"
+    "    local x, y, z = bench_query.x[i], bench_query.y[i], bench_query.z[i];\n"
+    "    local d, a = bench_query.dist[i], (bench_query.flags[i] & ENTITY_STATE_ACTIVE) ~= 0;\n"
+    "end;\n";
+
+void Bench_EntityQuery(int iterations)
+{
+    lua_State *lua = engine_lua;
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    int top = lua_gettop(lua);
+    int count;
+
+    if(luaL_dostring(lua, "bench_query = {}; bench_query_ids = {}; local n = queryEntities(bench_query);"
+                          "for i = 1, n do bench_query_ids[i] = bench_query.id[i]; end; return n;") != LUA_OK)
+    {
+        Con_Warning("bench_entity_query: %s", lua_tostring(lua, -1));
+        lua_settop(lua, top);
+        return;
+    }
+    count = lua_tointeger(lua, -1);
+
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        uint64_t t0;
+        if(luaL_loadstring(lua, (pass) ? (bench_query_bulk) : (bench_query_single)) != LUA_OK)
+        {
+            Con_Warning("bench_entity_query: %s", lua_tostring(lua, -1));
+            break;
+        }
+        t0 = SDL_GetPerformanceCounter();
+        for(int i = 0; i < iterations; ++i)
+        {
+            lua_pushvalue(lua, -1);
+            lua_CallAndLog(lua, 0, 0, 0);
+        }
+        t0 = SDL_GetPerformanceCounter() - t0;
+        lua_pop(lua, 1);
+        Con_Printf("%s: %d entities, %.2f us per frame", (pass) ? ("queryEntities") : ("single bindings"), count,
+                   1.0e6 * (double)t0 / ((double)freq * (double)iterations));
+    }
+
+    luaL_dostring(lua, "bench_query = nil; bench_query_ids = nil;");
+    lua_settop(lua, top);
+}
+
+
+/*
+ * Entity lights: the time the light setup takes per frame on a level, the old
+ * first-in-range walk against the cached strongest ones. The choice itself is
+ * checked by tests/test_render_lights.cpp.
+ */
+void CalculateWaterTint(GLfloat *tint, uint8_t fixed_colour);
+
+// the walk SetupEntityLight did before: the first lights in range, own room then near rooms
+static GLenum Bench_LightsOld(entity_p entity, const float mv[16], GLfloat *positions, GLfloat *colors, GLfloat *inner, GLfloat *outer)
+{
+    room_p room = entity->self->room;
+    float *entity_pos = entity->transform.M4x4 + 12;
+    GLenum n = 0;
+
+    for(uint32_t r = 0; (r <= room->content->near_room_list_size) && (n < MAX_NUM_LIGHTS); r++)
+    {
+        room_p src = (r) ? (room->content->near_room_list[r - 1]) : (room);
+        for(uint32_t i = 0; (i < src->content->lights_count) && (n < MAX_NUM_LIGHTS); i++)
+        {
+            light_p light = src->content->lights + i;
+            float d[3], distance;
+
+            vec3_sub(d, entity_pos, light->pos);
+            distance = vec3_abs(d);
+            for(int k = 0; k < 4; k++)
+            {
+                colors[n * 4 + k] = (light->colour[k] < 0.0f) ? (0.0f) : ((light->colour[k] > 1.0f) ? (1.0f) : (light->colour[k]));
+            }
+            if(!r && (room->content->room_flags & TR_ROOM_FLAG_WATER))
+            {
+                CalculateWaterTint(colors + n * 4, 0);
+            }
+            Mat4_vec3_mul(positions + 3 * n, mv, light->pos);
+            if(!r && (light->light_type == LT_SUN))
+            {
+                inner[n] = 1e20f;
+                outer[n] = 1e21f;
+                n++;
+            }
+            else if((distance <= light->outer + 1024.0f) && ((light->light_type == LT_POINT) || (light->light_type == LT_SHADOW)))
+            {
+                inner[n] = fabsf(light->inner);
+                outer[n] = fabsf(light->outer);
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
+
+static int Bench_LightsCollect(entity_p entity, void *data)
+{
+    entity_p **list = (entity_p**)data;
+    if(entity->self->room)
+    {
+        *((*list)++) = entity;
+    }
+    return 0;
+}
+
+void Bench_EntityLights(int frames)
+{
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+    if(!World_GetPlayer() && !Engine_LoadMap("tests/heavy1/LEVEL1.PHD"))
+    {
+        Con_Warning("bench_lights: can not load \"tests/heavy1/LEVEL1.PHD\"");
+        return;
+    }
+
+    {
+        GLfloat positions[3 * MAX_NUM_LIGHTS];
+        GLfloat colors[4 * MAX_NUM_LIGHTS];
+        GLfloat inner[MAX_NUM_LIGHTS];
+        GLfloat outer[MAX_NUM_LIGHTS];
+        entity_p *entities = (entity_p*)malloc(65536 * sizeof(entity_p));
+        entity_p *end = entities;
+        uint64_t t[3] = {0};
+        uint32_t lights[3] = {0};
+        int count, n;
+
+        World_IterateAllEntities(Bench_LightsCollect, &end);
+        count = end - entities;
+        for(int f = 0; f < frames; f++)
+        {
+            for(int pass = 0; pass < 3; pass++)
+            {
+                uint64_t t0 = SDL_GetPerformanceCounter();
+                for(int i = 0; i < count; i++)
+                {
+                    entity_p ent = entities[i];
+                    float mv[16];
+                    Mat4_Mat4_mul(mv, engine_camera.gl_view_mat, ent->transform.M4x4);
+                    if(pass == 0)
+                    {
+                        lights[pass] += Bench_LightsOld(ent, mv, positions, colors, inner, outer);
+                    }
+                    else
+                    {
+                        if(pass == 2)
+                        {
+                            ent->lights.room = NULL;        // chosen again every frame
+                        }
+                        lights[pass] += renderer.GetEntityLights(ent, mv, positions, colors, inner, outer);
+                    }
+                }
+                t[pass] += SDL_GetPerformanceCounter() - t0;
+            }
+        }
+        free(entities);
+
+        frames = (frames > 0) ? (frames) : (1);
+        n = (count > 0) ? (frames * count) : (1);
+        Con_Printf("%d entities, light setup per frame (without the uniform upload):", count);
+        Con_Printf("  first in range: %.3f ms, %.2f lights per entity", ms * t[0] / frames, (float)lights[0] / (float)n);
+        Con_Printf("  cached strongest: %.3f ms, chosen every frame: %.3f ms, %.2f lights per entity",
+                   ms * t[1] / frames, ms * t[2] / frames, (float)lights[1] / (float)n);
+    }
+}
+
+
+/*
+ * Hair chains on the player, swung around by moving the player itself: solver
+ * time per frame for 1, 10 and 50 chains. tests/test_hair.cpp checks that the
+ * element lengths hold.
+ */
+
+static struct hair_s *Bench_HairCreate(entity_p player)
+{
+    struct hair_s *ret = NULL;
+    int top = lua_gettop(engine_lua);
+
+    lua_getglobal(engine_lua, "hair");
+    for(int i = HAIR_TR1; lua_istable(engine_lua, -1) && !ret && (i <= HAIR_TR5_OLD); i++)
+    {
+        hair_setup_p setup;
+        lua_rawgeti(engine_lua, -1, i);
+        setup = Hair_GetSetup(engine_lua, lua_gettop(engine_lua));
+        ret = Hair_Create(setup, player);
+        Hair_DeleteSetup(setup);
+        lua_pop(engine_lua, 1);
+    }
+    lua_settop(engine_lua, top);
+
+    return ret;
+}
+
+void Bench_Hair(int frames)
+{
+    static const int counts[3] = {1, 10, 50};
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    entity_p player = World_GetPlayer();
+    struct hair_s *hairs[50];
+    float saved[16];
+
+    if(!player && Engine_LoadMap("tests/heavy1/LEVEL1.PHD"))
+    {
+        player = World_GetPlayer();
+    }
+    if(!player || !player->character)
+    {
+        Con_Warning("bench_hair: no player");
+        return;
+    }
+
+    Mat4_Copy(saved, player->transform.M4x4);
+    for(int c = 0; c < 3; c++)
+    {
+        uint64_t t = 0;
+        int n = 0;
+
+        Mat4_Copy(player->transform.M4x4, saved);
+        for(; (n < counts[c]) && ((hairs[n] = Bench_HairCreate(player)) != NULL); n++);
+        if(n < counts[c])
+        {
+            Con_Warning("bench_hair: no hair model in this level");
+            for(int i = 0; i < n; i++)
+            {
+                Hair_Delete(hairs[i]);
+            }
+            break;
+        }
+
+        for(int f = 0; f < frames; f++)
+        {
+            // runs, turns and stops, faster than the animations would
+            float a = 0.05f * f;
+            float pos[3] = {saved[12] + 512.0f * sinf(a), saved[13] + 256.0f * sinf(2.7f * a), saved[14] + 64.0f * sinf(5.0f * a)};
+            uint64_t t0;
+
+            Mat4_Copy(player->transform.M4x4, saved);
+            Mat4_RotateZ_SinCos(player->transform.M4x4, sinf(2.0f * sinf(0.7f * a)), cosf(2.0f * sinf(0.7f * a)));
+            vec3_copy(player->transform.M4x4 + 12, pos);
+
+            t0 = SDL_GetPerformanceCounter();
+            for(int i = 0; i < n; i++)
+            {
+                Hair_Update(hairs[i], player, 1.0f / 60.0f);
+            }
+            t += SDL_GetPerformanceCounter() - t0;
+        }
+
+        for(int i = 0; i < n; i++)
+        {
+            Hair_Delete(hairs[i]);
+        }
+        Con_Printf("%d hair chains: %.4f ms per frame", n, ms * t / ((frames > 0) ? (frames) : (1)));
+    }
+    Mat4_Copy(player->transform.M4x4, saved);
+}
+
+
+/*
+ * A wave of enemies dying in the same second, with the ragdoll pool empty
+ * (ragdolls built at death, as before the pool) and with it reserved at
+ * load: the worst frame of that second is what the player sees.
+ */
+static int Bench_RagdollCollect(entity_p ent, void *data)
+{
+    entity_p **list = (entity_p**)data;
+    if(ent->character && (ent != World_GetPlayer()) && Physics_IsBodyesInited(ent->physics) && !(ent->type_flags & ENTITY_TYPE_DYNAMIC))
+    {
+        *((*list)++) = ent;
+    }
+    return 0;
+}
+
+void Bench_Ragdolls(const char *level, int count)
+{
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    entity_p *victims = (entity_p*)malloc(4096 * sizeof(entity_p));
+
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        physics_ragdoll_stats_t before, after;
+        entity_p *end = victims;
+        uint64_t peak = 0, total = 0;
+        int n, dead = 0;
+
+        if(!Engine_LoadMap(level))
+        {
+            Con_Warning("bench_ragdolls: can not load \"%s\"", level);
+            break;
+        }
+        World_IterateAllEntities(Bench_RagdollCollect, &end);
+        n = end - victims;
+        n = (n < count) ? (n) : (count);
+        if(!pass)
+        {
+            Ragdoll_ClearPool();
+        }
+        for(int i = 0; i < n; ++i)
+        {
+            if(!victims[i]->character->ragdoll)
+            {
+                victims[i]->character->ragdoll = Ragdoll_AutoCreateSetup(victims[i]->bf->animations.model, 0, 0);
+            }
+            if(pass)
+            {
+                Ragdoll_Reserve(victims[i]->bf, victims[i]->character->ragdoll);
+            }
+        }
+        Physics_GetRagdollStats(&before);
+
+        for(int f = 0; f < 60; ++f)
+        {
+            uint64_t t0 = SDL_GetPerformanceCounter();
+            for(; (dead < n) && (dead * 60 <= f * n); ++dead)
+            {
+                entity_p ent = victims[dead];
+                if(ent->character->ragdoll && Ragdoll_Create(ent->physics, ent->bf, ent->character->ragdoll))
+                {
+                    ent->type_flags |= ENTITY_TYPE_DYNAMIC;
+                    ent->character->state.ragdoll = 0x01;
+                }
+            }
+            Physics_StepSimulation(1.0f / 60.0f);
+            for(int i = 0; i < dead; ++i)
+            {
+                Entity_UpdateRigidBody(victims[i], 1);
+            }
+            t0 = SDL_GetPerformanceCounter() - t0;
+            peak = (t0 > peak) ? (t0) : (peak);
+            total += t0;
+        }
+
+        Physics_GetRagdollStats(&after);
+        Con_Printf("%s: %d deaths in one second, peak frame %.3f ms, avg %.3f ms", (pass) ? ("reserved pool") : ("built at death"),
+                   n, ms * peak, ms * total / 60.0);
+        Con_Printf("  %d ragdolls built during the second, %d armed, %d frozen, %d active", after.built - before.built,
+                   after.armed - before.armed, after.frozen - before.frozen, after.active);
+    }
+    free(victims);
+}
+
+
+/*
+ * The open inventory ring, every item drawn as a model, then the unselected
+ * ones as impostors. Run with LIBGL_ALWAYS_SOFTWARE=1 to time it on llvmpipe.
+ */
+void Bench_Inventory(int frames)
+{
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    entity_p player = World_GetPlayer();
+    float saved_frame_time = engine_frame_time;
+
+    if(!player && Engine_LoadMap("tests/heavy1/LEVEL1.PHD"))
+    {
+        player = World_GetPlayer();
+    }
+    if(!player || !player->inventory || !main_inventory_manager)
+    {
+        Con_Warning("bench_inventory: no player inventory");
+        return;
+    }
+
+    Con_Printf("bench_inventory: %s", (const char*)qglGetString(GL_RENDERER));
+    engine_frame_time = 1.0f / 60.0f;
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        gui_item_impostor_stats_t stats;
+        uint64_t total = 0, worst = 0;
+        double f = frames;
+
+        Gui_SetItemImpostors(pass);
+        main_inventory_manager->setInventory(&player->inventory, player->id);
+        main_inventory_manager->send(GUI_COMMAND_OPEN);
+        for(int i = 0; (i < 600) && !main_inventory_manager->isIdle(); ++i)
+        {
+            Gui_Render();
+        }
+        main_inventory_manager->send(GUI_COMMAND_NONE);
+        Gui_Render();                                                           // the first pictures are taken here
+        qglFinish();
+
+        Gui_ResetItemImpostorStats();
+        for(int i = 0; i < frames; ++i)
+        {
+            uint64_t t0 = SDL_GetPerformanceCounter();
+            Gui_Render();
+            qglFinish();
+            t0 = SDL_GetPerformanceCounter() - t0;
+            worst = (t0 > worst) ? (t0) : (worst);
+            total += t0;
+        }
+        Gui_GetItemImpostorStats(&stats);
+        Con_Printf("%s: gui frame avg %.3f ms, worst %.3f ms, %.1f draw calls, %.1f models, %.1f quads, %d pictures taken",
+                   (pass) ? ("impostors") : ("models"), ms * total / f, ms * worst, stats.draw_calls / f,
+                   stats.live_items / f, stats.impostor_items / f, stats.bakes);
+        main_inventory_manager->setInventory(&player->inventory, player->id);   // closed at once
+    }
+    Gui_SetItemImpostors(1);
+    engine_frame_time = saved_frame_time;
+}
+
+
+void Bench_Shaders()
+{
+    static const char *pass_names[3] = {"no cache", "cold cache", "warm cache"};
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    uint64_t t0;
+
+    Con_Printf("bench_shaders: %s, program binaries %s", (const char*)qglGetString(GL_RENDERER),
+               (qglGetProgramBinary) ? ("supported") : ("not supported"));
+
+    // what startup costs now: no program is made before something draws with it
+    renderer.DeleteShaders();
+    t0 = SDL_GetPerformanceCounter();
+    renderer.DoShaders();
+    Con_Printf("lazy startup: %.3f ms", ms * (SDL_GetPerformanceCounter() - t0));
+
+    // and what making every variant costs, as the old startup did
+    for(int pass = 0; pass < 3; ++pass)
+    {
+        shader_cache_stats_t stats;
+        int programs;
+
+        ShaderCache_SetMode(pass == 2, pass > 0);
+        ShaderCache_ResetStats();
+        renderer.DeleteShaders();
+        t0 = SDL_GetPerformanceCounter();
+        renderer.DoShaders();
+        programs = renderer.shaderManager->compileAll();
+        qglFinish();
+        t0 = SDL_GetPerformanceCounter() - t0;
+        ShaderCache_GetStats(&stats);
+        Con_Printf("%s: %d programs in %.3f ms, %d linked, %d loaded, %d rejected, %d saved", pass_names[pass],
+                   programs, ms * t0, stats.programs_linked, stats.programs_loaded, stats.binaries_rejected, stats.binaries_saved);
+    }
+    ShaderCache_SetMode(1, 1);
+}
+
+
+static uint64_t Bench_OcclusionFrame()
+{
+    uint64_t t0 = SDL_GetPerformanceCounter();
+
+    qglClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    Cam_Apply(&engine_camera);
+    Cam_RecalcClipPlanes(&engine_camera);
+    qglPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    qglEnableClientState(GL_NORMAL_ARRAY);
+    qglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    qglFrontFace(GL_CW);
+    renderer.GenWorldList(&engine_camera);
+    renderer.DrawList();
+    qglPopClientAttrib();
+    qglFinish();
+
+    return SDL_GetPerformanceCounter() - t0;
+}
+
+
+static float Bench_OcclusionLinearDepth(float z)
+{
+    float n = engine_camera.dist_near, f = engine_camera.dist_far;
+    return 2.0f * n * f / (f + n - (2.0f * z - 1.0f) * (f - n));
+}
+
+/*
+ * Points spread over the portal windows of a hidden room: the ones the frame
+ * drawn without culling shows nearer than its depth buffer were wrongly hidden.
+ */
+static uint32_t Bench_OcclusionCheckRoom(room_p room, const float *depth, int w, int h)
+{
+    uint32_t wrong = 0;
+
+    for(frustum_p f = room->frustum; f; f = f->next)
+    {
+        for(uint16_t i = 2; i < f->vertex_count; ++i)
+        {
+            for(int s = 0; s < 64; ++s)
+            {
+                float a = Bench_Rand(0.0f, 1.0f), b = Bench_Rand(0.0f, 1.0f), p[4], c[4];
+                if(a + b > 1.0f)
+                {
+                    a = 1.0f - a;
+                    b = 1.0f - b;
+                }
+                for(int k = 0; k < 3; ++k)
+                {
+                    p[k] = f->vertex[k] + a * (f->vertex[3 * (i - 1) + k] - f->vertex[k]) + b * (f->vertex[3 * i + k] - f->vertex[k]);
+                }
+                p[3] = 1.0f;
+                Mat4_vec4_mul_macro(c, engine_camera.gl_view_proj_mat, p);
+                if(c[3] > engine_camera.dist_near)
+                {
+                    int x = (c[0] / c[3] * 0.5f + 0.5f) * w;
+                    int y = (c[1] / c[3] * 0.5f + 0.5f) * h;
+                    if((x >= 0) && (x < w) && (y >= 0) && (y < h) &&
+                       (c[3] < 0.99f * Bench_OcclusionLinearDepth(depth[y * w + x])))
+                    {
+                        wrong++;
+                    }
+                }
+            }
+        }
+    }
+
+    return wrong;
+}
+
+/*
+ * Frames from the middle of the level rooms, looking four ways, drawn with
+ * occlusion culling off and on. Run with LIBGL_ALWAYS_SOFTWARE=1 to time it
+ * on llvmpipe.
+ */
+void Bench_Occlusion(const char *level, int views)
+{
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    int8_t saved_setting = renderer.settings.occlusion_culling;
+    int w = screen_info.w, h = screen_info.h;
+    float *depth;
+    uint8_t *listed;
+    room_p rooms;
+    uint32_t rooms_count;
+    struct
+    {
+        uint64_t                    ticks;
+        uint64_t                    worst;
+        struct render_frame_stats_s sum;
+    }passes[2];
+    uint32_t hidden = 0, checked = 0, wrong = 0, frames = 0;
+    occlusion_stats_t stats;
+
+    Con_Printf("bench_occlusion: %s", (const char*)qglGetString(GL_RENDERER));
+    if(!Engine_LoadMap(level))
+    {
+        Con_Warning("bench_occlusion: can not load \"%s\"", level);
+        return;
+    }
+    World_GetRoomInfo(&rooms, &rooms_count);
+    if(!rooms_count)
+    {
+        return;
+    }
+
+    srand(views);
+    memset(passes, 0, sizeof(passes));
+    memset(&renderer.occlusionBuffer->stats, 0, sizeof(renderer.occlusionBuffer->stats));
+    depth = (float*)malloc(w * h * sizeof(float));
+    listed = (uint8_t*)malloc(rooms_count);
+    for(int v = 0; v < views; ++v)
+    {
+        room_p room = rooms + (uint32_t)((uint64_t)(v / 4) * 4 * rooms_count / views);
+        float ang[3] = {(float)(v % 4) * 0.5f * (float)M_PI, 0.0f, 0.0f};
+
+        if(room->real_room != room)
+        {
+            continue;
+        }
+        engine_camera.transform.M4x4[12 + 0] = 0.5f * (room->bb_min[0] + room->bb_max[0]);
+        engine_camera.transform.M4x4[12 + 1] = 0.5f * (room->bb_min[1] + room->bb_max[1]);
+        engine_camera.transform.M4x4[12 + 2] = 0.5f * (room->bb_min[2] + room->bb_max[2]);
+        engine_camera.current_room = NULL;
+        Cam_SetRotation(&engine_camera, ang);
+
+        for(int pass = 0; pass < 2; ++pass)
+        {
+            uint64_t t;
+            renderer.settings.occlusion_culling = pass;
+            t = Bench_OcclusionFrame();
+            passes[pass].ticks += t;
+            passes[pass].worst = (t > passes[pass].worst) ? (t) : (passes[pass].worst);
+            passes[pass].sum.rooms += renderer.frame_stats.rooms;
+            passes[pass].sum.statics += renderer.frame_stats.statics;
+            passes[pass].sum.entities += renderer.frame_stats.entities;
+            passes[pass].sum.draw_calls += renderer.frame_stats.draw_calls;
+            if(!pass)
+            {
+                for(uint32_t i = 0; i < rooms_count; ++i)
+                {
+                    listed[i] = rooms[i].is_in_r_list;
+                }
+                qglReadPixels(0, 0, w, h, GL_DEPTH_COMPONENT, GL_FLOAT, depth);
+            }
+        }
+
+        for(uint32_t i = 0; i < rooms_count; ++i)
+        {
+            if(listed[i] && !rooms[i].is_in_r_list)
+            {
+                uint32_t n = Bench_OcclusionCheckRoom(rooms + i, depth, w, h);
+                hidden++;
+                checked += (n) ? (1) : (0);
+                wrong += n;
+            }
+        }
+        frames++;
+    }
+
+    stats = renderer.occlusionBuffer->stats;
+    for(int pass = 0; (pass < 2) && frames; ++pass)
+    {
+        double f = frames;
+        Con_Printf("%s: %d frames, %.1f rooms, %.1f statics, %.1f entities, %.1f draw calls, frame avg %.3f ms, worst %.3f ms",
+                   (pass) ? ("occlusion on") : ("occlusion off"), frames, passes[pass].sum.rooms / f, passes[pass].sum.statics / f,
+                   passes[pass].sum.entities / f, passes[pass].sum.draw_calls / f, ms * passes[pass].ticks / f, ms * passes[pass].worst);
+    }
+    if(stats.frames)
+    {
+        Con_Printf("buffer: %.3f ms and %.1f triangles per frame, %d redrawn; rooms %d of %d hidden, objects %d of %d hidden",
+                   ms * stats.ticks / stats.frames, (double)stats.triangles / stats.frames, stats.rebuilds,
+                   stats.rooms_culled, stats.rooms_tested, stats.objects_culled, stats.objects_tested);
+    }
+    Con_Printf("check: %d hidden rooms, %d with window points GL drew in front (%d points)", hidden, checked, wrong);
+
+    renderer.settings.occlusion_culling = saved_setting;
+    free(listed);
+    free(depth);
+}
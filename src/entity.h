@@ -135,6 +135,22 @@ typedef struct activation_point_s
 }activation_point_t, *activation_point_p;
 
 
+/*
+ * Lights the renderer chose for the entity, as indices in its room light list.
+ * They stay until the entity changes room or sector, or moves far enough.
+ */
+#define ENTITY_MAX_LIGHTS                   (8)
+
+typedef struct entity_lights_s
+{
+    struct room_s                      *room;
+    struct room_sector_s               *sector;
+    float                               pos[3];
+    uint32_t                            generation;         // room light lists this choice was made from
+    uint16_t                            count;
+    uint16_t                            index[ENTITY_MAX_LIGHTS];
+}entity_lights_t, *entity_lights_p;
+
 typedef struct entity_s
 {
     uint32_t                            id;                     // Unique entity ID
@@ -167,6 +183,7 @@ typedef struct entity_s
     struct activation_point_s          *activation_point;
     struct inventory_node_s            *inventory;
     struct character_s                 *character;
+    struct entity_lights_s              lights;
 }entity_t, *entity_p;
 
 
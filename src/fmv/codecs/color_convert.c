@@ -0,0 +1,230 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <SDL2/SDL_cpuinfo.h>
+
+#include "color_convert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define COLOR_HAVE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define COLOR_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+static int color_kernel = COLOR_KERNEL_AUTO;
+
+
+int color_convert_set_kernel(int kernel)
+{
+    int best = COLOR_KERNEL_SCALAR;
+#if COLOR_HAVE_SSE2
+    if(SDL_HasSSE2())
+    {
+        best = COLOR_KERNEL_SIMD;
+    }
+#elif COLOR_HAVE_NEON
+    if(SDL_HasNEON())
+    {
+        best = COLOR_KERNEL_SIMD;
+    }
+#endif
+    color_kernel = ((kernel < 0) || (kernel > best)) ? (best) : (kernel);
+    return color_kernel;
+}
+
+
+int color_convert_get_kernel(void)
+{
+    return (color_kernel < 0) ? (color_convert_set_kernel(COLOR_KERNEL_AUTO)) : (color_kernel);
+}
+
+
+const char *color_convert_kernel_name(int kernel)
+{
+    if(kernel == COLOR_KERNEL_SIMD)
+    {
+#if COLOR_HAVE_SSE2
+        return "sse2";
+#elif COLOR_HAVE_NEON
+        return "neon";
+#endif
+    }
+    return "scalar";
+}
+
+/*
+ * RGB555: r = (c & 0x7C00) >> 7, g = (c & 0x03E0) >> 2, b = (c & 0x001F) << 3
+ */
+#if COLOR_HAVE_SSE2
+static inline __m128i color_rgb555_vec(__m128i c)
+{
+    __m128i r = _mm_and_si128(_mm_srli_epi32(c, 7), _mm_set1_epi32(0x000000f8));
+    __m128i g = _mm_and_si128(_mm_slli_epi32(c, 6), _mm_set1_epi32(0x0000f800));
+    __m128i b = _mm_and_si128(_mm_slli_epi32(c, 19), _mm_set1_epi32(0x00f80000));
+    return _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, _mm_set1_epi32(0xff000000)));
+}
+
+static size_t color_rgb555_to_rgba_simd(const uint16_t *src, uint8_t *rgba, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(rgba + 4 * i), color_rgb555_vec(_mm_unpacklo_epi16(c, zero)));
+        _mm_storeu_si128((__m128i*)(rgba + 4 * i + 16), color_rgb555_vec(_mm_unpackhi_epi16(c, zero)));
+    }
+    return i;
+}
+#elif COLOR_HAVE_NEON
+static size_t color_rgb555_to_rgba_simd(const uint16_t *src, uint8_t *rgba, size_t count)
+{
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        uint16x8_t c = vld1q_u16(src + i);
+        uint8x8x4_t px;
+        px.val[0] = vshrn_n_u16(vandq_u16(c, vdupq_n_u16(0x7C00)), 7);
+        px.val[1] = vmovn_u16(vshrq_n_u16(vandq_u16(c, vdupq_n_u16(0x03E0)), 2));
+        px.val[2] = vmovn_u16(vshlq_n_u16(c, 3));
+        px.val[3] = vdup_n_u8(0xFF);
+        vst4_u8(rgba + 4 * i, px);
+    }
+    return i;
+}
+#endif
+
+void color_convert_rgb555_to_rgba(const uint16_t *src, uint8_t *rgba, size_t count)
+{
+    size_t i = 0;
+#if COLOR_HAVE_SSE2 || COLOR_HAVE_NEON
+    if(color_convert_get_kernel() == COLOR_KERNEL_SIMD)
+    {
+        i = color_rgb555_to_rgba_simd(src, rgba, count);
+    }
+#endif
+
+    for(rgba += 4 * i; i < count; ++i)
+    {
+        *rgba++ = (src[i] & 0x7C00) >> (10 - 3);
+        *rgba++ = (src[i] & 0x03E0) >> (5 - 3);
+        *rgba++ = (src[i] & 0x001F) << 3;
+        *rgba++ = 0xFF;
+    }
+}
+
+/*
+ * YUV: r = y + r_v, g = y - g_u - g_v, b = y + b_u; truncated and clamped to [0, 255].
+ */
+void color_convert_yuv_table_init(struct color_yuv_table_s *t, const uint8_t chroma_vals[32], int y_shift)
+{
+    for(int i = 0; i < 32; ++i)
+    {
+        float c = chroma_vals[i];
+        t->r_v[i] = 1.13983f * (c - 128);
+        t->g_u[i] = 0.39465f * (c - 128);
+        t->g_v[i] = 0.58060f * (c - 128);
+        t->b_u[i] = 2.03211f * (c - 128);
+    }
+    t->y_shift = y_shift;
+}
+
+#if COLOR_HAVE_SSE2
+static size_t color_yuv_to_rgba_simd(const struct color_yuv_table_s *t, const uint8_t *y, const uint8_t *cb, const uint8_t *cr, uint8_t *rgba, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi16(0xFF);
+    const __m128i shift = _mm_cvtsi32_si128(t->y_shift);
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8, cb += 4, cr += 4)
+    {
+        __m128i y16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(y + i)), zero);
+        __m128 y0 = _mm_cvtepi32_ps(_mm_sll_epi32(_mm_unpacklo_epi16(y16, zero), shift));
+        __m128 y1 = _mm_cvtepi32_ps(_mm_sll_epi32(_mm_unpackhi_epi16(y16, zero), shift));
+        // 4 chroma samples cover 8 pixels
+        __m128 rv = _mm_setr_ps(t->r_v[cr[0] & 31], t->r_v[cr[1] & 31], t->r_v[cr[2] & 31], t->r_v[cr[3] & 31]);
+        __m128 gu = _mm_setr_ps(t->g_u[cb[0] & 31], t->g_u[cb[1] & 31], t->g_u[cb[2] & 31], t->g_u[cb[3] & 31]);
+        __m128 gv = _mm_setr_ps(t->g_v[cr[0] & 31], t->g_v[cr[1] & 31], t->g_v[cr[2] & 31], t->g_v[cr[3] & 31]);
+        __m128 bu = _mm_setr_ps(t->b_u[cb[0] & 31], t->b_u[cb[1] & 31], t->b_u[cb[2] & 31], t->b_u[cb[3] & 31]);
+        __m128i r, g, b, rb, ga, rg, ba;
+
+        r = _mm_packs_epi32(_mm_cvttps_epi32(_mm_add_ps(y0, _mm_unpacklo_ps(rv, rv))),
+                            _mm_cvttps_epi32(_mm_add_ps(y1, _mm_unpackhi_ps(rv, rv))));
+        g = _mm_packs_epi32(_mm_cvttps_epi32(_mm_sub_ps(_mm_sub_ps(y0, _mm_unpacklo_ps(gu, gu)), _mm_unpacklo_ps(gv, gv))),
+                            _mm_cvttps_epi32(_mm_sub_ps(_mm_sub_ps(y1, _mm_unpackhi_ps(gu, gu)), _mm_unpackhi_ps(gv, gv))));
+        b = _mm_packs_epi32(_mm_cvttps_epi32(_mm_add_ps(y0, _mm_unpacklo_ps(bu, bu))),
+                            _mm_cvttps_epi32(_mm_add_ps(y1, _mm_unpackhi_ps(bu, bu))));
+
+        // saturating packs do the clamping; then interleave to r g b a bytes
+        rb = _mm_packus_epi16(r, b);
+        ga = _mm_packus_epi16(g, alpha);
+        rg = _mm_unpacklo_epi8(rb, ga);
+        ba = _mm_unpackhi_epi8(rb, ga);
+        _mm_storeu_si128((__m128i*)(rgba + 4 * i), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i*)(rgba + 4 * i + 16), _mm_unpackhi_epi16(rg, ba));
+    }
+    return i;
+}
+#elif COLOR_HAVE_NEON
+static size_t color_yuv_to_rgba_simd(const struct color_yuv_table_s *t, const uint8_t *y, const uint8_t *cb, const uint8_t *cr, uint8_t *rgba, size_t count)
+{
+    const int16x8_t shift = vdupq_n_s16(t->y_shift);
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8, cb += 4, cr += 4)
+    {
+        uint16x8_t y16 = vshlq_u16(vmovl_u8(vld1_u8(y + i)), shift);
+        float32x4_t y0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(y16)));
+        float32x4_t y1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(y16)));
+        float rv_s[4] = {t->r_v[cr[0] & 31], t->r_v[cr[1] & 31], t->r_v[cr[2] & 31], t->r_v[cr[3] & 31]};
+        float gu_s[4] = {t->g_u[cb[0] & 31], t->g_u[cb[1] & 31], t->g_u[cb[2] & 31], t->g_u[cb[3] & 31]};
+        float gv_s[4] = {t->g_v[cr[0] & 31], t->g_v[cr[1] & 31], t->g_v[cr[2] & 31], t->g_v[cr[3] & 31]};
+        float bu_s[4] = {t->b_u[cb[0] & 31], t->b_u[cb[1] & 31], t->b_u[cb[2] & 31], t->b_u[cb[3] & 31]};
+        // 4 chroma samples cover 8 pixels
+        float32x4x2_t rv = vzipq_f32(vld1q_f32(rv_s), vld1q_f32(rv_s));
+        float32x4x2_t gu = vzipq_f32(vld1q_f32(gu_s), vld1q_f32(gu_s));
+        float32x4x2_t gv = vzipq_f32(vld1q_f32(gv_s), vld1q_f32(gv_s));
+        float32x4x2_t bu = vzipq_f32(vld1q_f32(bu_s), vld1q_f32(bu_s));
+        uint8x8x4_t px;
+
+        // separate multiply-free adds, so nothing can be fused and rounded differently
+        px.val[0] = vqmovn_u16(vcombine_u16(vqmovun_s32(vcvtq_s32_f32(vaddq_f32(y0, rv.val[0]))),
+                                            vqmovun_s32(vcvtq_s32_f32(vaddq_f32(y1, rv.val[1])))));
+        px.val[1] = vqmovn_u16(vcombine_u16(vqmovun_s32(vcvtq_s32_f32(vsubq_f32(vsubq_f32(y0, gu.val[0]), gv.val[0]))),
+                                            vqmovun_s32(vcvtq_s32_f32(vsubq_f32(vsubq_f32(y1, gu.val[1]), gv.val[1])))));
+        px.val[2] = vqmovn_u16(vcombine_u16(vqmovun_s32(vcvtq_s32_f32(vaddq_f32(y0, bu.val[0]))),
+                                            vqmovun_s32(vcvtq_s32_f32(vaddq_f32(y1, bu.val[1])))));
+        px.val[3] = vdup_n_u8(0xFF);
+        vst4_u8(rgba + 4 * i, px);
+    }
+    return i;
+}
+#endif
+
+void color_convert_yuv_to_rgba(const struct color_yuv_table_s *t, const uint8_t *y, const uint8_t *cb, const uint8_t *cr, uint8_t *rgba, size_t count)
+{
+    size_t i = 0;
+#if COLOR_HAVE_SSE2 || COLOR_HAVE_NEON
+    if(color_convert_get_kernel() == COLOR_KERNEL_SIMD)
+    {
+        i = color_yuv_to_rgba_simd(t, y, cb, cr, rgba, count);
+    }
+#endif
+
+    for(rgba += 4 * i; i < count; ++i)
+    {
+        uint8_t u = cb[i / 2] & 31;
+        uint8_t v = cr[i / 2] & 31;
+        float yf = (float)(y[i] << t->y_shift);
+        int r = yf + t->r_v[v];
+        int g = yf - t->g_u[u] - t->g_v[v];
+        int b = yf + t->b_u[u];
+        r = (r < 0) ? (0) : (r);
+        g = (g < 0) ? (0) : (g);
+        b = (b < 0) ? (0) : (b);
+        *rgba++ = (r <= 0xFF) ? (r) : 0xFF;
+        *rgba++ = (g <= 0xFF) ? (g) : 0xFF;
+        *rgba++ = (b <= 0xFF) ? (b) : 0xFF;
+        *rgba++ = 0xFF;
+    }
+}
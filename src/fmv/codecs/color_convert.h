@@ -0,0 +1,51 @@
+/*
+ * File:   color_convert.h
+ *
+ * Output colour conversion for the escape decoders: scalar kernels plus
+ * SSE2 (x86) and NEON (ARM) versions, the best one supported by the CPU
+ * is selected on the first call. All kernels give the same bytes.
+ */
+
+#ifndef COLOR_CONVERT_H
+#define COLOR_CONVERT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COLOR_KERNEL_AUTO       (-1)
+#define COLOR_KERNEL_SCALAR     (0)
+#define COLOR_KERNEL_SIMD       (1)     // SSE2 or NEON, whichever the build has
+
+/*
+ * Chroma contributions are kept per 5 bit chroma index, so every kernel does
+ * the same float operations in the same order as the original per pixel code.
+ */
+typedef struct color_yuv_table_s
+{
+    float       r_v[32];
+    float       g_u[32];
+    float       g_v[32];
+    float       b_u[32];
+    int         y_shift;
+} color_yuv_table_t, *color_yuv_table_p;
+
+int  color_convert_set_kernel(int kernel);     // returns the kernel really used, for benchmarking
+int  color_convert_get_kernel(void);
+const char *color_convert_kernel_name(int kernel);
+
+// X1R5G5B5 -> RGBA, alpha is always 0xFF
+void color_convert_rgb555_to_rgba(const uint16_t *src, uint8_t *rgba, size_t count);
+
+void color_convert_yuv_table_init(struct color_yuv_table_s *t, const uint8_t chroma_vals[32], int y_shift);
+// one row, cb / cr have one sample per 2 pixels and are masked to 5 bits
+void color_convert_yuv_to_rgba(const struct color_yuv_table_s *t, const uint8_t *y, const uint8_t *cb, const uint8_t *cr, uint8_t *rgba, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COLOR_CONVERT_H */
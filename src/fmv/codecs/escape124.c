@@ -24,6 +24,7 @@
 #include <SDL2/SDL.h>
 
 #include "../tiny_codec.h"
+#include "color_convert.h"
 #define BITSTREAM_READER_LE
 #include "../internal/get_bits.h"
 
@@ -374,16 +375,9 @@ static int escape124_decode_frame(struct tiny_codec_s *avctx, struct AVPacket *a
     if(avctx->video.rgba)
     {
         uint8_t *rgba = avctx->video.rgba;
-        for(i = 0; i < avctx->video.height; ++i)
+        for(i = 0; i < avctx->video.height; ++i, rgba += 4 * avctx->video.width)
         {
-            uint16_t *px = (uint16_t*)s->buff1 + i * new_stride;
-            for(int j = 0; j < avctx->video.width; ++j, ++px)
-            {
-                *rgba++ = ((*px) & 0x7C00) >> (10 - 3);
-                *rgba++ = ((*px) & 0x03E0) >> (5 - 3);
-                *rgba++ = ((*px) & 0x001F) << 3 ;
-                *rgba++ = 0xFF;
-            }
+            color_convert_rgb555_to_rgba((uint16_t*)s->buff1 + i * new_stride, rgba, avctx->video.width);
         }
     }
     FFSWAP(uint8_t*, s->buff1, s->buff2);
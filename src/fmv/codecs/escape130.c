@@ -24,6 +24,7 @@
 #include <SDL2/SDL.h>
 
 #include "../tiny_codec.h"
+#include "color_convert.h"
 #define BITSTREAM_READER_LE
 #include "../internal/get_bits.h"
 
@@ -37,6 +38,7 @@ typedef struct Escape130Context
 
     uint8_t *buf1, *buf2;
     int     linesize[3];
+    color_yuv_table_t yuv;
 } Escape130Context;
 
 static const uint8_t offset_table[] = { 2, 4, 10, 20 };
@@ -281,31 +283,12 @@ static int escape130_decode_frame(struct tiny_codec_s *avctx, struct AVPacket *a
     if(avctx->video.rgba)
     {
         uint8_t *rgba = avctx->video.rgba;
-        float y, u, v;
-        int r, g, b;
         new_cb = s->new_u;
         new_cr = s->new_v;
 
-        for(i = 0; i < avctx->video.height; ++i)
+        for(i = 0; i < avctx->video.height; ++i, rgba += 4 * avctx->video.width)
         {
-            for(int j = 0; j < avctx->video.width; ++j)
-            {
-                uint8_t cb = new_cb[j / 2] & 31;
-                uint8_t cr = new_cr[j / 2] & 31;
-                y = (s->new_y[new_y_stride * i + j] << 2);
-                u = chroma_vals[cb];
-                v = chroma_vals[cr];
-                r = y + 1.13983f * (v - 128);
-                g = y - 0.39465f * (u - 128) - 0.58060f * (v - 128);
-                b = y + 2.03211f * (u - 128);
-                r = (r < 0) ? (0) : (r);
-                g = (g < 0) ? (0) : (g);
-                b = (b < 0) ? (0) : (b);
-                *rgba++ = (r <= 0xFF) ? (r) : 0xFF;
-                *rgba++ = (g <= 0xFF) ? (g) : 0xFF;
-                *rgba++ = (b <= 0xFF) ? (b) : 0xFF;
-                *rgba++ = 0xFF;
-            }
+            color_convert_yuv_to_rgba(&s->yuv, s->new_y + new_y_stride * i, new_cb, new_cr, rgba, avctx->video.width);
             if(i & 1)
             {
                 new_cb += new_cb_stride;
@@ -352,6 +335,7 @@ void escape130_decode_init(struct tiny_codec_s *avctx)
         s->linesize[0] = avctx->video.width;
         s->linesize[1] = avctx->video.width / 2;
         s->linesize[2] = avctx->video.width / 2;
+        color_convert_yuv_table_init(&s->yuv, chroma_vals, 2);
 
         s->new_y = s->buf1;
         s->new_u = s->new_y + avctx->video.width * avctx->video.height;
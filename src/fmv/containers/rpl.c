@@ -32,6 +32,9 @@
 /** 256 is arbitrary, but should be big enough for any reasonable file. */
 #define RPL_LINE_LENGTH 256
 
+/** Bit readers may look a little past the end of a packet. */
+#define RPL_BUFFER_PADDING  64
+
 typedef struct RPLContext
 {
     // RPL header data
@@ -40,8 +43,18 @@ typedef struct RPLContext
     // Stream position data
     uint32_t chunk_part;
     uint32_t frame_in_part;
+
+    // Read-ahead window over [buffer_pos, buffer_pos + buffer_len) of the file
+    uint8_t *buffer;
+    uint32_t buffer_size;
+    uint32_t buffer_len;
+    int64_t  buffer_pos;
+    int64_t  file_pos;          ///< where the next read starts, -1 if unknown
+    int64_t  file_size;
 } RPLContext;
 
+static uint32_t rpl_read_ahead_size = RPL_READ_AHEAD_SIZE;
+
 static int read_line(SDL_RWops *pb, char* line, int bufsize)
 {
     int i;
@@ -111,6 +124,114 @@ static int read_fps(const char* line, uint64_t *num, uint64_t *denum)
 }
 
 
+static void rpl_free_context(void *context)
+{
+    RPLContext *rpl = (RPLContext*)context;
+    if(rpl)
+    {
+        free(rpl->buffer);
+        free(rpl);
+    }
+}
+
+/**
+ * Returns the size bytes at pos from the read-ahead window, valid until the next call.
+ * The window only moves forward: the part still needed by the stream that lags
+ * behind is kept and the rest is read sequentially after it, so no seek is done
+ * while both streams are played in order.
+ */
+static const uint8_t *rpl_buffer_range(struct tiny_codec_s *s, int64_t pos, uint32_t size)
+{
+    SDL_RWops *pb = s->input;
+    RPLContext *rpl = (RPLContext*)s->private_context;
+    int64_t low = pos;
+    int64_t lag;
+
+    if((pos >= rpl->buffer_pos) && (pos + size <= rpl->buffer_pos + rpl->buffer_len))
+    {
+        return rpl->buffer + (pos - rpl->buffer_pos);
+    }
+
+    if((pos < 0) || ((rpl->file_size >= 0) && (pos + size > rpl->file_size)))
+    {
+        return NULL;
+    }
+
+    if(s->video.entry_current < s->video.entry_size)
+    {
+        lag = (rpl->frame_in_part == 0) ? (s->video.entry[s->video.entry_current].pos) : (s->video.pkt.pos);
+        low = ((lag < low) && (pos + size - lag <= rpl->buffer_size)) ? (lag) : (low);
+    }
+    if(s->audio.entry_current < s->audio.entry_size)
+    {
+        lag = s->audio.entry[s->audio.entry_current].pos;
+        low = ((lag < low) && (pos + size - lag <= rpl->buffer_size)) ? (lag) : (low);
+    }
+
+    if(pos + size - low > rpl->buffer_size)
+    {
+        uint8_t *new_buffer = (uint8_t*)realloc(rpl->buffer, pos + size - low + RPL_BUFFER_PADDING);
+        if(!new_buffer)
+        {
+            // the old window is still valid, only this packet is lost
+            return NULL;
+        }
+        rpl->buffer = new_buffer;
+        rpl->buffer_size = pos + size - low;
+    }
+
+    if((low >= rpl->buffer_pos) && (low <= rpl->buffer_pos + rpl->buffer_len))
+    {
+        uint32_t keep = rpl->buffer_pos + rpl->buffer_len - low;
+        memmove(rpl->buffer, rpl->buffer + (low - rpl->buffer_pos), keep);
+        rpl->buffer_len = keep;
+    }
+    else
+    {
+        rpl->buffer_len = 0;
+    }
+    rpl->buffer_pos = low;
+
+    if(rpl->file_pos != rpl->buffer_pos + rpl->buffer_len)
+    {
+        rpl->file_pos = SDL_RWseek(pb, rpl->buffer_pos + rpl->buffer_len, RW_SEEK_SET);
+        if(rpl->file_pos < 0)
+        {
+            return NULL;
+        }
+    }
+    rpl->buffer_len += SDL_RWread(pb, rpl->buffer + rpl->buffer_len, 1, rpl->buffer_size - rpl->buffer_len);
+    rpl->file_pos = rpl->buffer_pos + rpl->buffer_len;
+
+    return (pos + size <= rpl->buffer_pos + rpl->buffer_len) ? (rpl->buffer + (pos - rpl->buffer_pos)) : (NULL);
+}
+
+static int rpl_get_packet(struct tiny_codec_s *s, struct AVPacket *pkt, int64_t pos, uint32_t size)
+{
+    RPLContext *rpl = (RPLContext*)s->private_context;
+    const uint8_t *data;
+
+    if(!rpl->buffer)
+    {
+        if(SDL_RWseek(s->input, pos, RW_SEEK_SET) < 0)
+            return -1;
+        return av_get_packet(s->input, pkt, size);
+    }
+
+    data = rpl_buffer_range(s, pos, size);
+    if(!data)
+        return -1;
+
+    av_packet_unref(pkt);
+    pkt->data = (uint8_t*)data;
+    pkt->size = size;
+    pkt->pts = 0;
+    pkt->duration = 0;
+    pkt->flags = 0;
+    pkt->pos = pos + size;
+    return size;
+}
+
 static int rpl_read_packet(struct tiny_codec_s *s, struct AVPacket *pkt)
 {
     SDL_RWops *pb = s->input;
@@ -125,21 +246,28 @@ static int rpl_read_packet(struct tiny_codec_s *s, struct AVPacket *pkt)
 
         entry = &s->video.entry[s->video.entry_current];
 
-        pkt->pos = (rpl->frame_in_part == 0) ? (entry->pos) : pkt->pos;
-        if(SDL_RWseek(pb, pkt->pos, RW_SEEK_SET) < 0)
-            return -1;
-
         if(s->video.codec_tag == AV_CODEC_ID_ESCAPE124)
         {
             // We have to split Escape 124 frames because there are
             // multiple frames per chunk in Escape 124 samples.
             uint32_t frame_size;
-            SDL_ReadLE32(pb); // flags
-            frame_size = SDL_ReadLE32(pb);
-            if (SDL_RWseek(pb, -8, RW_SEEK_CUR) < 0)
-                return -1;
+            int64_t pos = (rpl->frame_in_part == 0) ? (entry->pos) : (pkt->pos);
+            if(rpl->buffer)
+            {
+                const uint8_t *header = rpl_buffer_range(s, pos, 8);
+                if(!header)
+                    return -1;
+                frame_size = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+            }
+            else
+            {
+                if(SDL_RWseek(pb, pos, RW_SEEK_SET) < 0)
+                    return -1;
+                SDL_ReadLE32(pb); // flags
+                frame_size = SDL_ReadLE32(pb);
+            }
 
-            ret = av_get_packet(pb, pkt, frame_size);
+            ret = rpl_get_packet(s, pkt, pos, frame_size);
             if (ret < 0)
                 return ret;
             if (ret != frame_size)
@@ -159,11 +287,7 @@ static int rpl_read_packet(struct tiny_codec_s *s, struct AVPacket *pkt)
         }
         else if(s->video.codec_tag == AV_CODEC_ID_ESCAPE130)
         {
-            pkt->pos = entry->pos;
-            if(SDL_RWseek(pb, pkt->pos, RW_SEEK_SET) < 0)
-                return -1;
-
-            ret = av_get_packet(pb, pkt, entry->size);
+            ret = rpl_get_packet(s, pkt, entry->pos, entry->size);
             if (ret < 0)
                 return ret;
             if (ret != entry->size)
@@ -187,11 +311,7 @@ static int rpl_read_packet(struct tiny_codec_s *s, struct AVPacket *pkt)
 
         entry = &s->audio.entry[s->audio.entry_current];
 
-        pkt->pos = entry->pos;
-        if(SDL_RWseek(pb, pkt->pos, RW_SEEK_SET) < 0)
-            return -1;
-
-        ret = av_get_packet(pb, pkt, entry->size);
+        ret = rpl_get_packet(s, pkt, entry->pos, entry->size);
         if (ret < 0)
             return ret;
         if (ret != entry->size)
@@ -224,7 +344,7 @@ int codec_open_rpl(struct tiny_codec_s *s)
 {
     SDL_RWops *pb = s->input;
     s->private_context = (RPLContext*)calloc(sizeof(RPLContext), 1);
-    s->free_context = free;
+    s->free_context = rpl_free_context;
     RPLContext *rpl = (RPLContext*)s->private_context;
     int total_audio_size;
     int codec_tag;
@@ -398,5 +518,24 @@ int codec_open_rpl(struct tiny_codec_s *s)
         total_audio_size += audio_size * 8;
     }
 
+    // the whole index is known now, packets are read in file order from here on;
+    // without the buffer every packet is read by a seek as before
+    if(!error && rpl_read_ahead_size)
+    {
+        rpl->buffer_size = rpl_read_ahead_size;
+        rpl->buffer = (uint8_t*)malloc(rpl->buffer_size + RPL_BUFFER_PADDING);
+        rpl->buffer_pos = 0;
+        rpl->buffer_len = 0;
+        rpl->file_pos = -1;
+        rpl->file_size = SDL_RWsize(pb);
+    }
+
     return error;
 }
+
+uint32_t codec_set_rpl_read_ahead(uint32_t size)
+{
+    uint32_t ret = rpl_read_ahead_size;
+    rpl_read_ahead_size = size;
+    return ret;
+}
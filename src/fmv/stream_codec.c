@@ -0,0 +1,271 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+
+#include "tiny_codec.h"
+#include "stream_codec.h"
+
+#define STREAM_CODEC_IDLE_WAIT_MS   (5)
+
+
+static void stream_codec_push_video(struct stream_codec_s *s)
+{
+    int head = SDL_AtomicGet(&s->video_head);
+    stream_codec_video_frame_p f = s->video + (head & (STREAM_CODEC_VIDEO_FRAMES - 1));
+    uint32_t size = 4 * (uint32_t)s->codec.video.width * (uint32_t)s->codec.video.height;
+
+    if(f->allocated_size < size)
+    {
+        free(f->rgba);
+        f->rgba = (uint8_t*)malloc(size);
+        f->allocated_size = size;
+    }
+    memcpy(f->rgba, s->codec.video.rgba, size);
+    f->width = s->codec.video.width;
+    f->height = s->codec.video.height;
+    f->pts = s->codec.video.pkt.pts;
+    SDL_AtomicSet(&s->video_head, head + 1);
+}
+
+
+static void stream_codec_push_audio(struct stream_codec_s *s)
+{
+    int head = SDL_AtomicGet(&s->audio_head);
+    stream_codec_audio_block_p b = s->audio + (head & (STREAM_CODEC_AUDIO_BLOCKS - 1));
+    uint32_t size = s->codec.audio.buff_size;
+
+    if(b->allocated_size < size)
+    {
+        free(b->data);
+        b->data = (uint8_t*)malloc(size);
+        b->allocated_size = size;
+    }
+    memcpy(b->data, s->codec.audio.buff, size);
+    b->size = size;
+    SDL_AtomicSet(&s->audio_head, head + 1);
+}
+
+
+static int stream_codec_thread(void *data)
+{
+    struct stream_codec_s *s = (struct stream_codec_s*)data;
+    struct tiny_codec_s *c = &s->codec;
+
+    while(!SDL_AtomicGet(&s->stop))
+    {
+        int busy = 0;
+        if(!SDL_AtomicGet(&s->video_end) &&
+           (SDL_AtomicGet(&s->video_head) - SDL_AtomicGet(&s->video_tail) < STREAM_CODEC_VIDEO_FRAMES))
+        {
+            busy = 1;
+            if(codec_decode_video(c) && c->video.rgba)
+            {
+                stream_codec_push_video(s);
+            }
+            else
+            {
+                SDL_AtomicSet(&s->video_end, 1);
+            }
+        }
+
+        if(!SDL_AtomicGet(&s->audio_end) &&
+           (SDL_AtomicGet(&s->audio_head) - SDL_AtomicGet(&s->audio_tail) < STREAM_CODEC_AUDIO_BLOCKS))
+        {
+            busy = 1;
+            if(c->packet(c, &c->audio.pkt) >= 0)
+            {
+                // broken blocks are skipped, as before
+                if(c->audio.decode(c, &c->audio.pkt) && c->audio.buff && c->audio.buff_size)
+                {
+                    stream_codec_push_audio(s);
+                }
+            }
+            else
+            {
+                SDL_AtomicSet(&s->audio_end, 1);
+            }
+        }
+
+        if(!busy)
+        {
+            SDL_SemWaitTimeout(s->wakeup, STREAM_CODEC_IDLE_WAIT_MS);
+        }
+    }
+
+    return 0;
+}
+
+
+void stream_codec_init(struct stream_codec_s *s)
+{
+    codec_init(&s->codec, NULL);
+    s->thread = NULL;
+    s->wakeup = NULL;
+    SDL_AtomicSet(&s->stop, 0);
+    SDL_AtomicSet(&s->video_end, 0);
+    SDL_AtomicSet(&s->audio_end, 0);
+    SDL_AtomicSet(&s->video_head, 0);
+    SDL_AtomicSet(&s->video_tail, 0);
+    SDL_AtomicSet(&s->audio_head, 0);
+    SDL_AtomicSet(&s->audio_tail, 0);
+    memset(s->video, 0, sizeof(s->video));
+    memset(s->audio, 0, sizeof(s->audio));
+    s->fps_num = 0;
+    s->fps_denum = 1;
+    s->audio_sample_rate = 0;
+    s->audio_bits_per_sample = 0;
+    s->audio_channels = 0;
+    s->time_ns = 0;
+    s->frame = 0;
+    s->video_hold = 0;
+    s->frames_shown = 0;
+    s->frames_dropped = 0;
+}
+
+
+int stream_codec_open_rpl(struct stream_codec_s *s, SDL_RWops *rw)
+{
+    stream_codec_stop(s);
+    codec_init(&s->codec, rw);
+    if(!s->codec.input)
+    {
+        return -1;
+    }
+
+    if(0 != codec_open_rpl(&s->codec))
+    {
+        codec_clear(&s->codec);
+        return -1;
+    }
+
+    if(!s->codec.audio.decode)
+    {
+        SDL_AtomicSet(&s->audio_end, 1);
+    }
+    // set on open and never changed, but read them here once: the worker owns the codec from now on
+    s->fps_num = s->codec.fps_num;
+    s->fps_denum = s->codec.fps_denum;
+    s->audio_sample_rate = (s->codec.audio.decode) ? (s->codec.audio.sample_rate) : (0);
+    s->audio_bits_per_sample = s->codec.audio.bits_per_sample;
+    s->audio_channels = s->codec.audio.channels;
+    s->wakeup = SDL_CreateSemaphore(0);
+    s->thread = SDL_CreateThread(stream_codec_thread, "fmv", s);
+    if(!s->thread)
+    {
+        stream_codec_stop(s);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void stream_codec_stop(struct stream_codec_s *s)
+{
+    if(s->thread)
+    {
+        SDL_AtomicSet(&s->stop, 1);
+        SDL_SemPost(s->wakeup);
+        SDL_WaitThread(s->thread, NULL);
+        s->thread = NULL;
+    }
+    if(s->wakeup)
+    {
+        SDL_DestroySemaphore(s->wakeup);
+        s->wakeup = NULL;
+    }
+    codec_clear(&s->codec);
+
+    for(int i = 0; i < STREAM_CODEC_VIDEO_FRAMES; ++i)
+    {
+        free(s->video[i].rgba);
+    }
+    for(int i = 0; i < STREAM_CODEC_AUDIO_BLOCKS; ++i)
+    {
+        free(s->audio[i].data);
+    }
+    stream_codec_init(s);
+}
+
+
+int stream_codec_is_open(struct stream_codec_s *s)
+{
+    return s->thread != NULL;
+}
+
+
+int stream_codec_is_finished(struct stream_codec_s *s)
+{
+    return SDL_AtomicGet(&s->video_end) && (SDL_AtomicGet(&s->video_head) == SDL_AtomicGet(&s->video_tail));
+}
+
+
+struct stream_codec_video_frame_s *stream_codec_get_video(struct stream_codec_s *s, uint64_t time_ns, int64_t audio_samples)
+{
+    stream_codec_video_frame_p ret = NULL;
+    int tail = SDL_AtomicGet(&s->video_tail);
+    int head = SDL_AtomicGet(&s->video_head);
+
+    if((audio_samples >= 0) && s->audio_sample_rate)
+    {
+        uint64_t audio_ns = (uint64_t)audio_samples * 1000000000 / s->audio_sample_rate;
+        s->time_ns = (audio_ns > s->time_ns) ? (audio_ns) : (s->time_ns);
+    }
+    else
+    {
+        s->time_ns += time_ns;
+    }
+    s->frame = (s->fps_denum) ? ((s->time_ns * s->fps_num) / (s->fps_denum * 1000000000)) : (0);
+
+    // the frame picked last time is uploaded already, so its slot is freed as soon
+    // as a newer frame exists or its time is over (that ends the video after the last one)
+    if(s->video_hold && ((head - tail >= 2) || (s->video[tail & (STREAM_CODEC_VIDEO_FRAMES - 1)].pts < s->frame)))
+    {
+        s->video_hold = 0;
+        SDL_AtomicSet(&s->video_tail, ++tail);
+        SDL_SemPost(s->wakeup);
+    }
+
+    // skip the frames that are late: a newer one is due already
+    while((head - tail >= 2) && (s->video[(tail + 1) & (STREAM_CODEC_VIDEO_FRAMES - 1)].pts <= s->frame))
+    {
+        s->frames_dropped++;
+        SDL_AtomicSet(&s->video_tail, ++tail);
+        SDL_SemPost(s->wakeup);
+    }
+
+    if((tail != head) && (s->video[tail & (STREAM_CODEC_VIDEO_FRAMES - 1)].pts <= s->frame))
+    {
+        ret = s->video + (tail & (STREAM_CODEC_VIDEO_FRAMES - 1));
+        s->video_hold = 1;
+        s->frames_shown++;
+    }
+
+    return ret;
+}
+
+
+struct stream_codec_audio_block_s *stream_codec_peek_audio(struct stream_codec_s *s)
+{
+    int tail = SDL_AtomicGet(&s->audio_tail);
+    if(tail != SDL_AtomicGet(&s->audio_head))
+    {
+        return s->audio + (tail & (STREAM_CODEC_AUDIO_BLOCKS - 1));
+    }
+    return NULL;
+}
+
+
+void stream_codec_pop_audio(struct stream_codec_s *s)
+{
+    int tail = SDL_AtomicGet(&s->audio_tail);
+    if(tail != SDL_AtomicGet(&s->audio_head))
+    {
+        SDL_AtomicSet(&s->audio_tail, tail + 1);
+        SDL_SemPost(s->wakeup);
+    }
+}
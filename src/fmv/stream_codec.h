@@ -0,0 +1,95 @@
+/*
+ * File:   stream_codec.h
+ *
+ * Decode-ahead wrapper around tiny_codec: one worker thread demuxes and
+ * decodes the stream into small single producer / single consumer rings of
+ * RGBA frames and PCM blocks, the main thread only picks the frame for the
+ * current playback time and feeds audio blocks.
+ */
+
+#ifndef STREAM_CODEC_H
+#define STREAM_CODEC_H
+
+#include <inttypes.h>
+#include <SDL2/SDL_atomic.h>
+#include "tiny_codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STREAM_CODEC_VIDEO_FRAMES   (8)         // must be power of 2
+#define STREAM_CODEC_AUDIO_BLOCKS   (8)         // must be power of 2
+
+typedef struct stream_codec_video_frame_s
+{
+    uint64_t            pts;                    // frame number
+    uint16_t            width;
+    uint16_t            height;
+    uint32_t            allocated_size;
+    uint8_t            *rgba;
+} stream_codec_video_frame_t, *stream_codec_video_frame_p;
+
+typedef struct stream_codec_audio_block_s
+{
+    uint32_t            size;
+    uint32_t            allocated_size;
+    uint8_t            *data;
+} stream_codec_audio_block_t, *stream_codec_audio_block_p;
+
+typedef struct stream_codec_s
+{
+    struct tiny_codec_s         codec;          // owned by the worker while it runs
+    struct SDL_Thread          *thread;
+    struct SDL_semaphore       *wakeup;
+    SDL_atomic_t                stop;
+    SDL_atomic_t                video_end;
+    SDL_atomic_t                audio_end;
+
+    SDL_atomic_t                video_head;     // written by worker
+    SDL_atomic_t                video_tail;     // written by main thread
+    SDL_atomic_t                audio_head;
+    SDL_atomic_t                audio_tail;
+    struct stream_codec_video_frame_s   video[STREAM_CODEC_VIDEO_FRAMES];
+    struct stream_codec_audio_block_s   audio[STREAM_CODEC_AUDIO_BLOCKS];
+
+    // main thread copies of the stream format, the codec itself belongs to the worker
+    uint64_t                    fps_num;
+    uint64_t                    fps_denum;
+    uint32_t                    audio_sample_rate;
+    uint16_t                    audio_bits_per_sample;
+    uint16_t                    audio_channels;
+
+    // main thread playback state
+    uint64_t                    time_ns;        // playback clock
+    uint64_t                    frame;
+    uint16_t                    video_hold;     // tail frame is on screen now
+    uint32_t                    frames_shown;
+    uint32_t                    frames_dropped;
+}stream_codec_t, *stream_codec_p;
+
+
+void stream_codec_init(struct stream_codec_s *s);
+int  stream_codec_open_rpl(struct stream_codec_s *s, SDL_RWops *rw);  // 0 on success, starts decoding
+void stream_codec_stop(struct stream_codec_s *s);
+int  stream_codec_is_open(struct stream_codec_s *s);
+int  stream_codec_is_finished(struct stream_codec_s *s);
+
+/*
+ * Advances the playback clock and returns the newest decoded frame due by now,
+ * or NULL if the frame on the screen is still the right one. Frames that became
+ * late before they were picked are skipped and counted as dropped.
+ * While the sound plays, audio_samples is the count of samples it has played
+ * and the clock follows it, so the video keeps in sync with what is heard;
+ * with audio_samples < 0 (no sound, starved or ended) the clock advances by
+ * time_ns. The clock never goes back.
+ */
+struct stream_codec_video_frame_s *stream_codec_get_video(struct stream_codec_s *s, uint64_t time_ns, int64_t audio_samples);
+struct stream_codec_audio_block_s *stream_codec_peek_audio(struct stream_codec_s *s);
+void stream_codec_pop_audio(struct stream_codec_s *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STREAM_CODEC_H */
@@ -25,11 +25,12 @@ int av_get_packet(SDL_RWops *pb, AVPacket *pkt, int size)
     int ret = 0;
     if(pkt->allocated_size < size)
     {
-        pkt->allocated_size = size + 1024 - size % 1024;
-        if(pkt->data)
+        // data may be a slice of the demuxer buffer, it is owned only if allocated_size is set
+        if(pkt->allocated_size)
         {
             free(pkt->data);
         }
+        pkt->allocated_size = size + 1024 - size % 1024;
         pkt->data = (uint8_t*)malloc(pkt->allocated_size);
     }
     pkt->size = size;
@@ -43,7 +44,7 @@ int av_get_packet(SDL_RWops *pb, AVPacket *pkt, int size)
 
 void av_packet_unref(AVPacket *pkt)
 {
-    if(pkt->data)
+    if(pkt->data && pkt->allocated_size)
     {
         free(pkt->data);
     }
@@ -126,6 +126,8 @@ uint64_t codec_inc_time(struct tiny_codec_s *s, uint64_t time_ns); // return cur
 uint32_t codec_resize_audio_buffer(struct tiny_codec_s *s, uint32_t sample_size, uint32_t samples);
 
 int codec_open_rpl(struct tiny_codec_s *s);
+#define RPL_READ_AHEAD_SIZE (1024 * 1024)
+uint32_t codec_set_rpl_read_ahead(uint32_t size);   // returns the old size; 0 seeks for every packet
                     
 #define codec_decode_audio(s) (((s)->packet((s), &(s)->audio.pkt) >= 0) && (s)->audio.decode((s), &(s)->audio.pkt))
 #define codec_decode_video(s) (((s)->packet((s), &(s)->video.pkt) >= 0) && (s)->video.decode((s), &(s)->video.pkt))
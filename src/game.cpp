@@ -34,6 +34,7 @@ extern "C" {
 #include "inventory.h"
 #include "mesh.h"
 #include "weapons.h"
+#include "save_state.h"
 
 extern lua_State *engine_lua;
 
@@ -129,6 +130,10 @@ int Game_Load(const char* name)
 {
     FILE *f;
     char *ch, local;
+    char save_path[1024];
+    uint8_t *data;
+    long data_size;
+    int ret = 1;
 
     local = 1;
     for(ch = (char*)name; *ch; ch++)
@@ -142,7 +147,6 @@ int Game_Load(const char* name)
 
     if(local)
     {
-        char save_path[1024];
         size_t save_path_base_len = sizeof(save_path) - 1;
         strncpy(save_path, Engine_GetBasePath(), save_path_base_len);
         save_path[save_path_base_len] = 0;
@@ -153,23 +157,43 @@ int Game_Load(const char* name)
             Sys_extWarn("Can not read file \"%s\"", save_path);
             return 0;
         }
-        Script_LuaClearTasks();
-        luaL_dofile(engine_lua, save_path);
     }
     else
     {
-        f = fopen(name, "rb");
-        if(f == NULL)
+        strncpy(save_path, name, sizeof(save_path) - 1);
+        save_path[sizeof(save_path) - 1] = 0;
+    }
+
+    f = fopen(save_path, "rb");
+    if(f == NULL)
+    {
+        Sys_extWarn("Can not read file \"%s\"", save_path);
+        return 0;
+    }
+
+    // binary snapshots are recognised by the magic, everything else is a Lua script
+    fseek(f, 0, SEEK_END);
+    data_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (data_size > 0) ? ((uint8_t*)malloc(data_size)) : (NULL);
+    if(data && (fread(data, data_size, 1, f) == 1) && SaveState_IsSnapshot(data, data_size))
+    {
+        fclose(f);
+        ret = SaveState_Restore(data, data_size);
+        if(!ret)
         {
-            Sys_extWarn("Can not read file \"%s\"", name);
-            return 0;
+            Sys_extWarn("Can not load save \"%s\"", save_path);
         }
+    }
+    else
+    {
         fclose(f);
         Script_LuaClearTasks();
-        luaL_dofile(engine_lua, name);
+        luaL_dofile(engine_lua, save_path);
     }
+    free(data);
 
-    return 1;
+    return ret;
 }
 
 /**
@@ -330,12 +354,15 @@ int Save_Entity(entity_p ent, void *data)
 }
 
 /**
- * Save current game state
+ * Save current game state; delta saves keep only what changed since the level was loaded
  */
-int Game_Save(const char* name)
+static int Game_SaveFile(const char* name, int delta)
 {
     FILE *f;
     char local;
+    char save_path[1024];
+    char tmp_path[1024 + 4];
+    size_t name_len;
 
     local = 1;
     for(const char *ch = name; *ch; ch++)
@@ -349,19 +376,47 @@ int Game_Save(const char* name)
 
     if(local)
     {
-        char save_path[1024];
         size_t save_path_base_len = sizeof(save_path) - 1;
         strncpy(save_path, Engine_GetBasePath(), save_path_base_len);
         save_path[save_path_base_len] = 0;
         strncat(save_path, "save/", save_path_base_len - strlen(save_path));
         strncat(save_path, name, save_path_base_len - strlen(save_path));
-        f = fopen(save_path, "wb");
     }
     else
     {
-        f = fopen(name, "wb");
+        strncpy(save_path, name, sizeof(save_path) - 1);
+        save_path[sizeof(save_path) - 1] = 0;
     }
+    // the old save is replaced only once the new one is written in full
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", save_path);
 
+    // "*.lua" names keep the old script format, the rest are binary snapshots
+    name_len = strlen(name);
+    if((name_len < 4) || strcmp(name + name_len - 4, ".lua"))
+    {
+        save_state_t state;
+        int ret;
+        SaveState_Init(&state);
+        if(!((delta) ? (SaveState_CaptureDelta(&state)) : (SaveState_Capture(&state))))
+        {
+            SaveState_Clear(&state);
+            Sys_extWarn("Can not capture the game state, \"%s\" is left as it was", name);
+            return 0;
+        }
+        f = fopen(tmp_path, "wb");
+        ret = f && (fwrite(state.data, state.size, 1, f) == 1);
+        ret = f && (fclose(f) == 0) && ret;
+        SaveState_Clear(&state);
+        ret = ret && Sys_ReplaceFile(tmp_path, save_path);
+        if(!ret)
+        {
+            remove(tmp_path);
+            Sys_extWarn("Can not write file \"%s\"", name);
+        }
+        return ret;
+    }
+
+    f = fopen(tmp_path, "wb");
     if(!f)
     {
         Sys_extWarn("Can not create file \"%s\"", name);
@@ -404,12 +459,29 @@ int Game_Save(const char* name)
 
     World_IterateAllEntities(&Save_Entity, &f);
 
-    fclose(f);
+    if((fclose(f) != 0) || !Sys_ReplaceFile(tmp_path, save_path))
+    {
+        remove(tmp_path);
+        Sys_extWarn("Can not write file \"%s\"", name);
+        return 0;
+    }
 
     return 1;
 }
 
 
+int Game_Save(const char* name)
+{
+    return Game_SaveFile(name, 0);
+}
+
+
+int Game_QuickSave(const char* name)
+{
+    return Game_SaveFile(name, 1);
+}
+
+
 void Game_ApplyControls(struct entity_s *ent)
 {
     control_action_p act = control_states.actions;
@@ -626,6 +698,7 @@ int Game_UpdateEntity(entity_p ent, void *data)
         }
         Entity_Frame(ent, engine_frame_time);
         Entity_UpdateRigidBody(ent, ent->character != NULL);
+        Character_UpdateHair(ent, engine_frame_time);
         Entity_UpdateRoomPos(ent);
     }
 
@@ -728,6 +801,7 @@ void Game_Frame(float time)
         }
         Entity_Frame(player, time);
         Entity_UpdateRigidBody(player, 1);
+        Character_UpdateHair(player, time);
         Entity_UpdateRoomPos(player);
     }
     else if(control_states.free_look)
@@ -17,6 +17,7 @@ void Game_InitGlobals();
 void Game_RegisterLuaFunctions(struct lua_State *lua);
 int Game_Load(const char* name);
 int Game_Save(const char* name);
+int Game_QuickSave(const char* name);   // delta against the state the level was loaded in
 
 void Game_Frame(float time);
 
@@ -39,6 +39,30 @@ static gui_object_p     g_console_menu = NULL;
 static GLuint           crosshairBuffer = 0;
 static GLuint           rectBuffer = 0;
 static GLuint           load_screen_tex = 0;
+
+#define SCREEN_TEXTURE_PBO_COUNT    (3)
+
+/*
+ * Load screen / video texture storage is allocated once per size, and so are
+ * the PBOs the frames are streamed through. The frames are copied into a
+ * mapped PBO once, not decoded there: the GL loader goes up to
+ * ARB_vertex_buffer_object only, so there is no persistent mapping
+ * (ARB_buffer_storage), and a glMapBuffer pointer is only valid on the GL
+ * thread until the unmap, while the decoder runs ahead of playback on its
+ * own thread. The escape codecs also read their previous frame back, which
+ * must not live in write combined GL memory.
+ */
+static struct
+{
+    GLuint      pbo[SCREEN_TEXTURE_PBO_COUNT];
+    uint16_t    pbo_index;
+    int         width;
+    int         height;
+    GLenum      format;
+    uint32_t    tex_image_calls;
+    uint32_t    sub_image_calls;
+    uint64_t    upload_ticks;
+} screen_texture;
 GLuint      backgroundBuffer = 0;
 GLfloat     guiProjectionMatrix[16];
 
@@ -207,6 +231,7 @@ void Gui_Destroy()
         delete main_inventory_manager;
         main_inventory_manager = NULL;
     }
+    Gui_DestroyItemImpostors();
 
     if(g_main_menu)
     {
@@ -215,6 +240,13 @@ void Gui_Destroy()
     }
 
     qglDeleteTextures(1, &load_screen_tex);
+    if(screen_texture.pbo[0])
+    {
+        qglDeleteBuffersARB(SCREEN_TEXTURE_PBO_COUNT, screen_texture.pbo);
+        screen_texture.pbo[0] = 0;
+    }
+    screen_texture.width = 0;
+    screen_texture.height = 0;
     qglDeleteBuffersARB(1, &crosshairBuffer);
     qglDeleteBuffersARB(1, &backgroundBuffer);
     qglDeleteBuffersARB(1, &rectBuffer);
@@ -230,6 +262,7 @@ void Gui_UpdateResize()
 
     Gui_FillCrosshairBuffer();
     Gui_FillBackgroundBuffer();
+    Gui_InvalidateItemImpostors();
 
     if(g_current_menu && g_current_menu->handlers.screen_resized)
     {
@@ -553,21 +586,89 @@ bool Gui_SetScreenTexture(void *data, int w, int h, int bpp)
         return false;
     }
 
+    uint64_t t0 = SDL_GetPerformanceCounter();
+
     // Bind the texture object
     qglBindTexture(GL_TEXTURE_2D, load_screen_tex);
 
-    // Set the texture's stretching properties
-    qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Edit the texture object's image data using the information SDL_Surface gives us
-    qglTexImage2D(GL_TEXTURE_2D, 0, color_depth, w, h, 0,
-                 texture_format, GL_UNSIGNED_BYTE, data);
+    if((w != screen_texture.width) || (h != screen_texture.height) || (texture_format != screen_texture.format))
+    {
+        // Set the texture's stretching properties
+        qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // (Re)allocate texture storage, only on size or format change
+        qglTexImage2D(GL_TEXTURE_2D, 0, color_depth, w, h, 0,
+                     texture_format, GL_UNSIGNED_BYTE, data);
+        if(qglMapBufferARB && qglUnmapBufferARB)
+        {
+            GLsizeiptr size = w * h * ((bpp == 32) ? (4) : (3));
+            if(!screen_texture.pbo[0])
+            {
+                qglGenBuffersARB(SCREEN_TEXTURE_PBO_COUNT, screen_texture.pbo);
+            }
+            for(int i = 0; i < SCREEN_TEXTURE_PBO_COUNT; ++i)
+            {
+                qglBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, screen_texture.pbo[i]);
+                qglBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, size, NULL, GL_STREAM_DRAW_ARB);
+            }
+            qglBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+        }
+        screen_texture.width = w;
+        screen_texture.height = h;
+        screen_texture.format = texture_format;
+        screen_texture.tex_image_calls++;
+    }
+    else if(screen_texture.pbo[0])
+    {
+        GLsizeiptr size = w * h * ((bpp == 32) ? (4) : (3));
+        void *dst;
+
+        // round robin over the PBOs, the one we map was last read three frames ago
+        qglBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, screen_texture.pbo[screen_texture.pbo_index]);
+        screen_texture.pbo_index = (screen_texture.pbo_index + 1) % SCREEN_TEXTURE_PBO_COUNT;
+        dst = qglMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+        if(dst)
+        {
+            memcpy(dst, data, size);
+            qglUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB);
+            qglTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, texture_format, GL_UNSIGNED_BYTE, (void*)0);
+        }
+        qglBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+        if(!dst)
+        {
+            qglTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, texture_format, GL_UNSIGNED_BYTE, data);
+        }
+        screen_texture.sub_image_calls++;
+    }
+    else
+    {
+        qglTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, texture_format, GL_UNSIGNED_BYTE, data);
+        screen_texture.sub_image_calls++;
+    }
     qglBindTexture(GL_TEXTURE_2D, 0);
+    screen_texture.upload_ticks += SDL_GetPerformanceCounter() - t0;
 
     return true;
 }
 
+
+void Gui_GetScreenTextureStats(uint32_t *tex_image_calls, uint32_t *sub_image_calls, float *upload_ms)
+{
+    uint32_t uploads = screen_texture.tex_image_calls + screen_texture.sub_image_calls;
+    *tex_image_calls = screen_texture.tex_image_calls;
+    *sub_image_calls = screen_texture.sub_image_calls;
+    *upload_ms = (uploads) ? (1000.0f * (float)screen_texture.upload_ticks / ((float)SDL_GetPerformanceFrequency() * (float)uploads)) : (0.0f);
+}
+
+
+void Gui_ResetScreenTextureStats()
+{
+    screen_texture.tex_image_calls = 0;
+    screen_texture.sub_image_calls = 0;
+    screen_texture.upload_ticks = 0;
+}
+
 bool Gui_LoadScreenAssignPic(const char* pic_name)
 {
     size_t pic_len = strlen(pic_name);
@@ -187,6 +187,8 @@ void Gui_DrawCrosshair();
 void Gui_DrawBars();
 void Gui_DrawLoadScreen(int value);
 bool Gui_SetScreenTexture(void *data, int w, int h, int bpp);
+void Gui_GetScreenTextureStats(uint32_t *tex_image_calls, uint32_t *sub_image_calls, float *upload_ms);  // upload_ms is per frame
+void Gui_ResetScreenTextureStats();
 bool Gui_LoadScreenAssignPic(const char* pic_name);
 
 /**
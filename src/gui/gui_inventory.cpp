@@ -15,6 +15,7 @@
 #include "../render/render.h"
 #include "../render/shader_description.h"
 #include "../render/shader_manager.h"
+#include "../mesh.h"
 #include "../skeletal_model.h"
 #include "../script/script.h"
 #include "../audio/audio.h"
@@ -92,6 +93,579 @@ void Item_Frame(struct ss_bone_frame_s *bf, float time)
     SSBoneFrame_Update(bf, time);
 }
 
+/*
+ * Ring item impostors. While the ring stands still the items that are not
+ * selected do not move or animate, so each is drawn once, through an FBO, into
+ * a cell of an atlas: the same pixels the item covers on screen, with the same
+ * projection, moved into the cell. Then it is a quad over those pixels, and
+ * all the quads are drawn in one call. The selected item (it spins), and any
+ * item that moved since the last frame, is drawn as a model after the quads.
+ */
+#define GUI_IMPOSTOR_GRID               (8)             // the atlas holds GRID x GRID cells
+#define GUI_IMPOSTOR_CELL_MIN           (64)
+#define GUI_IMPOSTOR_CELL_MAX           (256)
+#define GUI_IMPOSTOR_MOVE_EPSILON       (0.001f)
+
+typedef struct item_impostor_s
+{
+    uint32_t                    item_id;
+    uint32_t                    pose_key;               // pose the cell was rendered in, 0 - the cell is empty
+    float                       transform[16];          // modelview the cell was rendered with
+    float                       last_transform[16];     // the one of the last frame, a picture is taken when two frames agree
+    float                       depth;
+    GLint                       rect[4];                // x, y, width, height in the viewport
+}item_impostor_t, *item_impostor_p;
+
+typedef struct item_impostor_quad_s
+{
+    float                       depth;
+    GLfloat                     vertices[6 * 8];        // x, y, colour, tex coords; as the background buffer
+}item_impostor_quad_t, *item_impostor_quad_p;
+
+static struct
+{
+    GLuint                      fbo;
+    GLuint                      depth_buffer;
+    GLuint                      texture;
+    GLuint                      vbo;
+    GLint                       viewport[4];
+    uint16_t                    cell_size;
+    uint16_t                    failed;                 // no FBO, everything is drawn as models
+    uint32_t                    items_count;
+    item_impostor_t             items[GUI_IMPOSTOR_GRID * GUI_IMPOSTOR_GRID];
+    uint32_t                    quads_count;
+    item_impostor_quad_t        quads[GUI_IMPOSTOR_GRID * GUI_IMPOSTOR_GRID];
+    gui_item_impostor_stats_t   stats;
+} item_impostors = {0};
+
+static int item_impostors_enabled = 1;
+
+
+static const lit_shader_description *Item_SetupShader()
+{
+    const lit_shader_description *shader = renderer.shaderManager->getEntityShader(0);
+    qglUseProgramObjectARB(shader->program);
+    qglUniform1iARB(shader->number_of_lights, 0);
+    qglUniform4fARB(shader->light_ambient, 1.0f, 1.0f, 1.0f, 1.0f);
+    qglUniform1fARB(shader->dist_fog, 65536.0f);
+    return shader;
+}
+
+
+static uint32_t Item_MeshDrawCalls(struct base_mesh_s *mesh, bool *animated)
+{
+    uint32_t ret = 0;
+    if(mesh->animated_vertex_count)
+    {
+        ret += mesh->animated_faces_count;
+        *animated = true;
+    }
+    if(mesh->vertex_count)
+    {
+        ret += mesh->faces_count;
+    }
+    return ret;
+}
+
+
+/*
+ * The draw calls CRender::DrawSkeletalModel makes for the item; animated
+ * textures can not be baked.
+ */
+static uint32_t Item_CountDrawCalls(struct ss_bone_frame_s *bf, bool *animated)
+{
+    uint32_t ret = 0;
+    ss_bone_tag_p btag = bf->bone_tags;
+
+    *animated = false;
+    for(uint16_t i = 0; i < bf->bone_tag_count; i++, btag++)
+    {
+        if(!btag->is_hidden)
+        {
+            ret += Item_MeshDrawCalls((btag->mesh_replace) ? (btag->mesh_replace) : (btag->mesh_base), animated);
+            if(btag->mesh_slot)
+            {
+                ret += Item_MeshDrawCalls(btag->mesh_slot, animated);
+            }
+            if(btag->mesh_skin && btag->parent)
+            {
+                ret += Item_MeshDrawCalls(btag->mesh_skin, animated);
+            }
+        }
+    }
+    return ret;
+}
+
+
+/*
+ * Everything SSBoneFrame_Update builds the item pose from, hashed (FNV-1a).
+ */
+static uint32_t Item_PoseKey(struct ss_bone_frame_s *bf)
+{
+    uint32_t hash = 2166136261u;
+    ss_animation_p anim = &bf->animations;
+    uintptr_t words[9];
+
+    words[0] = (uintptr_t)anim->model;
+    words[1] = (uint16_t)anim->current_animation;
+    words[2] = (uint16_t)anim->current_frame;
+    words[3] = (uint16_t)anim->prev_animation;
+    words[4] = (uint16_t)anim->prev_frame;
+    words[5] = 0;
+    memcpy(words + 5, &anim->lerp, sizeof(float));
+    words[6] = (uintptr_t)bf->bone_tags;
+    words[7] = bf->bone_tag_count;
+    words[8] = 0;
+    for(uint16_t i = 0; i < bf->bone_tag_count; i++)
+    {
+        ss_bone_tag_p btag = bf->bone_tags + i;
+        words[8] = words[8] * 31 + (uintptr_t)btag->mesh_replace + (uintptr_t)btag->mesh_slot + btag->is_hidden;
+    }
+
+    for(size_t i = 0; i < sizeof(words); i++)
+    {
+        hash = (hash ^ ((const uint8_t*)words)[i]) * 16777619u;
+    }
+
+    return (hash) ? (hash) : (1);
+}
+
+
+static bool Item_SameTransform(const float a[16], const float b[16])
+{
+    for(int i = 0; i < 16; i++)
+    {
+        if(fabsf(a[i] - b[i]) > GUI_IMPOSTOR_MOVE_EPSILON)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static uint16_t Item_ImpostorCellSize()
+{
+    uint16_t cell = GUI_IMPOSTOR_CELL_MIN;
+    while((cell < GUI_IMPOSTOR_CELL_MAX) && (cell < screen_info.h / 3))
+    {
+        cell *= 2;
+    }
+    return cell;
+}
+
+
+static void Item_ReleaseImpostors()
+{
+    if(item_impostors.fbo)
+    {
+        qglDeleteFramebuffersEXT(1, &item_impostors.fbo);
+        item_impostors.fbo = 0;
+    }
+    if(item_impostors.depth_buffer)
+    {
+        qglDeleteRenderbuffersEXT(1, &item_impostors.depth_buffer);
+        item_impostors.depth_buffer = 0;
+    }
+    if(item_impostors.texture)
+    {
+        qglDeleteTextures(1, &item_impostors.texture);
+        item_impostors.texture = 0;
+    }
+    if(item_impostors.vbo)
+    {
+        qglDeleteBuffersARB(1, &item_impostors.vbo);
+        item_impostors.vbo = 0;
+    }
+    item_impostors.items_count = 0;
+}
+
+
+static bool Item_InitImpostors()
+{
+    GLsizei atlas_size;
+
+    if(item_impostors.texture || item_impostors.failed)
+    {
+        return !item_impostors.failed;
+    }
+    if(!qglGenFramebuffersEXT)
+    {
+        item_impostors.failed = 1;
+        return false;
+    }
+
+    item_impostors.cell_size = Item_ImpostorCellSize();
+    atlas_size = item_impostors.cell_size * GUI_IMPOSTOR_GRID;
+
+    qglGenTextures(1, &item_impostors.texture);
+    qglBindTexture(GL_TEXTURE_2D, item_impostors.texture);
+    qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    qglTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlas_size, atlas_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    qglBindTexture(GL_TEXTURE_2D, 0);
+
+    qglGenRenderbuffersEXT(1, &item_impostors.depth_buffer);
+    qglBindRenderbufferEXT(GL_RENDERBUFFER_EXT, item_impostors.depth_buffer);
+    qglRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24, atlas_size, atlas_size);
+    qglBindRenderbufferEXT(GL_RENDERBUFFER_EXT, 0);
+
+    qglGenFramebuffersEXT(1, &item_impostors.fbo);
+    qglBindFramebufferEXT(GL_FRAMEBUFFER_EXT, item_impostors.fbo);
+    qglFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, item_impostors.texture, 0);
+    qglFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_RENDERBUFFER_EXT, item_impostors.depth_buffer);
+    if(qglCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) != GL_FRAMEBUFFER_COMPLETE_EXT)
+    {
+        qglBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+        Item_ReleaseImpostors();
+        item_impostors.failed = 1;
+        Con_Warning("inventory impostors disabled: incomplete framebuffer");
+        return false;
+    }
+    qglBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+    qglGenBuffersARB(1, &item_impostors.vbo);
+
+    return true;
+}
+
+
+static item_impostor_p Item_GetImpostor(uint32_t item_id, bool add)
+{
+    item_impostor_p it = item_impostors.items;
+    for(uint32_t i = 0; i < item_impostors.items_count; i++, it++)
+    {
+        if(it->item_id == item_id)
+        {
+            return it;
+        }
+    }
+
+    if(add && (item_impostors.items_count < GUI_IMPOSTOR_GRID * GUI_IMPOSTOR_GRID))
+    {
+        it = item_impostors.items + item_impostors.items_count++;
+        it->item_id = item_id;
+        it->pose_key = 0;
+        for(int i = 0; i < 16; i++)
+        {
+            it->last_transform[i] = 0.0f;                                       // matches no modelview
+        }
+        return it;
+    }
+
+    return NULL;
+}
+
+
+/*
+ * The projection is followed by a move and scale in NDC that puts the item
+ * screen rect on the whole cell viewport, pixel for pixel.
+ */
+static void Item_BakeImpostor(item_impostor_p it, struct ss_bone_frame_s *bf, const float mvMatrix[16])
+{
+    uint32_t cell = it - item_impostors.items;
+    GLint x = (cell % GUI_IMPOSTOR_GRID) * item_impostors.cell_size;
+    GLint y = (cell / GUI_IMPOSTOR_GRID) * item_impostors.cell_size;
+    GLint *vp = item_impostors.viewport;
+    float move[16], proj[16], mvp[16];
+    GLfloat clear_color[4];
+    GLboolean blend = qglIsEnabled(GL_BLEND);
+    bool animated;
+
+    Mat4_E_macro(move);
+    move[0] = (float)vp[2] / (float)it->rect[2];
+    move[5] = (float)vp[3] / (float)it->rect[3];
+    move[12] = (float)(vp[2] - 2 * it->rect[0]) / (float)it->rect[2] - 1.0f;
+    move[13] = (float)(vp[3] - 2 * it->rect[1]) / (float)it->rect[3] - 1.0f;
+    Mat4_Mat4_mul(proj, move, guiProjectionMatrix);
+    Mat4_Mat4_mul(mvp, proj, mvMatrix);
+
+    qglGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+    qglBindFramebufferEXT(GL_FRAMEBUFFER_EXT, item_impostors.fbo);
+    qglViewport(x, y, it->rect[2], it->rect[3]);
+    qglEnable(GL_SCISSOR_TEST);
+    qglScissor(x, y, it->rect[2], it->rect[3]);
+    qglClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    qglClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    qglDisable(GL_BLEND);                                                       // keep the alpha, the quad blends it
+
+    renderer.DrawSkeletalModel(Item_SetupShader(), bf, mvMatrix, mvp);
+
+    if(blend)
+    {
+        qglEnable(GL_BLEND);
+    }
+    qglDisable(GL_SCISSOR_TEST);
+    qglClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+    qglBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+    qglViewport(vp[0], vp[1], vp[2], vp[3]);
+
+    item_impostors.stats.bakes++;
+    item_impostors.stats.draw_calls += Item_CountDrawCalls(bf, &animated);
+}
+
+
+static bool Item_AddMeshToRect(struct base_mesh_s *mesh, const float mvMatrix[16], float ndc_min[2], float ndc_max[2])
+{
+    for(int i = 0; i < 8; i++)
+    {
+        float v[4], clip[4];
+        v[0] = (i & 1) ? (mesh->bb_max[0]) : (mesh->bb_min[0]);
+        v[1] = (i & 2) ? (mesh->bb_max[1]) : (mesh->bb_min[1]);
+        v[2] = (i & 4) ? (mesh->bb_max[2]) : (mesh->bb_min[2]);
+        Mat4_vec3_mul(v, mvMatrix, v);
+        v[3] = 1.0f;
+        Mat4_vec4_mul_macro(clip, guiProjectionMatrix, v);
+        if(clip[3] <= 1.0f)
+        {
+            return false;
+        }
+        for(int k = 0; k < 2; k++)
+        {
+            float t = clip[k] / clip[3];
+            ndc_min[k] = (t < ndc_min[k]) ? (t) : (ndc_min[k]);
+            ndc_max[k] = (t > ndc_max[k]) ? (t) : (ndc_max[k]);
+        }
+    }
+    return true;
+}
+
+
+/*
+ * The viewport pixels the visible meshes cover, with a pixel of margin; false
+ * if some are behind the camera or it is larger than a cell.
+ */
+static bool Item_ImpostorRect(item_impostor_p it, struct ss_bone_frame_s *bf, const float mvMatrix[16])
+{
+    float ndc_min[2] = {1.0e10f, 1.0e10f}, ndc_max[2] = {-1.0e10f, -1.0e10f};
+    float tr[16];
+    GLint *vp = item_impostors.viewport;
+    ss_bone_tag_p btag = bf->bone_tags;
+
+    for(uint16_t i = 0; i < bf->bone_tag_count; i++, btag++)
+    {
+        if(!btag->is_hidden)
+        {
+            Mat4_Mat4_mul(tr, mvMatrix, btag->current_transform);
+            if(!Item_AddMeshToRect((btag->mesh_replace) ? (btag->mesh_replace) : (btag->mesh_base), tr, ndc_min, ndc_max) ||
+               (btag->mesh_slot && !Item_AddMeshToRect(btag->mesh_slot, tr, ndc_min, ndc_max)) ||
+               (btag->mesh_skin && !Item_AddMeshToRect(btag->mesh_skin, tr, ndc_min, ndc_max)))
+            {
+                return false;
+            }
+        }
+    }
+    if(ndc_min[0] > ndc_max[0])
+    {
+        return false;                                                           // nothing to draw
+    }
+
+    it->rect[0] = (GLint)floorf((0.5f + 0.5f * ndc_min[0]) * vp[2]) - 1;
+    it->rect[1] = (GLint)floorf((0.5f + 0.5f * ndc_min[1]) * vp[3]) - 1;
+    it->rect[2] = (GLint)ceilf((0.5f + 0.5f * ndc_max[0]) * vp[2]) + 1 - it->rect[0];
+    it->rect[3] = (GLint)ceilf((0.5f + 0.5f * ndc_max[1]) * vp[3]) + 1 - it->rect[1];
+    it->depth = mvMatrix[14];
+
+    return (it->rect[2] <= item_impostors.cell_size) && (it->rect[3] <= item_impostors.cell_size);
+}
+
+
+/*
+ * Queues the quad of an unselected item, taking its picture first if needed;
+ * returns false if the item has to be drawn as a model.
+ */
+static bool Item_AddImpostor(uint32_t item_id, struct ss_bone_frame_s *bf, const float mvMatrix[16])
+{
+    item_impostor_p it;
+    item_impostor_quad_p q;
+    GLfloat x0, y0, x1, y1, u0, v0, u1, v1, scale_x, scale_y, atlas_size;
+    uint32_t cell, key;
+
+    if(!item_impostors_enabled || (item_impostors.quads_count >= GUI_IMPOSTOR_GRID * GUI_IMPOSTOR_GRID) ||
+       !Item_InitImpostors() || !(it = Item_GetImpostor(item_id, true)))
+    {
+        return false;
+    }
+
+    key = Item_PoseKey(bf);
+    if((it->pose_key != key) || !Item_SameTransform(it->transform, mvMatrix))
+    {
+        bool animated;
+        bool steady = Item_SameTransform(it->last_transform, mvMatrix);
+        memcpy(it->last_transform, mvMatrix, sizeof(it->last_transform));
+        it->pose_key = 0;
+        Item_CountDrawCalls(bf, &animated);
+        if(!steady || animated || !Item_ImpostorRect(it, bf, mvMatrix))
+        {
+            return false;
+        }
+        Item_BakeImpostor(it, bf, mvMatrix);
+        it->pose_key = key;
+        memcpy(it->transform, mvMatrix, sizeof(it->transform));
+    }
+
+    // viewport pixels to the text shader screen coordinates
+    cell = it - item_impostors.items;
+    scale_x = (GLfloat)screen_info.w / (GLfloat)item_impostors.viewport[2];
+    scale_y = (GLfloat)screen_info.h / (GLfloat)item_impostors.viewport[3];
+    x0 = scale_x * it->rect[0];
+    y0 = scale_y * it->rect[1];
+    x1 = scale_x * (it->rect[0] + it->rect[2]);
+    y1 = scale_y * (it->rect[1] + it->rect[3]);
+    atlas_size = item_impostors.cell_size * GUI_IMPOSTOR_GRID;
+    u0 = (GLfloat)((cell % GUI_IMPOSTOR_GRID) * item_impostors.cell_size) / atlas_size;
+    v0 = (GLfloat)((cell / GUI_IMPOSTOR_GRID) * item_impostors.cell_size) / atlas_size;
+    u1 = u0 + (GLfloat)it->rect[2] / atlas_size;
+    v1 = v0 + (GLfloat)it->rect[3] / atlas_size;
+
+    q = item_impostors.quads + item_impostors.quads_count++;
+    q->depth = it->depth;
+    {
+        const GLfloat corners[6][4] =
+        {
+            {x0, y0, u0, v0},
+            {x1, y0, u1, v0},
+            {x1, y1, u1, v1},
+            {x0, y0, u0, v0},
+            {x1, y1, u1, v1},
+            {x0, y1, u0, v1}
+        };
+        GLfloat *v = q->vertices;
+        for(int i = 0; i < 6; i++, v += 8)
+        {
+            v[0] = corners[i][0];
+            v[1] = corners[i][1];
+            v[2] = v[3] = v[4] = v[5] = 1.0f;
+            v[6] = corners[i][2];
+            v[7] = corners[i][3];
+        }
+    }
+
+    return true;
+}
+
+
+/*
+ * True if the item pose did not change since its picture was taken, so the
+ * bone frame does not need to be updated.
+ */
+static bool Item_ImpostorIsPosed(struct base_item_s *bi)
+{
+    item_impostor_p it = (item_impostors_enabled) ? (Item_GetImpostor(bi->id, false)) : (NULL);
+    return it && it->pose_key && (it->pose_key == Item_PoseKey(bi->bf));
+}
+
+
+static void Item_BeginImpostors()
+{
+    qglGetIntegerv(GL_VIEWPORT, item_impostors.viewport);
+    item_impostors.quads_count = 0;
+}
+
+
+/*
+ * Draws the queued quads farthest first, in one call, with the text shader.
+ */
+static void Item_DrawImpostors()
+{
+    const text_shader_description *shader;
+    GLfloat *v;
+
+    item_impostors.stats.frames++;
+    if(!item_impostors.quads_count)
+    {
+        return;
+    }
+
+    // insertion sort, a ring holds a few items
+    for(uint32_t i = 1; i < item_impostors.quads_count; i++)
+    {
+        for(uint32_t j = i; (j > 0) && (item_impostors.quads[j].depth < item_impostors.quads[j - 1].depth); j--)
+        {
+            item_impostor_quad_t t = item_impostors.quads[j];
+            item_impostors.quads[j] = item_impostors.quads[j - 1];
+            item_impostors.quads[j - 1] = t;
+        }
+    }
+
+    shader = renderer.shaderManager->getTextShader();
+    qglUseProgramObjectARB(shader->program);
+    qglUniform1iARB(shader->sampler, 0);
+    qglUniform2fARB(shader->screenSize, (GLfloat)screen_info.w, (GLfloat)screen_info.h);
+    qglUniform1fARB(shader->colorReplace, 0.0f);
+
+    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, item_impostors.vbo);
+    qglBufferDataARB(GL_ARRAY_BUFFER_ARB, item_impostors.quads_count * sizeof(GLfloat[6 * 8]), NULL, GL_STREAM_DRAW_ARB);
+    v = (GLfloat*)qglMapBufferARB(GL_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+    if(v)
+    {
+        for(uint32_t i = 0; i < item_impostors.quads_count; i++, v += 6 * 8)
+        {
+            memcpy(v, item_impostors.quads[i].vertices, sizeof(GLfloat[6 * 8]));
+        }
+        qglUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+
+        qglDisable(GL_DEPTH_TEST);
+        qglDisableClientState(GL_NORMAL_ARRAY);
+        qglBindTexture(GL_TEXTURE_2D, item_impostors.texture);
+        qglVertexPointer(2, GL_FLOAT, 8 * sizeof(GLfloat), (void *)0);
+        qglColorPointer(4, GL_FLOAT, 8 * sizeof(GLfloat), (void *)sizeof(GLfloat[2]));
+        qglTexCoordPointer(2, GL_FLOAT, 8 * sizeof(GLfloat), (void *)sizeof(GLfloat[6]));
+        qglDrawArrays(GL_TRIANGLES, 0, 6 * item_impostors.quads_count);
+        qglEnableClientState(GL_NORMAL_ARRAY);
+        qglEnable(GL_DEPTH_TEST);
+        item_impostors.stats.draw_calls++;
+    }
+    renderer.ResetActiveTexture();
+    item_impostors.stats.impostor_items += item_impostors.quads_count;
+    item_impostors.quads_count = 0;
+}
+
+
+static void Item_DrawLive(struct ss_bone_frame_s *bf, const float mvMatrix[16])
+{
+    bool animated;
+    Gui_RenderItem(bf, 0.0f, mvMatrix);
+    item_impostors.stats.live_items++;
+    item_impostors.stats.draw_calls += Item_CountDrawCalls(bf, &animated);
+}
+
+
+void Gui_SetItemImpostors(int enabled)
+{
+    item_impostors_enabled = enabled;
+}
+
+
+void Gui_InvalidateItemImpostors()
+{
+    item_impostors.items_count = 0;
+    if(item_impostors.texture && (item_impostors.cell_size != Item_ImpostorCellSize()))
+    {
+        Item_ReleaseImpostors();                                                // built again at the next open inventory
+    }
+}
+
+
+void Gui_DestroyItemImpostors()
+{
+    Item_ReleaseImpostors();
+    item_impostors.failed = 0;
+}
+
+
+void Gui_GetItemImpostorStats(struct gui_item_impostor_stats_s *stats)
+{
+    *stats = item_impostors.stats;
+}
+
+
+void Gui_ResetItemImpostorStats()
+{
+    memset(&item_impostors.stats, 0, sizeof(item_impostors.stats));
+}
+
 /**
  * The base function, that draws one item by them id. Items may be animated.
  * This time for correct time calculation that function must be called every frame.
@@ -101,11 +675,7 @@ void Item_Frame(struct ss_bone_frame_s *bf, float time)
  */
 void Gui_RenderItem(struct ss_bone_frame_s *bf, float size, const float *mvMatrix)
 {
-    const lit_shader_description *shader = renderer.shaderManager->getEntityShader(0);
-    qglUseProgramObjectARB(shader->program);
-    qglUniform1iARB(shader->number_of_lights, 0);
-    qglUniform4fARB(shader->light_ambient, 1.0f, 1.0f, 1.0f, 1.0f);
-    qglUniform1fARB(shader->dist_fog, 65536.0f);
+    const lit_shader_description *shader = Item_SetupShader();
 
     if(size != 0.0f)
     {
@@ -186,6 +756,7 @@ gui_InventoryManager::gui_InventoryManager()
     m_label_title.y_align       = GLTEXT_ALIGN_TOP;
     m_label_title.next          = NULL;
     m_label_title.prev          = NULL;
+    m_label_title.run           = NULL;
 
     m_label_title.font_id       = FONT_PRIMARY;
     m_label_title.style_id      = FONTSTYLE_MENU_TITLE;
@@ -200,6 +771,7 @@ gui_InventoryManager::gui_InventoryManager()
     m_label_item_name.y_align   = GLTEXT_ALIGN_BOTTOM;
     m_label_item_name.next      = NULL;
     m_label_item_name.prev      = NULL;
+    m_label_item_name.run       = NULL;
 
     m_label_item_name.font_id   = FONT_PRIMARY;
     m_label_item_name.style_id  = FONTSTYLE_MENU_CONTENT;
@@ -735,7 +1307,10 @@ void gui_InventoryManager::frameItems(float time)
     {
         inventory_node_p next_node = i->next;
         base_item_p bi = World_GetBaseItemByID(i->id);
-        Item_Frame(bi->bf, 0.0f);
+        if(bi && ((bi->type != m_current_items_type) || (ring_item_index == m_selected_item) || !Item_ImpostorIsPosed(bi)))
+        {
+            Item_Frame(bi->bf, 0.0f);
+        }
 
         if(bi && (bi->type == m_current_items_type))
         {
@@ -1315,6 +1890,13 @@ void gui_InventoryManager::render()
             return;
         }
 
+        // models are drawn after the impostor quads, the selected one is in front of them
+        size_t live_size = m_current_items_count * (sizeof(ss_bone_frame_p) + sizeof(float[16]));
+        ss_bone_frame_p *live_items = (ss_bone_frame_p*)Sys_GetTempMem(live_size);
+        float *live_matrices = (float*)(live_items + m_current_items_count);
+        int live_count = 0;
+
+        Item_BeginImpostors();
         for(inventory_node_p i = *m_inventory; i; i = i->next)
         {
             base_item_p bi = World_GetBaseItemByID(i->id);
@@ -1370,10 +1952,30 @@ void gui_InventoryManager::render()
                 offset[2] = -0.5f * bi->bf->centre[2];
                 Mat4_Translate(matrix, offset);
                 Mat4_Scale(matrix, scale, scale, scale);
-                Gui_RenderItem(bi->bf, 0.0f, matrix);
+                if((ring_item_index != m_selected_item) && Item_AddImpostor(bi->id, bi->bf, matrix))
+                {
+                    // drawn with the quads
+                }
+                else if(live_count < m_current_items_count)
+                {
+                    live_items[live_count] = bi->bf;
+                    memcpy(live_matrices + 16 * live_count, matrix, sizeof(matrix));
+                    live_count++;
+                }
+                else
+                {
+                    Item_DrawLive(bi->bf, matrix);
+                }
                 ring_item_index++;
             }
         }
+
+        Item_DrawImpostors();
+        for(int k = 0; k < live_count; k++)
+        {
+            Item_DrawLive(live_items[k], live_matrices + 16 * k);
+        }
+        Sys_ReturnTempMem(live_size);
     }
 }
 
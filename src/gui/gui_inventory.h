@@ -68,6 +68,25 @@ void Gui_InitNotifier();
 void Item_Frame(struct ss_bone_frame_s *bf, float time);
 void Gui_RenderItem(struct ss_bone_frame_s *bf, float size, const float *mvMatrix);
 
+/*
+ * Ring items that are not selected are drawn as quads cut from an atlas of
+ * impostors, rendered once per item pose and ring tilt.
+ */
+typedef struct gui_item_impostor_stats_s
+{
+    uint32_t    frames;
+    uint32_t    live_items;             // drawn as models
+    uint32_t    impostor_items;         // drawn as quads
+    uint32_t    bakes;                  // pictures rendered into the atlas
+    uint32_t    draw_calls;
+}gui_item_impostor_stats_t, *gui_item_impostor_stats_p;
+
+void Gui_SetItemImpostors(int enabled);
+void Gui_InvalidateItemImpostors();     // call when item models or the screen size change
+void Gui_DestroyItemImpostors();
+void Gui_GetItemImpostorStats(struct gui_item_impostor_stats_s *stats);
+void Gui_ResetItemImpostorStats();
+
 /*
  * Inventory renderer class
  */
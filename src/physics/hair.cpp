@@ -1,13 +1,74 @@
 
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 extern "C" {
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
 }
 
+#include "../core/base_types.h"
+#include "../core/vmath.h"
+#include "../mesh.h"
+#include "../skeletal_model.h"
+#include "../entity.h"
+#include "../world.h"
+#include "physics.h"
 #include "hair.h"
 
+
+typedef struct hair_particle_s
+{
+    float                     pos[3];
+    float                     prev_pos[3];
+    float                     inv_mass;           // zero for the root, it follows the head
+    float                     length;             // rest distance to the next particle
+}hair_particle_t, *hair_particle_p;
+
+
+typedef struct hair_element_s
+{
+    struct base_mesh_s       *mesh;               // Pointer to rendered mesh.
+    float                     transform[16];
+}hair_element_t, *hair_element_p;
+
+
+typedef struct hair_collider_s
+{
+    uint16_t                  bone;
+    float                     centre[3];          // in the bone space
+    float                     radius;
+    float                     world_centre[3];
+}hair_collider_t, *hair_collider_p;
+
+
+typedef struct hair_s
+{
+    engine_container_p        container;
+    uint32_t                  owner_body;         // Owner entity's body ID.
+
+    uint8_t                   root_index;         // Index of "root" element.
+    uint8_t                   tail_index;         // Index of "tail" element.
+
+    uint8_t                   element_count;      // Overall amount of elements.
+    hair_element_p            elements;           // Array of elements.
+    hair_particle_p           particles;          // element_count + 1, the last one is the tail end
+
+    uint16_t                  collider_count;
+    hair_collider_p           colliders;
+
+    float                     root_transform[16]; // first joint in the owner bone space
+    float                     linear_damping;
+    float                     angular_damping;    // damps motion relative to the previous particle
+    float                     stiffness;
+    float                     restitution;
+    float                     friction;
+    float                     tip_radius;
+    float                     last_time;
+}hair_t, *hair_p;
+
+
 struct hair_setup_s *Hair_GetSetup(struct lua_State *lua, int stack_pos)
 {
     struct hair_setup_s *hair_setup = NULL;
@@ -155,4 +216,454 @@ void Hair_DeleteSetup(hair_setup_p setup)
     {
         free(setup);
     }
-}
\ No newline at end of file
+}
+
+static void Hair_GetBoneTransform(float tr[16], struct entity_s *entity, uint16_t bone)
+{
+    Mat4_Mat4_mul(tr, entity->transform.M4x4, entity->bf->bone_tags[bone].current_transform);
+}
+
+
+static float Hair_GetInnerRadius(struct base_mesh_s *mesh)
+{
+    float r = mesh->bb_max[0] - mesh->bb_min[0];
+    float t = mesh->bb_max[1] - mesh->bb_min[1];
+    r = (t < r) ? (t) : (r);
+    t = mesh->bb_max[2] - mesh->bb_min[2];
+    return 0.5f * ((t < r) ? (t) : (r));
+}
+
+
+// element frames follow the segments, each one turned as little as possible from the previous one
+static void Hair_UpdateTransforms(struct hair_s *hair, const float root_tr[16])
+{
+    float x[3], y[3], z[3], t;
+
+    vec3_copy(x, root_tr + 0);
+    vec3_copy(y, root_tr + 4);
+    vec3_copy(z, root_tr + 8);
+    for(uint16_t i = 0; i < hair->element_count; i++)
+    {
+        hair_particle_p p = hair->particles + i;
+        float *tr = hair->elements[i].transform;
+        float d[3];
+
+        vec3_sub(d, p[1].pos, p[0].pos);
+        t = vec3_abs(d);
+        if(t > 0.001f)
+        {
+            vec3_mul_scalar(y, d, 1.0f / t);
+        }
+        t = vec3_dot(x, y);
+        vec3_sub_mul(x, x, y, t);
+        t = vec3_abs(x);
+        if(t < 0.001f)
+        {
+            vec3_cross(x, y, z);
+            t = vec3_abs(x);
+        }
+        vec3_mul_scalar(x, x, 1.0f / t);
+        vec3_cross(z, x, y);
+
+        vec3_copy(tr + 0, x);
+        vec3_copy(tr + 4, y);
+        vec3_copy(tr + 8, z);
+        vec3_copy(tr + 12, p[0].pos);
+        tr[3] = tr[7] = tr[11] = 0.0f;
+        tr[15] = 1.0f;
+    }
+}
+
+
+struct hair_s *Hair_Create(struct hair_setup_s *setup, struct entity_s *entity)
+{
+    // No setup or parent to link to - bypass function.
+
+    if(!entity || !setup || !entity->bf || (setup->link_body >= entity->bf->bone_tag_count))
+    {
+        return NULL;
+    }
+
+    skeletal_model_p model = World_GetModelByID(setup->model_id);
+    if((!model) || (model->mesh_count == 0))
+    {
+        return NULL;
+    }
+
+    // The container only carries the room for the tip collision test.
+    struct hair_s *hair = (struct hair_s*)calloc(1, sizeof(struct hair_s));
+    hair->container = Container_Create();
+    hair->container->collision_group = COLLISION_GROUP_DYNAMICS_NI;
+    hair->container->collision_mask = COLLISION_GROUP_STATIC_ROOM | COLLISION_GROUP_STATIC_OBLECT;
+    hair->container->collision_shape = COLLISION_SHAPE_SINGLE_SPHERE;
+    hair->container->object_type = OBJECT_HAIR;
+    hair->container->object = hair;
+    hair->container->room = entity->self->room;
+
+    hair->owner_body    = setup->link_body;
+    hair->element_count = model->mesh_count;
+    hair->elements      = (hair_element_p)calloc(hair->element_count, sizeof(hair_element_t));
+    hair->particles     = (hair_particle_p)calloc(hair->element_count + 1, sizeof(hair_particle_t));
+
+    // Root index should be always zero, as it is how engine determines that it is
+    // connected to head and renders it properly. Tail index should be always the
+    // last element of the hair.
+
+    hair->root_index = 0;
+    hair->tail_index = hair->element_count - 1;
+
+    // The same joint frame the rigid body chain had: offset and set-up angle on
+    // the head, then turned so the first element goes along its y axis.
+    Mat4_E(hair->root_transform);
+    vec3_copy(hair->root_transform + 12, setup->head_offset);
+    Mat4_RotateZ_SinCos(hair->root_transform, sinf(setup->root_angle[2]), cosf(setup->root_angle[2]));
+    Mat4_RotateY_SinCos(hair->root_transform, sinf(setup->root_angle[1]), cosf(setup->root_angle[1]));
+    Mat4_RotateX_SinCos(hair->root_transform, sinf(setup->root_angle[0]), cosf(setup->root_angle[0]));
+    Mat4_RotateY_SinCos(hair->root_transform, 1.0f, 0.0f);
+
+    // Particle weights go from root weight to tail weight, element lengths are
+    // the mesh heights less the joint overlap.
+    float weight_step = (setup->root_weight - setup->tail_weight) / hair->element_count;
+    float current_weight = setup->root_weight;
+    for(uint16_t i = 0; i < hair->element_count; i++)
+    {
+        struct base_mesh_s *mesh = model->mesh_tree[i].mesh_base;
+        float length = fabs(mesh->bb_max[1] - mesh->bb_min[1]) * setup->joint_overlap;
+
+        current_weight -= weight_step;
+        hair->elements[i].mesh = mesh;
+        hair->particles[i].length = (length > 1.0f) ? (length) : (1.0f);
+        hair->particles[i + 1].inv_mass = (current_weight > 0.0f) ? (1.0f / current_weight) : (1.0f);
+    }
+    hair->particles[0].inv_mass = 0.0f;
+    hair->tip_radius = Hair_GetInnerRadius(hair->elements[hair->tail_index].mesh);
+    hair->tip_radius = (hair->tip_radius > 1.0f) ? (hair->tip_radius) : (1.0f);
+
+    hair->linear_damping  = setup->hair_damping[0];
+    hair->angular_damping = setup->hair_damping[1];
+    hair->restitution     = setup->hair_restitution;
+    hair->friction        = setup->hair_friction;
+    // CFM softens the joints, ERP is how much of the error goes away at once
+    hair->stiffness       = setup->joint_erp / (1.0f + setup->joint_cfm);
+    hair->stiffness       = (hair->stiffness < 0.1f) ? (0.1f) : ((hair->stiffness > 1.0f) ? (1.0f) : (hair->stiffness));
+
+    // The chain hangs straight from the root at first.
+    float head_tr[16], root_tr[16];
+    Hair_GetBoneTransform(head_tr, entity, hair->owner_body);
+    Mat4_Mat4_mul(root_tr, head_tr, hair->root_transform);
+    vec3_copy(hair->particles[0].pos, root_tr + 12);
+    for(uint16_t i = 0; i <= hair->element_count; i++)
+    {
+        hair_particle_p p = hair->particles + i;
+        if(i > 0)
+        {
+            vec3_add_mul(p->pos, p[-1].pos, root_tr + 4, p[-1].length);
+        }
+        vec3_copy(p->prev_pos, p->pos);
+    }
+
+    // Sphere colliders on the owner bones, except the ones the root sits in.
+    hair->colliders = (hair_collider_p)calloc(entity->bf->bone_tag_count, sizeof(hair_collider_t));
+    for(uint16_t i = 0; i < entity->bf->bone_tag_count; i++)
+    {
+        struct base_mesh_s *mesh = entity->bf->bone_tags[i].mesh_base;
+        hair_collider_p c = hair->colliders + hair->collider_count;
+        float tr[16], centre[3];
+
+        if(!mesh || (mesh->vertex_count == 0))
+        {
+            continue;
+        }
+        c->bone = i;
+        c->radius = Hair_GetInnerRadius(mesh);
+        vec3_copy(c->centre, mesh->centre);
+        Hair_GetBoneTransform(tr, entity, i);
+        Mat4_vec3_mul(centre, tr, c->centre);
+        if((c->radius > 0.0f) && (vec3_dist_sq(centre, root_tr + 12) > c->radius * c->radius))
+        {
+            hair->collider_count++;
+        }
+    }
+
+    Hair_UpdateTransforms(hair, root_tr);
+
+    return hair;
+}
+
+
+void Hair_Delete(struct hair_s *hair)
+{
+    if(hair)
+    {
+        free(hair->elements);
+        hair->elements = NULL;
+        free(hair->particles);
+        hair->particles = NULL;
+        hair->element_count = 0;
+        free(hair->colliders);
+        hair->colliders = NULL;
+        hair->collider_count = 0;
+
+        free(hair->container);
+        hair->container = NULL;
+
+        free(hair);
+    }
+}
+
+
+// sweeps the tip along its move; on a hit the plane it touched is given back, free side positive
+static int Hair_CollideTip(struct hair_s *hair, float plane[4])
+{
+    hair_particle_p tip = hair->particles + hair->element_count;
+    collision_result_t cr;
+    float move[3];
+
+    vec3_sub(move, tip->pos, tip->prev_pos);
+    if((vec3_sqabs(move) > 0.01f) &&
+       Physics_SphereTest(&cr, tip->prev_pos, tip->pos, hair->tip_radius, hair->container, COLLISION_GROUP_STATIC_ROOM | COLLISION_GROUP_STATIC_OBLECT))
+    {
+        float contact[3], rest[3], vn, t;
+
+        t = vec3_dot(cr.normale, move);
+        if(t > 0.0f)
+        {
+            vec3_inv(cr.normale);
+            t = -t;
+        }
+
+        // stop at the contact, slide the rest of the way along the surface
+        vec3_add_mul(contact, tip->prev_pos, move, cr.fraction);
+        vec3_mul_scalar(rest, move, 1.0f - cr.fraction);
+        vn = vec3_dot(rest, cr.normale);
+        vec3_sub_mul(rest, rest, cr.normale, vn);
+        vec3_add_mul(tip->pos, contact, rest, 1.0f - hair->friction);
+
+        // the motion bounces off by restitution and loses friction along the surface
+        vec3_sub_mul(move, move, cr.normale, t);
+        vec3_mul_scalar(move, move, 1.0f - hair->friction);
+        vec3_add_mul(move, move, cr.normale, -t * hair->restitution);
+        vec3_sub(tip->prev_pos, tip->pos, move);
+
+        vec3_copy(plane, cr.normale);
+        plane[3] = -vec3_dot(cr.normale, contact);
+        return 1;
+    }
+    return 0;
+}
+
+
+static void Hair_PushOut(struct hair_s *hair, uint16_t first, uint16_t last)
+{
+    hair_particle_p p = hair->particles;
+
+    for(uint16_t i = first; i <= last; i++)
+    {
+        for(uint16_t j = 0; j < hair->collider_count; j++)
+        {
+            hair_collider_p c = hair->colliders + j;
+            float d[3], r = c->radius, t;
+            vec3_sub(d, p[i].pos, c->world_centre);
+            t = vec3_sqabs(d);
+            if((t < r * r) && (t > 0.0001f))
+            {
+                t = r / sqrtf(t);
+                vec3_add_mul(p[i].pos, c->world_centre, d, t);
+            }
+        }
+    }
+}
+
+
+static void Hair_SolveConstraints(struct hair_s *hair, const float root_axis[3], float stiffness, int hard)
+{
+    hair_particle_p p = hair->particles;
+
+    Hair_PushOut(hair, 1, hair->element_count);
+
+    for(uint16_t i = 0; i < hair->element_count; i++)
+    {
+        float d[3], len, w, k;
+
+        vec3_sub(d, p[i + 1].pos, p[i].pos);
+        len = vec3_abs(d);
+        w = p[i].inv_mass + p[i + 1].inv_mass;
+        if(len <= 0.001f)
+        {
+            continue;
+        }
+        if(hard)
+        {
+            // only the child moves, so the lengths fixed before it stay fixed
+            vec3_add_mul(p[i + 1].pos, p[i].pos, d, p[i].length / len);
+        }
+        else if(w > 0.0f)
+        {
+            k = stiffness * (len - p[i].length) / (len * w);
+            vec3_add_mul(p[i].pos, p[i].pos, d, k * p[i].inv_mass);
+            vec3_sub_mul(p[i + 1].pos, p[i + 1].pos, d, k * p[i + 1].inv_mass);
+        }
+
+        if(i == 0)
+        {
+            // keep the first element inside the cone around its set-up direction
+            float t;
+            vec3_sub(d, p[1].pos, p[0].pos);
+            len = vec3_abs(d);
+            t = (len > 0.001f) ? (vec3_dot(d, root_axis) / len) : (1.0f);
+            if(t < HAIR_ROOT_CONE_COS)
+            {
+                vec3_sub_mul(d, d, root_axis, t * len);
+                t = vec3_abs(d);
+                if(t > 0.001f)
+                {
+                    float s = sqrtf(1.0f - HAIR_ROOT_CONE_COS * HAIR_ROOT_CONE_COS);
+                    vec3_mul_scalar(d, d, s * len / t);
+                    vec3_add_mul(d, d, root_axis, HAIR_ROOT_CONE_COS * len);
+                    vec3_add(p[1].pos, p[0].pos, d);
+                }
+            }
+        }
+    }
+}
+
+
+/*
+ * The chain is pulled to the tip where the collisions left it and hung from
+ * the root again, then the tip is put out of the body and off the plane it
+ * hit; a few times, so the lengths come back and the tip stays out.
+ */
+static void Hair_SettleTip(struct hair_s *hair, const float plane[4])
+{
+    hair_particle_p p = hair->particles;
+    uint16_t n = hair->element_count;
+
+    for(int k = 0; k < HAIR_TIP_ITERATIONS; k++)
+    {
+        float d[3], len;
+
+        for(uint16_t i = n - 1; i > 0; i--)
+        {
+            vec3_sub(d, p[i].pos, p[i + 1].pos);
+            len = vec3_abs(d);
+            if(len > 0.001f)
+            {
+                vec3_add_mul(p[i].pos, p[i + 1].pos, d, p[i].length / len);
+            }
+        }
+        for(uint16_t i = 0; i < n; i++)
+        {
+            vec3_sub(d, p[i + 1].pos, p[i].pos);
+            len = vec3_abs(d);
+            if(len > 0.001f)
+            {
+                vec3_add_mul(p[i + 1].pos, p[i].pos, d, p[i].length / len);
+            }
+        }
+        Hair_PushOut(hair, n, n);
+        if(plane)
+        {
+            float t = vec3_dot(plane, p[n].pos) + plane[3];
+            if(t < 0.0f)
+            {
+                vec3_sub_mul(p[n].pos, p[n].pos, plane, t);
+            }
+        }
+    }
+}
+
+
+void Hair_Update(struct hair_s *hair, struct entity_s *entity, float time)
+{
+    if(hair && (hair->element_count > 0))
+    {
+        hair_particle_p p = hair->particles;
+        float head_tr[16], root_tr[16], g[3], root_move[3], tip[3], plane[4];
+        int hit;
+
+        hair->container->room = entity->self->room;
+        Hair_GetBoneTransform(head_tr, entity, hair->owner_body);
+        Mat4_Mat4_mul(root_tr, head_tr, hair->root_transform);
+        vec3_sub(root_move, root_tr + 12, p[0].pos);
+        vec3_copy(p[0].prev_pos, p[0].pos);
+        vec3_copy(p[0].pos, root_tr + 12);
+
+        if(time > 0.0f)
+        {
+            float ratio, damp_linear, damp_relative;
+
+            time = (time < HAIR_MAX_TIME_STEP) ? (time) : (HAIR_MAX_TIME_STEP);
+            ratio = (hair->last_time > 0.0f) ? (time / hair->last_time) : (1.0f);
+            damp_linear = powf(1.0f - ((hair->linear_damping < 1.0f) ? (hair->linear_damping) : (1.0f)), time);
+            damp_relative = powf(1.0f - ((hair->angular_damping < 1.0f) ? (hair->angular_damping) : (1.0f)), time);
+            Physics_GetGravity(g);
+            vec3_mul_scalar(g, g, time * time);
+
+            // time corrected Verlet step; the motion relative to the previous
+            // particle is damped apart, it is what the chain swings with
+            for(uint16_t i = 1; i <= hair->element_count; i++)
+            {
+                float v[3];
+                vec3_sub(v, p[i].pos, p[i].prev_pos);
+                vec3_mul_scalar(v, v, ratio);
+                vec3_sub(v, v, root_move);
+                vec3_mul_scalar(v, v, damp_relative);
+                vec3_add_to(v, root_move);
+                vec3_mul_scalar(v, v, damp_linear);
+                vec3_copy(root_move, v);
+                vec3_copy(p[i].prev_pos, p[i].pos);
+                vec3_add(p[i].pos, p[i].pos, v);
+                vec3_add_to(p[i].pos, g);
+            }
+            hair->last_time = time;
+        }
+
+        for(uint16_t j = 0; j < hair->collider_count; j++)
+        {
+            float tr[16];
+            Hair_GetBoneTransform(tr, entity, hair->colliders[j].bone);
+            Mat4_vec3_mul(hair->colliders[j].world_centre, tr, hair->colliders[j].centre);
+        }
+        // the last pass is hard, so element lengths hold whatever the others did
+        for(int i = 1; i <= HAIR_SOLVER_ITERATIONS; i++)
+        {
+            Hair_SolveConstraints(hair, root_tr + 4, hair->stiffness, i == HAIR_SOLVER_ITERATIONS);
+        }
+        // the hard pass may pull the tip back into the body or through the room, collisions have the last word
+        vec3_copy(tip, p[hair->element_count].pos);
+        Hair_PushOut(hair, hair->element_count, hair->element_count);
+        hit = (time > 0.0f) && Hair_CollideTip(hair, plane);
+        if(hit || (vec3_dist_sq(tip, p[hair->element_count].pos) > 0.0f))
+        {
+            Hair_SettleTip(hair, (hit) ? (plane) : (NULL));
+        }
+
+        Hair_UpdateTransforms(hair, root_tr);
+    }
+}
+
+
+int Hair_GetElementsCount(struct hair_s *hair)
+{
+    return (hair)?(hair->element_count):(0);
+}
+
+
+void Hair_GetElementInfo(struct hair_s *hair, int element, struct base_mesh_s **mesh, float tr[16])
+{
+    Mat4_Copy(tr, hair->elements[element].transform);
+    *mesh = hair->elements[element].mesh;
+}
+
+
+float Hair_GetMaxStretch(struct hair_s *hair)
+{
+    float ret = 0.0f;
+    for(uint16_t i = 0; hair && (i < hair->element_count); i++)
+    {
+        hair_particle_p p = hair->particles + i;
+        float d = fabs(vec3_dist(p[1].pos, p[0].pos) - p->length) / p->length;
+        ret = (d > ret) ? (d) : (ret);
+    }
+    return ret;
+}
@@ -60,4 +60,34 @@ typedef struct hair_setup_s
 hair_setup_p Hair_GetSetup(struct lua_State *lua, int stack_pos);
 void Hair_DeleteSetup(hair_setup_p setup);
 
+/*
+ * Hair is a Verlet chain of its own, out of the dynamics world: one particle at
+ * each joint and one at the tail end, held together by distance constraints.
+ * It is pushed out of spheres around the owner bones, and only the tail tip
+ * is tested against the room geometry.
+ */
+#define HAIR_SOLVER_ITERATIONS  (6)
+#define HAIR_TIP_ITERATIONS     (8)             // the tip goes back to its length along what it touches
+#define HAIR_MAX_TIME_STEP      (1.0f / 20.0f)  // longer frames are simulated as that, not to explode
+#define HAIR_ROOT_CONE_COS      (0.0f)          // the first element stays within 90 degrees of its set-up angle
+
+struct hair_s;
+struct entity_s;
+
+// Creates hair attached to the entity bone set-up says, NULL if the model or the bone is missing.
+struct hair_s *Hair_Create(struct hair_setup_s *setup, struct entity_s *entity);
+
+// Removes specified hair from entity and clears it from memory.
+void Hair_Delete(struct hair_s *hair);
+
+// Steps the chain after the owner entity got its new pose.
+void Hair_Update(struct hair_s *hair, struct entity_s *entity, float time);
+
+int Hair_GetElementsCount(struct hair_s *hair);
+
+void Hair_GetElementInfo(struct hair_s *hair, int element, struct base_mesh_s **mesh, float tr[16]);
+
+// The worst relative deviation of an element length from its rest length.
+float Hair_GetMaxStretch(struct hair_s *hair);
+
 #endif	/* PHYSICS_HAIR_H */
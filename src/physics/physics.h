@@ -53,6 +53,14 @@ typedef struct ghost_shape_s
 struct physics_data_s;
 struct physics_object_s;
 
+typedef struct physics_bvh_cache_stats_s
+{
+    uint32_t    built;
+    uint32_t    attached;           // deserialized from the cache file
+    uint32_t    shared;             // same geometry as a BVH already attached
+    float       time_ms;            // spent on static trimesh BVHs, built or attached
+}physics_bvh_cache_stats_t, *physics_bvh_cache_stats_p;
+
 /* Common physics functions */
 void Physics_Init();
 void Physics_Destroy();
@@ -60,6 +68,13 @@ void Physics_StepSimulation(float time);
 void Physics_DebugDrawWorld();
 void Physics_CleanUpObjects();
 
+/* Static trimesh BVH cache, one file per level; Open drops the BVHs of the previous level */
+void Physics_BvhCacheOpen(const char *level_path);
+void Physics_BvhCacheFlush();
+void Physics_BvhCacheClose();
+int  Physics_BvhCacheRemove(const char *level_path);
+void Physics_GetBvhCacheStats(struct physics_bvh_cache_stats_s *stats);
+
 struct physics_data_s *Physics_CreatePhysicsData(struct engine_container_s *cont);
 void Physics_DeletePhysicsData(struct physics_data_s *physics);
 
@@ -109,50 +124,26 @@ void Physics_SetLinearFactor(struct physics_data_s *physics, float factor[3], ui
 
 #define RD_DEFAULT_SLEEPING_THRESHOLD 10.0
 
+#define RD_MAX_ACTIVE 8                   // more ragdolls freeze the oldest ones in their pose
+
 struct rd_setup_s;
 
+typedef struct physics_ragdoll_stats_s
+{
+    uint32_t    built;                  // pooled ragdolls made, at reserve time or on demand
+    uint32_t    armed;
+    uint32_t    frozen;
+    uint32_t    active;
+}physics_ragdoll_stats_t, *physics_ragdoll_stats_p;
+
 bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf, struct rd_setup_s *setup);
 bool Ragdoll_Delete(struct physics_data_s *physics);
+// builds a pooled ragdoll for the model and set-up ahead of time, up to RD_MAX_ACTIVE of them
+void Ragdoll_Reserve(struct ss_bone_frame_s *bf, struct rd_setup_s *setup);
+// the pool is keyed by model, so it goes with the level
+void Ragdoll_ClearPool();
+void Physics_GetRagdollStats(struct physics_ragdoll_stats_s *stats);
 
 
-/* Hair interface */
-#define HAIR_TR1       0
-#define HAIR_TR2       1
-#define HAIR_TR3       2
-#define HAIR_TR4_KID_1 3
-#define HAIR_TR4_KID_2 4
-#define HAIR_TR4_OLD   5
-#define HAIR_TR5_KID_1 6
-#define HAIR_TR5_KID_2 7
-#define HAIR_TR5_OLD   8
-
-// Maximum amount of joint hair vertices. By default, TR4-5 used four
-// vertices for each hair (unused TR1 hair mesh even used three).
-// It's hardly possible if anyone will exceed a limit of 8 vertices,
-// but if it happens, this should be edited.
-
-#define HAIR_VERTEX_MAP_LIMIT 8
-
-// Since we apply TR4 hair scheme to TR2-3 as well, we need to discard
-// polygons which are unused. These are 0 and 5 in both TR2 and TR3.
-
-#define HAIR_DISCARD_ROOT_FACE 0
-#define HAIR_DISCARD_TAIL_FACE 5
-
-struct hair_s;
-struct hair_setup_s;
-
-// Creates hair into allocated hair structure, using previously defined setup and
-// entity index.
-struct hair_s *Hair_Create(struct hair_setup_s *setup, struct physics_data_s *physics);
-
-// Removes specified hair from entity and clears it from memory.
-void Hair_Delete(struct hair_s *hair);
-
-void Hair_Update(struct hair_s *hair, struct physics_data_s *physics);
-
-int Hair_GetElementsCount(struct hair_s *hair);
-
-void Hair_GetElementInfo(struct hair_s *hair, int element, struct base_mesh_s **mesh, float tr[16]);
 
 #endif	/* ENGINE_PHYSICS_H */
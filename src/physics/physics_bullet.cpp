@@ -1,7 +1,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <SDL2/SDL_filesystem.h>
+#include <SDL2/SDL_timer.h>
 
 #include <btBulletCollisionCommon.h>
 #include <btBulletDynamicsCommon.h>
@@ -11,6 +14,7 @@
 #include <BulletCollision/CollisionDispatch/btGhostObject.h>
 #include <BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h>
 #include <BulletCollision/NarrowPhaseCollision/btRaycastCallback.h>
+#include <BulletCollision/CollisionShapes/btOptimizedBvh.h>
 
 #include "../core/gl_util.h"
 #include "../core/gl_font.h"
@@ -30,7 +34,6 @@
 #include "../world.h"
 #include "physics.h"
 #include "ragdoll.h"
-#include "hair.h"
 
 
 /*
@@ -256,9 +259,9 @@ typedef struct physics_data_s
     btPairCachingGhostObject          **ghost_objects;          // like Bullet character controller for penetration resolving.
     btManifoldArray                    *manifoldArray;          // keep track of the contact manifolds
     struct collision_node_s            *collision_track;
-    uint16_t                            objects_count;          // Ragdoll joints
-    uint16_t                            bt_joint_count;         // Ragdoll joints
-    btTypedConstraint                 **bt_joints;              // Ragdoll joints
+    uint16_t                            objects_count;
+    uint16_t                            ragdoll_frozen;         // posed by a ragdoll that went back to the pool
+    struct bt_ragdoll_s                *ragdoll;                // lent from the pool, its bodies are in bt_body
 
     int16_t                             collision_group;
     int16_t                             collision_mask;
@@ -331,8 +334,10 @@ btCollisionShape* BT_CSfromHeightmap(struct room_sector_s *heightmap, uint32_t s
 
 uint32_t BT_AddFloorAndCeilingToTrimesh(btTriangleMesh *trimesh, struct room_sector_s *sector);
 uint32_t BT_AddSectorTweenToTrimesh(btTriangleMesh *trimesh, struct sector_tween_s *tween);
+btCollisionShape* BT_CreateBvhShape(btTriangleMesh *trimesh, bool useCompression, bool buildBvh);
 
 void Physics_DeleteRigidBody(struct physics_data_s *physics);                   // only for internal usage
+static void BT_RagdollRelease(struct bt_ragdoll_s *rd);
 
 btScalar getInnerBBRadius(btScalar bb_min[3], btScalar bb_max[3])
 {
@@ -343,6 +348,401 @@ btScalar getInnerBBRadius(btScalar bb_min[3], btScalar bb_max[3])
     return ((t > r) && (r != 0.0f)) ? (0.5f * r) : (0.5f * t);
 }
 
+/*
+ * Quantized BVH cache: every static trimesh BVH of a level goes into one file,
+ * serialized in place and keyed by a hash of the triangles it was built from.
+ * The next load reads the file into one aligned block and attaches the BVHs
+ * from it, instead of building them again. Built BVHs are kept here too, so
+ * meshes with the same geometry (static mesh instances, flip tweens) share one.
+ * Cached BVHs live until the next level is opened; shapes do not own them.
+ */
+#define BT_BVH_CACHE_MAGIC      (0x48564254)    // "TBVH"
+#define BT_BVH_CACHE_VERSION    (2)
+#define BT_BVH_CACHE_ALIGN      (16)            // serializeInPlace() wants 16 aligned buffers
+
+typedef struct bt_bvh_cache_header_s
+{
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    scalar_size;
+    uint32_t    bvh_size;               // the in place layout is the raw btOptimizedBvh of this build
+    uint32_t    reserved;
+}bt_bvh_cache_header_t, *bt_bvh_cache_header_p;
+
+typedef struct bt_bvh_cache_record_s
+{
+    uint64_t    hash;
+    uint64_t    checksum;               // of the serialized BVH, it is deserialized in place without checks
+    uint32_t    triangles;
+    uint32_t    size;                   // serialized BVH that follows, padded to BT_BVH_CACHE_ALIGN
+    uint64_t    reserved;               // keeps the records a multiple of BT_BVH_CACHE_ALIGN
+}bt_bvh_cache_record_t, *bt_bvh_cache_record_p;
+
+typedef struct bt_bvh_cache_entry_s
+{
+    uint64_t            hash;
+    uint32_t            triangles;
+    uint32_t            size;
+    uint8_t            *data;           // serialized BVH: in the file block, or a pending record to write
+    btOptimizedBvh     *bvh;            // attached BVH, NULL until the first request
+    uint8_t             owned;          // built here, not deserialized in place
+    uint8_t             pending;        // not in the file yet
+}bt_bvh_cache_entry_t, *bt_bvh_cache_entry_p;
+
+static struct
+{
+    int                         active;
+    int                         file_valid;     // the file has a good header, records are appended to it
+    int                         file_rewrite;   // the file has a bad record, it is written again up to it
+    long                        file_end;       // end of the last good record
+    char                        path[1024];
+    uint8_t                    *file_data;
+    bt_bvh_cache_entry_p        entries;
+    uint32_t                    entries_count;
+    uint32_t                    entries_allocated;
+    uint64_t                    ticks;
+    physics_bvh_cache_stats_t   stats;
+} bt_bvh_cache = {0};
+
+
+static uint64_t BT_TrimeshHash(btTriangleMesh *trimesh, bool useCompression, uint32_t *triangles)
+{
+    uint64_t hash = 0xCBF29CE484222325;             // FNV-1a
+    *triangles = 0;
+
+    for(int part = 0; part < trimesh->getNumSubParts(); ++part)
+    {
+        const unsigned char *vertices, *indices;
+        int vertices_count, vertex_stride, index_stride, faces_count;
+        PHY_ScalarType vertex_type, index_type;
+
+        trimesh->getLockedReadOnlyVertexIndexBase(&vertices, vertices_count, vertex_type, vertex_stride,
+                                                  &indices, index_stride, faces_count, index_type, part);
+        // only xyz: the padding of 4 component vertices is not initialized
+        size_t vertex_size = 3 * ((vertex_type == PHY_DOUBLE) ? (sizeof(double)) : (sizeof(float)));
+        for(int i = 0; i < vertices_count; ++i, vertices += vertex_stride)
+        {
+            for(size_t j = 0; j < vertex_size; ++j)
+            {
+                hash = (hash ^ vertices[j]) * 0x100000001B3;
+            }
+        }
+        for(size_t i = 0; i < (size_t)faces_count * index_stride; ++i)
+        {
+            hash = (hash ^ indices[i]) * 0x100000001B3;
+        }
+        hash = (hash ^ (uint64_t)vertices_count) * 0x100000001B3;
+        hash = (hash ^ (uint64_t)index_type) * 0x100000001B3;
+        *triangles += faces_count;
+        trimesh->unLockReadOnlyVertexBase(part);
+    }
+
+    return (hash ^ (uint64_t)useCompression) * 0x100000001B3;
+}
+
+
+static uint64_t BT_BvhCacheChecksum(const uint8_t *data, uint32_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325;             // FNV-1a on words, sizes are BT_BVH_CACHE_ALIGN multiples
+
+    for(uint32_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001B3;
+    }
+    return (hash ^ (uint64_t)size) * 0x100000001B3;
+}
+
+
+static bt_bvh_cache_entry_p BT_BvhCacheAddEntry(uint64_t hash, uint32_t triangles, uint32_t size, uint8_t *data)
+{
+    if(bt_bvh_cache.entries_count >= bt_bvh_cache.entries_allocated)
+    {
+        bt_bvh_cache.entries_allocated += 256;
+        bt_bvh_cache.entries = (bt_bvh_cache_entry_p)realloc(bt_bvh_cache.entries, bt_bvh_cache.entries_allocated * sizeof(bt_bvh_cache_entry_t));
+    }
+
+    bt_bvh_cache_entry_p e = bt_bvh_cache.entries + bt_bvh_cache.entries_count++;
+    e->hash = hash;
+    e->triangles = triangles;
+    e->size = size;
+    e->data = data;
+    e->bvh = NULL;
+    e->owned = 0;
+    e->pending = 0;
+    return e;
+}
+
+
+static bt_bvh_cache_entry_p BT_BvhCacheFind(uint64_t hash, uint32_t triangles)
+{
+    // from the end: a record appended after a bad one replaces it
+    for(uint32_t i = bt_bvh_cache.entries_count; i > 0; --i)
+    {
+        bt_bvh_cache_entry_p e = bt_bvh_cache.entries + i - 1;
+        if((e->hash == hash) && (e->triangles == triangles))
+        {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+
+static void BT_BvhCacheGetFilePath(char *path, size_t size, const char *level_path)
+{
+    uint64_t hash = 0xCBF29CE484222325;
+    char *cache_path = SDL_GetPrefPath("OpenTomb", "cache");
+
+    for(const char *ch = level_path; *ch; ++ch)
+    {
+        hash = (hash ^ (uint8_t)*ch) * 0x100000001B3;
+    }
+    path[0] = 0;
+    if(cache_path)
+    {
+        snprintf(path, size, "%sbvh_%016llx.bin", cache_path, (unsigned long long)hash);
+        SDL_free(cache_path);
+    }
+}
+
+
+void Physics_BvhCacheOpen(const char *level_path)
+{
+    FILE *f;
+    long file_size;
+
+    Physics_BvhCacheClose();
+    BT_BvhCacheGetFilePath(bt_bvh_cache.path, sizeof(bt_bvh_cache.path), level_path);
+    if(!bt_bvh_cache.path[0])
+    {
+        return;
+    }
+    bt_bvh_cache.active = 1;
+
+    f = fopen(bt_bvh_cache.path, "rb");
+    if(!f)
+    {
+        return;
+    }
+    fseek(f, 0, SEEK_END);
+    file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if(file_size >= (long)sizeof(bt_bvh_cache_header_t))
+    {
+        bt_bvh_cache.file_data = (uint8_t*)btAlignedAlloc(file_size, BT_BVH_CACHE_ALIGN);
+        if(fread(bt_bvh_cache.file_data, file_size, 1, f) == 1)
+        {
+            bt_bvh_cache_header_p header = (bt_bvh_cache_header_p)bt_bvh_cache.file_data;
+            bt_bvh_cache.file_valid = (header->magic == BT_BVH_CACHE_MAGIC) && (header->version == BT_BVH_CACHE_VERSION) &&
+                                      (header->scalar_size == sizeof(btScalar)) && (header->bvh_size == sizeof(btOptimizedBvh));
+        }
+    }
+    fclose(f);
+
+    if(bt_bvh_cache.file_valid)
+    {
+        // a record cut short (an interrupted write) or damaged ends the index;
+        // the file is written again up to it before anything is appended
+        long pos = sizeof(bt_bvh_cache_header_t);
+        while(pos + (long)sizeof(bt_bvh_cache_record_t) <= file_size)
+        {
+            bt_bvh_cache_record_p rec = (bt_bvh_cache_record_p)(bt_bvh_cache.file_data + pos);
+            uint8_t *data = bt_bvh_cache.file_data + pos + sizeof(bt_bvh_cache_record_t);
+            if((rec->size % BT_BVH_CACHE_ALIGN) || ((long)rec->size > file_size - pos - (long)sizeof(bt_bvh_cache_record_t)) ||
+               (BT_BvhCacheChecksum(data, rec->size) != rec->checksum))
+            {
+                break;
+            }
+            BT_BvhCacheAddEntry(rec->hash, rec->triangles, rec->size, data);
+            pos += sizeof(bt_bvh_cache_record_t) + rec->size;
+        }
+        bt_bvh_cache.file_end = pos;
+        bt_bvh_cache.file_rewrite = (pos != file_size);
+    }
+    else if(bt_bvh_cache.file_data)
+    {
+        btAlignedFree(bt_bvh_cache.file_data);
+        bt_bvh_cache.file_data = NULL;
+    }
+}
+
+
+static FILE *BT_BvhCacheCreateFile()
+{
+    FILE *f = fopen(bt_bvh_cache.path, "wb");
+    bt_bvh_cache_header_t header;
+
+    if(f)
+    {
+        header.magic = BT_BVH_CACHE_MAGIC;
+        header.version = BT_BVH_CACHE_VERSION;
+        header.scalar_size = sizeof(btScalar);
+        header.bvh_size = sizeof(btOptimizedBvh);
+        header.reserved = 0;
+        fwrite(&header, sizeof(header), 1, f);
+        bt_bvh_cache.file_valid = 1;
+    }
+    return f;
+}
+
+
+void Physics_BvhCacheFlush()
+{
+    FILE *f = NULL;
+    bt_bvh_cache_entry_p e = bt_bvh_cache.entries;
+
+    if(bt_bvh_cache.file_rewrite)
+    {
+        // the good records are still in the file block, the bad one and the rest are dropped
+        f = BT_BvhCacheCreateFile();
+        if(!f)
+        {
+            return;
+        }
+        fwrite(bt_bvh_cache.file_data + sizeof(bt_bvh_cache_header_t), bt_bvh_cache.file_end - sizeof(bt_bvh_cache_header_t), 1, f);
+        bt_bvh_cache.file_rewrite = 0;
+    }
+
+    for(uint32_t i = 0; i < bt_bvh_cache.entries_count; ++i, ++e)
+    {
+        if(e->pending)
+        {
+            if(!f)
+            {
+                f = (bt_bvh_cache.file_valid) ? (fopen(bt_bvh_cache.path, "ab")) : (BT_BvhCacheCreateFile());
+                if(!f)
+                {
+                    break;
+                }
+            }
+
+            bt_bvh_cache_record_t rec;
+            rec.hash = e->hash;
+            rec.checksum = BT_BvhCacheChecksum(e->data, e->size);
+            rec.triangles = e->triangles;
+            rec.size = e->size;
+            rec.reserved = 0;
+            fwrite(&rec, sizeof(rec), 1, f);
+            fwrite(e->data, e->size, 1, f);
+            // the built BVH stays attached, the serialized copy is not needed any more
+            btAlignedFree(e->data);
+            e->data = NULL;
+            e->pending = 0;
+        }
+    }
+
+    if(f)
+    {
+        fclose(f);
+    }
+}
+
+
+void Physics_BvhCacheClose()
+{
+    bt_bvh_cache_entry_p e = bt_bvh_cache.entries;
+
+    if(bt_bvh_cache.active)
+    {
+        Physics_BvhCacheFlush();
+    }
+
+    for(uint32_t i = 0; i < bt_bvh_cache.entries_count; ++i, ++e)
+    {
+        if(e->owned)
+        {
+            e->bvh->~btOptimizedBvh();
+            btAlignedFree(e->bvh);
+        }
+        if(e->pending)
+        {
+            btAlignedFree(e->data);
+        }
+    }
+    free(bt_bvh_cache.entries);
+    if(bt_bvh_cache.file_data)
+    {
+        btAlignedFree(bt_bvh_cache.file_data);
+    }
+    memset(&bt_bvh_cache, 0, sizeof(bt_bvh_cache));
+}
+
+
+int Physics_BvhCacheRemove(const char *level_path)
+{
+    char path[1024];
+    BT_BvhCacheGetFilePath(path, sizeof(path), level_path);
+    return path[0] && (remove(path) == 0);
+}
+
+
+void Physics_GetBvhCacheStats(struct physics_bvh_cache_stats_s *stats)
+{
+    *stats = bt_bvh_cache.stats;
+    stats->time_ms = 1000.0f * (double)bt_bvh_cache.ticks / (double)SDL_GetPerformanceFrequency();
+}
+
+
+btCollisionShape *BT_CreateBvhShape(btTriangleMesh *trimesh, bool useCompression, bool buildBvh)
+{
+    uint64_t t0 = SDL_GetPerformanceCounter();
+    btBvhTriangleMeshShape *ret;
+    bt_bvh_cache_entry_p e;
+    uint32_t triangles;
+    uint64_t hash;
+
+    if(!bt_bvh_cache.active || !buildBvh)
+    {
+        return new btBvhTriangleMeshShape(trimesh, useCompression, buildBvh);
+    }
+
+    // the shape gets its local AABB from the mesh, the BVH is attached after
+    ret = new btBvhTriangleMeshShape(trimesh, useCompression, false);
+    hash = BT_TrimeshHash(trimesh, useCompression, &triangles);
+    e = BT_BvhCacheFind(hash, triangles);
+
+    if(e && e->bvh)
+    {
+        bt_bvh_cache.stats.shared++;
+    }
+    else if(e && (e->bvh = btOptimizedBvh::deSerializeInPlace(e->data, e->size, false)))
+    {
+        bt_bvh_cache.stats.attached++;
+    }
+    else
+    {
+        btOptimizedBvh *bvh = new(btAlignedAlloc(sizeof(btOptimizedBvh), BT_BVH_CACHE_ALIGN)) btOptimizedBvh();
+        uint32_t size;
+
+        bvh->build(trimesh, useCompression, ret->getLocalAabbMin(), ret->getLocalAabbMax());
+        size = (bvh->calculateSerializeBufferSize() + BT_BVH_CACHE_ALIGN - 1) & ~(BT_BVH_CACHE_ALIGN - 1);
+        if(!e)
+        {
+            e = BT_BvhCacheAddEntry(hash, triangles, 0, NULL);
+        }
+        e->bvh = bvh;
+        e->owned = 1;
+        e->data = (uint8_t*)btAlignedAlloc(size, BT_BVH_CACHE_ALIGN);
+        memset(e->data, 0, size);
+        e->pending = bvh->serializeInPlace(e->data, size, false);
+        e->size = size;
+        if(!e->pending)
+        {
+            btAlignedFree(e->data);
+            e->data = NULL;
+        }
+        bt_bvh_cache.stats.built++;
+    }
+
+    ret->setOptimizedBvh(e->bvh);
+    bt_bvh_cache.ticks += SDL_GetPerformanceCounter() - t0;
+
+    return ret;
+}
+
 // Bullet Physics initialization.
 void Physics_Init()
 {
@@ -371,6 +771,9 @@ void Physics_Init()
 
 void Physics_Destroy()
 {
+    Physics_BvhCacheClose();
+    Ragdoll_ClearPool();
+
     //delete dynamics world
     delete bt_engine_dynamicsWorld;
 
@@ -444,9 +847,9 @@ struct physics_data_s *Physics_CreatePhysicsData(struct engine_container_s *cont
 
     ret->bt_body = NULL;
     ret->bt_info = NULL;
-    ret->bt_joints = NULL;
+    ret->ragdoll = NULL;
     ret->objects_count = 0;
-    ret->bt_joint_count = 0;
+    ret->ragdoll_frozen = 0;
     ret->manifoldArray = NULL;
     ret->ghosts_info = NULL;
     ret->ghost_objects = NULL;
@@ -477,21 +880,9 @@ void Physics_DeletePhysicsData(struct physics_data_s *physics)
             physics->bt_info = NULL;
         }
 
-        if(physics->bt_joints)
+        if(physics->ragdoll)
         {
-            for(uint32_t i = 0; i < physics->bt_joint_count; i++)
-            {
-                if(physics->bt_joints[i])
-                {
-                    bt_engine_dynamicsWorld->removeConstraint(physics->bt_joints[i]);
-                    delete physics->bt_joints[i];
-                    physics->bt_joints[i] = NULL;
-                }
-            }
-
-            free(physics->bt_joints);
-            physics->bt_joints = NULL;
-            physics->bt_joint_count = 0;
+            BT_RagdollRelease(physics->ragdoll);   // the kinematic bodies are deleted below
         }
 
         if(physics->ghost_objects)
@@ -893,7 +1284,7 @@ btCollisionShape *BT_CSfromMesh(struct base_mesh_s *mesh, bool useCompression, b
 
     if(is_static)
     {
-        ret = new btBvhTriangleMeshShape(trimesh, useCompression, buildBvh);
+        ret = BT_CreateBvhShape(trimesh, useCompression, buildBvh);
     }
     else
     {
@@ -1188,7 +1579,7 @@ btCollisionShape *BT_CSfromHeightmap(struct room_sector_s *heightmap, uint32_t s
         return NULL;
     }
 
-    ret = new btBvhTriangleMeshShape(trimesh, useCompression, buildBvh);
+    ret = BT_CreateBvhShape(trimesh, useCompression, buildBvh);
     return ret;
 }
 
@@ -1313,6 +1704,11 @@ void Physics_GenRigidBody(struct physics_data_s *physics, struct ss_bone_frame_s
 
 void Physics_DeleteRigidBody(struct physics_data_s *physics)
 {
+    if(physics->ragdoll)
+    {
+        BT_RagdollRelease(physics->ragdoll);   // the pool bodies go back to it, the kinematic ones are deleted below
+    }
+
     if(physics->bt_body)
     {
         for(int i = 0; i < physics->objects_count; i++)
@@ -1779,464 +2175,360 @@ void Physics_SetLinearFactor(struct physics_data_s *physics, float factor[3], ui
 
 
 /* *****************************************************************************
- * ************************  HAIR DATA  ****************************************
+ * ************************  RAGDOLL DATA  *************************************
  * ****************************************************************************/
 
-typedef struct hair_element_s
+/*
+ * Ragdoll pool: bodies and joints of a ragdoll are built once per skeletal
+ * model and set-up, out of the world, and lent to a dying entity: its
+ * kinematic bodies are swapped out for the ragdoll ones, which take their
+ * shapes and transforms. Past RD_MAX_ACTIVE the oldest ragdoll is frozen: its
+ * pose goes back to the kinematic bodies and the pool gets it back.
+ */
+typedef struct bt_ragdoll_s
 {
-    struct base_mesh_s         *mesh;              // Pointer to rendered mesh.
-    btCollisionShape           *shape;             // Pointer to collision shape.
-    btRigidBody                *body;              // Pointer to dynamic body.
-    btGeneric6DofConstraint    *joint;             // Array of joints.
-}hair_element_t, *hair_element_p;
-
-
-typedef struct hair_s
+    struct skeletal_model_s    *model;
+    uint32_t                    setup_hash;
+    uint16_t                    body_count;
+    uint16_t                    joint_count;
+    btRigidBody               **bodies;
+    btTypedConstraint         **joints;
+    btRigidBody               **saved_bodies;   // the owner's kinematic bodies while it is lent
+    btScalar                   *masses;
+    struct physics_data_s      *owner;
+    uint32_t                    order;          // when it was lent, the lowest one is frozen first
+    struct bt_ragdoll_s        *next;
+}bt_ragdoll_t, *bt_ragdoll_p;
+
+static struct
 {
-    engine_container_p        container;
-    uint32_t                  owner_body;         // Owner entity's body ID.
-
-    uint8_t                   root_index;         // Index of "root" element.
-    uint8_t                   tail_index;         // Index of "tail" element.
+    bt_ragdoll_p                list;
+    uint32_t                    order;
+    physics_ragdoll_stats_t     stats;
+} bt_ragdoll_pool = {0};
 
-    uint8_t                   element_count;      // Overall amount of elements.
-    hair_element_s           *elements;           // Array of elements.
 
-    uint8_t                   vertex_map_count;
-    uint32_t                 *hair_vertex_map;    // Hair vertex indices to link
-    uint32_t                 *head_vertex_map;    // Head vertex indices to link
-
-}hair_t, *hair_p;
-
-
-struct hair_s *Hair_Create(struct hair_setup_s *setup, struct physics_data_s *physics)
+static uint32_t BT_RagdollSetupHash(struct rd_setup_s *setup)
 {
-    // No setup or parent to link to - bypass function.
+    uint32_t hash = 0x811C9DC5;                 // FNV-1a
+    const uint8_t *p = (const uint8_t*)setup->joint_setup;
 
-    if(!physics || !setup || (setup->link_body >= physics->objects_count) ||
-       !physics->bt_body[setup->link_body])
+    for(size_t i = 0; i < setup->joint_count * sizeof(rd_joint_setup_t); ++i)
     {
-        return NULL;
+        hash = (hash ^ p[i]) * 0x01000193;
     }
-
-    skeletal_model_p model = World_GetModelByID(setup->model_id);
-    if((!model) || (model->mesh_count == 0))
+    p = (const uint8_t*)setup->body_setup;
+    for(size_t i = 0; i < setup->body_count * sizeof(rd_body_setup_t); ++i)
     {
-        return NULL;
+        hash = (hash ^ p[i]) * 0x01000193;
     }
-
-    // Setup engine container. FIXME: DOESN'T WORK PROPERLY ATM.
-    struct hair_s *hair = (struct hair_s*)calloc(1, sizeof(struct hair_s));
-    hair->container = Container_Create();
-    hair->container->collision_group = COLLISION_GROUP_DYNAMICS_NI;
-    hair->container->collision_mask = COLLISION_GROUP_STATIC_ROOM | COLLISION_GROUP_STATIC_OBLECT | COLLISION_GROUP_KINEMATIC | COLLISION_GROUP_CHARACTERS;
-    hair->container->collision_shape = COLLISION_SHAPE_TRIMESH;
-    hair->container->object_type = OBJECT_HAIR;
-    hair->container->object = hair;
-    hair->container->room = physics->cont->room;
-
-    // Setup initial hair parameters.
-    hair->owner_body = setup->link_body;    // Entity body to refer to.
-
-    // Setup initial position / angles.
-    btTransform startTransform = physics->bt_body[hair->owner_body]->getWorldTransform();
-    // Number of elements (bodies) is equal to number of hair meshes.
-
-    hair->element_count = model->mesh_count;
-    hair->elements      = (hair_element_p)calloc(hair->element_count, sizeof(hair_element_t));
-
-    // Root index should be always zero, as it is how engine determines that it is
-    // connected to head and renders it properly. Tail index should be always the
-    // last element of the hair, as it indicates absence of "child" constraint.
-
-    hair->root_index = 0;
-    hair->tail_index = hair->element_count - 1;
-
-    // Weight step is needed to determine the weight of each hair body.
-    // It is derived from root body weight and tail body weight.
-
-    btScalar weight_step = ((setup->root_weight - setup->tail_weight) / hair->element_count);
-    btScalar current_weight = setup->root_weight;
-
-    for(uint32_t i = 0; i < hair->element_count; i++)
+    p = (const uint8_t*)&setup->joint_cfm;
+    for(size_t i = 0; i < 2 * sizeof(float); ++i)
     {
-        // Point to corresponding mesh.
-
-        hair->elements[i].mesh = model->mesh_tree[i].mesh_base;
-
-        // Begin creating ACTUAL physical hair mesh.
-        btVector3   localInertia(0, 0, 0);
-
-        // Make collision shape out of mesh.
-        hair->elements[i].shape = BT_CSfromMesh(hair->elements[i].mesh, true, true, false);
-        hair->elements[i].shape->calculateLocalInertia((current_weight * setup->hair_inertia), localInertia);
-        hair->elements[i].joint = NULL;
-
-        // Decrease next body weight to weight_step parameter.
-        current_weight -= weight_step;
-
-        // Initialize motion state for body.
-        btDefaultMotionState* motionState = new btDefaultMotionState(startTransform);
-
-        // Make rigid body.
-        hair->elements[i].body = new btRigidBody(current_weight, motionState, hair->elements[i].shape, localInertia);
-
-        // Damping makes body stop in space by itself, to prevent it from continous movement.
-        hair->elements[i].body->setDamping(setup->hair_damping[0], setup->hair_damping[1]);
-
-        // Restitution and friction parameters define "bounciness" and "dullness" of hair.
-        hair->elements[i].body->setRestitution(setup->hair_restitution);
-        hair->elements[i].body->setFriction(setup->hair_friction);
-
-        // Since hair is always moving with Lara, even if she's in still state (like, hanging
-        // on a ledge), hair bodies shouldn't deactivate over time.
-        hair->elements[i].body->forceActivationState(DISABLE_DEACTIVATION);
+        hash = (hash ^ p[i]) * 0x01000193;
+    }
+    return hash ^ (setup->body_count << 16) ^ setup->joint_count;
+}
 
-        // Hair bodies must not collide with each other, and also collide ONLY with kinematic
-        // bodies (e. g. animated meshes), or else Lara's ghost object or anything else will be able to
-        // collide with hair!
-        hair->elements[i].body->setUserPointer(hair->container);
-        bt_engine_dynamicsWorld->addRigidBody(hair->elements[i].body, btBroadphaseProxy::CharacterFilter, btBroadphaseProxy::DefaultFilter | btBroadphaseProxy::StaticFilter | btBroadphaseProxy::KinematicFilter | btBroadphaseProxy::CharacterFilter);
 
-        hair->elements[i].body->activate();
+static void BT_RagdollDelete(bt_ragdoll_p rd)
+{
+    for(uint16_t i = 0; i < rd->joint_count; i++)
+    {
+        delete rd->joints[i];
+    }
+    for(uint16_t i = 0; i < rd->body_count; i++)
+    {
+        delete rd->bodies[i];
     }
+    free(rd->joints);
+    free(rd->bodies);
+    free(rd->saved_bodies);
+    free(rd->masses);
+    free(rd);
+}
 
-    // GENERATE CONSTRAINTS.
-    // All constraints are generic 6-DOF type, as they seem perfect fit for hair.
 
-    // If multiple joints per body is specified, joints are placed in circular manner,
-    // with obvious step of (SIMD_2_PI) / joint count. It means that all joints will form
-    // circle-like figure.
+static bt_ragdoll_p BT_RagdollBuild(struct ss_bone_frame_s *bf, struct rd_setup_s *setup, uint32_t hash)
+{
+    bt_ragdoll_p rd = (bt_ragdoll_p)calloc(1, sizeof(bt_ragdoll_t));
+
+    rd->model = bf->animations.model;
+    rd->setup_hash = hash;
+    rd->body_count = setup->body_count;
+    rd->bodies = (btRigidBody**)calloc(rd->body_count, sizeof(btRigidBody*));
+    rd->saved_bodies = (btRigidBody**)calloc(rd->body_count, sizeof(btRigidBody*));
+    rd->masses = (btScalar*)calloc(rd->body_count, sizeof(btScalar));
+    rd->joints = (btTypedConstraint**)calloc(setup->joint_count, sizeof(btTypedConstraint*));
+
+    // Shapes and transforms come from the entity the ragdoll is lent to.
+    for(uint16_t i = 0; i < rd->body_count; i++)
+    {
+        btRigidBody::btRigidBodyConstructionInfo info(setup->body_setup[i].mass, NULL, NULL);
+        info.m_linearDamping  = setup->body_setup[i].damping[0];
+        info.m_angularDamping = setup->body_setup[i].damping[1];
+        info.m_restitution    = setup->body_setup[i].restitution;
+        info.m_friction       = setup->body_setup[i].friction;
+        info.m_linearSleepingThreshold  = RD_DEFAULT_SLEEPING_THRESHOLD;
+        info.m_angularSleepingThreshold = RD_DEFAULT_SLEEPING_THRESHOLD;
+        rd->masses[i] = setup->body_setup[i].mass;
+        rd->bodies[i] = new btRigidBody(info);
+
+        if((i < bf->bone_tag_count) && (bf->bone_tags[i].parent == NULL))
+        {
+            btScalar r = getInnerBBRadius(bf->bone_tags[i].mesh_base->bb_min, bf->bone_tags[i].mesh_base->bb_max);
+            rd->bodies[i]->setCcdMotionThreshold(0.8 * r);
+            rd->bodies[i]->setCcdSweptSphereRadius(r);
+        }
+    }
 
-    for(uint32_t i = 0; i < hair->element_count; i++)
+    for(uint32_t i = 0; i < setup->joint_count; i++, rd->joint_count++)
     {
-        btRigidBody* prev_body;
-        btScalar     body_length;
-
-        // Each body width and height are used to calculate position of each joint.
+        if((setup->joint_setup[i].body_index >= setup->body_count) ||
+           (setup->joint_setup[i].body_index >= bf->bone_tag_count))
+        {
+            BT_RagdollDelete(rd);
+            return NULL;    // If body 1 or body 2 are absent, the set-up is bad.
+        }
 
-        //btScalar body_width = fabs(hair->elements[i].mesh->bb_max[0] - hair->elements[i].mesh->bb_min[0]);
-        //btScalar body_depth = fabs(hair->elements[i].mesh->bb_max[3] - hair->elements[i].mesh->bb_min[3]);
+        btTransform localA, localB;
+        ss_bone_tag_p btB = bf->bone_tags + setup->joint_setup[i].body_index;
+        ss_bone_tag_p btA = btB->parent;
+        if((btA == NULL) || (btA->index >= setup->body_count))
+        {
+            BT_RagdollDelete(rd);
+            return NULL;
+        }
 
-        btTransform localA; localA.setIdentity();
-        btTransform localB; localB.setIdentity();
+        localA.getBasis().setEulerZYX(setup->joint_setup[i].body1_angle[0], setup->joint_setup[i].body1_angle[1], setup->joint_setup[i].body1_angle[2]);
+        localA.setOrigin(btVector3(btB->local_transform[12 + 0], btB->local_transform[12 + 1], btB->local_transform[12 + 2]));
 
-        btScalar joint_x = 0.0;
-        btScalar joint_y = 0.0;
+        localB.getBasis().setEulerZYX(setup->joint_setup[i].body2_angle[0], setup->joint_setup[i].body2_angle[1], setup->joint_setup[i].body2_angle[2]);
+        localB.setOrigin(btVector3(0.0, 0.0, 0.0));
 
-        if(i == 0)  // First joint group
+        switch(setup->joint_setup[i].joint_type)
         {
-            // Adjust pivot point A to parent body.
-            localA.setOrigin(btVector3(setup->head_offset[0] + joint_x, setup->head_offset[1], setup->head_offset[2] + joint_y));
-            localA.getBasis().setEulerZYX(setup->root_angle[0], setup->root_angle[1], setup->root_angle[2]);
+            case RD_CONSTRAINT_POINT:
+                {
+                    btPoint2PointConstraint* pointC = new btPoint2PointConstraint(*rd->bodies[btA->index], *rd->bodies[btB->index], localA.getOrigin(), localB.getOrigin());
+                    rd->joints[i] = pointC;
+                }
+                break;
 
-            localB.setOrigin(btVector3(joint_x, 0.0, joint_y));
-            localB.getBasis().setEulerZYX(0,-SIMD_HALF_PI,0);
+            case RD_CONSTRAINT_HINGE:
+                {
+                    btHingeConstraint* hingeC = new btHingeConstraint(*rd->bodies[btA->index], *rd->bodies[btB->index], localA, localB);
+                    hingeC->setLimit(setup->joint_setup[i].joint_limit[0], setup->joint_setup[i].joint_limit[1], 0.9, 0.3, 0.3);
+                    rd->joints[i] = hingeC;
+                }
+                break;
 
-            prev_body = physics->bt_body[hair->owner_body];                     // Previous body is parent body.
+            case RD_CONSTRAINT_CONE:
+            default:
+                {
+                    btConeTwistConstraint* coneC = new btConeTwistConstraint(*rd->bodies[btA->index], *rd->bodies[btB->index], localA, localB);
+                    coneC->setLimit(setup->joint_setup[i].joint_limit[0], setup->joint_setup[i].joint_limit[1], setup->joint_setup[i].joint_limit[2], 0.9, 0.3, 0.7);
+                    rd->joints[i] = coneC;
+                }
+                break;
         }
-        else
-        {
-            // Adjust pivot point A to previous mesh's length, considering mesh overlap multiplier.
-
-            body_length = fabs(hair->elements[i-1].mesh->bb_max[1] - hair->elements[i-1].mesh->bb_min[1]) * setup->joint_overlap;
 
-            localA.setOrigin(btVector3(joint_x, body_length, joint_y));
-            localA.getBasis().setEulerZYX(0,SIMD_HALF_PI,0);
-
-            // Pivot point B is automatically adjusted by Bullet.
+        rd->joints[i]->setParam(BT_CONSTRAINT_STOP_CFM, setup->joint_cfm, -1);
+        rd->joints[i]->setParam(BT_CONSTRAINT_STOP_ERP, setup->joint_erp, -1);
+        rd->joints[i]->setDbgDrawSize(64.0);
+    }
 
-            localB.setOrigin(btVector3(joint_x, 0.0, joint_y));
-            localB.getBasis().setEulerZYX(0,SIMD_HALF_PI,0);
+    rd->next = bt_ragdoll_pool.list;
+    bt_ragdoll_pool.list = rd;
+    bt_ragdoll_pool.stats.built++;
 
-            prev_body = hair->elements[i-1].body;   // Previous body is preceiding hair mesh.
-        }
+    return rd;
+}
 
-        // Create 6DOF constraint.
-        hair->elements[i].joint = new btGeneric6DofConstraint(*prev_body, *(hair->elements[i].body), localA, localB, true);
 
-        // CFM and ERP parameters are critical for making joint "hard" and link
-        // to Lara's head. With wrong values, constraints may become "elastic".
-        for(int axis = 0; axis <= 5; axis++)
-        {
-            hair->elements[i].joint->setParam(BT_CONSTRAINT_STOP_CFM, setup->joint_cfm, axis);
-            hair->elements[i].joint->setParam(BT_CONSTRAINT_STOP_ERP, setup->joint_erp, axis);
-        }
-
-        if(i == 0)
-        {
-            // First joint group should be more limited in motion, as it is connected
-            // right to the head. NB: Should we make it scriptable as well?
-            hair->elements[i].joint->setLinearLowerLimit(btVector3(0., 0., 0.));
-            hair->elements[i].joint->setLinearUpperLimit(btVector3(0., 0., 0.));
-            hair->elements[i].joint->setAngularLowerLimit(btVector3(-SIMD_HALF_PI,     0., -SIMD_HALF_PI*0.4));
-            hair->elements[i].joint->setAngularUpperLimit(btVector3(-SIMD_HALF_PI*0.3, 0.,  SIMD_HALF_PI*0.4));
-
-            // Increased solver iterations make constraint even more stable.
-            hair->elements[i].joint->setOverrideNumSolverIterations(100);
-        }
-        else
-        {
-            // Normal joint with more movement freedom.
-            hair->elements[i].joint->setLinearLowerLimit(btVector3(0., 0., 0.));
-            hair->elements[i].joint->setLinearUpperLimit(btVector3(0., 0., 0.));
-            hair->elements[i].joint->setAngularLowerLimit(btVector3(-SIMD_HALF_PI*0.5, 0., -SIMD_HALF_PI*0.5));
-            hair->elements[i].joint->setAngularUpperLimit(btVector3( SIMD_HALF_PI*0.5, 0.,  SIMD_HALF_PI*0.5));
-        }
-        hair->elements[i].joint->setDbgDrawSize(btScalar(5.f));    // Draw constraint axes.
+// gives the owner its kinematic bodies back, in the pose the ragdoll left
+static void BT_RagdollRelease(bt_ragdoll_p rd)
+{
+    struct physics_data_s *physics = rd->owner;
 
-        // Add constraint to the world.
-        bt_engine_dynamicsWorld->addConstraint(hair->elements[i].joint, true);
+    for(uint16_t i = 0; i < rd->joint_count; i++)
+    {
+        bt_engine_dynamicsWorld->removeConstraint(rd->joints[i]);
+    }
+    for(uint16_t i = 0; i < rd->body_count; i++)
+    {
+        btRigidBody *body = rd->saved_bodies[i];
+        bt_engine_dynamicsWorld->removeRigidBody(rd->bodies[i]);
+        rd->bodies[i]->setUserPointer(NULL);
+        body->setWorldTransform(rd->bodies[i]->getWorldTransform());
+        body->setMassProps(0, btVector3(0.0, 0.0, 0.0));
+        bt_engine_dynamicsWorld->addRigidBody(body, btBroadphaseProxy::KinematicFilter, btBroadphaseProxy::AllFilter);
+        physics->bt_body[i] = body;
+        rd->saved_bodies[i] = NULL;
     }
 
-    return hair;
+    physics->ragdoll = NULL;
+    rd->owner = NULL;
+    bt_ragdoll_pool.stats.active--;
 }
 
 
-void Hair_Delete(struct hair_s *hair)
+static bt_ragdoll_p BT_RagdollFind(struct skeletal_model_s *model, uint32_t hash, uint32_t *count)
 {
-    if(hair)
-    {
-        for(int i = 0; i < hair->element_count; i++)
-        {
-            if(hair->elements[i].joint)
-            {
-                bt_engine_dynamicsWorld->removeConstraint(hair->elements[i].joint);
-                delete hair->elements[i].joint;
-                hair->elements[i].joint = NULL;
-            }
-        }
+    bt_ragdoll_p ret = NULL;
 
-        for(int i = 0; i < hair->element_count; i++)
+    *count = 0;
+    for(bt_ragdoll_p rd = bt_ragdoll_pool.list; rd; rd = rd->next)
+    {
+        if((rd->model == model) && (rd->setup_hash == hash))
         {
-            if(hair->elements[i].body)
-            {
-                hair->elements[i].body->setUserPointer(NULL);
-                bt_engine_dynamicsWorld->removeRigidBody(hair->elements[i].body);
-                delete hair->elements[i].body;
-                hair->elements[i].body = NULL;
-            }
-            if(hair->elements[i].shape)
-            {
-                delete hair->elements[i].shape;
-                hair->elements[i].shape = NULL;
-            }
+            (*count)++;
+            ret = (!ret && !rd->owner) ? (rd) : (ret);
         }
-        free(hair->elements);
-        hair->elements = NULL;
-        hair->element_count = 0;
-
-        hair->container = NULL;
-        hair->owner_body = 0;
+    }
+    return ret;
+}
 
-        hair->root_index = 0;
-        hair->tail_index = 0;
 
-        free(hair->container);
-        hair->container = NULL;
+void Ragdoll_Reserve(struct ss_bone_frame_s *bf, struct rd_setup_s *setup)
+{
+    uint32_t hash, count;
 
-        free(hair);
+    if(bf && setup)
+    {
+        hash = BT_RagdollSetupHash(setup);
+        BT_RagdollFind(bf->animations.model, hash, &count);
+        if(count < RD_MAX_ACTIVE)
+        {
+            BT_RagdollBuild(bf, setup, hash);
+        }
     }
 }
 
 
-void Hair_Update(struct hair_s *hair, struct physics_data_s *physics)
+void Ragdoll_ClearPool()
 {
-    if(hair && (hair->element_count > 0))
+    for(bt_ragdoll_p rd = bt_ragdoll_pool.list; rd;)
     {
-        hair->container->room = physics->cont->room;
+        bt_ragdoll_p next = rd->next;
+        if(rd->owner)
+        {
+            BT_RagdollRelease(rd);
+        }
+        BT_RagdollDelete(rd);
+        rd = next;
     }
+    bt_ragdoll_pool.list = NULL;
+    bt_ragdoll_pool.order = 0;
+    memset(&bt_ragdoll_pool.stats, 0, sizeof(bt_ragdoll_pool.stats));
 }
 
-int Hair_GetElementsCount(struct hair_s *hair)
-{
-    return (hair)?(hair->element_count):(0);
-}
 
-void Hair_GetElementInfo(struct hair_s *hair, int element, struct base_mesh_s **mesh, float tr[16])
+void Physics_GetRagdollStats(struct physics_ragdoll_stats_s *stats)
 {
-    hair->elements[element].body->getWorldTransform().getOpenGLMatrix(tr);
-    *mesh = hair->elements[element].mesh;
+    *stats = bt_ragdoll_pool.stats;
 }
 
 
-/* *****************************************************************************
- * ************************  RAGDOLL DATA  *************************************
- * ****************************************************************************/
-
 bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf, struct rd_setup_s *setup)
 {
     // No entity, setup or body count overflow - bypass function.
 
-    if(!physics || !setup || (setup->body_count > physics->objects_count))
+    if(!physics || !bf || !setup || (setup->body_count > physics->objects_count))
     {
         return false;
     }
 
-    bool result = true;
-
-    // If ragdoll already exists, overwrite it with new one.
-
-    if(physics->bt_joint_count > 0)
-    {
-        result = Ragdoll_Delete(physics);
-    }
-
-    // Setup bodies.
-    physics->bt_joint_count = 0;
-    // update current character animation and full fix body to avoid starting ragdoll partially inside the wall or floor...
     for(uint32_t i = 0; i < setup->body_count; i++)
     {
         if(physics->bt_body[i] == NULL)
         {
-            result = false;
-            continue;   // If body is absent, return false and bypass this body setup.
+            return false;   // If body is absent, there is nothing to lend the shape.
         }
+    }
 
-        btVector3 inertia (0.0, 0.0, 0.0);
-        btScalar  mass = setup->body_setup[i].mass;
-
-        if(physics->bt_body[i]->isInWorld())
-        {
-            bt_engine_dynamicsWorld->removeRigidBody(physics->bt_body[i]);
-        }
-        physics->bt_body[i]->getCollisionShape()->calculateLocalInertia(mass, inertia);
-        physics->bt_body[i]->setMassProps(mass, inertia);
-
-        physics->bt_body[i]->updateInertiaTensor();
-        physics->bt_body[i]->clearForces();
-
-        physics->bt_body[i]->setLinearFactor (btVector3(1.0, 1.0, 1.0));
-        physics->bt_body[i]->setAngularFactor(btVector3(1.0, 1.0, 1.0));
-
-        physics->bt_body[i]->setDamping(setup->body_setup[i].damping[0], setup->body_setup[i].damping[1]);
-        physics->bt_body[i]->setRestitution(setup->body_setup[i].restitution);
-        physics->bt_body[i]->setFriction(setup->body_setup[i].friction);
-        physics->bt_body[i]->setSleepingThresholds(RD_DEFAULT_SLEEPING_THRESHOLD, RD_DEFAULT_SLEEPING_THRESHOLD);
+    // If ragdoll already exists, overwrite it with new one.
+    Ragdoll_Delete(physics);
 
-        if(bf->bone_tags[i].parent == NULL)
+    // Freeze the oldest ones over the limit, then take a free ragdoll of this
+    // model, or build one if the pool has none.
+    while(bt_ragdoll_pool.stats.active >= RD_MAX_ACTIVE)
+    {
+        bt_ragdoll_p oldest = NULL;
+        for(bt_ragdoll_p rd = bt_ragdoll_pool.list; rd; rd = rd->next)
         {
-            btScalar r = getInnerBBRadius(bf->bone_tags[i].mesh_base->bb_min, bf->bone_tags[i].mesh_base->bb_max);
-            physics->bt_body[i]->setCcdMotionThreshold(0.8 * r);
-            physics->bt_body[i]->setCcdSweptSphereRadius(r);
+            oldest = (rd->owner && (!oldest || (rd->order < oldest->order))) ? (rd) : (oldest);
         }
+        oldest->owner->ragdoll_frozen = 0x01;
+        BT_RagdollRelease(oldest);
+        bt_ragdoll_pool.stats.frozen++;
     }
 
-    for(uint32_t i = 0; i < setup->body_count; i++)
+    uint32_t count, hash = BT_RagdollSetupHash(setup);
+    bt_ragdoll_p rd = BT_RagdollFind(bf->animations.model, hash, &count);
+    rd = (rd) ? (rd) : (BT_RagdollBuild(bf, setup, hash));
+    if(!rd)
     {
-        bt_engine_dynamicsWorld->addRigidBody(physics->bt_body[i], btBroadphaseProxy::CharacterFilter, btBroadphaseProxy::CharacterFilter | btBroadphaseProxy::StaticFilter | btBroadphaseProxy::KinematicFilter);
-        physics->bt_body[i]->activate();
-        physics->bt_body[i]->setLinearVelocity(btVector3(0.0, 0.0, 0.0));
+        return false;
     }
 
-    // Setup constraints.
-    physics->bt_joint_count = setup->joint_count;
-    physics->bt_joints = (btTypedConstraint**)calloc(physics->bt_joint_count, sizeof(btTypedConstraint*));
-
-    for(int i = 0; i < physics->bt_joint_count; i++)
+    for(uint16_t i = 0; i < rd->body_count; i++)
     {
-        if( (setup->joint_setup[i].body_index >= setup->body_count) ||
-            (physics->bt_body[setup->joint_setup[i].body_index] == NULL) )
-        {
-            result = false;
-            break;       // If body 1 or body 2 are absent, return false and bypass this joint.
-        }
+        btRigidBody *body = rd->bodies[i];
+        btRigidBody *kinematic = physics->bt_body[i];
+        btVector3 inertia(0.0, 0.0, 0.0);
 
-        btTransform localA, localB;
-        ss_bone_tag_p btB = bf->bone_tags + setup->joint_setup[i].body_index;
-        ss_bone_tag_p btA = btB->parent;
-        if(btA == NULL)
+        if(kinematic->isInWorld())
         {
-            result = false;
-            break;
-        }
-#if 0
-        localA.setFromOpenGLMatrix(btB->local_transform);
-        localB.setIdentity();
-#else
-        localA.getBasis().setEulerZYX(setup->joint_setup[i].body1_angle[0], setup->joint_setup[i].body1_angle[1], setup->joint_setup[i].body1_angle[2]);
-        //localA.setOrigin(setup->joint_setup[i].body1_offset);
-        localA.setOrigin(btVector3(btB->local_transform[12 + 0], btB->local_transform[12 + 1], btB->local_transform[12 + 2]));
-
-        localB.getBasis().setEulerZYX(setup->joint_setup[i].body2_angle[0], setup->joint_setup[i].body2_angle[1], setup->joint_setup[i].body2_angle[2]);
-        //localB.setOrigin(setup->joint_setup[i].body2_offset);
-        localB.setOrigin(btVector3(0.0, 0.0, 0.0));
-#endif
-
-        switch(setup->joint_setup[i].joint_type)
-        {
-            case RD_CONSTRAINT_POINT:
-                {
-                    btPoint2PointConstraint* pointC = new btPoint2PointConstraint(*physics->bt_body[btA->index], *physics->bt_body[btB->index], localA.getOrigin(), localB.getOrigin());
-                    physics->bt_joints[i] = pointC;
-                }
-                break;
-
-            case RD_CONSTRAINT_HINGE:
-                {
-                    btHingeConstraint* hingeC = new btHingeConstraint(*physics->bt_body[btA->index], *physics->bt_body[btB->index], localA, localB);
-                    hingeC->setLimit(setup->joint_setup[i].joint_limit[0], setup->joint_setup[i].joint_limit[1], 0.9, 0.3, 0.3);
-                    physics->bt_joints[i] = hingeC;
-                }
-                break;
-
-            case RD_CONSTRAINT_CONE:
-                {
-                    btConeTwistConstraint* coneC = new btConeTwistConstraint(*physics->bt_body[btA->index], *physics->bt_body[btB->index], localA, localB);
-                    coneC->setLimit(setup->joint_setup[i].joint_limit[0], setup->joint_setup[i].joint_limit[1], setup->joint_setup[i].joint_limit[2], 0.9, 0.3, 0.7);
-                    physics->bt_joints[i] = coneC;
-                }
-                break;
+            bt_engine_dynamicsWorld->removeRigidBody(kinematic);
         }
+        body->setCollisionShape(kinematic->getCollisionShape());
+        body->getCollisionShape()->calculateLocalInertia(rd->masses[i], inertia);
+        body->setMassProps(rd->masses[i], inertia);
+        body->updateInertiaTensor();
+        body->setWorldTransform(kinematic->getWorldTransform());
+        body->setInterpolationWorldTransform(kinematic->getWorldTransform());
+        body->setLinearVelocity(btVector3(0.0, 0.0, 0.0));
+        body->setAngularVelocity(btVector3(0.0, 0.0, 0.0));
+        body->clearForces();
+        body->setUserPointer(kinematic->getUserPointer());
+        body->setUserIndex(kinematic->getUserIndex());
 
-        physics->bt_joints[i]->setParam(BT_CONSTRAINT_STOP_CFM, setup->joint_cfm, -1);
-        physics->bt_joints[i]->setParam(BT_CONSTRAINT_STOP_ERP, setup->joint_erp, -1);
-
-        physics->bt_joints[i]->setDbgDrawSize(64.0);
-        bt_engine_dynamicsWorld->addConstraint(physics->bt_joints[i], true);
+        rd->saved_bodies[i] = kinematic;
+        physics->bt_body[i] = body;
+        bt_engine_dynamicsWorld->addRigidBody(body, btBroadphaseProxy::CharacterFilter, btBroadphaseProxy::CharacterFilter | btBroadphaseProxy::StaticFilter | btBroadphaseProxy::KinematicFilter);
+        body->forceActivationState(ACTIVE_TAG);
+        body->setDeactivationTime(0.0);
     }
 
-    if(result == false)
+    for(uint16_t i = 0; i < rd->joint_count; i++)
     {
-        Ragdoll_Delete(physics);  // PARANOID: Clean up the mess, if something went wrong.
+        bt_engine_dynamicsWorld->addConstraint(rd->joints[i], true);
     }
 
+    rd->owner = physics;
+    rd->order = ++bt_ragdoll_pool.order;
+    physics->ragdoll = rd;
     physics->cont->collision_group = COLLISION_GROUP_DYNAMICS_NI;
+    bt_ragdoll_pool.stats.active++;
+    bt_ragdoll_pool.stats.armed++;
 
-    return result;
+    return true;
 }
 
 
 bool Ragdoll_Delete(struct physics_data_s *physics)
 {
-    if(physics->bt_joint_count == 0)
+    if(!physics->ragdoll && !physics->ragdoll_frozen)
     {
         return false;
     }
 
-    for(uint32_t i = 0; i < physics->bt_joint_count; i++)
-    {
-        if(physics->bt_joints[i])
-        {
-            bt_engine_dynamicsWorld->removeConstraint(physics->bt_joints[i]);
-            delete physics->bt_joints[i];
-            physics->bt_joints[i] = NULL;
-        }
-    }
-
-    for(uint32_t i = 0; i < physics->objects_count; i++)
+    if(physics->ragdoll)
     {
-        if(physics->bt_body[i]->isInWorld())
-        {
-            bt_engine_dynamicsWorld->removeRigidBody(physics->bt_body[i]);
-        }
-        physics->bt_body[i]->setMassProps(0, btVector3(0.0, 0.0, 0.0));
-        bt_engine_dynamicsWorld->addRigidBody(physics->bt_body[i], btBroadphaseProxy::KinematicFilter, btBroadphaseProxy::AllFilter);
+        BT_RagdollRelease(physics->ragdoll);
     }
-
-    free(physics->bt_joints);
-    physics->bt_joints = NULL;
-    physics->bt_joint_count = 0;
+    physics->ragdoll_frozen = 0x00;
     physics->cont->collision_group = COLLISION_GROUP_CHARACTERS;
 
     return true;
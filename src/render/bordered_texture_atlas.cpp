@@ -8,16 +8,22 @@
 
 #include "bordered_texture_atlas.h"
 
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_cpuinfo.h>
+#include <SDL2/SDL_rwops.h>
+#include <SDL2/SDL_thread.h>
 #include <assert.h>
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <zlib.h>
 
 #include "../core/gl_util.h"
 #include "../core/polygon.h"
-#include "bsp_tree_2d.h"
+#include "../core/system.h"
+#include "skyline_2d.h"
 #include "../vt/vt_level.h"
 
 #ifndef __APPLE__
@@ -50,6 +56,23 @@ static __inline GLuint NextPowerOf2(GLuint in)
 #define ARRAY_CAPACITY_INCREASE_STEP (32)
 #define WHITE_TEXTURE_INDEX          (0x8000)
 
+#define ATLAS_CACHE_MAGIC            (0x4341544FU)      // "OTAC"
+#define ATLAS_CACHE_VERSION          (2)                // pages are zlib packed
+#define ATLAS_MAX_THREADS            (8)
+#define ATLAS_TEXTURES_PER_THREAD    (64)               // don't wake threads for tiny pages
+
+/*!
+ * Shared state of the threads filling one result page. Every canonical texture of the page owns a separate rectangle (border included), so the threads never write the same pixels.
+ */
+struct atlas_fill_job_s
+{
+    const bordered_texture_atlas   *atlas;
+    GLubyte                        *data;
+    const unsigned long            *textures;
+    int                             textures_count;
+    SDL_atomic_t                    next;
+};
+
 /*!
  * The bordered texture atlas used by the borderedTextureAtlas_CompareCanonicalTextureSizes function. Sadly, qsort does not allow passing this context through as a parameter, and the nonstandard extensions qsort_r/qsort_s which do are not supported on MinGW, so this has to be done as a global variable.
  */
@@ -86,7 +109,7 @@ int bordered_texture_atlas::compareCanonicalTextureSizes(const void *parameter1,
 
 /*!
  * Lays out the texture data and switches the atlas to laid out mode. This makes
- * use of a bsp_tree_2d to handle all the really annoying stuff.
+ * use of a skyline_2d to handle all the really annoying stuff.
  */
 void bordered_texture_atlas::layOutTextures()
 {
@@ -102,7 +125,7 @@ void bordered_texture_atlas::layOutTextures()
     // Find positions for the canonical textures
     number_result_pages = 0;
     result_page_height = NULL;
-    bsp_tree_2d_p *result_pages = NULL;
+    skyline_2d_p *result_pages = NULL;
 
     for (unsigned long texture = 0; texture < number_canonical_object_textures; texture++)
     {
@@ -112,11 +135,11 @@ void bordered_texture_atlas::layOutTextures()
         bool found_place = 0;
         for (unsigned long page = 0; page < number_result_pages; page++)
         {
-            found_place = BSPTree2D_FindSpaceFor(result_pages[page],
-                                                 canonical.width + 2*border_width,
-                                                 canonical.height + 2*border_width,
-                                                 &(canonical.new_x_with_border),
-                                                 &(canonical.new_y_with_border));
+            found_place = Skyline2D_FindSpaceFor(result_pages[page],
+                                                  canonical.width + 2*border_width,
+                                                  canonical.height + 2*border_width,
+                                                  &(canonical.new_x_with_border),
+                                                  &(canonical.new_y_with_border));
             if (found_place)
             {
                 canonical.new_page = page;
@@ -132,12 +155,16 @@ void bordered_texture_atlas::layOutTextures()
         // No existing page has enough remaining space so open new one.
         if (!found_place)
         {
+            skyline_2d_p *new_pages = (skyline_2d_p *) realloc(result_pages, sizeof(skyline_2d_p) * (number_result_pages + 1));
+            result_pages = (new_pages) ? (new_pages) : (result_pages);
+            unsigned *new_heights = (unsigned *) realloc(result_page_height, sizeof(unsigned) * (number_result_pages + 1));
+            result_page_height = (new_heights) ? (new_heights) : (result_page_height);
+            if (!new_pages || !new_heights)
+                Sys_Error("Texture atlas: out of memory for page %lu", number_result_pages);
             number_result_pages += 1;
-            result_pages = (bsp_tree_2d_p *) realloc(result_pages, sizeof(bsp_tree_2d_p) * number_result_pages);
-            result_pages[number_result_pages - 1] = BSPTree2D_Create(result_page_width, result_page_width);
-            result_page_height = (unsigned *) realloc(result_page_height, sizeof(unsigned) * number_result_pages);
+            result_pages[number_result_pages - 1] = Skyline2D_Create(result_page_width, result_page_width);
 
-            BSPTree2D_FindSpaceFor(result_pages[number_result_pages - 1],
+            Skyline2D_FindSpaceFor(result_pages[number_result_pages - 1],
                                    canonical.width + 2*border_width,
                                    canonical.height + 2*border_width,
                                    &(canonical.new_x_with_border),
@@ -158,17 +185,129 @@ void bordered_texture_atlas::layOutTextures()
     // Cleanup
     delete [] sorted_indices;
     for (unsigned long i = 0; i < number_result_pages; i++)
-        BSPTree2D_Destroy(result_pages[i]);
+        Skyline2D_Destroy(result_pages[i]);
     free(result_pages);
 }
 
+void bordered_texture_atlas::bucketPageTextures()
+{
+    page_textures = new unsigned long[number_canonical_object_textures];
+    page_textures_first = new unsigned long[number_result_pages + 1];
+
+    // Counting sort by page; keeps the size order of the textures inside the page.
+    memset(page_textures_first, 0, sizeof(unsigned long) * (number_result_pages + 1));
+    for (unsigned long texture = 0; texture < number_canonical_object_textures; texture++)
+        page_textures_first[canonical_object_textures[texture].new_page + 1]++;
+    for (unsigned long page = 0; page < number_result_pages; page++)
+        page_textures_first[page + 1] += page_textures_first[page];
+
+    unsigned long *fill = new unsigned long[number_result_pages];
+    memcpy(fill, page_textures_first, sizeof(unsigned long) * number_result_pages);
+    for (unsigned long texture = 0; texture < number_canonical_object_textures; texture++)
+        page_textures[fill[canonical_object_textures[texture].new_page]++] = texture;
+    delete [] fill;
+}
+
+/*!
+ * FNV-1a over 32 bit words. Covers the layout input (canonical textures, border, page width) and all the source pixels, so edited level files never pick up a stale cache.
+ */
+uint32_t bordered_texture_atlas::calculateCacheHash() const
+{
+    uint32_t hash = 2166136261U;
+#define ATLAS_HASH(value) hash = (hash ^ (uint32_t)(value)) * 16777619U
+
+    ATLAS_HASH(ATLAS_CACHE_VERSION);
+    ATLAS_HASH(border_width);
+    ATLAS_HASH(result_page_width);
+    ATLAS_HASH(number_canonical_object_textures);
+    for (unsigned long i = 0; i < number_canonical_object_textures; i++)
+    {
+        const canonical_object_texture &canonical = canonical_object_textures[i];
+        ATLAS_HASH((canonical.width << 24) | (canonical.height << 16) | canonical.original_page);
+        ATLAS_HASH((canonical.original_x << 8) | canonical.original_y);
+    }
+
+    ATLAS_HASH(number_original_pages);
+    for (unsigned long page = 0; page < number_original_pages; page++)
+    {
+        const uint32_t *pixels = &original_pages[page].pixels[0][0];
+        for (unsigned i = 0; i < 256 * 256; i++)
+            ATLAS_HASH(pixels[i]);
+    }
+#undef ATLAS_HASH
+
+    return hash;
+}
+
+bool bordered_texture_atlas::readCacheLayout()
+{
+    SDL_RWops *f = SDL_RWFromFile(cache_file, "rb");
+    if (!f)
+        return false;
+
+    bool ok = false;
+    uint32_t header[7];
+    if ((SDL_RWread(f, header, sizeof(header), 1) == 1) &&
+        (header[0] == ATLAS_CACHE_MAGIC) &&
+        (header[1] == ATLAS_CACHE_VERSION) &&
+        (header[2] == cache_hash) &&
+        (header[3] == (uint32_t)border_width) &&
+        (header[4] == result_page_width) &&
+        (header[5] == number_canonical_object_textures) &&
+        (header[6] > 0))
+    {
+        number_result_pages = header[6];
+        result_page_height = (unsigned *) malloc(sizeof(unsigned) * number_result_pages);
+        ok = (result_page_height != NULL);
+        for (unsigned long page = 0; ok && (page < number_result_pages); page++)
+        {
+            uint32_t height = 0;
+            ok = (SDL_RWread(f, &height, sizeof(height), 1) == 1) && (height > 0) && (height <= result_page_width);
+            result_page_height[page] = height;
+        }
+
+        for (unsigned long i = 0; ok && (i < number_canonical_object_textures); i++)
+        {
+            canonical_object_texture &canonical = canonical_object_textures[i];
+            uint32_t place[3];
+            ok = (SDL_RWread(f, place, sizeof(place), 1) == 1) && (place[0] < number_result_pages);
+            canonical.new_page = place[0];
+            canonical.new_x_with_border = place[1];
+            canonical.new_y_with_border = place[2];
+        }
+
+        // Every page is a packed size and the packed pixels; a cut off file is rejected here, so it is written again.
+        Sint64 file_size = SDL_RWsize(f);
+        cache_pixels_offset = (long)SDL_RWtell(f);
+        for (unsigned long page = 0; ok && (page < number_result_pages); page++)
+        {
+            uint32_t packed_size = 0;
+            ok = (SDL_RWread(f, &packed_size, sizeof(packed_size), 1) == 1) &&
+                 (SDL_RWtell(f) + (Sint64)packed_size <= file_size) &&
+                 (SDL_RWseek(f, packed_size, RW_SEEK_CUR) >= 0);
+        }
+        ok = ok && (SDL_RWtell(f) == file_size);
+
+        if (!ok)
+        {
+            free(result_page_height);
+            result_page_height = NULL;
+            number_result_pages = 0;
+        }
+    }
+
+    SDL_RWclose(f);
+    return ok;
+}
+
 bordered_texture_atlas::bordered_texture_atlas(int border,
                                                size_t page_count,
                                                const tr4_textile32_t *pages,
                                                size_t object_texture_count,
                                                const tr4_object_texture_t *object_textures,
                                                size_t sprite_texture_count,
-                                               const tr_sprite_texture_t *sprite_textures)
+                                               const tr_sprite_texture_t *sprite_textures,
+                                               const char *cache_path)
 : border_width(border),
 number_result_pages(0),
 result_page_width(0),
@@ -181,7 +320,13 @@ number_sprite_textures(0),
 canonical_textures_for_sprite_textures(NULL),
 number_canonical_object_textures(0),
 canonical_object_textures(NULL),
-textures_indexes(NULL)
+textures_indexes(NULL),
+page_textures(NULL),
+page_textures_first(NULL),
+cache_file(NULL),
+cache_hash(0),
+cache_valid(false),
+cache_pixels_offset(0)
 {
     GLint max_texture_edge_length = 0;
     qglGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_edge_length);
@@ -212,7 +357,18 @@ textures_indexes(NULL)
         addSpriteTexture(sprite_textures[i]);
     }
 
-    layOutTextures();
+    if (cache_path)
+    {
+        cache_file = strdup(cache_path);
+        cache_hash = calculateCacheHash();
+        cache_valid = readCacheLayout();
+    }
+
+    if (!cache_valid)
+    {
+        layOutTextures();
+    }
+    bucketPageTextures();
 }
 
 bordered_texture_atlas::~bordered_texture_atlas()
@@ -220,8 +376,11 @@ bordered_texture_atlas::~bordered_texture_atlas()
     delete [] file_object_textures;
     delete [] canonical_textures_for_sprite_textures;
     delete [] canonical_object_textures;
+    delete [] page_textures;
+    delete [] page_textures_first;
     original_pages = NULL;
     free(result_page_height);
+    free(cache_file);
 }
 
 void bordered_texture_atlas::addObjectTexture(const tr4_object_texture_t &texture)
@@ -493,6 +652,175 @@ unsigned long bordered_texture_atlas::getNumAtlasPages() const
     return number_result_pages;
 }
 
+void bordered_texture_atlas::blitCanonicalTexture(GLubyte *data, unsigned long texture) const
+{
+    const canonical_object_texture &canonical = canonical_object_textures[texture];
+
+    if(canonical.original_page == WHITE_TEXTURE_INDEX)
+    {
+        uint32_t white_pixels[1] = {0xFFFFFFFFU};
+        // Add top border
+        for (int border = 0; border < border_width; border++)
+        {
+            unsigned x = canonical.new_x_with_border;
+            unsigned y = canonical.new_y_with_border + border;
+
+            // expand top-left pixel
+            memset_pattern4(&data[(y*result_page_width + x) * 4],
+                   white_pixels, 4 * border_width);
+            // copy top line
+            memset_pattern4(&data[(y*result_page_width + x + border_width) * 4],
+                   white_pixels, canonical.width * 4);
+            // expand top-right pixel
+            memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
+                   white_pixels, 4 * border_width);
+        }
+
+        // Copy main content
+        for (int line = 0; line < canonical.height; line++)
+        {
+            unsigned x = canonical.new_x_with_border;
+            unsigned y = canonical.new_y_with_border + border_width + line;
+
+            // expand left pixel
+            memset_pattern4(&data[(y*result_page_width + x) * 4],
+                   white_pixels, 4 * border_width);
+            // copy line
+            memset_pattern4(&data[(y*result_page_width + x + border_width) * 4],
+                   white_pixels, canonical.width * 4);
+            // expand right pixel
+            memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
+                   white_pixels, 4 * border_width);
+        }
+
+        // Add bottom border
+        for (int border = 0; border < border_width; border++)
+        {
+            unsigned x = canonical.new_x_with_border;
+            unsigned y = canonical.new_y_with_border + canonical.height + border_width + border;
+
+            // expand bottom-left pixel
+            memset_pattern4(&data[(y*result_page_width + x) * 4],
+                   white_pixels, 4 * border_width);
+            // copy bottom line
+            memset_pattern4(&data[(y*result_page_width + x + border_width) * 4],
+                   white_pixels, canonical.width * 4);
+            // expand bottom-right pixel
+            memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
+                   white_pixels, 4 * border_width);
+        }
+    }
+    else
+    {
+        const char *original = (char *) original_pages[canonical.original_page].pixels;
+        // Add top border
+        for (int border = 0; border < border_width; border++)
+        {
+            unsigned x = canonical.new_x_with_border;
+            unsigned y = canonical.new_y_with_border + border;
+            unsigned old_x = canonical.original_x;
+            unsigned old_y = canonical.original_y;
+
+            // expand top-left pixel
+            memset_pattern4(&data[(y*result_page_width + x) * 4],
+                   &(original[(old_y * 256 + old_x) * 4]),
+                   4 * border_width);
+            // copy top line
+            memcpy(&data[(y*result_page_width + x + border_width) * 4],
+                   &original[(old_y * 256 + old_x) * 4],
+                   canonical.width * 4);
+            // expand top-right pixel
+            memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
+                   &(original[(old_y * 256 + old_x + canonical.width) * 4]),
+                   4 * border_width);
+        }
+
+        // Copy main content
+        for (int line = 0; line < canonical.height; line++)
+        {
+            unsigned x = canonical.new_x_with_border;
+            unsigned y = canonical.new_y_with_border + border_width + line;
+            unsigned old_x = canonical.original_x;
+            unsigned old_y = canonical.original_y + line;
+
+            // expand left pixel
+            memset_pattern4(&data[(y*result_page_width + x) * 4],
+                   &(original[(old_y * 256 + old_x) * 4]),
+                   4 * border_width);
+            // copy line
+            memcpy(&data[(y*result_page_width + x + border_width) * 4],
+                   &original[(old_y * 256 + old_x) * 4],
+                   canonical.width * 4);
+            // expand right pixel
+            memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
+                   &(original[(old_y * 256 + old_x + canonical.width) * 4]),
+                   4 * border_width);
+        }
+
+        // Add bottom border
+        for (int border = 0; border < border_width; border++)
+        {
+            unsigned x = canonical.new_x_with_border;
+            unsigned y = canonical.new_y_with_border + canonical.height + border_width + border;
+            unsigned old_x = canonical.original_x;
+            unsigned old_y = canonical.original_y + canonical.height;
+
+            // expand bottom-left pixel
+            memset_pattern4(&data[(y*result_page_width + x) * 4],
+                   &(original[(old_y * 256 + old_x) * 4]),
+                   4 * border_width);
+            // copy bottom line
+            memcpy(&data[(y*result_page_width + x + border_width) * 4],
+                   &original[(old_y * 256 + old_x) * 4],
+                   canonical.width * 4);
+            // expand bottom-right pixel
+            memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
+                   &(original[(old_y * 256 + old_x + canonical.width) * 4]),
+                   4 * border_width);
+        }
+    }
+}
+
+int bordered_texture_atlas::fillPageThread(void *data)
+{
+    struct atlas_fill_job_s *job = (struct atlas_fill_job_s *) data;
+    int i;
+    while ((i = SDL_AtomicAdd(&job->next, 1)) < job->textures_count)
+    {
+        job->atlas->blitCanonicalTexture(job->data, job->textures[i]);
+    }
+    return 0;
+}
+
+void bordered_texture_atlas::fillPage(GLubyte *data, unsigned long page) const
+{
+    struct atlas_fill_job_s job;
+    SDL_Thread *threads[ATLAS_MAX_THREADS];
+    int threads_count = SDL_GetCPUCount() - 1;
+
+    job.atlas = this;
+    job.data = data;
+    job.textures = page_textures + page_textures_first[page];
+    job.textures_count = (int)(page_textures_first[page + 1] - page_textures_first[page]);
+    SDL_AtomicSet(&job.next, 0);
+
+    if (threads_count > job.textures_count / ATLAS_TEXTURES_PER_THREAD)
+        threads_count = job.textures_count / ATLAS_TEXTURES_PER_THREAD;
+    if (threads_count > ATLAS_MAX_THREADS)
+        threads_count = ATLAS_MAX_THREADS;
+
+    for (int i = 0; i < threads_count; i++)
+    {
+        threads[i] = SDL_CreateThread(fillPageThread, "atlas", &job);
+    }
+    fillPageThread(&job);           // the calling thread works too
+    for (int i = 0; i < threads_count; i++)
+    {
+        if (threads[i])
+            SDL_WaitThread(threads[i], NULL);
+    }
+}
+
 void bordered_texture_atlas::createTextures(GLuint *textureNames)
 {
     GLubyte *data = (GLubyte *) malloc(4 * result_page_width * result_page_width);
@@ -501,137 +829,59 @@ void bordered_texture_atlas::createTextures(GLuint *textureNames)
 
     textures_indexes = textureNames;
 
-    for (unsigned long page = 0; page < number_result_pages; page++)
+    SDL_RWops *cache_in = NULL;
+    SDL_RWops *cache_out = NULL;
+    uLong packed_capacity = compressBound(4 * result_page_width * result_page_width);
+    Bytef *packed = (cache_file) ? ((Bytef *) malloc(packed_capacity)) : (NULL);
+    if (cache_valid && packed)
     {
-        for (unsigned long texture = 0; texture < number_canonical_object_textures; texture++)
+        cache_in = SDL_RWFromFile(cache_file, "rb");
+        if (cache_in && (SDL_RWseek(cache_in, cache_pixels_offset, RW_SEEK_SET) < 0))
         {
-            const canonical_object_texture &canonical = canonical_object_textures[texture];
-            if (canonical.new_page != page)
-                continue;
-
-            if(canonical.original_page == WHITE_TEXTURE_INDEX)
-            {
-                uint32_t white_pixels[1] = {0xFFFFFFFFU};
-                // Add top border
-                for (int border = 0; border < border_width; border++)
-                {
-                    unsigned x = canonical.new_x_with_border;
-                    unsigned y = canonical.new_y_with_border + border;
-
-                    // expand top-left pixel
-                    memset_pattern4(&data[(y*result_page_width + x) * 4],
-                           white_pixels, 4 * border_width);
-                    // copy top line
-                    memset_pattern4(&data[(y*result_page_width + x + border_width) * 4],
-                           white_pixels, canonical.width * 4);
-                    // expand top-right pixel
-                    memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
-                           white_pixels, 4 * border_width);
-                }
+            SDL_RWclose(cache_in);
+            cache_in = NULL;
+        }
+    }
+    if (packed && !cache_in)
+    {
+        cache_out = openCacheForWrite();
+    }
 
-                // Copy main content
-                for (int line = 0; line < canonical.height; line++)
-                {
-                    unsigned x = canonical.new_x_with_border;
-                    unsigned y = canonical.new_y_with_border + border_width + line;
-
-                    // expand left pixel
-                    memset_pattern4(&data[(y*result_page_width + x) * 4],
-                           white_pixels, 4 * border_width);
-                    // copy line
-                    memset_pattern4(&data[(y*result_page_width + x + border_width) * 4],
-                           white_pixels, canonical.width * 4);
-                    // expand right pixel
-                    memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
-                           white_pixels, 4 * border_width);
-                }
+    for (unsigned long page = 0; page < number_result_pages; page++)
+    {
+        GLsizei page_size = 4 * result_page_width * result_page_height[page];
+        bool page_ready = false;
 
-                // Add bottom border
-                for (int border = 0; border < border_width; border++)
-                {
-                    unsigned x = canonical.new_x_with_border;
-                    unsigned y = canonical.new_y_with_border + canonical.height + border_width + border;
-
-                    // expand bottom-left pixel
-                    memset_pattern4(&data[(y*result_page_width + x) * 4],
-                           white_pixels, 4 * border_width);
-                    // copy bottom line
-                    memset_pattern4(&data[(y*result_page_width + x + border_width) * 4],
-                           white_pixels, canonical.width * 4);
-                    // expand bottom-right pixel
-                    memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
-                           white_pixels, 4 * border_width);
-                }
-            }
-            else
+        if (cache_in)
+        {
+            page_ready = readCachePage(cache_in, data, page_size, packed, packed_capacity);
+            if (!page_ready)
             {
-                const char *original = (char *) original_pages[canonical.original_page].pixels;
-                // Add top border
-                for (int border = 0; border < border_width; border++)
+                // Damaged cache: write it again, the pages already uploaded are filled once more for it.
+                SDL_RWclose(cache_in);
+                cache_in = NULL;
+                cache_out = openCacheForWrite();
+                for (unsigned long done = 0; cache_out && (done < page); done++)
                 {
-                    unsigned x = canonical.new_x_with_border;
-                    unsigned y = canonical.new_y_with_border + border;
-                    unsigned old_x = canonical.original_x;
-                    unsigned old_y = canonical.original_y;
-
-                    // expand top-left pixel
-                    memset_pattern4(&data[(y*result_page_width + x) * 4],
-                           &(original[(old_y * 256 + old_x) * 4]),
-                           4 * border_width);
-                    // copy top line
-                    memcpy(&data[(y*result_page_width + x + border_width) * 4],
-                           &original[(old_y * 256 + old_x) * 4],
-                           canonical.width * 4);
-                    // expand top-right pixel
-                    memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
-                           &(original[(old_y * 256 + old_x + canonical.width) * 4]),
-                           4 * border_width);
+                    fillPage(data, done);
+                    if (!writeCachePage(cache_out, data, 4 * result_page_width * result_page_height[done], packed, packed_capacity))
+                    {
+                        SDL_RWclose(cache_out);
+                        cache_out = NULL;
+                    }
                 }
+            }
+        }
 
-                // Copy main content
-                for (int line = 0; line < canonical.height; line++)
-                {
-                    unsigned x = canonical.new_x_with_border;
-                    unsigned y = canonical.new_y_with_border + border_width + line;
-                    unsigned old_x = canonical.original_x;
-                    unsigned old_y = canonical.original_y + line;
-
-                    // expand left pixel
-                    memset_pattern4(&data[(y*result_page_width + x) * 4],
-                           &(original[(old_y * 256 + old_x) * 4]),
-                           4 * border_width);
-                    // copy line
-                    memcpy(&data[(y*result_page_width + x + border_width) * 4],
-                           &original[(old_y * 256 + old_x) * 4],
-                           canonical.width * 4);
-                    // expand right pixel
-                    memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
-                           &(original[(old_y * 256 + old_x + canonical.width) * 4]),
-                           4 * border_width);
-                }
+        if (!page_ready)
+        {
+            fillPage(data, page);
+        }
 
-                // Add bottom border
-                for (int border = 0; border < border_width; border++)
-                {
-                    unsigned x = canonical.new_x_with_border;
-                    unsigned y = canonical.new_y_with_border + canonical.height + border_width + border;
-                    unsigned old_x = canonical.original_x;
-                    unsigned old_y = canonical.original_y + canonical.height;
-
-                    // expand bottom-left pixel
-                    memset_pattern4(&data[(y*result_page_width + x) * 4],
-                           &(original[(old_y * 256 + old_x) * 4]),
-                           4 * border_width);
-                    // copy bottom line
-                    memcpy(&data[(y*result_page_width + x + border_width) * 4],
-                           &original[(old_y * 256 + old_x) * 4],
-                           canonical.width * 4);
-                    // expand bottom-right pixel
-                    memset_pattern4(&data[(y*result_page_width + x + border_width + canonical.width) * 4],
-                           &(original[(old_y * 256 + old_x + canonical.width) * 4]),
-                           4 * border_width);
-                }
-            }
+        if (cache_out && !writeCachePage(cache_out, data, page_size, packed, packed_capacity))
+        {
+            SDL_RWclose(cache_out);
+            cache_out = NULL;
         }
 
         qglBindTexture(GL_TEXTURE_2D, textureNames[page]);
@@ -690,5 +940,70 @@ void bordered_texture_atlas::createTextures(GLuint *textureNames)
         qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     }
 
+    if (cache_in)
+    {
+        SDL_RWclose(cache_in);
+    }
+    if (cache_out)
+    {
+        uint32_t magic = ATLAS_CACHE_MAGIC;
+        if (SDL_RWseek(cache_out, 0, RW_SEEK_SET) == 0)
+        {
+            SDL_RWwrite(cache_out, &magic, sizeof(magic), 1);
+        }
+        SDL_RWclose(cache_out);
+    }
+
+    free(packed);
     free(data);
 }
+
+/*!
+ * Starts a new cache file with the header and the layout; the magic is written last, so an interrupted write never looks valid.
+ */
+SDL_RWops *bordered_texture_atlas::openCacheForWrite() const
+{
+    uint32_t header[7] = {0, ATLAS_CACHE_VERSION, cache_hash, (uint32_t)border_width, result_page_width,
+                          (uint32_t)number_canonical_object_textures, (uint32_t)number_result_pages};
+    SDL_RWops *f = SDL_RWFromFile(cache_file, "wb");
+    bool ok = (f != NULL) && (SDL_RWwrite(f, header, sizeof(header), 1) == 1);
+    for (unsigned long page = 0; ok && (page < number_result_pages); page++)
+    {
+        uint32_t height = result_page_height[page];
+        ok = (SDL_RWwrite(f, &height, sizeof(height), 1) == 1);
+    }
+    for (unsigned long i = 0; ok && (i < number_canonical_object_textures); i++)
+    {
+        const canonical_object_texture &canonical = canonical_object_textures[i];
+        uint32_t place[3] = {(uint32_t)canonical.new_page, canonical.new_x_with_border, canonical.new_y_with_border};
+        ok = (SDL_RWwrite(f, place, sizeof(place), 1) == 1);
+    }
+    if (!ok && f)
+    {
+        SDL_RWclose(f);
+        f = NULL;
+    }
+    return f;
+}
+
+bool bordered_texture_atlas::readCachePage(SDL_RWops *f, GLubyte *data, uLong size, Bytef *packed, uLong packed_capacity) const
+{
+    uint32_t packed_size = 0;
+    uLongf unpacked_size = size;
+    return (SDL_RWread(f, &packed_size, sizeof(packed_size), 1) == 1) &&
+           (packed_size > 0) && (packed_size <= packed_capacity) &&
+           (SDL_RWread(f, packed, packed_size, 1) == 1) &&
+           (uncompress(data, &unpacked_size, packed, packed_size) == Z_OK) &&
+           (unpacked_size == size);
+}
+
+bool bordered_texture_atlas::writeCachePage(SDL_RWops *f, const GLubyte *data, uLong size, Bytef *packed, uLong packed_capacity) const
+{
+    uLongf packed_size = packed_capacity;
+    uint32_t packed_size32;
+    if (compress2(packed, &packed_size, data, size, Z_BEST_SPEED) != Z_OK)
+        return false;
+    packed_size32 = (uint32_t)packed_size;
+    return (SDL_RWwrite(f, &packed_size32, sizeof(packed_size32), 1) == 1) &&
+           (SDL_RWwrite(f, packed, packed_size, 1) == 1);
+}
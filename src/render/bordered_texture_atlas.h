@@ -29,6 +29,8 @@
 #include <stdint.h>
 #include <SDL2/SDL_platform.h>
 #include <SDL2/SDL_opengl.h>
+#include <SDL2/SDL_rwops.h>
+#include <zlib.h>
 #include "../core/polygon.h"
 #include "../vt/tr_types.h"
 
@@ -103,9 +105,46 @@ class bordered_texture_atlas
     
     GLuint *textures_indexes;
     
+    // Canonical textures bucketed by result page: textures of page N are page_textures[page_textures_first[N] .. page_textures_first[N + 1]).
+    unsigned long *page_textures;
+    unsigned long *page_textures_first;
+    
+    // Optional disk cache of the layout and the result page pixels.
+    char *cache_file;
+    uint32_t cache_hash;
+    bool cache_valid;
+    long cache_pixels_offset;
+    
     /*! Lays out the texture data and switches the atlas to laid out mode. */
     void layOutTextures();
     
+    /*! Sorts canonical textures into per page buckets, needed by createTextures. */
+    void bucketPageTextures();
+    
+    /*! Copies one canonical texture with its borders into the result page data. */
+    void blitCanonicalTexture(GLubyte *data, unsigned long texture) const;
+    
+    /*! Fills all canonical textures of one result page, split between worker threads. */
+    void fillPage(GLubyte *data, unsigned long page) const;
+    
+    /*! Worker entry for fillPage. */
+    static int fillPageThread(void *data);
+    
+    /*! Hash of everything the layout and the page pixels depend on. */
+    uint32_t calculateCacheHash() const;
+    
+    /*! Restores the layout from the cache file; returns false if there is no cache, it is outdated or cut off. */
+    bool readCacheLayout();
+    
+    /*! Creates the cache file and writes the layout; the pages follow with writeCachePage. */
+    SDL_RWops *openCacheForWrite() const;
+    
+    /*! Reads and unpacks one result page; false if the cache is damaged. */
+    bool readCachePage(SDL_RWops *f, GLubyte *data, uLong size, Bytef *packed, uLong packed_capacity) const;
+    
+    /*! Packs and writes one result page. */
+    bool writeCachePage(SDL_RWops *f, const GLubyte *data, uLong size, Bytef *packed, uLong packed_capacity) const;
+    
     /*! For sorting: Compares two different textures and sorts them by size. */
     static int compareCanonicalTextureSizes(const void *parameter1, const void *parameter2);
     
@@ -119,6 +158,7 @@ public:
     /*!
      * Create a new Bordered texture atlas with the specified border width and textures. This lays out all the data for the textures, but does not upload anything to OpenGL yet.
      * @param border The border width around each texture.
+     * @param cache_file If not NULL, the layout and page pixels are read from / written to this file, so the next load of the same level skips packing.
      */
     bordered_texture_atlas(int border,
                            size_t page_count,
@@ -126,7 +166,8 @@ public:
                            size_t object_texture_count,
                            const tr4_object_texture_t *object_textures,
                            size_t sprite_texture_count,
-                           const tr_sprite_texture_t *sprite_textures);
+                           const tr_sprite_texture_t *sprite_textures,
+                           const char *cache_file = NULL);
     
     /*!
      * Destroy all contents of a bordered texture atlas. Using the atlas afterwards
@@ -44,6 +44,7 @@ void Cam_Init(camera_p cam)
     cam->frustum->parents_count = 0;
     cam->frustum->vertex = NULL;
     cam->frustum->planes = cam->clip_planes;
+    cam->frustum->packed_planes = NULL;
     cam->frustum->vertex = (float*)malloc(3 * 4 * sizeof(float));
 
     cam->prev_pos[0] = 0.0f;
@@ -393,6 +394,7 @@ void Cam_RecalcClipPlanes(camera_p cam)
     }
 
     vec3_add(cam->frustum->vertex, cam->transform.M4x4 + 12, cam->transform.M4x4 + 8);
+    Frustum_PackPlanes(cam->frustum, cam->packed_clip_planes);
 }
 
 /*
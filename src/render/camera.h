@@ -72,6 +72,7 @@ typedef struct camera_s
     engine_transform_s          transform;
     
     GLfloat                     clip_planes[16];        // frustum side clip planes
+    GLfloat                     packed_clip_planes[16] OT_ATTRIBUTE_ALIGN(16);  // the same, packed for box tests
     GLfloat                     prev_pos[3];            // previous camera position
     struct frustum_s           *frustum;                // camera frustum structure
     GLfloat                     dist_near;
@@ -12,6 +12,11 @@
 #include "frustum.h"
 #include "camera.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FRUSTUM_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
 
 #define SPLIT_EMPTY         (0x00)
 #define SPLIT_SUCCES        (0x01)
@@ -62,6 +67,7 @@ frustum_p CFrustumManager::CreateFrustum()
         ret->next = NULL;
         ret->parent = NULL;
         ret->planes = NULL;
+        ret->packed_planes = NULL;
         ret->vertex = NULL;
         ret->cam_pos = NULL;
         vec4_set_zero(ret->norm);
@@ -194,7 +200,8 @@ int CFrustumManager::SplitByPlane(frustum_p p, float n[4], float *buf)
 
 void CFrustumManager::GenClipPlanes(frustum_p p, struct camera_s *cam)
 {
-    if(m_allocated + p->vertex_count * 4 * sizeof(float) >= m_buffer_size)
+    uint32_t packed_size = 16 * ((p->vertex_count + 3) / 4);
+    if(m_allocated + (p->vertex_count * 4 + packed_size) * sizeof(float) >= m_buffer_size)
     {
         m_need_realloc = true;
     }
@@ -229,6 +236,7 @@ void CFrustumManager::GenClipPlanes(frustum_p p, struct camera_s *cam)
         }
 
         p->cam_pos = cam->transform.M4x4 + 12;
+        Frustum_PackPlanes(p, this->Alloc(packed_size));
     }
 }
 
@@ -653,7 +661,7 @@ bool Frustum_IsAABBVisible(float bbmin[3], float bbmax[3], struct frustum_s *fru
 }
 
 
-bool Frustum_IsOBBVisible(struct obb_s *obb, struct frustum_s *frustum)
+bool Frustum_IsOBBVisibleClip(struct obb_s *obb, struct frustum_s *frustum)
 {
     bool inside = true;
     float t;
@@ -675,11 +683,149 @@ bool Frustum_IsOBBVisible(struct obb_s *obb, struct frustum_s *frustum)
     return inside;
 }
 
+
+void Frustum_PackPlanes(struct frustum_s *frustum, float *packed)
+{
+    float *n = frustum->planes;
+    uint16_t groups = (frustum->vertex_count + 3) / 4;
+
+    vec4_set_zero(frustum->apex_plane);
+    for(uint16_t i = 0; i < 4 * groups; ++i)
+    {
+        float *g = packed + 16 * (i / 4) + i % 4;
+        if(i < frustum->vertex_count)
+        {
+            g[0] = n[4 * i + 0];
+            g[4] = n[4 * i + 1];
+            g[8] = n[4 * i + 2];
+            g[12] = n[4 * i + 3];
+            vec4_add(frustum->apex_plane, frustum->apex_plane, n + 4 * i);
+        }
+        else
+        {
+            // padding: no normal and always in front, never culls
+            g[0] = g[4] = g[8] = 0.0f;
+            g[12] = 1.0f;
+        }
+    }
+    frustum->packed_planes = packed;
+}
+
+/*
+ * Box by centre and half axes (axis * extent): its projected radius on a plane
+ * is |n.a0| + |n.a1| + |n.a2|, and it is out when it is behind any plane by
+ * more than that. Four planes go at a time through one packed group.
+ */
+static bool Frustum_IsBoxOutside(const float *packed, uint16_t groups, const float c[3], const float a[9])
+{
+#if FRUSTUM_HAVE_SSE2
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 eps = _mm_set1_ps(-SPLIT_EPSILON);
+    const __m128 cx = _mm_set1_ps(c[0]), cy = _mm_set1_ps(c[1]), cz = _mm_set1_ps(c[2]);
+    const __m128 a0x = _mm_set1_ps(a[0]), a0y = _mm_set1_ps(a[1]), a0z = _mm_set1_ps(a[2]);
+    const __m128 a1x = _mm_set1_ps(a[3]), a1y = _mm_set1_ps(a[4]), a1z = _mm_set1_ps(a[5]);
+    const __m128 a2x = _mm_set1_ps(a[6]), a2y = _mm_set1_ps(a[7]), a2z = _mm_set1_ps(a[8]);
+
+    for(; groups > 0; --groups, packed += 16)
+    {
+        __m128 nx = _mm_loadu_ps(packed + 0);
+        __m128 ny = _mm_loadu_ps(packed + 4);
+        __m128 nz = _mm_loadu_ps(packed + 8);
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), _mm_loadu_ps(packed + 12)));
+        __m128 r0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, a0x), _mm_mul_ps(ny, a0y)), _mm_mul_ps(nz, a0z));
+        __m128 r1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, a1x), _mm_mul_ps(ny, a1y)), _mm_mul_ps(nz, a1z));
+        __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, a2x), _mm_mul_ps(ny, a2y)), _mm_mul_ps(nz, a2z));
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_and_ps(r0, abs_mask), _mm_and_ps(r1, abs_mask)), _mm_and_ps(r2, abs_mask));
+        if(_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(d, r), eps)))
+        {
+            return true;
+        }
+    }
+#else
+    for(; groups > 0; --groups, packed += 16)
+    {
+        for(int i = 0; i < 4; ++i)
+        {
+            const float *n = packed + i;
+            float d = n[0] * c[0] + n[4] * c[1] + n[8] * c[2] + n[12];
+            float r = fabsf(n[0] * a[0] + n[4] * a[1] + n[8] * a[2]) +
+                      fabsf(n[0] * a[3] + n[4] * a[4] + n[8] * a[5]) +
+                      fabsf(n[0] * a[6] + n[4] * a[7] + n[8] * a[8]);
+            if(d + r < -SPLIT_EPSILON)
+            {
+                return true;
+            }
+        }
+    }
+#endif
+    return false;
+}
+
+
+static void Frustum_GetOBBAxes(struct obb_s *obb, float a[9])
+{
+    if(obb->transform)
+    {
+        vec3_mul_scalar(a + 0, obb->transform + 0, obb->extent[0]);
+        vec3_mul_scalar(a + 3, obb->transform + 4, obb->extent[1]);
+        vec3_mul_scalar(a + 6, obb->transform + 8, obb->extent[2]);
+    }
+    else
+    {
+        a[0] = obb->extent[0]; a[1] = 0.0f;           a[2] = 0.0f;
+        a[3] = 0.0f;           a[4] = obb->extent[1]; a[5] = 0.0f;
+        a[6] = 0.0f;           a[7] = 0.0f;           a[8] = obb->extent[2];
+    }
+}
+
+/*
+ * All clip planes pass through the camera, so a box in front of every one of
+ * them may still be behind the camera, in the mirrored cone. Boxes that cross
+ * the apex plane (the camera may be inside them) take the polygon path.
+ */
+static bool Frustum_IsOBBVisibleBox(struct obb_s *obb, const float a[9], struct frustum_s *frustum)
+{
+    const float *n = frustum->apex_plane;
+    float d, r, eps;
+
+    if(!frustum->packed_planes)
+    {
+        return Frustum_IsOBBVisibleClip(obb, frustum);
+    }
+    if(Frustum_IsBoxOutside(frustum->packed_planes, (frustum->vertex_count + 3) / 4, obb->centre, a))
+    {
+        return false;
+    }
+
+    d = vec3_plane_dist(n, obb->centre);
+    r = fabsf(vec3_dot(n, a + 0)) + fabsf(vec3_dot(n, a + 3)) + fabsf(vec3_dot(n, a + 6));
+    eps = frustum->vertex_count * SPLIT_EPSILON;
+    if(d + r < -eps)
+    {
+        return false;
+    }
+    if(d - r > eps)
+    {
+        return true;
+    }
+    return Frustum_IsOBBVisibleClip(obb, frustum);
+}
+
+
+bool Frustum_IsOBBVisible(struct obb_s *obb, struct frustum_s *frustum)
+{
+    float a[9];
+    Frustum_GetOBBAxes(obb, a);
+    return Frustum_IsOBBVisibleBox(obb, a, frustum);
+}
+
 bool Frustum_IsOBBVisibleInFrustumList(struct obb_s *obb, struct frustum_s *frustum)
 {
+    float a[9];
+    Frustum_GetOBBAxes(obb, a);
     for(; frustum; frustum = frustum->next)
     {
-        if(Frustum_IsOBBVisible(obb, frustum))
+        if(Frustum_IsOBBVisibleBox(obb, a, frustum))
         {
             return true;
         }
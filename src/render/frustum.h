@@ -29,6 +29,8 @@ typedef struct frustum_s
     float              *vertex;                                                 // frustum vertices
     float              *cam_pos;                                                ///@TODO: delete it!
     float               norm[4];                                                // main frustum clip plane (inv. plane of parent portal)
+    float              *packed_planes;                                          // clip planes as x[4], y[4], z[4], w[4] groups, for box tests
+    float               apex_plane[4];                                          // sum of the clip planes, the frustum is on its positive side
 
     struct frustum_s   *parent;                                                 // by who frustum was generated; parent == NULL is equal generated by camera
     struct frustum_s   *next;                                                   // next frustum in list
@@ -62,6 +64,10 @@ bool Frustum_IsPolyVisible(struct polygon_s *p, struct frustum_s *frustum, bool
 bool Frustum_IsAABBVisible(float bbmin[3], float bbmax[3], struct frustum_s *frustum);
 bool Frustum_IsOBBVisible(struct obb_s *obb, struct frustum_s *frustum);
 bool Frustum_IsOBBVisibleInFrustumList(struct obb_s *obb, struct frustum_s *frustum);
+// exact test by the OBB polygons, the box test falls back to it near the frustum apex
+bool Frustum_IsOBBVisibleClip(struct obb_s *obb, struct frustum_s *frustum);
+// fills packed_planes and apex_plane from planes; packed needs 16 floats per 4 planes
+void Frustum_PackPlanes(struct frustum_s *frustum, float *packed);
 
 
 portal_p Portal_Create(unsigned int vcount);
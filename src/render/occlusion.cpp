@@ -0,0 +1,733 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL2/SDL_timer.h>
+
+#include "../core/system.h"
+#include "../core/vmath.h"
+#include "../core/polygon.h"
+#include "../core/obb.h"
+#include "../room.h"
+#include "../mesh.h"
+#include "render.h"
+#include "occlusion.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define OCCLUSION_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+#define OCCLUSION_CLIP_NEAR         (0x01)
+#define OCCLUSION_CLIP_RIGHT        (0x02)
+#define OCCLUSION_CLIP_LEFT         (0x04)
+#define OCCLUSION_CLIP_TOP          (0x08)
+#define OCCLUSION_CLIP_BOTTOM       (0x10)
+#define OCCLUSION_CLIP_PLANES       (5)
+#define OCCLUSION_CLIP_MAX_VERTICES (3 + OCCLUSION_CLIP_PLANES)
+
+typedef struct occluder_candidate_s
+{
+    float                   area;
+    struct polygon_s       *polygon;
+}occluder_candidate_t, *occluder_candidate_p;
+
+
+static int Occlusion_CompareCandidates(const void *a, const void *b)
+{
+    float da = ((const occluder_candidate_t*)a)->area;
+    float db = ((const occluder_candidate_t*)b)->area;
+    return (da < db) ? (1) : ((da > db) ? (-1) : (0));
+}
+
+
+static float Occlusion_PolygonArea(struct polygon_s *p)
+{
+    float n[3] = {0.0f, 0.0f, 0.0f};
+    const float *v0 = p->vertices[0].position;
+
+    for(uint16_t i = 2; i < p->vertex_count; i++)
+    {
+        float e1[3], e2[3], c[3];
+        vec3_sub(e1, p->vertices[i - 1].position, v0);
+        vec3_sub(e2, p->vertices[i].position, v0);
+        vec3_cross(c, e1, e2);
+        vec3_add(n, n, c);
+    }
+
+    return 0.5f * vec3_abs(n);
+}
+
+
+void Occlusion_BuildRoomOccluders(struct occluder_list_s *list, struct room_s *room)
+{
+    struct base_mesh_s *mesh = room->content->mesh;
+    occluder_candidate_p candidates;
+    uint32_t candidates_count = 0;
+    uint32_t triangles_count = 0;
+    size_t buf_size;
+
+    Occlusion_FreeRoomOccluders(list);
+    list->content = room->content;
+    if(!mesh || !mesh->polygons_count || room->content->overlapped_room_list_size)
+    {
+        return;
+    }
+
+    buf_size = mesh->polygons_count * sizeof(occluder_candidate_t);
+    candidates = (occluder_candidate_p)Sys_GetTempMem(buf_size);
+    for(uint32_t i = 0; i < mesh->polygons_count; i++)
+    {
+        polygon_p p = mesh->polygons + i;
+        if((p->transparency == BM_OPAQUE) && (p->vertex_count >= 3) && !Polygon_IsBroken(p))
+        {
+            float area = Occlusion_PolygonArea(p);
+            if(area >= OCCLUSION_MIN_AREA)
+            {
+                candidates[candidates_count].area = area;
+                candidates[candidates_count].polygon = p;
+                candidates_count++;
+            }
+        }
+    }
+    qsort(candidates, candidates_count, sizeof(occluder_candidate_t), Occlusion_CompareCandidates);
+
+    for(uint32_t i = 0; i < candidates_count; i++)
+    {
+        uint32_t n = candidates[i].polygon->vertex_count - 2;
+        if(triangles_count + n > OCCLUSION_ROOM_TRIANGLES)
+        {
+            candidates_count = i;
+            break;
+        }
+        triangles_count += n;
+    }
+
+    if(triangles_count)
+    {
+        occluder_triangle_p t;
+        list->triangles = (occluder_triangle_p)malloc(triangles_count * sizeof(occluder_triangle_t));
+        list->count = triangles_count;
+        t = list->triangles;
+        for(uint32_t i = 0; i < candidates_count; i++)
+        {
+            polygon_p p = candidates[i].polygon;
+            float v0[3];
+            Mat4_vec3_mul_macro(v0, room->transform, p->vertices[0].position);
+            for(uint16_t j = 2; j < p->vertex_count; j++, t++)
+            {
+                vec3_copy(t->vertices + 0, v0);
+                Mat4_vec3_mul_macro(t->vertices + 3, room->transform, p->vertices[j - 1].position);
+                Mat4_vec3_mul_macro(t->vertices + 6, room->transform, p->vertices[j].position);
+                Mat4_vec3_rot_macro(t->plane, room->transform, p->plane);
+                t->plane[3] = -vec3_dot(t->plane, v0);
+                t->double_side = p->double_side;
+            }
+        }
+        Occlusion_LinkOccluders(list->triangles, list->count);
+    }
+
+    Sys_ReturnTempMem(buf_size);
+}
+
+
+void Occlusion_FreeRoomOccluders(struct occluder_list_s *list)
+{
+    if(list->triangles)
+    {
+        free(list->triangles);
+    }
+    list->triangles = NULL;
+    list->count = 0;
+    list->content = NULL;
+}
+
+
+static inline bool Occlusion_IsSameVertex(const float a[3], const float b[3])
+{
+    return (a[0] == b[0]) && (a[1] == b[1]) && (a[2] == b[2]);
+}
+
+
+void Occlusion_LinkOccluders(struct occluder_triangle_s *triangles, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        occluder_triangle_p t = triangles + i;
+        for(int k = 0; k < 3; k++)
+        {
+            const float *a = t->vertices + 3 * k;
+            const float *b = t->vertices + 3 * ((k + 1) % 3);
+            t->neighbours[k] = -1;
+            for(uint32_t j = 0; (j < count) && (t->neighbours[k] < 0); j++)
+            {
+                const float *v = triangles[j].vertices;
+                for(int m = 0; (m < 3) && (j != i); m++)
+                {
+                    if(Occlusion_IsSameVertex(v + 3 * m, b) && Occlusion_IsSameVertex(v + 3 * ((m + 1) % 3), a))
+                    {
+                        t->neighbours[k] = j;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+static inline void Occlusion_Project(float clip[4], const float m[16], const float v[3])
+{
+    clip[0] = m[0] * v[0] + m[4] * v[1] + m[8]  * v[2] + m[12];
+    clip[1] = m[1] * v[0] + m[5] * v[1] + m[9]  * v[2] + m[13];
+    clip[2] = m[2] * v[0] + m[6] * v[1] + m[10] * v[2] + m[14];
+    clip[3] = m[3] * v[0] + m[7] * v[1] + m[11] * v[2] + m[15];
+}
+
+
+static inline uint32_t Occlusion_ClipCode(const float c[4], float band)
+{
+    uint32_t code = (c[3] < OCCLUSION_NEAR_W) ? (OCCLUSION_CLIP_NEAR) : (0);
+    float w = band * c[3];
+    code |= (c[0] > w) ? (OCCLUSION_CLIP_RIGHT) : (0);
+    code |= (c[0] < -w) ? (OCCLUSION_CLIP_LEFT) : (0);
+    code |= (c[1] > w) ? (OCCLUSION_CLIP_TOP) : (0);
+    code |= (c[1] < -w) ? (OCCLUSION_CLIP_BOTTOM) : (0);
+    return code;
+}
+
+
+static inline float Occlusion_ClipDist(const float c[4], int plane)
+{
+    switch(plane)
+    {
+        case 0: return c[3] - OCCLUSION_NEAR_W;
+        case 1: return OCCLUSION_GUARD_BAND * c[3] - c[0];
+        case 2: return OCCLUSION_GUARD_BAND * c[3] + c[0];
+        case 3: return OCCLUSION_GUARD_BAND * c[3] - c[1];
+        default: return OCCLUSION_GUARD_BAND * c[3] + c[1];
+    };
+}
+
+
+static inline void Occlusion_ToScreen(float s[3], const float c[4])
+{
+    float inv_w = 1.0f / c[3];
+    s[0] = (c[0] * inv_w * 0.5f + 0.5f) * (float)OCCLUSION_WIDTH;
+    s[1] = (c[1] * inv_w * 0.5f + 0.5f) * (float)OCCLUSION_HEIGHT;
+    s[2] = inv_w;
+}
+
+
+static void Occlusion_GetOBBAxes(struct obb_s *obb, float a[9])
+{
+    if(obb->transform)
+    {
+        vec3_mul_scalar(a + 0, obb->transform + 0, obb->extent[0]);
+        vec3_mul_scalar(a + 3, obb->transform + 4, obb->extent[1]);
+        vec3_mul_scalar(a + 6, obb->transform + 8, obb->extent[2]);
+    }
+    else
+    {
+        a[0] = obb->extent[0]; a[1] = 0.0f;           a[2] = 0.0f;
+        a[3] = 0.0f;           a[4] = obb->extent[1]; a[5] = 0.0f;
+        a[6] = 0.0f;           a[7] = 0.0f;           a[8] = obb->extent[2];
+    }
+}
+
+/*
+ * =============================================================================
+ */
+
+COcclusionBuffer::COcclusionBuffer():
+m_ready(false),
+m_begin_time(0),
+m_triangles_count(0)
+{
+    uint32_t size = 0;
+
+    memset(&stats, 0, sizeof(stats));
+    memset(m_view_proj, 0, sizeof(m_view_proj));
+    memset(m_cam_pos, 0, sizeof(m_cam_pos));
+    memset(m_bins_count, 0, sizeof(m_bins_count));
+    m_triangles = (struct occlusion_triangle_s*)malloc(OCCLUSION_MAX_TRIANGLES * sizeof(struct occlusion_triangle_s));
+    m_bins = (uint16_t*)malloc(OCCLUSION_TILES_X * OCCLUSION_TILES_Y * OCCLUSION_MAX_TRIANGLES * sizeof(uint16_t));
+
+    for(int i = 0; i < OCCLUSION_LEVELS; i++)
+    {
+        int w = ((OCCLUSION_WIDTH >> i) > 0) ? (OCCLUSION_WIDTH >> i) : (1);
+        int h = ((OCCLUSION_HEIGHT >> i) > 0) ? (OCCLUSION_HEIGHT >> i) : (1);
+        size += w * h;
+    }
+    m_levels[0] = (float*)calloc(size, sizeof(float));
+    for(int i = 1; i < OCCLUSION_LEVELS; i++)
+    {
+        int w, h;
+        this->GetDepth(i - 1, &w, &h);
+        m_levels[i] = m_levels[i - 1] + w * h;
+    }
+}
+
+
+COcclusionBuffer::~COcclusionBuffer()
+{
+    free(m_levels[0]);
+    free(m_bins);
+    free(m_triangles);
+}
+
+
+void COcclusionBuffer::Clear()
+{
+    m_ready = false;
+}
+
+
+void COcclusionBuffer::Begin(const float view_proj[16], const float cam_pos[3])
+{
+    memcpy(m_view_proj, view_proj, sizeof(m_view_proj));
+    vec3_copy(m_cam_pos, cam_pos);
+    memset(m_bins_count, 0, sizeof(m_bins_count));
+    m_triangles_count = 0;
+    m_ready = false;
+    m_begin_time = SDL_GetPerformanceCounter();
+}
+
+
+void COcclusionBuffer::AddOccluders(const struct occluder_list_s *list)
+{
+    const occluder_triangle_t *t = list->triangles;
+    for(uint32_t i = 0; i < list->count; i++, t++)
+    {
+        // GL culls back faces, so they hide nothing
+        bool front = vec3_plane_dist(t->plane, m_cam_pos) >= 0.0f;
+        if(t->double_side || front)
+        {
+            // a neighbour facing the other way folds over the edge on the screen
+            uint32_t shared = 0;
+            for(int k = 0; k < 3; k++)
+            {
+                const occluder_triangle_t *n = (t->neighbours[k] >= 0) ? (list->triangles + t->neighbours[k]) : (NULL);
+                if(n && ((vec3_plane_dist(n->plane, m_cam_pos) >= 0.0f) == front) && (n->double_side || front))
+                {
+                    shared |= 1 << k;
+                }
+            }
+            this->AddTriangle(t->vertices + 0, t->vertices + 3, t->vertices + 6, shared);
+        }
+    }
+}
+
+
+void COcclusionBuffer::End()
+{
+    memset(m_levels[0], 0, OCCLUSION_WIDTH * OCCLUSION_HEIGHT * sizeof(float));
+    for(uint32_t i = 0; i < OCCLUSION_TILES_X * OCCLUSION_TILES_Y; i++)
+    {
+        this->DrawTile(i);
+    }
+    this->BuildPyramid();
+
+    m_ready = true;
+    stats.triangles += m_triangles_count;
+    stats.ticks += SDL_GetPerformanceCounter() - m_begin_time;
+}
+
+
+const float *COcclusionBuffer::GetDepth(int level, int *width, int *height) const
+{
+    *width = ((OCCLUSION_WIDTH >> level) > 0) ? (OCCLUSION_WIDTH >> level) : (1);
+    *height = ((OCCLUSION_HEIGHT >> level) > 0) ? (OCCLUSION_HEIGHT >> level) : (1);
+    return m_levels[level];
+}
+
+
+bool COcclusionBuffer::IsPolygonVisible(const float *v, uint16_t count)
+{
+    return !m_ready || this->IsPointsVisible(v, count);
+}
+
+
+bool COcclusionBuffer::IsOBBVisible(struct obb_s *obb)
+{
+    float a[9], v[24], *p = v;
+
+    if(!m_ready)
+    {
+        return true;
+    }
+
+    Occlusion_GetOBBAxes(obb, a);
+    for(int i = 0; i < 8; i++, p += 3)
+    {
+        float sx = (i & 1) ? (1.0f) : (-1.0f);
+        float sy = (i & 2) ? (1.0f) : (-1.0f);
+        float sz = (i & 4) ? (1.0f) : (-1.0f);
+        p[0] = obb->centre[0] + sx * a[0] + sy * a[3] + sz * a[6];
+        p[1] = obb->centre[1] + sx * a[1] + sy * a[4] + sz * a[7];
+        p[2] = obb->centre[2] + sx * a[2] + sy * a[5] + sz * a[8];
+    }
+
+    stats.objects_tested++;
+    if(this->IsPointsVisible(v, 8))
+    {
+        return true;
+    }
+    stats.objects_culled++;
+    return false;
+}
+
+/*
+ * Triangles that cross the near plane or leave the guard band are clipped,
+ * the rest go to the setup as they are; the band keeps the edge functions in
+ * a range where float is exact enough. The edges along the clip planes count
+ * as shared: the polygon goes on past them.
+ */
+void COcclusionBuffer::AddTriangle(const float *v0, const float *v1, const float *v2, uint32_t shared)
+{
+    float poly[2][OCCLUSION_CLIP_MAX_VERTICES][4];
+    float s[OCCLUSION_CLIP_MAX_VERTICES][3];
+    uint32_t edges[2][OCCLUSION_CLIP_MAX_VERTICES];     // shared, for the edge from the vertex to the next one
+    uint32_t screen_and, guard_or;
+    int count = 3, in = 0;
+
+    Occlusion_Project(poly[0][0], m_view_proj, v0);
+    Occlusion_Project(poly[0][1], m_view_proj, v1);
+    Occlusion_Project(poly[0][2], m_view_proj, v2);
+    edges[0][0] = shared & 1;
+    edges[0][1] = (shared >> 1) & 1;
+    edges[0][2] = (shared >> 2) & 1;
+
+    screen_and = Occlusion_ClipCode(poly[0][0], 1.0f) & Occlusion_ClipCode(poly[0][1], 1.0f) & Occlusion_ClipCode(poly[0][2], 1.0f);
+    if(screen_and)
+    {
+        return;
+    }
+
+    guard_or = Occlusion_ClipCode(poly[0][0], OCCLUSION_GUARD_BAND) | Occlusion_ClipCode(poly[0][1], OCCLUSION_GUARD_BAND) | Occlusion_ClipCode(poly[0][2], OCCLUSION_GUARD_BAND);
+    for(int plane = 0; guard_or && (plane < OCCLUSION_CLIP_PLANES); plane++)
+    {
+        const float (*src)[4] = poly[in];
+        float (*dst)[4] = poly[in ^ 1];
+        const uint32_t *src_edges = edges[in];
+        uint32_t *dst_edges = edges[in ^ 1];
+        int dst_count = 0;
+
+        if(!(guard_or & (1 << plane)))
+        {
+            continue;
+        }
+        for(int i = 0; i < count; i++)
+        {
+            const float *a = src[i];
+            const float *b = src[(i + 1 < count) ? (i + 1) : (0)];
+            float da = Occlusion_ClipDist(a, plane);
+            float db = Occlusion_ClipDist(b, plane);
+            if(da >= 0.0f)
+            {
+                vec4_copy(dst[dst_count], a);
+                dst_edges[dst_count] = src_edges[i];
+                dst_count++;
+            }
+            if((da >= 0.0f) != (db >= 0.0f))
+            {
+                float t = da / (da - db);
+                dst[dst_count][0] = a[0] + t * (b[0] - a[0]);
+                dst[dst_count][1] = a[1] + t * (b[1] - a[1]);
+                dst[dst_count][2] = a[2] + t * (b[2] - a[2]);
+                dst[dst_count][3] = a[3] + t * (b[3] - a[3]);
+                dst_edges[dst_count] = (da >= 0.0f) ? (1) : (src_edges[i]);
+                dst_count++;
+            }
+        }
+        in ^= 1;
+        count = dst_count;
+        if(count < 3)
+        {
+            return;
+        }
+    }
+
+    for(int i = 0; i < count; i++)
+    {
+        Occlusion_ToScreen(s[i], poly[in][i]);
+    }
+    // the fan diagonals are shared too
+    for(int i = 2; i < count; i++)
+    {
+        uint32_t fan = (i == 2) ? (edges[in][0]) : (1);
+        fan |= edges[in][i - 1] << 1;
+        fan |= ((i == count - 1) ? (edges[in][count - 1]) : (1)) << 2;
+        this->SetupTriangle(s[0], s[i - 1], s[i], fan);
+    }
+}
+
+
+void COcclusionBuffer::SetupTriangle(const float *s0, const float *s1, const float *s2, uint32_t shared)
+{
+    struct occlusion_triangle_s *t;
+    const float *v[3];
+    float area, min_x, max_x, min_y, max_y, dx1, dy1, dz1, dx2, dy2, dz2, p, q;
+    int x0, y0, x1, y1;
+
+    if(m_triangles_count >= OCCLUSION_MAX_TRIANGLES)
+    {
+        return;
+    }
+
+    area = (s1[0] - s0[0]) * (s2[1] - s0[1]) - (s2[0] - s0[0]) * (s1[1] - s0[1]);
+    if(fabsf(area) < 0.01f)
+    {
+        return;
+    }
+    v[0] = s0;
+    v[1] = (area > 0.0f) ? (s1) : (s2);
+    v[2] = (area > 0.0f) ? (s2) : (s1);
+    if(area < 0.0f)
+    {
+        shared = ((shared & 1) << 2) | (shared & 2) | ((shared >> 2) & 1);
+    }
+    area = fabsf(area);
+
+    // pixels whose centre may be inside
+    min_x = fminf(fminf(s0[0], s1[0]), s2[0]);
+    max_x = fmaxf(fmaxf(s0[0], s1[0]), s2[0]);
+    min_y = fminf(fminf(s0[1], s1[1]), s2[1]);
+    max_y = fmaxf(fmaxf(s0[1], s1[1]), s2[1]);
+    x0 = (int)ceilf(min_x - 0.5f);
+    x1 = (int)floorf(max_x - 0.5f) + 1;
+    y0 = (int)ceilf(min_y - 0.5f);
+    y1 = (int)floorf(max_y - 0.5f) + 1;
+    x0 = (x0 > 0) ? (x0) : (0);
+    y0 = (y0 > 0) ? (y0) : (0);
+    x1 = (x1 < OCCLUSION_WIDTH) ? (x1) : (OCCLUSION_WIDTH);
+    y1 = (y1 < OCCLUSION_HEIGHT) ? (y1) : (OCCLUSION_HEIGHT);
+    if((x0 >= x1) || (y0 >= y1))
+    {
+        return;
+    }
+
+    t = m_triangles + m_triangles_count;
+    t->rect[0] = x0;
+    t->rect[1] = y0;
+    t->rect[2] = x1;
+    t->rect[3] = y1;
+
+    // edge functions are positive inside, taken at the pixel centres on the shared edges and at the outermost corners elsewhere
+    for(int i = 0; i < 3; i++)
+    {
+        const float *a = v[i];
+        const float *b = v[(i + 1) % 3];
+        float *e = t->edge[i];
+        e[0] = a[1] - b[1];
+        e[1] = b[0] - a[0];
+        e[2] = a[0] * b[1] - a[1] * b[0] + 0.5f * (e[0] + e[1]);
+        if(!(shared & (1 << i)))
+        {
+            e[2] -= 0.5f * (fabsf(e[0]) + fabsf(e[1]));
+        }
+    }
+
+    dx1 = v[1][0] - v[0][0]; dy1 = v[1][1] - v[0][1]; dz1 = v[1][2] - v[0][2];
+    dx2 = v[2][0] - v[0][0]; dy2 = v[2][1] - v[0][1]; dz2 = v[2][2] - v[0][2];
+    p = (dz1 * dy2 - dz2 * dy1) / area;
+    q = (dz2 * dx1 - dz1 * dx2) / area;
+    t->depth[0] = p;
+    t->depth[1] = q;
+    t->depth[2] = v[0][2] - p * v[0][0] - q * v[0][1] + 0.5f * (p + q) - 0.5f * (fabsf(p) + fabsf(q));
+
+    x1 = (x1 - 1) / OCCLUSION_TILE_SIZE;
+    y1 = (y1 - 1) / OCCLUSION_TILE_SIZE;
+    for(int ty = y0 / OCCLUSION_TILE_SIZE; ty <= y1; ty++)
+    {
+        for(int tx = x0 / OCCLUSION_TILE_SIZE; tx <= x1; tx++)
+        {
+            uint32_t tile = ty * OCCLUSION_TILES_X + tx;
+            m_bins[tile * OCCLUSION_MAX_TRIANGLES + m_bins_count[tile]++] = m_triangles_count;
+        }
+    }
+    m_triangles_count++;
+}
+
+/*
+ * Rows of a tile are walked four pixels at a time from a multiple of four:
+ * tiles start at one, so the extra pixels are still in the tile, and they are
+ * outside the triangle anyway.
+ */
+void COcclusionBuffer::DrawTile(uint32_t tile)
+{
+    const int tile_x0 = (tile % OCCLUSION_TILES_X) * OCCLUSION_TILE_SIZE;
+    const int tile_y0 = (tile / OCCLUSION_TILES_X) * OCCLUSION_TILE_SIZE;
+    const uint16_t *bin = m_bins + tile * OCCLUSION_MAX_TRIANGLES;
+
+    for(uint16_t i = 0; i < m_bins_count[tile]; i++)
+    {
+        const struct occlusion_triangle_s *t = m_triangles + bin[i];
+        int x0 = (t->rect[0] > tile_x0) ? (t->rect[0]) : (tile_x0);
+        int y0 = (t->rect[1] > tile_y0) ? (t->rect[1]) : (tile_y0);
+        int x1 = (t->rect[2] < tile_x0 + OCCLUSION_TILE_SIZE) ? (t->rect[2]) : (tile_x0 + OCCLUSION_TILE_SIZE);
+        int y1 = (t->rect[3] < tile_y0 + OCCLUSION_TILE_SIZE) ? (t->rect[3]) : (tile_y0 + OCCLUSION_TILE_SIZE);
+
+        x0 &= ~3;
+#if OCCLUSION_HAVE_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 steps = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        const __m128 a0 = _mm_set1_ps(t->edge[0][0]), a1 = _mm_set1_ps(t->edge[1][0]), a2 = _mm_set1_ps(t->edge[2][0]);
+        const __m128 dp = _mm_set1_ps(t->depth[0]);
+        for(int y = y0; y < y1; y++)
+        {
+            float *row = m_levels[0] + y * OCCLUSION_WIDTH;
+            const __m128 c0 = _mm_set1_ps(t->edge[0][1] * y + t->edge[0][2]);
+            const __m128 c1 = _mm_set1_ps(t->edge[1][1] * y + t->edge[1][2]);
+            const __m128 c2 = _mm_set1_ps(t->edge[2][1] * y + t->edge[2][2]);
+            const __m128 dc = _mm_set1_ps(t->depth[1] * y + t->depth[2]);
+            for(int x = x0; x < x1; x += 4)
+            {
+                __m128 fx = _mm_add_ps(_mm_set1_ps((float)x), steps);
+                __m128 mask = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, fx), c0), zero),
+                                         _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, fx), c1), zero));
+                mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, fx), c2), zero));
+                if(_mm_movemask_ps(mask))
+                {
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 d = _mm_max_ps(old, _mm_add_ps(_mm_mul_ps(dp, fx), dc));
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, d), _mm_andnot_ps(mask, old)));
+                }
+            }
+        }
+#else
+        for(int y = y0; y < y1; y++)
+        {
+            float *row = m_levels[0] + y * OCCLUSION_WIDTH;
+            float c0 = t->edge[0][1] * y + t->edge[0][2];
+            float c1 = t->edge[1][1] * y + t->edge[1][2];
+            float c2 = t->edge[2][1] * y + t->edge[2][2];
+            float dc = t->depth[1] * y + t->depth[2];
+            for(int x = x0; x < x1; x++)
+            {
+                if((t->edge[0][0] * x + c0 >= 0.0f) && (t->edge[1][0] * x + c1 >= 0.0f) && (t->edge[2][0] * x + c2 >= 0.0f))
+                {
+                    float d = t->depth[0] * x + dc;
+                    row[x] = (d > row[x]) ? (d) : (row[x]);
+                }
+            }
+        }
+#endif
+    }
+}
+
+/*
+ * Every texel of a level keeps the farthest depth of the 2x2 texels under it.
+ */
+void COcclusionBuffer::BuildPyramid()
+{
+    for(int level = 1; level < OCCLUSION_LEVELS; level++)
+    {
+        int sw, sh, dw, dh;
+        const float *src = this->GetDepth(level - 1, &sw, &sh);
+        float *dst = m_levels[level];
+        this->GetDepth(level, &dw, &dh);
+
+#if OCCLUSION_HAVE_SSE2
+        if(((dw & 3) == 0) && (sh >= 2 * dh))
+        {
+            for(int y = 0; y < dh; y++)
+            {
+                const float *r0 = src + 2 * y * sw;
+                const float *r1 = r0 + sw;
+                for(int x = 0; x < dw; x += 4)
+                {
+                    __m128 a = _mm_loadu_ps(r0 + 2 * x), b = _mm_loadu_ps(r0 + 2 * x + 4);
+                    __m128 m0 = _mm_min_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+                    a = _mm_loadu_ps(r1 + 2 * x);
+                    b = _mm_loadu_ps(r1 + 2 * x + 4);
+                    __m128 m1 = _mm_min_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+                    _mm_storeu_ps(dst + y * dw + x, _mm_min_ps(m0, m1));
+                }
+            }
+            continue;
+        }
+#endif
+        for(int y = 0; y < dh; y++)
+        {
+            const float *r0 = src + ((2 * y < sh) ? (2 * y) : (sh - 1)) * sw;
+            const float *r1 = src + ((2 * y + 1 < sh) ? (2 * y + 1) : (sh - 1)) * sw;
+            for(int x = 0; x < dw; x++)
+            {
+                int x0 = (2 * x < sw) ? (2 * x) : (sw - 1);
+                int x1 = (2 * x + 1 < sw) ? (2 * x + 1) : (sw - 1);
+                float m0 = (r0[x0] < r0[x1]) ? (r0[x0]) : (r0[x1]);
+                float m1 = (r1[x0] < r1[x1]) ? (r1[x0]) : (r1[x1]);
+                dst[y * dw + x] = (m0 < m1) ? (m0) : (m1);
+            }
+        }
+    }
+}
+
+/*
+ * The rectangle is read from the level where it spans at most 4x4 texels;
+ * it is visible if its nearest depth is in front of the farthest one there.
+ */
+bool COcclusionBuffer::IsRectVisible(float x0, float y0, float x1, float y1, float depth)
+{
+    int ix0, iy0, ix1, iy1, w, h, level = 0;
+    const float *buf;
+
+    if((x1 <= 0.0f) || (y1 <= 0.0f) || (x0 >= (float)OCCLUSION_WIDTH) || (y0 >= (float)OCCLUSION_HEIGHT))
+    {
+        return false;
+    }
+
+    ix0 = (x0 > 0.0f) ? ((int)x0) : (0);
+    iy0 = (y0 > 0.0f) ? ((int)y0) : (0);
+    ix1 = (x1 < (float)(OCCLUSION_WIDTH - 1)) ? ((int)x1) : (OCCLUSION_WIDTH - 1);
+    iy1 = (y1 < (float)(OCCLUSION_HEIGHT - 1)) ? ((int)y1) : (OCCLUSION_HEIGHT - 1);
+    while((level < OCCLUSION_LEVELS - 1) && (((ix1 >> level) - (ix0 >> level) >= 4) || ((iy1 >> level) - (iy0 >> level) >= 4)))
+    {
+        level++;
+    }
+
+    buf = this->GetDepth(level, &w, &h);
+    ix0 >>= level; ix1 >>= level;
+    iy0 >>= level; iy1 >>= level;
+    ix1 = (ix1 < w) ? (ix1) : (w - 1);
+    iy1 = (iy1 < h) ? (iy1) : (h - 1);
+    depth *= 1.0f + OCCLUSION_DEPTH_BIAS;
+    for(int y = iy0; y <= iy1; y++)
+    {
+        for(int x = ix0; x <= ix1; x++)
+        {
+            if(buf[y * w + x] <= depth)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+bool COcclusionBuffer::IsPointsVisible(const float *v, uint16_t count)
+{
+    float x0 = 1.0e30f, y0 = 1.0e30f, x1 = -1.0e30f, y1 = -1.0e30f, depth = 0.0f;
+
+    for(uint16_t i = 0; i < count; i++, v += 3)
+    {
+        float c[4], s[3];
+        Occlusion_Project(c, m_view_proj, v);
+        if(c[3] < OCCLUSION_NEAR_W)
+        {
+            return true;
+        }
+        Occlusion_ToScreen(s, c);
+        x0 = (s[0] < x0) ? (s[0]) : (x0);
+        y0 = (s[1] < y0) ? (s[1]) : (y0);
+        x1 = (s[0] > x1) ? (s[0]) : (x1);
+        y1 = (s[1] > y1) ? (s[1]) : (y1);
+        depth = (s[2] > depth) ? (s[2]) : (depth);
+    }
+
+    // the pixels the rectangle touches are enough, only whole pixels are covered
+    return (count == 0) || this->IsRectVisible(x0, y0, x1, y1, depth);
+}
@@ -0,0 +1,118 @@
+
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <stdint.h>
+
+struct room_s;
+struct room_content_s;
+struct obb_s;
+
+/*
+ * CPU occlusion culling: the biggest opaque polygons of the visible rooms are
+ * drawn into a small software depth buffer, binned into tiles, and a pyramid
+ * of the farthest depth of each 2x2 block is built over it. Things whose
+ * nearest point is behind everything in their screen rectangle are hidden.
+ * Depth is 1 / w, so bigger is nearer and 0 is nothing drawn.
+ *
+ * A pixel is covered only when all of it is inside the triangle, so a gap
+ * between occluders stays open however narrow it is. Edges shared with a
+ * triangle that is drawn too are the exception: there the pixel centre
+ * decides, so the polygons of a wall join without cracks. A covered pixel
+ * takes the triangle depth at its farthest corner.
+ */
+#define OCCLUSION_WIDTH             (256)
+#define OCCLUSION_HEIGHT            (128)
+#define OCCLUSION_LEVELS            (9)                 // 256x128 down to 1x1
+#define OCCLUSION_TILE_SIZE         (32)
+#define OCCLUSION_TILES_X           (OCCLUSION_WIDTH / OCCLUSION_TILE_SIZE)
+#define OCCLUSION_TILES_Y           (OCCLUSION_HEIGHT / OCCLUSION_TILE_SIZE)
+#define OCCLUSION_MAX_TRIANGLES     (4096)              // per frame, after clipping
+#define OCCLUSION_ROOM_TRIANGLES    (64)                // occluders kept per room
+#define OCCLUSION_MIN_AREA          (256.0f * 1024.0f)  // a quarter of a sector; smaller polygons hide too little
+#define OCCLUSION_NEAR_W            (1.0f)              // anything closer than that is visible
+#define OCCLUSION_GUARD_BAND        (8.0f)              // triangles are clipped at 8 screen sizes around the view
+#define OCCLUSION_DEPTH_BIAS        (0.001f)
+
+typedef struct occluder_triangle_s
+{
+    float                       vertices[9];            // world space
+    float                       plane[4];               // of the room polygon, GL culls it from behind
+    uint32_t                    double_side;
+    int32_t                     neighbours[3];          // across the edges v0-v1, v1-v2, v2-v0 in the same list, -1 for none
+}occluder_triangle_t, *occluder_triangle_p;
+
+typedef struct occluder_list_s
+{
+    struct room_content_s      *content;                // built for it; flipped rooms build again
+    uint32_t                    count;
+    struct occluder_triangle_s *triangles;
+}occluder_list_t, *occluder_list_p;
+
+typedef struct occlusion_stats_s
+{
+    uint32_t                    frames;
+    uint32_t                    triangles;              // drawn into the buffer
+    uint32_t                    rebuilds;               // buffers made again without the occluders of hidden rooms
+    uint32_t                    rooms_tested;
+    uint32_t                    rooms_culled;
+    uint32_t                    objects_tested;         // static meshes and entities
+    uint32_t                    objects_culled;
+    uint64_t                    ticks;                  // spent drawing the buffers, SDL performance counter
+}occlusion_stats_t, *occlusion_stats_p;
+
+// the largest opaque polygons of the room mesh; rooms drawn through the stencil get none
+void Occlusion_BuildRoomOccluders(struct occluder_list_s *list, struct room_s *room);
+void Occlusion_FreeRoomOccluders(struct occluder_list_s *list);
+// finds the triangles that share an edge, the same two vertices the other way round
+void Occlusion_LinkOccluders(struct occluder_triangle_s *triangles, uint32_t count);
+
+
+class COcclusionBuffer
+{
+public:
+    COcclusionBuffer();
+   ~COcclusionBuffer();
+
+    void Clear();                                       // nothing is hidden until the next End()
+    void Begin(const float view_proj[16], const float cam_pos[3]);
+    void AddOccluders(const struct occluder_list_s *list);
+    void End();                                         // draws the bins and builds the pyramid
+    bool IsReady() const { return m_ready; }
+
+    // world space polygon, e.g. a portal window
+    bool IsPolygonVisible(const float *v, uint16_t count);
+    bool IsOBBVisible(struct obb_s *obb);
+
+    const float *GetDepth(int level, int *width, int *height) const;
+
+    struct occlusion_stats_s    stats;
+
+private:
+    struct occlusion_triangle_s
+    {
+        float       edge[3][3];                         // a, b, c: a * x + b * y + c >= 0 for covered pixels
+        float       depth[3];                           // a, b, c: 1 / w at the farthest corner of pixel x, y
+        int16_t     rect[4];                            // x0, y0, x1, y1, ends excluded
+    };
+
+    // bit i of shared is set when the edge from vertex i to the next one joins a drawn triangle
+    void AddTriangle(const float *v0, const float *v1, const float *v2, uint32_t shared);
+    void SetupTriangle(const float *s0, const float *s1, const float *s2, uint32_t shared);
+    void DrawTile(uint32_t tile);
+    void BuildPyramid();
+    bool IsRectVisible(float x0, float y0, float x1, float y1, float depth);
+    bool IsPointsVisible(const float *v, uint16_t count);
+
+    bool                        m_ready;
+    float                       m_view_proj[16];
+    float                       m_cam_pos[3];
+    uint64_t                    m_begin_time;
+    uint32_t                    m_triangles_count;
+    struct occlusion_triangle_s *m_triangles;
+    uint16_t                    m_bins_count[OCCLUSION_TILES_X * OCCLUSION_TILES_Y];
+    uint16_t                   *m_bins;                 // OCCLUSION_MAX_TRIANGLES per tile
+    float                      *m_levels[OCCLUSION_LEVELS];
+};
+
+#endif
@@ -1,6 +1,7 @@
 
 #include <cmath>
 #include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL_platform.h>
 #include <SDL2/SDL_opengl.h>
 
@@ -19,6 +20,7 @@
 #include "render_debug.h"
 #include "bsp_tree.h"
 #include "frustum.h"
+#include "occlusion.h"
 #include "shader_description.h"
 #include "shader_manager.h"
 #include "../room.h"
@@ -49,21 +51,47 @@ r_list_size(0),
 r_list_active_count(0),
 r_list(NULL),
 frustumManager(NULL),
+m_room_lights(NULL),
+m_lights_generation(0),
+m_room_occluders(NULL),
 shaderManager(NULL),
 debugDrawer(NULL),
 dynamicBSP(NULL),
+occlusionBuffer(NULL),
 r_flags(0x00)
 {
     this->InitSettings();
-    frustumManager = new CFrustumManager(32768);
-    debugDrawer    = new CRenderDebugDrawer();
-    dynamicBSP     = new CDynamicBSP(512 * 1024);
+    memset(&frame_stats, 0, sizeof(frame_stats));
+    frustumManager  = new CFrustumManager(32768);
+    debugDrawer     = new CRenderDebugDrawer();
+    dynamicBSP      = new CDynamicBSP(512 * 1024);
+    occlusionBuffer = new COcclusionBuffer();
 }
 
 CRender::~CRender()
 {
     m_camera = NULL;
 
+    if(m_room_lights)
+    {
+        for(uint32_t i = 0; i < m_rooms_count; i++)
+        {
+            Render_FreeRoomLights(m_room_lights + i);
+        }
+        free(m_room_lights);
+        m_room_lights = NULL;
+    }
+
+    if(m_room_occluders)
+    {
+        for(uint32_t i = 0; i < m_rooms_count; i++)
+        {
+            Occlusion_FreeRoomOccluders(m_room_occluders + i);
+        }
+        free(m_room_occluders);
+        m_room_occluders = NULL;
+    }
+
     if(r_list)
     {
         r_list_active_count = 0;
@@ -90,6 +118,12 @@ CRender::~CRender()
         dynamicBSP = NULL;
     }
 
+    if(occlusionBuffer)
+    {
+        delete occlusionBuffer;
+        occlusionBuffer = NULL;
+    }
+
     if(shaderManager)
     {
         delete shaderManager;
@@ -106,6 +140,7 @@ void CRender::InitSettings()
     settings.mipmaps = 3;
     settings.mipmap_mode = 3;
     settings.texture_border = 8;
+    settings.texture_cache = 0;
     settings.z_depth = 16;
     settings.fog_enabled = 1;
     settings.fog_color[0] = 0.0f;
@@ -113,6 +148,7 @@ void CRender::InitSettings()
     settings.fog_color[2] = 0.0f;
     settings.fog_start_depth = 10000.0f;
     settings.fog_end_depth = 16000.0f;
+    settings.occlusion_culling = 1;
 }
 
 void CRender::DoShaders()
@@ -123,11 +159,43 @@ void CRender::DoShaders()
     }
 }
 
+void CRender::DeleteShaders()
+{
+    if(shaderManager)
+    {
+        shaderManager->deletePrograms();
+        delete shaderManager;
+        shaderManager = NULL;
+    }
+}
+
 void CRender::ResetWorld(struct room_s *rooms, uint32_t rooms_count, struct anim_seq_s *anim_sequences, uint32_t anim_sequences_count)
 {
     this->CleanList();
     r_flags = 0x00;
 
+    if(m_room_lights)
+    {
+        for(uint32_t i = 0; i < m_rooms_count; i++)
+        {
+            Render_FreeRoomLights(m_room_lights + i);
+        }
+        free(m_room_lights);
+        m_room_lights = NULL;
+    }
+    m_lights_generation++;                                                      // entities drop the lights they kept
+
+    if(m_room_occluders)
+    {
+        for(uint32_t i = 0; i < m_rooms_count; i++)
+        {
+            Occlusion_FreeRoomOccluders(m_room_occluders + i);
+        }
+        free(m_room_occluders);
+        m_room_occluders = NULL;
+    }
+    occlusionBuffer->Clear();
+
     m_rooms = rooms;
     m_rooms_count = rooms_count;
     m_anim_sequences = anim_sequences;
@@ -155,6 +223,12 @@ void CRender::ResetWorld(struct room_s *rooms, uint32_t rooms_count, struct anim
         {
             m_rooms[i].is_in_r_list = 0;
         }
+        m_room_lights = (render_room_lights_p)calloc(m_rooms_count, sizeof(render_room_lights_t));
+        m_room_occluders = (occluder_list_p)calloc(m_rooms_count, sizeof(occluder_list_t));
+        for(uint32_t i = 0; i < m_rooms_count; i++)
+        {
+            Occlusion_BuildRoomOccluders(m_room_occluders + i, m_rooms + i);
+        }
     }
 }
 
@@ -232,6 +306,8 @@ void CRender::GenWorldList(struct camera_s *cam)
     this->CleanList();
     this->dynamicBSP->Reset(m_anim_sequences);
     this->frustumManager->Reset();
+    this->occlusionBuffer->Clear();
+    memset(&frame_stats, 0, sizeof(frame_stats));
     cam->frustum->next = NULL;
     m_camera = cam;
 
@@ -282,6 +358,7 @@ void CRender::GenWorldList(struct camera_s *cam)
                 }
             }
         }
+        this->CullOccludedRooms();
     }
     else                                                                        // camera is out of all rooms
     {
@@ -294,6 +371,7 @@ void CRender::GenWorldList(struct camera_s *cam)
             }
         }
     }
+    frame_stats.rooms = r_list_active_count;
 }
 
 /**
@@ -371,7 +449,8 @@ void CRender::DrawList()
             // Add transparency polygons from static meshes (if they exists)
             for(uint16_t j = 0; j < r->content->static_mesh_count; j++)
             {
-                if((r->content->static_mesh[j].mesh->transparency_polygons != NULL) && Frustum_IsOBBVisibleInFrustumList(r->content->static_mesh[j].obb, (r->frustum) ? (r->frustum) : (m_camera->frustum)))
+                if((r->content->static_mesh[j].mesh->transparency_polygons != NULL) && Frustum_IsOBBVisibleInFrustumList(r->content->static_mesh[j].obb, (r->frustum) ? (r->frustum) : (m_camera->frustum)) &&
+                   occlusionBuffer->IsOBBVisible(r->content->static_mesh[j].obb))
                 {
                     dynamicBSP->AddNewPolygonList(r->content->static_mesh[j].mesh->transparency_polygons, r->content->static_mesh[j].transform, m_camera->frustum);
                 }
@@ -383,7 +462,8 @@ void CRender::DrawList()
                 if(cont->object_type == OBJECT_ENTITY)
                 {
                     entity_p ent = (entity_p)cont->object;
-                    if((ent->state_flags & ENTITY_STATE_VISIBLE) && ent->bf->animations.model && (ent->bf->animations.model->transparency_flags == MESH_HAS_TRANSPARENCY) && Frustum_IsOBBVisibleInFrustumList(ent->obb, (r->frustum) ? (r->frustum) : (m_camera->frustum)))
+                    if((ent->state_flags & ENTITY_STATE_VISIBLE) && ent->bf->animations.model && (ent->bf->animations.model->transparency_flags == MESH_HAS_TRANSPARENCY) && Frustum_IsOBBVisibleInFrustumList(ent->obb, (r->frustum) ? (r->frustum) : (m_camera->frustum)) &&
+                       occlusionBuffer->IsOBBVisible(ent->obb))
                     {
                         float tr[16];
                         for(uint16_t j = 0; j < ent->bf->bone_tag_count; j++)
@@ -754,6 +834,7 @@ void CRender::DrawMesh(struct base_mesh_s *mesh, const float *overrideVertices,
             }
             qglDrawElements(GL_TRIANGLES, face->elements_count, GL_UNSIGNED_INT, face->elements);
         }
+        frame_stats.draw_calls += mesh->animated_faces_count;
     }
 
     if(mesh->vertex_count == 0)
@@ -790,6 +871,7 @@ void CRender::DrawMesh(struct base_mesh_s *mesh, const float *overrideVertices,
         }
         qglDrawElements(GL_TRIANGLES, face->elements_count, GL_UNSIGNED_INT, face->elements);
     }
+    frame_stats.draw_calls += mesh->faces_count;
 }
 
 void CRender::DrawSkinMesh(struct base_mesh_s *mesh, struct base_mesh_s *parent_mesh, uint32_t *map, float transform[16])
@@ -892,6 +974,11 @@ void CRender::DrawSkeletalModel(const lit_shader_description *shader, struct ss_
     }
 }
 
+void CRender::ResetActiveTexture()
+{
+    m_active_texture = 0;
+}
+
 void CRender::DrawEntity(struct entity_s *entity, const float modelViewMatrix[16], const float modelViewProjectionMatrix[16])
 {
     if(!(entity->state_flags & ENTITY_STATE_VISIBLE) || (entity->bf->animations.model->hide && !(r_flags & R_DRAW_NULLMESHES)))
@@ -1063,8 +1150,10 @@ void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], con
         for(uint32_t i = 0; i < room->content->static_mesh_count; i++)
         {
             if((!room->content->static_mesh[i].hide || (r_flags & R_DRAW_DUMMY_STATICS)) &&
-               Frustum_IsOBBVisibleInFrustumList(room->content->static_mesh[i].obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)))
+               Frustum_IsOBBVisibleInFrustumList(room->content->static_mesh[i].obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)) &&
+               occlusionBuffer->IsOBBVisible(room->content->static_mesh[i].obb))
             {
+                frame_stats.statics++;
                 Mat4_Mat4_mul(transform, modelViewProjectionMatrix, room->content->static_mesh[i].transform);
                 qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, transform);
                 qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
@@ -1090,8 +1179,10 @@ void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], con
         {
         case OBJECT_ENTITY:
             ent = (entity_p)cont->object;
-            if(Frustum_IsOBBVisibleInFrustumList(ent->obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)))
+            if(Frustum_IsOBBVisibleInFrustumList(ent->obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)) &&
+               occlusionBuffer->IsOBBVisible(ent->obb))
             {
+                frame_stats.entities++;
                 this->DrawEntity(ent, modelViewMatrix, modelViewProjectionMatrix);
             }
             break;
@@ -1110,8 +1201,10 @@ void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], con
                 {
                     if(OBB_OBB_Test(near_room->content->static_mesh[si].obb, room->obb, 0.0f) &&
                        Frustum_IsOBBVisibleInFrustumList(near_room->content->static_mesh[si].obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)) &&
-                       (!near_room->content->static_mesh[si].hide || (r_flags & R_DRAW_DUMMY_STATICS)))
+                       (!near_room->content->static_mesh[si].hide || (r_flags & R_DRAW_DUMMY_STATICS)) &&
+                       occlusionBuffer->IsOBBVisible(near_room->content->static_mesh[si].obb))
                     {
+                        frame_stats.statics++;
                         qglUseProgramObjectARB(shader->program);
                         Mat4_Mat4_mul(transform, modelViewProjectionMatrix, near_room->content->static_mesh[si].transform);
                         qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, transform);
@@ -1139,8 +1232,10 @@ void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], con
                 case OBJECT_ENTITY:
                     ent = (entity_p)cont->object;
                     if(OBB_OBB_Test(ent->obb, room->obb, 0.0f) &&
-                       Frustum_IsOBBVisibleInFrustumList(ent->obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)))
+                       Frustum_IsOBBVisibleInFrustumList(ent->obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)) &&
+                       occlusionBuffer->IsOBBVisible(ent->obb))
                     {
+                        frame_stats.entities++;
                         this->DrawEntity(ent, modelViewMatrix, modelViewProjectionMatrix);
                     }
                     break;
@@ -1290,112 +1385,202 @@ int CRender::ProcessRoom(struct portal_s *portal, struct frustum_s *frus)
 }
 
 /**
- * Sets up the light calculations for the given entity based on its current
- * room. Returns the used shader, which will have been made current already.
+ * Takes out of the list the rooms whose portal windows are all behind the
+ * occluders of the listed rooms. If a hidden room gave occluders, the buffer
+ * is drawn again from the rooms that stay only, so nothing that is not drawn
+ * hides anything; with less occluders no room can become hidden.
  */
-const lit_shader_description *CRender::SetupEntityLight(struct entity_s *entity, const float modelViewMatrix[16])
+void CRender::CullOccludedRooms()
 {
-    // Calculate lighting
-    const lit_shader_description *shader;
+    uint8_t *visible;
+    size_t buf_size;
+    uint32_t count = 0;
 
-    room_s *room = entity->self->room;
-    if(room != NULL)
+    if(!settings.occlusion_culling || !m_room_occluders || (r_list_active_count < 2) ||
+       (r_flags & (R_SKIP_ROOM | R_DRAW_WIRE | R_DRAW_POINTS)))
     {
-        GLfloat ambient_component[4];
-
-        ambient_component[0] = room->content->ambient_lighting[0];
-        ambient_component[1] = room->content->ambient_lighting[1];
-        ambient_component[2] = room->content->ambient_lighting[2];
-        ambient_component[3] = 1.0f;
+        return;
+    }
 
-        if(room->content->room_flags & TR_ROOM_FLAG_WATER)
+    buf_size = r_list_active_count * sizeof(uint8_t);
+    visible = (uint8_t*)Sys_GetTempMem(buf_size);
+    for(int pass = 0; pass < 2; pass++)
+    {
+        bool hidden_occluders = false;
+        occlusionBuffer->Begin(m_camera->gl_view_proj_mat, m_camera->transform.M4x4 + 12);
+        for(uint32_t i = 0; i < r_list_active_count; i++)
         {
-            CalculateWaterTint(ambient_component, 0);
+            if((pass == 0) || visible[i])
+            {
+                occlusionBuffer->AddOccluders(this->GetRoomOccluders(r_list[i].room));
+            }
         }
+        occlusionBuffer->End();
 
-        GLenum current_light_number = 0;
-        light_s *current_light = NULL;
+        for(uint32_t i = 0; i < r_list_active_count; i++)
+        {
+            room_p room = r_list[i].room;
+            visible[i] = (room->frustum == NULL);                                // rooms with the camera inside stay
+            for(frustum_p f = room->frustum; f && !visible[i]; f = f->next)
+            {
+                visible[i] = occlusionBuffer->IsPolygonVisible(f->vertex, f->vertex_count);
+            }
+            hidden_occluders |= !visible[i] && this->GetRoomOccluders(room)->count;
+        }
 
-        GLfloat positions[3*MAX_NUM_LIGHTS];
-        GLfloat colors[4*MAX_NUM_LIGHTS];
-        GLfloat innerRadiuses[1*MAX_NUM_LIGHTS];
-        GLfloat outerRadiuses[1*MAX_NUM_LIGHTS];
-        memset(positions, 0, sizeof(positions));
-        memset(colors, 0, sizeof(colors));
-        memset(innerRadiuses, 0, sizeof(innerRadiuses));
-        memset(outerRadiuses, 0, sizeof(outerRadiuses));
+        if(!hidden_occluders)
+        {
+            break;
+        }
+        occlusionBuffer->stats.rebuilds++;
+    }
 
-        float *entity_pos = entity->transform.M4x4 + 12;
+    r_flags &= ~R_DRAW_SKYBOX;
+    for(uint32_t i = 0; i < r_list_active_count; i++)
+    {
+        room_p room = r_list[i].room;
+        occlusionBuffer->stats.rooms_tested += (room->frustum) ? (1) : (0);
+        if(visible[i])
+        {
+            r_list[count++] = r_list[i];
+            if(room->content->room_flags & TR_ROOM_FLAG_SKYBOX)
+            {
+                r_flags |= R_DRAW_SKYBOX;
+            }
+        }
+        else
+        {
+            room->is_in_r_list = 0;
+            occlusionBuffer->stats.rooms_culled++;
+        }
+    }
+    for(uint32_t i = count; i < r_list_active_count; i++)
+    {
+        r_list[i].active = 0;
+        r_list[i].dist = 0.0;
+        r_list[i].room = NULL;
+    }
+    r_list_active_count = count;
+    occlusionBuffer->stats.frames++;
+    Sys_ReturnTempMem(buf_size);
+}
 
-        for(uint32_t i = 0; (i < room->content->lights_count) && (current_light_number < MAX_NUM_LIGHTS); i++)
+struct render_room_lights_s *CRender::GetRoomLights(struct room_s *room)
+{
+    uint32_t i = room - m_rooms;
+    if(!m_room_lights || (room < m_rooms) || (i >= m_rooms_count))
+    {
+        return NULL;
+    }
+    if(m_room_lights[i].content != room->content)
+    {
+        if(m_room_lights[i].content)                                            // flipped: entities drop the lights they kept
         {
-            current_light = &room->content->lights[i];
+            m_lights_generation++;
+        }
+        Render_BuildRoomLights(m_room_lights + i, room);
+    }
+    return m_room_lights + i;
+}
 
-            float x = entity_pos[0] - current_light->pos[0];
-            float y = entity_pos[1] - current_light->pos[1];
-            float z = entity_pos[2] - current_light->pos[2];
 
-            float distance = sqrtf(x * x + y * y + z * z);
+struct occluder_list_s *CRender::GetRoomOccluders(struct room_s *room)
+{
+    uint32_t i = room - m_rooms;
+    if(!m_room_occluders || (room < m_rooms) || (i >= m_rooms_count))
+    {
+        return NULL;
+    }
+    if(m_room_occluders[i].content != room->content)                           // flipped
+    {
+        Occlusion_BuildRoomOccluders(m_room_occluders + i, room);
+    }
+    return m_room_occluders + i;
+}
 
-            // Find color
-            colors[current_light_number*4 + 0] = std::fmin(std::fmax(current_light->colour[0], 0.0), 1.0);
-            colors[current_light_number*4 + 1] = std::fmin(std::fmax(current_light->colour[1], 0.0), 1.0);
-            colors[current_light_number*4 + 2] = std::fmin(std::fmax(current_light->colour[2], 0.0), 1.0);
-            colors[current_light_number*4 + 3] = std::fmin(std::fmax(current_light->colour[3], 0.0), 1.0);
 
-            if(room->content->room_flags & TR_ROOM_FLAG_WATER)
-            {
-                CalculateWaterTint(colors + current_light_number * 4, 0);
-            }
+/**
+ * Chooses the entity lights, or keeps the ones it has while it stays in the
+ * same room and sector and near the place they were chosen at.
+ */
+struct render_room_lights_s *CRender::SelectEntityLights(struct entity_s *entity)
+{
+    entity_lights_p cache = &entity->lights;
+    room_s *room = entity->self->room;
+    render_room_lights_p list = (room) ? (this->GetRoomLights(room)) : (NULL);
+    float *pos = entity->transform.M4x4 + 12;
+    float d[3];
 
-            // Find position
-            Mat4_vec3_mul(&positions[3*current_light_number], modelViewMatrix, current_light->pos);
+    if(!list)
+    {
+        cache->room = NULL;
+        cache->count = 0;
+        return NULL;
+    }
 
-            // Find fall-off
-            if(current_light->light_type == LT_SUN)
-            {
-                innerRadiuses[current_light_number] = 1e20f;
-                outerRadiuses[current_light_number] = 1e21f;
-                current_light_number++;
-            }
-            else if(distance <= current_light->outer + 1024.0f && (current_light->light_type == LT_POINT || current_light->light_type == LT_SHADOW))
-            {
-                innerRadiuses[current_light_number] = std::fabs(current_light->inner);
-                outerRadiuses[current_light_number] = std::fabs(current_light->outer);
-                current_light_number++;
-            }
-        }
+    vec3_sub(d, pos, cache->pos);
+    if((cache->room != room) || (cache->sector != entity->self->sector) || (cache->generation != m_lights_generation) ||
+       (vec3_dot(d, d) > RENDER_LIGHT_MOVE_THRESHOLD * RENDER_LIGHT_MOVE_THRESHOLD))
+    {
+        float radius = (entity->obb) ? (entity->obb->radius) : (0.0f);
+        cache->room = room;
+        cache->sector = entity->self->sector;
+        cache->generation = m_lights_generation;
+        vec3_copy(cache->pos, pos);
+        cache->count = Render_SelectLights(list, pos, radius, cache->index, ENTITY_MAX_LIGHTS);
+    }
 
-        for(uint32_t room_index = 0; (current_light_number < MAX_NUM_LIGHTS) && (room_index < room->content->near_room_list_size); room_index++)
-        {
-            room_p near_room = room->content->near_room_list[room_index];
-            for(uint32_t i = 0; (i < near_room->content->lights_count) && (current_light_number < MAX_NUM_LIGHTS); i++)
-            {
-                current_light = &near_room->content->lights[i];
+    return list;
+}
 
-                float x = entity_pos[0] - current_light->pos[0];
-                float y = entity_pos[1] - current_light->pos[1];
-                float z = entity_pos[2] - current_light->pos[2];
+/**
+ * Fills the shader light arrays for the entity: colours and fall-off are ready
+ * in the room list, only the positions go to the view space.
+ */
+uint16_t CRender::GetEntityLights(struct entity_s *entity, const float modelViewMatrix[16], float *positions, float *colors, float *inner, float *outer)
+{
+    render_room_lights_p list = this->SelectEntityLights(entity);
+    uint16_t count = (list) ? (entity->lights.count) : (0);
 
-                float distance = sqrtf(x * x + y * y + z * z);
+    for(uint16_t i = 0; i < count; i++)
+    {
+        render_light_p light = list->lights + entity->lights.index[i];
+        Mat4_vec3_mul(positions + 3 * i, modelViewMatrix, light->pos);
+        vec4_copy(colors + 4 * i, light->colour);
+        inner[i] = light->inner;
+        outer[i] = light->outer;
+    }
 
-                // Find color
-                colors[current_light_number*4 + 0] = std::fmin(std::fmax(current_light->colour[0], 0.0), 1.0);
-                colors[current_light_number*4 + 1] = std::fmin(std::fmax(current_light->colour[1], 0.0), 1.0);
-                colors[current_light_number*4 + 2] = std::fmin(std::fmax(current_light->colour[2], 0.0), 1.0);
-                colors[current_light_number*4 + 3] = std::fmin(std::fmax(current_light->colour[3], 0.0), 1.0);
+    return count;
+}
 
-                // Find position
-                Mat4_vec3_mul(&positions[3*current_light_number], modelViewMatrix, current_light->pos);
+/**
+ * Sets up the light calculations for the given entity based on its current
+ * room. Returns the used shader, which will have been made current already.
+ */
+const lit_shader_description *CRender::SetupEntityLight(struct entity_s *entity, const float modelViewMatrix[16])
+{
+    // Calculate lighting
+    const lit_shader_description *shader;
 
-                // Find fall-off
-                if(distance <= current_light->outer + 1024.0f && (current_light->light_type == LT_POINT || current_light->light_type == LT_SHADOW))
-                {
-                    innerRadiuses[current_light_number] = std::fabs(current_light->inner);
-                    outerRadiuses[current_light_number] = std::fabs(current_light->outer);
-                    current_light_number++;
-                }
-            }
+    room_s *room = entity->self->room;
+    if(room != NULL)
+    {
+        GLfloat ambient_component[4];
+        GLfloat positions[3*MAX_NUM_LIGHTS];
+        GLfloat colors[4*MAX_NUM_LIGHTS];
+        GLfloat innerRadiuses[1*MAX_NUM_LIGHTS];
+        GLfloat outerRadiuses[1*MAX_NUM_LIGHTS];
+        GLenum current_light_number = this->GetEntityLights(entity, modelViewMatrix, positions, colors, innerRadiuses, outerRadiuses);
+
+        ambient_component[0] = room->content->ambient_lighting[0];
+        ambient_component[1] = room->content->ambient_lighting[1];
+        ambient_component[2] = room->content->ambient_lighting[2];
+        ambient_component[3] = 1.0f;
+
+        if(room->content->room_flags & TR_ROOM_FLAG_WATER)
+        {
+            CalculateWaterTint(ambient_component, 0);
         }
 
         shader = shaderManager->getEntityShader(current_light_number);
@@ -54,14 +54,55 @@ typedef struct render_settings_s
     int8_t    antialias;
     int8_t    antialias_samples;
     int8_t    texture_border;
+    int8_t    texture_cache;
     int8_t    z_depth;
     int8_t    fog_enabled;
+    int8_t    occlusion_culling;
     GLfloat   fog_color[4];
     float     fog_start_depth;
     float     fog_end_depth;
     bool      show_fps;
 }render_settings_t, *render_settings_p;
 
+/*
+ * Entity lights: each room gets a list of the lights that may reach entities
+ * in it, its own lights first, then the point lights of the near rooms. The
+ * colours are clamped (and tinted in water rooms) once, when it is built.
+ */
+#define RENDER_LIGHT_REACH_MARGIN       (1024.0f)   // lights are taken up to this far past their outer radius
+#define RENDER_LIGHT_MOVE_THRESHOLD     (256.0f)    // entities moving less than that keep their lights
+
+typedef struct render_light_s
+{
+    float       pos[3];
+    float       colour[4];
+    float       inner;
+    float       outer;
+    float       reach;                  // not taken farther than that
+    float       strength;               // colour sum, the contribution is strength * (1 - d / outer)
+}render_light_t, *render_light_p;
+
+typedef struct render_room_lights_s
+{
+    struct room_content_s *content;     // built for it; flipped rooms build again
+    uint32_t            count;
+    render_light_p      lights;
+}render_room_lights_t, *render_room_lights_p;
+
+void Render_BuildRoomLights(struct render_room_lights_s *list, struct room_s *room);
+void Render_FreeRoomLights(struct render_room_lights_s *list);
+// the strongest lights at pos for a body of that radius, strongest first; returns their count
+uint16_t Render_SelectLights(struct render_room_lights_s *list, const float pos[3], float radius, uint16_t *index, uint16_t max_count);
+
+
+typedef struct render_frame_stats_s
+{
+    uint32_t    rooms;
+    uint32_t    statics;
+    uint32_t    entities;
+    uint32_t    draw_calls;                 // glDrawElements of the meshes, reset by GenWorldList
+}render_frame_stats_t, *render_frame_stats_p;
+
 
 class CRender
 {
@@ -69,6 +110,7 @@ class CRender
         CRender();
        ~CRender();
         void DoShaders();
+        void DeleteShaders();                   // before the GL context goes
         void ResetWorld(struct room_s *rooms, uint32_t rooms_count, struct anim_seq_s *anim_sequences, uint32_t anim_sequences_count);
         void UpdateAnimTextures();
 
@@ -86,6 +128,7 @@ class CRender
         void DrawSkyBox(const float matrix[16]);
 
         void DrawSkeletalModel(const struct lit_shader_description *shader, struct ss_bone_frame_s *bframe, const float mvMatrix[16], const float mvpMatrix[16]);
+        void ResetActiveTexture();                                             // after textures were bound outside of the renderer
         void DrawEntity(struct entity_s *entity, const float modelViewMatrix[16], const float modelViewProjectionMatrix[16]);
 
         void DrawRoom(struct room_s *room, const float matrix[16], const float modelViewProjectionMatrix[16]);
@@ -93,6 +136,10 @@ class CRender
 
         struct gl_text_line_s *OutTextXYZ(GLfloat x, GLfloat y, GLfloat z, const char *fmt, ...);
 
+        struct render_room_lights_s *GetRoomLights(struct room_s *room);
+        struct occluder_list_s *GetRoomOccluders(struct room_s *room);
+        uint16_t GetEntityLights(struct entity_s *entity, const float modelViewMatrix[16], float *positions, float *colors, float *inner, float *outer);
+
     private:
         struct render_list_s
         {
@@ -104,7 +151,9 @@ class CRender
         void InitSettings();
         int  AddRoom(struct room_s *room);
         int  ProcessRoom(struct portal_s *portal, struct frustum_s *frus);
+        void CullOccludedRooms();
         const lit_shader_description *SetupEntityLight(struct entity_s *entity, const float modelViewMatrix[16]);
+        struct render_room_lights_s *SelectEntityLights(struct entity_s *entity);
 
         struct camera_s            *m_camera;
 
@@ -121,12 +170,17 @@ class CRender
         uint32_t                    r_list_active_count;
         struct render_list_s       *r_list;
         class CFrustumManager      *frustumManager;
+        struct render_room_lights_s *m_room_lights;
+        uint32_t                    m_lights_generation;
+        struct occluder_list_s     *m_room_occluders;
 
     public:
         struct render_settings_s    settings;
         class shader_manager       *shaderManager;
         class CRenderDebugDrawer   *debugDrawer;
         class CDynamicBSP          *dynamicBSP;
+        class COcclusionBuffer     *occlusionBuffer;
+        struct render_frame_stats_s frame_stats;
         uint32_t                    r_flags;
 };
 
@@ -0,0 +1,135 @@
+
+#include <cmath>
+#include <stdlib.h>
+#include <SDL2/SDL_platform.h>
+#include <SDL2/SDL_opengl.h>
+
+#include "../core/vmath.h"
+#include "render.h"
+#include "shader_manager.h"
+#include "../room.h"
+#include "../mesh.h"
+
+void CalculateWaterTint(GLfloat *tint, uint8_t fixed_colour);
+
+static void Render_AddRoomLight(render_room_lights_p list, light_p light, int water)
+{
+    render_light_p l = list->lights + list->count++;
+
+    vec3_copy(l->pos, light->pos);
+    for(int i = 0; i < 4; i++)
+    {
+        l->colour[i] = std::fmin(std::fmax(light->colour[i], 0.0), 1.0);
+    }
+    if(water)
+    {
+        CalculateWaterTint(l->colour, 0);
+    }
+
+    if(light->light_type == LT_SUN)
+    {
+        l->inner = 1e20f;
+        l->outer = 1e21f;
+        l->reach = 1e21f;
+    }
+    else
+    {
+        l->inner = std::fabs(light->inner);
+        l->outer = std::fabs(light->outer);
+        l->reach = light->outer + RENDER_LIGHT_REACH_MARGIN;
+    }
+    l->strength = l->colour[0] + l->colour[1] + l->colour[2];
+}
+
+
+void Render_BuildRoomLights(struct render_room_lights_s *list, struct room_s *room)
+{
+    uint32_t count = room->content->lights_count;
+    int water = (room->content->room_flags & TR_ROOM_FLAG_WATER) ? (1) : (0);
+
+    for(uint16_t i = 0; i < room->content->near_room_list_size; i++)
+    {
+        count += room->content->near_room_list[i]->content->lights_count;
+    }
+
+    Render_FreeRoomLights(list);
+    list->content = room->content;
+    list->lights = (count) ? ((render_light_p)malloc(count * sizeof(render_light_t))) : (NULL);
+
+    // the sun lights only its own room, near rooms give their point lights, untinted
+    for(uint32_t i = 0; i < room->content->lights_count; i++)
+    {
+        light_p light = room->content->lights + i;
+        if((light->light_type == LT_SUN) || (light->light_type == LT_POINT) || (light->light_type == LT_SHADOW))
+        {
+            Render_AddRoomLight(list, light, water);
+        }
+    }
+    for(uint16_t i = 0; i < room->content->near_room_list_size; i++)
+    {
+        room_p near_room = room->content->near_room_list[i];
+        for(uint32_t j = 0; j < near_room->content->lights_count; j++)
+        {
+            light_p light = near_room->content->lights + j;
+            if((light->light_type == LT_POINT) || (light->light_type == LT_SHADOW))
+            {
+                Render_AddRoomLight(list, light, 0);
+            }
+        }
+    }
+}
+
+
+void Render_FreeRoomLights(struct render_room_lights_s *list)
+{
+    if(list->lights)
+    {
+        free(list->lights);
+        list->lights = NULL;
+    }
+    list->count = 0;
+    list->content = NULL;
+}
+
+
+uint16_t Render_SelectLights(struct render_room_lights_s *list, const float pos[3], float radius, uint16_t *index, uint16_t max_count)
+{
+    float score[MAX_NUM_LIGHTS];
+    uint16_t count = 0;
+
+    max_count = (max_count < MAX_NUM_LIGHTS) ? (max_count) : (MAX_NUM_LIGHTS);
+    for(uint32_t i = 0; i < list->count; i++)
+    {
+        render_light_p l = list->lights + i;
+        float d[3], dist, t;
+        uint16_t j;
+
+        vec3_sub(d, pos, l->pos);
+        dist = vec3_abs(d);
+        if(dist > l->reach)
+        {
+            continue;
+        }
+
+        // what reaches the nearest side of the body, as the entity shader attenuates it
+        t = (dist > radius) ? (1.0f - (dist - radius) / l->outer) : (1.0f);
+        t = l->strength * ((t > 0.0f) ? (t) : (0.0f));
+
+        // sorted insert, equal ones keep the list order
+        for(j = count; (j > 0) && (score[j - 1] < t); j--);
+        if(j >= max_count)
+        {
+            continue;
+        }
+        count = (count < max_count) ? (count + 1) : (count);
+        for(uint16_t k = count - 1; k > j; k--)
+        {
+            score[k] = score[k - 1];
+            index[k] = index[k - 1];
+        }
+        score[j] = t;
+        index[j] = i;
+    }
+
+    return count;
+}
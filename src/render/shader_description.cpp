@@ -6,35 +6,259 @@
 //  Copyright (c) 2015 Torsten Kammer. All rights reserved.
 //
 
+#include <SDL2/SDL_filesystem.h>
+#include <SDL2/SDL_stdinc.h>
+#include <SDL2/SDL_timer.h>
+
 #include "shader_description.h"
 #include "../engine.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 
+#define SHADER_CACHE_MAGIC      (0x4853544F)    // "OTSH"
+#define SHADER_CACHE_VERSION    (1)
+
+// ARB handles are the program names of GL 2.0 everywhere program binaries exist
+#define SHADER_PROGRAM_NAME(program) ((GLuint)(uintptr_t)(program))
+
+typedef struct shader_cache_header_s
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint64_t    hash;                   // the same as in the file name
+    uint32_t    format;                 // binaryFormat of glGetProgramBinary
+    uint32_t    size;
+}shader_cache_header_t, *shader_cache_header_p;
+
+static struct
+{
+    int                     load;
+    int                     save;
+    uint64_t                driver_hash;
+    shader_cache_stats_t    stats;
+} shader_cache = {1, 1, 0};
+
+
 shader_stage::shader_stage(GLenum type, const char *filename, const char *additionalDefines)
+: type(type), source(NULL), defines(NULL), shader(0)
 {
     char shader_path[1024];
     size_t shader_path_base_len = sizeof(shader_path) - 1;
     strncpy(shader_path, Engine_GetBasePath(), shader_path_base_len);
     shader_path[shader_path_base_len] = 0;
     strncat(shader_path, filename, shader_path_base_len - strlen(shader_path));
-    shader = qglCreateShaderObjectARB(type);
-    if (!loadShaderFromFile(shader, shader_path, additionalDefines))
+    source = loadShaderSource(shader_path);
+    if (!source)
         abort();
+    if (additionalDefines)
+        defines = strdup(additionalDefines);
 }
 
 shader_stage::~shader_stage()
 {
-    qglDeleteObjectARB(shader);
+    if (shader)
+        qglDeleteObjectARB(shader);
+    free(source);
+    free(defines);
+}
+
+GLhandleARB shader_stage::compile() const
+{
+    if (!shader)
+    {
+        shader = qglCreateShaderObjectARB(type);
+        if (!loadShaderFromBuff(shader, source, defines))
+            abort();
+    }
+    return shader;
+}
+
+
+static uint64_t ShaderCache_HashString(uint64_t hash, const char *str)
+{
+    if (str)
+    {
+        for (; *str; ++str)
+        {
+            hash = (hash ^ (uint8_t)*str) * 0x100000001B3;
+        }
+    }
+    return (hash ^ 0xFF) * 0x100000001B3;           // end mark, so moving text from defines to source changes the hash
+}
+
+
+static uint64_t ShaderCache_Hash(const shader_stage &vertex, const shader_stage &fragment)
+{
+    uint64_t hash;
+
+    if (!shader_cache.driver_hash)
+    {
+        hash = 0xCBF29CE484222325;                  // FNV-1a
+        hash = ShaderCache_HashString(hash, (const char*)qglGetString(GL_RENDERER));
+        shader_cache.driver_hash = ShaderCache_HashString(hash, (const char*)qglGetString(GL_VERSION));
+    }
+    hash = ShaderCache_HashString(shader_cache.driver_hash, vertex.defines);
+    hash = ShaderCache_HashString(hash, vertex.source);
+    hash = ShaderCache_HashString(hash, fragment.defines);
+    return ShaderCache_HashString(hash, fragment.source);
+}
+
+
+static void ShaderCache_GetFilePath(char *path, size_t size, uint64_t hash)
+{
+    char *cache_path = SDL_GetPrefPath("OpenTomb", "cache");
+
+    path[0] = 0;
+    if (cache_path)
+    {
+        snprintf(path, size, "%sshader_%016llx.bin", cache_path, (unsigned long long)hash);
+        SDL_free(cache_path);
+    }
 }
 
+
+// returns a linked program, or 0 if there is no binary or the driver does not take it
+static GLhandleARB ShaderCache_Load(const char *path, uint64_t hash)
+{
+    shader_cache_header_t header;
+    GLhandleARB program = 0;
+    long file_size;
+    FILE *f;
+
+    if (!qglProgramBinary || !path[0] || !(f = fopen(path, "rb")))
+    {
+        return 0;
+    }
+
+    fseek(f, 0, SEEK_END);
+    file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    // the size comes from the file, it can not be more than the file has after the header
+    if ((file_size >= (long)sizeof(header)) && (fread(&header, sizeof(header), 1, f) == 1) && (header.magic == SHADER_CACHE_MAGIC) &&
+       (header.version == SHADER_CACHE_VERSION) && (header.hash == hash) && (header.size > 0) &&
+       ((long)header.size <= file_size - (long)sizeof(header)))
+    {
+        void *binary = malloc(header.size);
+        if (binary && (fread(binary, header.size, 1, f) == 1))
+        {
+            GLint status = 0;
+            program = qglCreateProgramObjectARB();
+            qglProgramBinary(SHADER_PROGRAM_NAME(program), header.format, binary, header.size);
+            qglGetObjectParameterivARB(program, GL_OBJECT_LINK_STATUS_ARB, &status);
+            if (!status)
+            {
+                // driver update or a format it does not know any more
+                checkOpenGLError();
+                qglDeleteObjectARB(program);
+                program = 0;
+                shader_cache.stats.binaries_rejected++;
+            }
+        }
+        free(binary);
+    }
+    fclose(f);
+
+    return program;
+}
+
+
+static void ShaderCache_Save(GLhandleARB program, const char *path, uint64_t hash)
+{
+    GLuint name = SHADER_PROGRAM_NAME(program);
+    GLint status = 0;
+    GLint size = 0;
+    FILE *f;
+
+    if (!qglGetProgramBinary || !path[0])
+    {
+        return;
+    }
+
+    qglGetObjectParameterivARB(program, GL_OBJECT_LINK_STATUS_ARB, &status);
+    qglGetProgramiv(name, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (status && (size > 0))
+    {
+        shader_cache_header_t header;
+        GLenum format = 0;
+        GLsizei length = 0;
+        void *binary = malloc(size);
+
+        qglGetProgramBinary(name, size, &length, &format, binary);
+        if ((length > 0) && (f = fopen(path, "wb")))
+        {
+            header.magic = SHADER_CACHE_MAGIC;
+            header.version = SHADER_CACHE_VERSION;
+            header.hash = hash;
+            header.format = format;
+            header.size = length;
+            // a short write leaves a file the loader does not take, so nothing to undo here
+            if ((fwrite(&header, sizeof(header), 1, f) == 1) && (fwrite(binary, length, 1, f) == 1))
+            {
+                shader_cache.stats.binaries_saved++;
+            }
+            fclose(f);
+        }
+        free(binary);
+    }
+}
+
+
+void ShaderCache_SetMode(int load, int save)
+{
+    shader_cache.load = load;
+    shader_cache.save = save;
+}
+
+
+void ShaderCache_GetStats(shader_cache_stats_p stats)
+{
+    *stats = shader_cache.stats;
+}
+
+
+void ShaderCache_ResetStats()
+{
+    memset(&shader_cache.stats, 0, sizeof(shader_cache.stats));
+}
+
+
 shader_description::shader_description(const shader_stage &vertex, const shader_stage &fragment)
 {
-    program = qglCreateProgramObjectARB();
-    qglAttachObjectARB(program, vertex.shader);
-    qglAttachObjectARB(program, fragment.shader);
-    qglLinkProgramARB(program);
-    //printInfoLog(program);
+    uint64_t time = SDL_GetPerformanceCounter();
+    char path[1024] = {0};
+    uint64_t hash = 0;
+
+    if (shader_cache.load || shader_cache.save)
+    {
+        hash = ShaderCache_Hash(vertex, fragment);
+        ShaderCache_GetFilePath(path, sizeof(path), hash);
+    }
+
+    program = (shader_cache.load) ? (ShaderCache_Load(path, hash)) : (0);
+    if (program)
+    {
+        shader_cache.stats.programs_loaded++;
+    }
+    else
+    {
+        program = qglCreateProgramObjectARB();
+        qglAttachObjectARB(program, vertex.compile());
+        qglAttachObjectARB(program, fragment.compile());
+        if (qglProgramParameteri)
+        {
+            qglProgramParameteri(SHADER_PROGRAM_NAME(program), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        qglLinkProgramARB(program);
+        //printInfoLog(program);
+        shader_cache.stats.programs_linked++;
+        if (shader_cache.save)
+        {
+            ShaderCache_Save(program, path, hash);
+        }
+    }
+    shader_cache.stats.ticks += SDL_GetPerformanceCounter() - time;
 
     sampler = qglGetUniformLocationARB(program, "color_map");
 }
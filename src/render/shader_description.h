@@ -1,18 +1,48 @@
 #ifndef __OpenTomb__shader_description__
 #define __OpenTomb__shader_description__
 
+#include <stdint.h>
 #include <SDL2/SDL_platform.h>
 #include <SDL2/SDL_opengl.h>
 #include "../core/gl_util.h"
 
+/*!
+ * One stage of a program. The source is read when the stage is made, but
+ * only compiled when a program has to be linked from it, so programs that
+ * come from the binary cache never compile their stages.
+ */
 struct shader_stage
 {
-    GLhandleARB shader;
+    GLenum type;
+    char *source;
+    char *defines;
+    mutable GLhandleARB shader;
     
     shader_stage(GLenum type, const char *filename, const char *additionalDefines = 0);
     ~shader_stage();
+    
+    GLhandleARB compile() const;
 };
 
+/*
+ * Linked programs are kept on disk with glGetProgramBinary, one file per
+ * program, named by a hash of the GL renderer and version strings and the
+ * sources and defines of both stages. A binary the driver refuses is linked
+ * from source again and written over.
+ */
+typedef struct shader_cache_stats_s
+{
+    uint32_t    programs_loaded;        // from the binary cache
+    uint32_t    programs_linked;        // compiled and linked from source
+    uint32_t    binaries_rejected;      // found on disk, but glProgramBinary failed
+    uint32_t    binaries_saved;
+    uint64_t    ticks;                  // spent making programs, SDL performance counter
+}shader_cache_stats_t, *shader_cache_stats_p;
+
+void ShaderCache_SetMode(int load, int save);
+void ShaderCache_GetStats(shader_cache_stats_p stats);
+void ShaderCache_ResetStats();
+
 /*!
  * A shader description consists of a program, code to load the
  * program, and the indices of the various uniform values. Each
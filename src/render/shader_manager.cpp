@@ -4,48 +4,115 @@
 #include "shader_manager.h"
 
 shader_manager::shader_manager()
+: static_mesh_shader(0), text(0)
 {
-    //Color mult prog
-    static_mesh_shader = new unlit_tinted_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/static_mesh.vsh"), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/static_mesh.fsh"));
-
-    //Room prog
-    shader_stage roomFragmentShader(GL_FRAGMENT_SHADER_ARB, "shaders/room.fsh");
     for (int isWater = 0; isWater < 2; isWater++)
     {
         for (int isFlicker = 0; isFlicker < 2; isFlicker++)
         {
-            std::ostringstream stream;
-            stream << "#define IS_WATER " << isWater << std::endl;
-            stream << "#define IS_FLICKER " << isFlicker << std::endl;
+            room_shaders[isWater][isFlicker] = 0;
+        }
+    }
+    for (int i = 0; i <= MAX_NUM_LIGHTS; i++)
+    {
+        entity_shader[i] = 0;
+    }
+}
 
-            room_shaders[isWater][isFlicker] = new unlit_tinted_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/room.vsh", stream.str().c_str()), roomFragmentShader);
+shader_manager::~shader_manager()
+{
+    // no GL here: it may run at exit, after the context is gone; deletePrograms() did the work
+}
+
+void shader_manager::deletePrograms()
+{
+    delete static_mesh_shader;
+    static_mesh_shader = 0;
+    delete text;
+    text = 0;
+    for (int isWater = 0; isWater < 2; isWater++)
+    {
+        for (int isFlicker = 0; isFlicker < 2; isFlicker++)
+        {
+            delete room_shaders[isWater][isFlicker];
+            room_shaders[isWater][isFlicker] = 0;
         }
     }
+    for (int i = 0; i <= MAX_NUM_LIGHTS; i++)
+    {
+        delete entity_shader[i];
+        entity_shader[i] = 0;
+    }
+}
 
-    // Entity prog
-    shader_stage entityVertexShader(GL_VERTEX_SHADER_ARB, "shaders/entity.vsh");
-    for (int i = 0; i <= MAX_NUM_LIGHTS; i++) {
+const lit_shader_description *shader_manager::getEntityShader(unsigned numberOfLights)
+{
+    assert(numberOfLights <= MAX_NUM_LIGHTS);
+
+    if (!entity_shader[numberOfLights])
+    {
+        // Entity prog
         std::ostringstream stream;
-        stream << "#define NUMBER_OF_LIGHTS " << i << std::endl;
+        stream << "#define NUMBER_OF_LIGHTS " << numberOfLights << std::endl;
 
-        entity_shader[i] = new lit_shader_description(entityVertexShader, shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/entity.fsh", stream.str().c_str()));
+        entity_shader[numberOfLights] = new lit_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/entity.vsh"), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/entity.fsh", stream.str().c_str()));
     }
-
-    text = new text_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/text.vsh"), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/text.fsh"));
+    return entity_shader[numberOfLights];
 }
 
-shader_manager::~shader_manager()
+const unlit_tinted_shader_description *shader_manager::getStaticMeshShader()
 {
-    // Do nothing. All shaders are released by OpenGL anyway.
+    if (!static_mesh_shader)
+    {
+        //Color mult prog
+        static_mesh_shader = new unlit_tinted_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/static_mesh.vsh"), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/static_mesh.fsh"));
+    }
+    return static_mesh_shader;
 }
 
-const lit_shader_description *shader_manager::getEntityShader(unsigned numberOfLights) const {
-    assert(numberOfLights <= MAX_NUM_LIGHTS);
+const unlit_tinted_shader_description *shader_manager::getRoomShader(bool isFlickering, bool isWater)
+{
+    unlit_tinted_shader_description *&shader = room_shaders[isWater ? 1 : 0][isFlickering ? 1 : 0];
 
-    return entity_shader[numberOfLights];
+    if (!shader)
+    {
+        //Room prog
+        std::ostringstream stream;
+        stream << "#define IS_WATER " << (isWater ? 1 : 0) << std::endl;
+        stream << "#define IS_FLICKER " << (isFlickering ? 1 : 0) << std::endl;
+
+        shader = new unlit_tinted_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/room.vsh", stream.str().c_str()), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/room.fsh"));
+    }
+    return shader;
+}
+
+const text_shader_description *shader_manager::getTextShader()
+{
+    if (!text)
+    {
+        text = new text_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/text.vsh"), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/text.fsh"));
+    }
+    return text;
 }
 
-const unlit_tinted_shader_description *shader_manager::getRoomShader(bool isFlickering, bool isWater) const
+int shader_manager::compileAll()
 {
-    return room_shaders[isWater ? 1 : 0][isFlickering ? 1 : 0];
+    int missing = (static_mesh_shader ? 0 : 1) + (text ? 0 : 1);
+
+    getStaticMeshShader();
+    getTextShader();
+    for (int isWater = 0; isWater < 2; isWater++)
+    {
+        for (int isFlicker = 0; isFlicker < 2; isFlicker++)
+        {
+            missing += (room_shaders[isWater][isFlicker]) ? 0 : 1;
+            getRoomShader(isFlicker != 0, isWater != 0);
+        }
+    }
+    for (int i = 0; i <= MAX_NUM_LIGHTS; i++)
+    {
+        missing += (entity_shader[i]) ? 0 : 1;
+        getEntityShader(i);
+    }
+    return missing;
 }
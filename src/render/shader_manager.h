@@ -6,6 +6,10 @@
 // Highest number of lights that will show up in the entity shader.
 #define MAX_NUM_LIGHTS 8
 
+/*!
+ * Programs are made on first use, so a level only pays for the variants
+ * it draws with. Most come from the binary cache after the first run.
+ */
 class shader_manager {
     unlit_tinted_shader_description *room_shaders[2][2];
     unlit_tinted_shader_description *static_mesh_shader;
@@ -16,13 +20,19 @@ public:
     shader_manager();
     ~shader_manager();
     
-    const lit_shader_description *getEntityShader(unsigned numberOfLights) const;
+    const lit_shader_description *getEntityShader(unsigned numberOfLights);
     
-    const unlit_tinted_shader_description *getStaticMeshShader() const { return static_mesh_shader; }
+    const unlit_tinted_shader_description *getStaticMeshShader();
     
-    const unlit_tinted_shader_description *getRoomShader(bool isFlickering, bool isWater) const;
+    const unlit_tinted_shader_description *getRoomShader(bool isFlickering, bool isWater);
     
-    const text_shader_description *getTextShader() const { return text; }
+    const text_shader_description *getTextShader();
+    
+    // makes all the variants now, returns how many were missing
+    int compileAll();
+
+    // deletes the programs made so far, while the GL context is still there
+    void deletePrograms();
 };
 
 #endif /* defined(__OpenTomb__shader_manager__) */
@@ -0,0 +1,178 @@
+#include "skyline_2d.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*!
+ * One horizontal segment of the skyline: everything below y in [x, x + width) is occupied.
+ */
+typedef struct skyline_2d_node_s
+{
+    unsigned x;
+    unsigned y;
+    unsigned width;
+} skyline_2d_node_t, *skyline_2d_node_p;
+
+/*!
+ * Segments are sorted by x, do not overlap and always cover the whole width.
+ */
+struct skyline_2d_s
+{
+    skyline_2d_node_p nodes;
+    unsigned nodes_count;
+    unsigned nodes_capacity;
+    unsigned width;
+    unsigned height;
+};
+
+#define SKYLINE_CAPACITY_GROWTH 32
+
+
+skyline_2d_p Skyline2D_Create(unsigned width, unsigned height)
+{
+    skyline_2d_p skyline = (skyline_2d_p)malloc(sizeof(struct skyline_2d_s));
+
+    skyline->nodes_capacity = SKYLINE_CAPACITY_GROWTH;
+    skyline->nodes = (skyline_2d_node_p)malloc(skyline->nodes_capacity * sizeof(skyline_2d_node_t));
+    skyline->nodes_count = 1;
+    skyline->nodes[0].x = 0;
+    skyline->nodes[0].y = 0;
+    skyline->nodes[0].width = width;
+    skyline->width = width;
+    skyline->height = height;
+
+    return skyline;
+}
+
+
+void Skyline2D_Destroy(skyline_2d_p skyline)
+{
+    if(skyline)
+    {
+        free(skyline->nodes);
+        free(skyline);
+    }
+}
+
+
+/*!
+ * Returns the lowest y where a rectangle of the given size, starting at node index, fits; or -1 if it does not fit at all.
+ */
+static long Skyline2D_Fit(skyline_2d_p skyline, unsigned index, unsigned width, unsigned height)
+{
+    unsigned x = skyline->nodes[index].x;
+    unsigned y = 0;
+    unsigned width_left = width;
+
+    if(x + width > skyline->width)
+    {
+        return -1;
+    }
+
+    for(unsigned i = index; width_left > 0; ++i)
+    {
+        assert(i < skyline->nodes_count);
+        if(skyline->nodes[i].y > y)
+        {
+            y = skyline->nodes[i].y;
+        }
+        if(y + height > skyline->height)
+        {
+            return -1;
+        }
+        width_left = (skyline->nodes[i].width < width_left) ? (width_left - skyline->nodes[i].width) : (0);
+    }
+
+    return (long)y;
+}
+
+
+int Skyline2D_FindSpaceFor(skyline_2d_p skyline, unsigned width, unsigned height, unsigned *x, unsigned *y)
+{
+    long best_y = -1;
+    unsigned best_index = 0;
+    unsigned best_width = 0;
+    skyline_2d_node_t node;
+
+    if((width == 0) || (height == 0))
+    {
+        *x = 0;
+        *y = 0;
+        return 1;
+    }
+
+    // Bottom-left rule: lowest position first, then the narrowest segment to waste less space.
+    for(unsigned i = 0; i < skyline->nodes_count; ++i)
+    {
+        long fit_y = Skyline2D_Fit(skyline, i, width, height);
+        if((fit_y >= 0) && ((best_y < 0) || (fit_y < best_y) ||
+           ((fit_y == best_y) && (skyline->nodes[i].width < best_width))))
+        {
+            best_y = fit_y;
+            best_index = i;
+            best_width = skyline->nodes[i].width;
+        }
+    }
+
+    if(best_y < 0)
+    {
+        return 0;
+    }
+
+    node.x = skyline->nodes[best_index].x;
+    node.y = (unsigned)best_y + height;
+    node.width = width;
+    *x = node.x;
+    *y = (unsigned)best_y;
+
+    if(skyline->nodes_count + 1 > skyline->nodes_capacity)
+    {
+        skyline->nodes_capacity += SKYLINE_CAPACITY_GROWTH;
+        skyline->nodes = (skyline_2d_node_p)realloc(skyline->nodes, skyline->nodes_capacity * sizeof(skyline_2d_node_t));
+    }
+
+    memmove(skyline->nodes + best_index + 1, skyline->nodes + best_index, (skyline->nodes_count - best_index) * sizeof(skyline_2d_node_t));
+    skyline->nodes[best_index] = node;
+    skyline->nodes_count++;
+
+    // Shrink or remove the segments now hidden under the new one.
+    for(unsigned i = best_index + 1; i < skyline->nodes_count; )
+    {
+        skyline_2d_node_p prev = skyline->nodes + i - 1;
+        skyline_2d_node_p curr = skyline->nodes + i;
+        if(curr->x >= prev->x + prev->width)
+        {
+            break;
+        }
+        else
+        {
+            unsigned shrink = prev->x + prev->width - curr->x;
+            if(curr->width > shrink)
+            {
+                curr->x += shrink;
+                curr->width -= shrink;
+                break;
+            }
+            memmove(curr, curr + 1, (skyline->nodes_count - i - 1) * sizeof(skyline_2d_node_t));
+            skyline->nodes_count--;
+        }
+    }
+
+    // Merge neighbours of the same height.
+    for(unsigned i = 0; i + 1 < skyline->nodes_count; )
+    {
+        if(skyline->nodes[i].y == skyline->nodes[i + 1].y)
+        {
+            skyline->nodes[i].width += skyline->nodes[i + 1].width;
+            memmove(skyline->nodes + i + 1, skyline->nodes + i + 2, (skyline->nodes_count - i - 2) * sizeof(skyline_2d_node_t));
+            skyline->nodes_count--;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,46 @@
+#ifndef SKYLINE_2D_H
+#define SKYLINE_2D_H
+
+/*!
+ * @header skyline_2d
+ * @abstract Manage the fill state of a 2D rectangle where new rectangles may be added at any time.
+ * @discussion This is used internally by the bordered texture atlas for laying out texture tiles in the big texture atlas pages. It has the same contract as the bsp_tree_2d, but keeps only the upper outline ("skyline") of the already placed rectangles, and places every new rectangle at the lowest possible position (bottom-left rule). That is much cheaper than the tree walk and packs the height sorted TR tiles tighter, so atlas pages become smaller.
+ * @see bordered_textured_atlas_t
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * The struct that defines this type. Its contents are not relevant for or accessible to clients.
+ */
+typedef struct skyline_2d_s *skyline_2d_p;
+
+/*!
+ * Creates a new empty area with the given dimensions.
+ */
+skyline_2d_p Skyline2D_Create(unsigned width, unsigned height);
+
+/*!
+ * Destroys the skyline and releases all allocated resources.
+ */
+void Skyline2D_Destroy(skyline_2d_p skyline);
+
+/*!
+ * @abstract Find space for a given rectangle within the area.
+ * @discussion Produces the start of an area that has the passed in size, and does not overlap any area returned by previous calls to this method. If no such area can be found, it returns 0 and leaves the internal state untouched.
+ * @param skyline The skyline.
+ * @param width The width of the area.
+ * @param height The height of the area.
+ * @param x On return, the x coordinate of an area with the given size. Must never be NULL.
+ * @param y On return, the y coordinate of an area with the given size. Must never be NULL.
+ * @result 1 if such an area was found, or 0 if no area was found.
+ */
+int Skyline2D_FindSpaceFor(skyline_2d_p skyline, unsigned width, unsigned height, unsigned *x, unsigned *y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SKYLINE_2D_H */
@@ -0,0 +1,884 @@
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+}
+
+#include "core/system.h"
+#include "core/console.h"
+#include "core/vmath.h"
+#include "script/script.h"
+#include "physics/physics.h"
+#include "vt/tr_versions.h"
+#include "room.h"
+#include "world.h"
+#include "skeletal_model.h"
+#include "entity.h"
+#include "character_controller.h"
+#include "engine.h"
+#include "gameflow.h"
+#include "inventory.h"
+#include "mesh.h"
+#include "save_state.h"
+
+#define SAVE_STATE_NONE             (0xFFFFFFFF)
+
+// entity record flags
+#define SAVE_ENTITY_SPAWNED         (0x0001)
+#define SAVE_ENTITY_CHARACTER       (0x0002)
+#define SAVE_ENTITY_ACTIVATION      (0x0004)
+#define SAVE_ENTITY_NO_FIX_ALL      (0x0008)
+#define SAVE_ENTITY_NO_MOVE         (0x0010)
+#define SAVE_ENTITY_BASE_MODEL      (0x0020)
+
+typedef struct save_capture_s
+{
+    save_state_p    state;
+    uint32_t        entities_count;
+    entity_p        player;
+    int             delta;              // skip the records equal to the baseline ones
+    save_record_p   records;            // filled for the baseline only
+    uint32_t        records_count;
+    uint32_t        records_allocated;
+    uint8_t        *baseline_seen;      // per baseline record, the entity still exists
+} save_capture_t, *save_capture_p;
+
+typedef struct save_header_s
+{
+    uint32_t        magic;
+    uint64_t        baseline_hash;
+    uint32_t        game_id;
+    uint32_t        level_id;
+    const char     *path;
+    uint32_t        path_size;
+} save_header_t, *save_header_p;
+
+/*
+ * The level state right after it was loaded: delta saves keep only what differs from it.
+ */
+static struct
+{
+    save_state_t    state;
+    uint64_t        hash;
+    save_record_p   records;            // sorted by id
+    uint32_t        records_count;
+    uint8_t        *flip_map;
+    uint8_t        *flip_state;
+    uint32_t        flip_count;
+} save_baseline = {{NULL, 0, 0, 0}, 0, NULL, 0, NULL, NULL, 0};
+
+/*
+ * Lua side data is kept as the chunk the scripts return from their onSave handlers.
+ */
+static void SaveState_RunLuaBlob(const char *blob, uint32_t size, const char *name)
+{
+    if(blob && size && engine_lua)
+    {
+        int top = lua_gettop(engine_lua);
+        if(luaL_loadbuffer(engine_lua, blob, size, name) == LUA_OK)
+        {
+            lua_CallAndLog(engine_lua, 0, 0, 0);
+        }
+        else
+        {
+            Con_Warning("save: %s", lua_tostring(engine_lua, -1));
+        }
+        lua_settop(engine_lua, top);
+    }
+}
+
+
+static size_t SaveState_GetEntityLuaData(void *arg, char *buf, size_t buf_size)
+{
+    return Script_GetEntitySaveData(engine_lua, ((entity_p)arg)->id, buf, buf_size);
+}
+
+
+static size_t SaveState_GetFlipEffectsLuaData(void *arg, char *buf, size_t buf_size)
+{
+    return Script_GetFlipEffectsSaveData(engine_lua, buf, buf_size);
+}
+
+
+static int SaveState_IsBaselineRecord(save_record_p rec, const uint8_t *data, uint32_t size)
+{
+    return rec && (rec->size == size) && !memcmp(save_baseline.state.data + rec->offset, data, size);
+}
+
+
+int SaveState_IsSnapshot(const uint8_t *data, uint32_t size)
+{
+    uint32_t magic, version;
+    if(size < 2 * sizeof(uint32_t))
+    {
+        return 0;
+    }
+    memcpy(&magic, data, sizeof(magic));
+    memcpy(&version, data + sizeof(magic), sizeof(version));
+    return ((magic == SAVE_STATE_MAGIC) || (magic == SAVE_STATE_DELTA_MAGIC)) && (version == SAVE_STATE_VERSION);
+}
+
+
+static int SaveState_ReadHeader(save_reader_p reader, save_header_p header)
+{
+    uint32_t hash_lo, hash_hi;
+    header->magic = SaveState_GetU32(reader);
+    SaveState_GetU32(reader);                   // version
+    hash_lo = SaveState_GetU32(reader);
+    hash_hi = SaveState_GetU32(reader);
+    header->baseline_hash = ((uint64_t)hash_hi << 32) | hash_lo;
+    header->game_id = SaveState_GetU32(reader);
+    header->level_id = SaveState_GetU32(reader);
+    header->path = SaveState_GetBlob(reader, &header->path_size);
+    return !reader->error;
+}
+
+/*
+ * Entity record, in the order the Lua save applies it.
+ */
+static int SaveState_CaptureEntity(entity_p ent, void *data)
+{
+    save_capture_p capture = (save_capture_p)data;
+    save_state_p state = capture->state;
+    uint32_t record_offset = state->size;
+    uint32_t flags = 0;
+    uint32_t count = 0;
+    save_record_p baseline_rec = NULL;
+    ss_animation_p ss_anim;
+
+    flags |= (ent->type_flags & ENTITY_TYPE_SPAWNED) ? (SAVE_ENTITY_SPAWNED) : (0);
+    flags |= (ent->character) ? (SAVE_ENTITY_CHARACTER) : (0);
+    flags |= (ent->activation_point) ? (SAVE_ENTITY_ACTIVATION) : (0);
+    flags |= (ent->no_fix_all) ? (SAVE_ENTITY_NO_FIX_ALL) : (0);
+    flags |= (ent->no_move) ? (SAVE_ENTITY_NO_MOVE) : (0);
+    flags |= (ent->bf->animations.model && ent->character) ? (SAVE_ENTITY_BASE_MODEL) : (0);
+
+    SaveState_PutU32(state, ent->id);
+    SaveState_PutU32(state, flags);
+    SaveState_PutU32(state, (ent->bf->animations.model) ? (ent->bf->animations.model->id) : (SAVE_STATE_NONE));
+    SaveState_PutU32(state, (ent->self->room) ? (ent->self->room->id) : (SAVE_STATE_NONE));
+    SaveState_PutFloats(state, ent->transform.M4x4 + 12, 3);
+    SaveState_PutFloats(state, ent->transform.angles, 3);
+    SaveState_PutU32(state, ent->move_type);
+    SaveState_PutU32(state, ent->dir_flag);
+
+    if(ent->activation_point)
+    {
+        SaveState_PutFloats(state, ent->activation_point->offset, 4);
+        SaveState_PutFloats(state, ent->activation_point->direction, 4);
+    }
+
+    // override animations, from the last one as they were added
+    for(ss_anim = &ent->bf->animations; ss_anim->next; ss_anim = ss_anim->next);
+    for(ss_animation_p it = ss_anim; it; it = it->prev)
+    {
+        count += (it->type != ANIM_TYPE_BASE) ? (1) : (0);
+    }
+    SaveState_PutU32(state, count);
+    for(; ss_anim; ss_anim = ss_anim->prev)
+    {
+        if(ss_anim->type != ANIM_TYPE_BASE)
+        {
+            SaveState_PutU32(state, ss_anim->type);
+            SaveState_PutU32(state, (ss_anim->model) ? (ss_anim->model->id) : (SAVE_STATE_NONE));
+        }
+    }
+
+    if(ent->character)
+    {
+        character_p ch = ent->character;
+        SaveState_PutFloats(state, ch->climb.point, 3);
+        SaveState_PutU32(state, ch->target_id);
+        SaveState_PutI32(state, ch->state.dead);
+        SaveState_PutI32(state, ch->state.weapon_ready);
+        SaveState_PutI32(state, ch->weapon_id_req);
+        SaveState_PutI32(state, ch->weapon_id);
+        SaveState_PutU32(state, PARAM_LASTINDEX);
+        SaveState_PutFloats(state, ch->parameters.param, PARAM_LASTINDEX);
+        SaveState_PutFloats(state, ch->parameters.maximum, PARAM_LASTINDEX);
+    }
+
+    SaveState_PutU32(state, ent->bf->bone_tag_count);
+    for(uint16_t i = 0; i < ent->bf->bone_tag_count; ++i)
+    {
+        ss_bone_tag_p b_tag = ent->bf->bone_tags + i;
+        SaveState_PutU32(state, b_tag->is_hidden | (b_tag->is_targeted << 1) | (b_tag->is_axis_modded << 2));
+        if(ent->character)
+        {
+            SaveState_PutU32(state, (b_tag->mesh_replace) ? (b_tag->mesh_replace->id) : (SAVE_STATE_NONE));
+            SaveState_PutU32(state, (b_tag->mesh_slot) ? (b_tag->mesh_slot->id) : (SAVE_STATE_NONE));
+            if(b_tag->is_targeted)
+            {
+                SaveState_PutFloats(state, b_tag->mod.target_pos, 3);
+                SaveState_PutFloats(state, b_tag->mod.bone_local_direction, 3);
+            }
+            if(b_tag->is_axis_modded)
+            {
+                SaveState_PutFloats(state, b_tag->mod.axis_mod, 3);
+            }
+            SaveState_PutFloats(state, b_tag->mod.limit, 4);
+            SaveState_PutFloats(state, b_tag->mod.current_q, 4);
+        }
+    }
+
+    SaveState_PutString(state, SaveState_GetEntityLuaData, ent);
+
+    count = 0;
+    for(inventory_node_p i = ent->inventory; i; i = i->next)
+    {
+        count++;
+    }
+    SaveState_PutU32(state, count);
+    for(inventory_node_p i = ent->inventory; i; i = i->next)
+    {
+        SaveState_PutU32(state, i->id);
+        SaveState_PutI32(state, i->count);
+    }
+
+    SaveState_PutFloats(state, &ent->linear_speed, 1);
+    SaveState_PutFloats(state, ent->speed, 3);
+    SaveState_PutU32(state, ent->state_flags);
+    SaveState_PutU32(state, ent->type_flags);
+    SaveState_PutU32(state, ent->callback_flags);
+    SaveState_PutI32(state, ent->self->collision_group);
+    SaveState_PutI32(state, ent->self->collision_shape);
+    SaveState_PutI32(state, ent->self->collision_mask);
+    SaveState_PutU32(state, ent->trigger_layout);
+    SaveState_PutFloats(state, &ent->timer, 1);
+
+    count = 0;
+    for(ss_anim = &ent->bf->animations; ss_anim; ss_anim = ss_anim->next)
+    {
+        count += (ss_anim->model) ? (1) : (0);
+    }
+    SaveState_PutU32(state, count);
+    for(ss_anim = &ent->bf->animations; ss_anim; ss_anim = ss_anim->next)
+    {
+        if(ss_anim->model)
+        {
+            SaveState_PutU32(state, ss_anim->type);
+            SaveState_PutI32(state, ss_anim->current_animation);
+            SaveState_PutI32(state, ss_anim->current_frame);
+            SaveState_PutI32(state, ss_anim->prev_animation);
+            SaveState_PutI32(state, ss_anim->prev_frame);
+            SaveState_PutI32(state, ss_anim->target_state);
+            SaveState_PutU32(state, ss_anim->heavy_state | (ss_anim->enabled << 1));
+            SaveState_PutU32(state, ss_anim->anim_ext_flags);
+        }
+    }
+
+    if(capture->baseline_seen)
+    {
+        baseline_rec = SaveState_FindRecord(save_baseline.records, save_baseline.records_count, ent->id);
+        if(baseline_rec)
+        {
+            capture->baseline_seen[baseline_rec - save_baseline.records] = 1;
+        }
+    }
+
+    // the player goes in always: its baseline depends on how the level was entered
+    if(capture->delta && (ent != capture->player) &&
+       SaveState_IsBaselineRecord(baseline_rec, state->data + record_offset, state->size - record_offset))
+    {
+        state->size = record_offset;
+        return 0;
+    }
+
+    if(capture->records)
+    {
+        if(capture->records_count >= capture->records_allocated)
+        {
+            save_record_p new_records = (save_record_p)realloc(capture->records, 2 * capture->records_allocated * sizeof(save_record_t));
+            if(!new_records)
+            {
+                state->error = 1;
+                return 1;
+            }
+            capture->records = new_records;
+            capture->records_allocated *= 2;
+        }
+        capture->records[capture->records_count].id = ent->id;
+        capture->records[capture->records_count].offset = record_offset;
+        capture->records[capture->records_count].size = state->size - record_offset;
+        capture->records_count++;
+    }
+    capture->entities_count++;
+
+    return 0;
+}
+
+
+static void SaveState_CaptureInternal(save_state_p state, save_capture_p capture)
+{
+    const char *level_path = Gameflow_GetCurrentLevelPathLocal();
+    uint8_t *flip_map;
+    uint8_t *flip_state;
+    uint32_t flip_count, rooms_count, count, count_pos;
+    room_p rooms;
+
+    state->size = 0;
+    SaveState_PutU32(state, (capture->delta) ? (SAVE_STATE_DELTA_MAGIC) : (SAVE_STATE_MAGIC));
+    SaveState_PutU32(state, SAVE_STATE_VERSION);
+    SaveState_PutU32(state, (capture->delta) ? ((uint32_t)save_baseline.hash) : (0));
+    SaveState_PutU32(state, (capture->delta) ? ((uint32_t)(save_baseline.hash >> 32)) : (0));
+    SaveState_PutU32(state, Gameflow_GetCurrentGameID());
+    SaveState_PutU32(state, Gameflow_GetCurrentLevelID());
+    SaveState_PutBlob(state, level_path, strlen(level_path));
+
+    World_GetFlipInfo(&flip_map, &flip_state, &flip_count);
+    count = 0;
+    count_pos = state->size;
+    SaveState_PutU32(state, count);
+    for(uint32_t i = 0; i < flip_count; ++i)
+    {
+        if(!capture->delta || (i >= save_baseline.flip_count) ||
+           (flip_map[i] != save_baseline.flip_map[i]) || (flip_state[i] != save_baseline.flip_state[i]))
+        {
+            SaveState_PutU32(state, i);
+            SaveState_Put(state, flip_map + i, 1);
+            SaveState_Put(state, flip_state + i, 1);
+            count++;
+        }
+    }
+    SaveState_SetU32(state, count_pos, count);
+    SaveState_PutI32(state, (World_GetVersion() < TR_IV) ? ((int32_t)World_GetGlobalFlipState()) : (-1));
+
+    // a freshly loaded level shows the original content in every room
+    World_GetRoomInfo(&rooms, &rooms_count);
+    count = 0;
+    count_pos = state->size;
+    SaveState_PutU32(state, count);
+    for(uint32_t i = 0; i < rooms_count; ++i)
+    {
+        if((rooms[i].alternate_room_next || rooms[i].alternate_room_prev) &&
+           (!capture->delta || (rooms[i].content->original_room_id != rooms[i].id)))
+        {
+            SaveState_PutU32(state, rooms[i].id);
+            SaveState_PutU32(state, rooms[i].content->original_room_id);
+            count++;
+        }
+    }
+    SaveState_SetU32(state, count_pos, count);
+
+    SaveState_PutString(state, SaveState_GetFlipEffectsLuaData, NULL);
+
+    capture->state = state;
+    capture->entities_count = 0;
+    capture->player = World_GetPlayer();
+    count_pos = state->size;
+    SaveState_PutU32(state, 0);
+    World_IterateAllEntities(&SaveState_CaptureEntity, capture);
+    SaveState_SetU32(state, count_pos, capture->entities_count);
+
+    // the level loads them again, so the ones deleted since go to the list of removed ones
+    SaveState_PutRemovedRecords(state, save_baseline.records, capture->baseline_seen,
+                                (capture->baseline_seen) ? (save_baseline.records_count) : (0));
+}
+
+
+static uint8_t *SaveState_AllocBaselineSeen(save_state_p state)
+{
+    uint8_t *ret = NULL;
+    if(save_baseline.records_count)
+    {
+        ret = (uint8_t*)calloc(save_baseline.records_count, 1);
+        state->error |= (ret) ? (0) : (1);
+    }
+    return ret;
+}
+
+
+static int SaveState_CheckCaptured(save_state_p state)
+{
+    if(state->error)
+    {
+        Con_Warning("save: out of memory after %d bytes, the game is not saved", state->size);
+        return 0;
+    }
+    return 1;
+}
+
+
+int SaveState_Capture(save_state_p state)
+{
+    save_capture_t capture;
+    capture.delta = 0;
+    capture.records = NULL;
+    capture.baseline_seen = SaveState_AllocBaselineSeen(state);
+    SaveState_CaptureInternal(state, &capture);
+    free(capture.baseline_seen);
+    return SaveState_CheckCaptured(state);
+}
+
+
+int SaveState_CaptureDelta(save_state_p state)
+{
+    save_capture_t capture;
+    if(!save_baseline.state.size)
+    {
+        return 0;
+    }
+    capture.delta = 1;
+    capture.records = NULL;
+    capture.baseline_seen = SaveState_AllocBaselineSeen(state);
+    SaveState_CaptureInternal(state, &capture);
+    free(capture.baseline_seen);
+    return SaveState_CheckCaptured(state);
+}
+
+
+void SaveState_SetBaseline()
+{
+    save_capture_t capture;
+    uint8_t *flip_map;
+    uint8_t *flip_state;
+
+    capture.delta = 0;
+    capture.records_count = 0;
+    capture.records_allocated = 256;
+    capture.records = (save_record_p)malloc(capture.records_allocated * sizeof(save_record_t));
+    capture.baseline_seen = NULL;
+    save_baseline.state.error = (capture.records) ? (0) : (1);
+    SaveState_CaptureInternal(&save_baseline.state, &capture);
+    free(save_baseline.records);
+    save_baseline.records = capture.records;
+    save_baseline.records_count = capture.records_count;
+    if(!SaveState_CheckCaptured(&save_baseline.state))
+    {
+        // quick saves fall back to full ones
+        save_baseline.state.size = 0;
+        save_baseline.state.error = 0;
+        save_baseline.records_count = 0;
+        return;
+    }
+    SaveState_SortRecords(save_baseline.records, save_baseline.records_count);
+    save_baseline.hash = SaveState_Hash(save_baseline.state.data, save_baseline.state.size);
+
+    World_GetFlipInfo(&flip_map, &flip_state, &save_baseline.flip_count);
+    save_baseline.flip_map = (uint8_t*)realloc(save_baseline.flip_map, save_baseline.flip_count + 1);
+    save_baseline.flip_state = (uint8_t*)realloc(save_baseline.flip_state, save_baseline.flip_count + 1);
+    memcpy(save_baseline.flip_map, flip_map, save_baseline.flip_count);
+    memcpy(save_baseline.flip_state, flip_state, save_baseline.flip_count);
+}
+
+
+uint32_t SaveState_GetBaselineSize()
+{
+    return save_baseline.state.size;
+}
+
+/*
+ * Applies one entity record; the record is read in full even if the entity is gone.
+ */
+static void SaveState_ApplyEntity(save_reader_p reader)
+{
+    uint32_t id = SaveState_GetU32(reader);
+    uint32_t flags = SaveState_GetU32(reader);
+    uint32_t model_id = SaveState_GetU32(reader);
+    uint32_t room_id = SaveState_GetU32(reader);
+    uint32_t count, size;
+    float pos[3], ang[3], v[4];
+    const char *blob;
+    entity_p ent;
+
+    SaveState_GetFloats(reader, pos, 3);
+    SaveState_GetFloats(reader, ang, 3);
+    if(reader->error)
+    {
+        return;
+    }
+
+    if(flags & SAVE_ENTITY_SPAWNED)
+    {
+        World_SpawnEntity(model_id, room_id, pos, ang, id);
+        ent = World_GetEntityByID(id);
+    }
+    else if((ent = World_GetEntityByID(id)))
+    {
+        vec3_copy(ent->transform.M4x4 + 12, pos);
+        vec3_copy(ent->transform.angles, ang);
+        Entity_UpdateTransform(ent);
+        Entity_UpdateRigidBody(ent, 1);
+    }
+
+    if(ent)
+    {
+        room_p room = World_GetRoomByID(room_id);
+        if((room_id != SAVE_STATE_NONE) && room && (ent->self->room != room))
+        {
+            if(ent->self->room != NULL)
+            {
+                Room_RemoveObject(ent->self->room, ent->self);
+            }
+            Room_AddObject(room, ent->self);
+        }
+        Entity_UpdateRoomPos(ent);
+    }
+    count = SaveState_GetU32(reader);
+    if(ent)
+    {
+        ent->move_type = count;
+    }
+    count = SaveState_GetU32(reader);
+    if(ent)
+    {
+        ent->dir_flag = count;
+    }
+
+    if(ent && (flags & SAVE_ENTITY_BASE_MODEL))
+    {
+        skeletal_model_p model = World_GetModelByID(model_id);
+        if(model && ent->bf->animations.model && (ent->bf->animations.model->mesh_count == model->mesh_count))
+        {
+            ent->bf->animations.model = model;
+            ent->bf->animations.prev_animation = 0;
+            ent->bf->animations.prev_frame = 0;
+            ent->bf->animations.current_animation = 0;
+            ent->bf->animations.current_frame = 0;
+        }
+    }
+
+    if(flags & SAVE_ENTITY_ACTIVATION)
+    {
+        if(ent && !ent->activation_point)
+        {
+            Entity_InitActivationPoint(ent);
+        }
+        SaveState_GetFloats(reader, v, 4);
+        if(ent)
+        {
+            vec4_copy(ent->activation_point->offset, v);
+        }
+        SaveState_GetFloats(reader, v, 4);
+        if(ent)
+        {
+            vec4_copy(ent->activation_point->direction, v);
+        }
+    }
+
+    count = SaveState_GetU32(reader);
+    for(uint32_t i = 0; (i < count) && !reader->error; ++i)
+    {
+        uint32_t anim_type = SaveState_GetU32(reader);
+        uint32_t anim_model = SaveState_GetU32(reader);
+        if(ent && !SSBoneFrame_GetOverrideAnim(ent->bf, anim_type))
+        {
+            SSBoneFrame_AddOverrideAnim(ent->bf, (anim_model != SAVE_STATE_NONE) ? (World_GetModelByID(anim_model)) : (NULL), anim_type);
+        }
+    }
+
+    if(flags & SAVE_ENTITY_CHARACTER)
+    {
+        character_p ch = (ent) ? (ent->character) : (NULL);
+        float param[PARAM_LASTINDEX], maximum[PARAM_LASTINDEX];
+        int32_t dead, weapon_ready, weapon_id_req, weapon_id;
+        uint32_t target_id;
+
+        SaveState_GetFloats(reader, v, 3);
+        target_id = SaveState_GetU32(reader);
+        dead = SaveState_GetI32(reader);
+        weapon_ready = SaveState_GetI32(reader);
+        weapon_id_req = SaveState_GetI32(reader);
+        weapon_id = SaveState_GetI32(reader);
+        if(SaveState_GetU32(reader) != PARAM_LASTINDEX)
+        {
+            reader->error = 1;
+            return;
+        }
+        SaveState_GetFloats(reader, param, PARAM_LASTINDEX);
+        SaveState_GetFloats(reader, maximum, PARAM_LASTINDEX);
+        if(ch)
+        {
+            vec3_copy(ch->climb.point, v);
+            ch->target_id = target_id;
+            ch->state.dead = dead;
+            ch->state.weapon_ready = weapon_ready;
+            ch->weapon_id_req = weapon_id_req;
+            if(ch->set_weapon_model_func)
+            {
+                ch->weapon_id = weapon_id;
+                ch->set_weapon_model_func(ent, 0, -1);
+            }
+            memcpy(ch->parameters.param, param, sizeof(param));
+            memcpy(ch->parameters.maximum, maximum, sizeof(maximum));
+        }
+    }
+
+    count = SaveState_GetU32(reader);
+    for(uint32_t i = 0; (i < count) && !reader->error; ++i)
+    {
+        ss_bone_tag_p b_tag = (ent && (i < ent->bf->bone_tag_count)) ? (ent->bf->bone_tags + i) : (NULL);
+        uint32_t tag_flags = SaveState_GetU32(reader);
+        if(b_tag && (tag_flags & 0x01))
+        {
+            b_tag->is_hidden = 1;
+        }
+        if(flags & SAVE_ENTITY_CHARACTER)
+        {
+            uint32_t replace_id = SaveState_GetU32(reader);
+            uint32_t slot_id = SaveState_GetU32(reader);
+            float dir[3];
+            if(b_tag)
+            {
+                b_tag->mesh_replace = World_GetMeshByID(replace_id);
+                b_tag->mesh_slot = World_GetMeshByID(slot_id);
+            }
+            if(tag_flags & 0x02)
+            {
+                SaveState_GetFloats(reader, v, 3);
+                SaveState_GetFloats(reader, dir, 3);
+                if(b_tag)
+                {
+                    SSBoneFrame_SetTarget(b_tag, v, dir);
+                }
+            }
+            if(tag_flags & 0x04)
+            {
+                SaveState_GetFloats(reader, v, 3);
+                if(b_tag)
+                {
+                    SSBoneFrame_SetTargetingAxisMod(b_tag, v);
+                }
+            }
+            SaveState_GetFloats(reader, v, 4);
+            if(b_tag)
+            {
+                SSBoneFrame_SetTargetingLimit(b_tag, v);
+            }
+            SaveState_GetFloats(reader, v, 4);
+            if(b_tag)
+            {
+                vec4_copy(b_tag->mod.current_q, v);
+            }
+        }
+    }
+
+    blob = SaveState_GetBlob(reader, &size);
+    if(ent)
+    {
+        SaveState_RunLuaBlob(blob, size, "entity");
+    }
+
+    if(ent)
+    {
+        Inventory_RemoveAllItems(&ent->inventory);
+    }
+    count = SaveState_GetU32(reader);
+    for(uint32_t i = 0; (i < count) && !reader->error; ++i)
+    {
+        uint32_t item_id = SaveState_GetU32(reader);
+        int32_t item_count = SaveState_GetI32(reader);
+        if(ent)
+        {
+            Inventory_AddItem(&ent->inventory, item_id, item_count);
+        }
+    }
+
+    SaveState_GetFloats(reader, v, 4);
+    if(ent)
+    {
+        ent->linear_speed = v[0];
+        vec3_copy(ent->speed, v + 1);
+    }
+
+    {
+        uint32_t state_flags = SaveState_GetU32(reader);
+        uint32_t type_flags = SaveState_GetU32(reader);
+        uint32_t callback_flags = SaveState_GetU32(reader);
+        int32_t collision_group = SaveState_GetI32(reader);
+        int32_t collision_shape = SaveState_GetI32(reader);
+        int32_t collision_mask = SaveState_GetI32(reader);
+        uint32_t trigger_layout = SaveState_GetU32(reader);
+        float timer;
+        SaveState_GetFloats(reader, &timer, 1);
+        if(ent && !reader->error)
+        {
+            ent->state_flags = state_flags;
+            if(ent->state_flags & ENTITY_STATE_COLLIDABLE)
+            {
+                Entity_EnableCollision(ent);
+            }
+            else
+            {
+                Entity_DisableCollision(ent);
+            }
+            ent->type_flags = type_flags;
+            ent->callback_flags = callback_flags;
+            ent->self->collision_group = collision_group;
+            ent->self->collision_shape = collision_shape;
+            ent->self->collision_mask = collision_mask;
+            if(Physics_GetBodiesCount(ent->physics) != ent->bf->bone_tag_count)
+            {
+                ent->self->collision_shape = COLLISION_SHAPE_SINGLE_BOX;
+            }
+            ent->trigger_layout = trigger_layout;
+            ent->timer = timer;
+        }
+    }
+
+    count = SaveState_GetU32(reader);
+    for(uint32_t i = 0; (i < count) && !reader->error; ++i)
+    {
+        uint32_t anim_type = SaveState_GetU32(reader);
+        int32_t current_animation = SaveState_GetI32(reader);
+        int32_t current_frame = SaveState_GetI32(reader);
+        int32_t prev_animation = SaveState_GetI32(reader);
+        int32_t prev_frame = SaveState_GetI32(reader);
+        int32_t target_state = SaveState_GetI32(reader);
+        uint32_t anim_flags = SaveState_GetU32(reader);
+        uint32_t anim_ext_flags = SaveState_GetU32(reader);
+        ss_animation_p ss_anim = (ent) ? (SSBoneFrame_GetOverrideAnim(ent->bf, anim_type)) : (NULL);
+        if(ss_anim && ss_anim->model && !reader->error)
+        {
+            Anim_SetAnimation(ss_anim, current_animation, current_frame);
+            if((prev_animation < ss_anim->model->animation_count) && (prev_frame < ss_anim->model->animations[prev_animation].frames_count))
+            {
+                ss_anim->prev_animation = prev_animation;
+                ss_anim->prev_frame = prev_frame;
+            }
+            SSBoneFrame_Update(ent->bf, 0.0f);
+            ss_anim->target_state = target_state;
+            if(anim_flags & 0x01)
+            {
+                ss_anim->heavy_state = 0x01;
+            }
+            ss_anim->enabled = 0x01 & (anim_flags >> 1);
+            ss_anim->anim_ext_flags = anim_ext_flags;
+            if(anim_flags & 0x02)
+            {
+                SSBoneFrame_EnableOverrideAnimByType(ent->bf, anim_type);
+            }
+            else
+            {
+                SSBoneFrame_DisableOverrideAnimByType(ent->bf, anim_type);
+            }
+        }
+    }
+
+    if(ent)
+    {
+        ent->no_fix_all = (flags & SAVE_ENTITY_NO_FIX_ALL) ? (1) : (ent->no_fix_all);
+        ent->no_move = (flags & SAVE_ENTITY_NO_MOVE) ? (1) : (ent->no_move);
+    }
+}
+
+
+int SaveState_Apply(const uint8_t *data, uint32_t size)
+{
+    save_reader_t reader;
+    save_header_t header;
+    uint32_t count, size_blob;
+    const char *blob;
+    int32_t global_flip_state;
+
+    if(!SaveState_IsSnapshot(data, size))
+    {
+        return 0;
+    }
+
+    reader.data = data;
+    reader.size = size;
+    reader.pos = 0;
+    reader.error = 0;
+    SaveState_ReadHeader(&reader, &header);
+
+    count = SaveState_GetU32(&reader);
+    for(uint32_t i = 0; (i < count) && !reader.error; ++i)
+    {
+        uint32_t flip_index = SaveState_GetU32(&reader);
+        const uint8_t *flip = SaveState_Get(&reader, 2);
+        if(flip)
+        {
+            World_SetFlipMap(flip_index, flip[0], 0);
+            World_SetFlipState(flip_index, flip[1]);
+        }
+    }
+    global_flip_state = SaveState_GetI32(&reader);
+    if(reader.error)
+    {
+        return 0;
+    }
+    if(global_flip_state >= 0)
+    {
+        World_SetGlobalFlipState(global_flip_state);
+    }
+
+    count = SaveState_GetU32(&reader);
+    for(uint32_t i = 0; (i < count) && !reader.error; ++i)
+    {
+        room_p r1 = World_GetRoomByID(SaveState_GetU32(&reader));
+        room_p r2 = World_GetRoomByID(SaveState_GetU32(&reader));
+        if(r1 && r2 && (r1->content->original_room_id != r2->id))
+        {
+            Room_SetActiveContent(r1, r2);
+        }
+    }
+
+    blob = SaveState_GetBlob(&reader, &size_blob);
+    SaveState_RunLuaBlob(blob, size_blob, "flipeffects");
+
+    count = SaveState_GetU32(&reader);
+    for(uint32_t i = 0; (i < count) && !reader.error; ++i)
+    {
+        SaveState_ApplyEntity(&reader);
+    }
+
+    count = SaveState_GetU32(&reader);
+    for(uint32_t i = 0; (i < count) && !reader.error; ++i)
+    {
+        World_DeleteEntity(SaveState_GetU32(&reader));
+    }
+
+    if(reader.error)
+    {
+        Con_Warning("save: snapshot is damaged at offset %d", reader.pos);
+        return 0;
+    }
+
+    return 1;
+}
+
+
+int SaveState_Restore(const uint8_t *data, uint32_t size)
+{
+    save_reader_t reader;
+    save_header_t header;
+    char level_path[MAX_ENGINE_PATH];
+
+    if(!SaveState_IsSnapshot(data, size))
+    {
+        return 0;
+    }
+
+    reader.data = data;
+    reader.size = size;
+    reader.pos = 0;
+    reader.error = 0;
+    if(!SaveState_ReadHeader(&reader, &header) || (header.path_size >= sizeof(level_path)))
+    {
+        return 0;
+    }
+    memcpy(level_path, header.path, header.path_size);
+    level_path[header.path_size] = 0;
+
+    Script_LuaClearTasks();
+    if(!Gameflow_SetMap(level_path, header.game_id, header.level_id))
+    {
+        return 0;
+    }
+
+    // loading the level took a new baseline; a delta only fits the one it was made against,
+    // applied to another one it would leave the entities it does not list in a wrong state
+    if((header.magic == SAVE_STATE_DELTA_MAGIC) && (header.baseline_hash != save_baseline.hash))
+    {
+        Con_Warning("save: level initial state differs from the one the quick save was made with, the save is not loaded; load a full save");
+        return 0;
+    }
+
+    return SaveState_Apply(data, size);
+}
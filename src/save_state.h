@@ -0,0 +1,33 @@
+
+#ifndef SAVE_STATE_H
+#define SAVE_STATE_H
+
+#include <stdint.h>
+#include "save_state_format.h"
+
+/*
+ * Binary game state snapshot: the same data the Lua text save holds, written
+ * field by field into one memory block, so a save is a single fwrite and a load
+ * does not run the Lua parser for every entity.
+ */
+
+#define SAVE_STATE_MAGIC        (0x5653544F)    // "OTSV"
+#define SAVE_STATE_DELTA_MAGIC  (0x4453544F)    // "OTSD", only the changes against the level baseline
+#define SAVE_STATE_VERSION      (3)
+
+// writes the current level, flip maps, rooms and entities; returns 0 on error (out of memory)
+int  SaveState_Capture(save_state_p state);
+// the same, but entities, flip entries and rooms equal to the baseline are left out;
+// both list the baseline entities deleted since, applying the snapshot deletes them
+int  SaveState_CaptureDelta(save_state_p state);
+// called once the level is loaded; the snapshot it takes is what delta saves are made against
+void SaveState_SetBaseline();
+uint32_t SaveState_GetBaselineSize();
+// loads the saved level, then applies the rest of the snapshot; a delta made against
+// another initial state of the level is refused, the level stays as loaded
+int  SaveState_Restore(const uint8_t *data, uint32_t size);
+// applies the snapshot to the level that is loaded now
+int  SaveState_Apply(const uint8_t *data, uint32_t size);
+int  SaveState_IsSnapshot(const uint8_t *data, uint32_t size);
+
+#endif
@@ -0,0 +1,236 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "save_state_format.h"
+
+#define SAVE_STATE_MIN_SIZE         (65536)
+#define SAVE_STATE_STRING_SIZE      (32768)     // most Lua data fits, bigger one is asked for twice
+
+
+void SaveState_Init(save_state_p state)
+{
+    state->data = NULL;
+    state->size = 0;
+    state->allocated_size = 0;
+    state->error = 0;
+}
+
+
+void SaveState_Clear(save_state_p state)
+{
+    free(state->data);
+    SaveState_Init(state);
+}
+
+
+uint8_t *SaveState_Reserve(save_state_p state, uint32_t size)
+{
+    if(state->error || (size > UINT32_MAX / 2 - state->size))
+    {
+        state->error = 1;
+        return NULL;
+    }
+    if(state->size + size > state->allocated_size)
+    {
+        uint32_t new_size = (state->allocated_size) ? (state->allocated_size) : (SAVE_STATE_MIN_SIZE);
+        uint8_t *new_data;
+        while(state->size + size > new_size)
+        {
+            new_size *= 2;
+        }
+        new_data = (uint8_t*)realloc(state->data, new_size);
+        if(!new_data)
+        {
+            state->error = 1;
+            return NULL;
+        }
+        state->data = new_data;
+        state->allocated_size = new_size;
+    }
+    return state->data + state->size;
+}
+
+
+void SaveState_Put(save_state_p state, const void *src, uint32_t size)
+{
+    uint8_t *dst = SaveState_Reserve(state, size);
+    if(dst)
+    {
+        memcpy(dst, src, size);
+        state->size += size;
+    }
+}
+
+
+void SaveState_PutU32(save_state_p state, uint32_t value)
+{
+    SaveState_Put(state, &value, sizeof(value));
+}
+
+
+void SaveState_PutI32(save_state_p state, int32_t value)
+{
+    SaveState_Put(state, &value, sizeof(value));
+}
+
+
+void SaveState_PutFloats(save_state_p state, const float *values, uint32_t count)
+{
+    SaveState_Put(state, values, count * sizeof(float));
+}
+
+
+void SaveState_PutBlob(save_state_p state, const char *blob, uint32_t size)
+{
+    SaveState_PutU32(state, size);
+    SaveState_Put(state, blob, size);
+}
+
+
+void SaveState_PutString(save_state_p state, save_string_getter_t getter, void *arg)
+{
+    uint32_t size_pos = state->size;
+    uint32_t size = 0;
+    size_t length;
+    char *dst;
+
+    SaveState_PutU32(state, size);
+    dst = (char*)SaveState_Reserve(state, SAVE_STATE_STRING_SIZE);
+    if(!dst)
+    {
+        return;
+    }
+    length = getter(arg, dst, SAVE_STATE_STRING_SIZE);
+    if(length > SAVE_STATE_STRING_SIZE)
+    {
+        // the first call only told the length
+        dst = (length < UINT32_MAX / 2) ? ((char*)SaveState_Reserve(state, length)) : (NULL);
+        if(!dst)
+        {
+            state->error = 1;
+            return;
+        }
+        length = getter(arg, dst, length);
+    }
+    size = length;
+    state->size += size;
+    SaveState_SetU32(state, size_pos, size);
+}
+
+
+void SaveState_SetU32(save_state_p state, uint32_t pos, uint32_t value)
+{
+    if(!state->error && (pos + sizeof(value) <= state->size))
+    {
+        memcpy(state->data + pos, &value, sizeof(value));
+    }
+}
+
+
+const uint8_t *SaveState_Get(save_reader_p reader, uint32_t size)
+{
+    const uint8_t *ret = NULL;
+    if(!reader->error && (size <= reader->size - reader->pos))
+    {
+        ret = reader->data + reader->pos;
+        reader->pos += size;
+    }
+    else
+    {
+        reader->error = 1;
+    }
+    return ret;
+}
+
+
+uint32_t SaveState_GetU32(save_reader_p reader)
+{
+    uint32_t value = 0;
+    const uint8_t *src = SaveState_Get(reader, sizeof(value));
+    if(src)
+    {
+        memcpy(&value, src, sizeof(value));
+    }
+    return value;
+}
+
+
+int32_t SaveState_GetI32(save_reader_p reader)
+{
+    return (int32_t)SaveState_GetU32(reader);
+}
+
+
+void SaveState_GetFloats(save_reader_p reader, float *values, uint32_t count)
+{
+    const uint8_t *src = SaveState_Get(reader, count * sizeof(float));
+    if(src)
+    {
+        memcpy(values, src, count * sizeof(float));
+    }
+    else
+    {
+        memset(values, 0, count * sizeof(float));
+    }
+}
+
+
+const char *SaveState_GetBlob(save_reader_p reader, uint32_t *size)
+{
+    *size = SaveState_GetU32(reader);
+    return (const char*)SaveState_Get(reader, *size);
+}
+
+
+uint64_t SaveState_Hash(const uint8_t *data, uint32_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325;             // FNV-1a
+    for(uint32_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ data[i]) * 0x100000001B3;
+    }
+    return hash;
+}
+
+
+static int SaveState_RecordCompare(const void *a, const void *b)
+{
+    uint32_t id_a = ((const save_record_t*)a)->id;
+    uint32_t id_b = ((const save_record_t*)b)->id;
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+
+void SaveState_SortRecords(save_record_p records, uint32_t count)
+{
+    if(count)
+    {
+        qsort(records, count, sizeof(save_record_t), SaveState_RecordCompare);
+    }
+}
+
+
+save_record_p SaveState_FindRecord(save_record_p records, uint32_t count, uint32_t id)
+{
+    save_record_t key;
+    key.id = id;
+    return (count) ? ((save_record_p)bsearch(&key, records, count, sizeof(save_record_t), SaveState_RecordCompare)) : (NULL);
+}
+
+
+void SaveState_PutRemovedRecords(save_state_p state, const save_record_t *records, const uint8_t *seen, uint32_t count)
+{
+    uint32_t count_pos = state->size;
+    uint32_t removed = 0;
+    SaveState_PutU32(state, removed);
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        if(!seen[i])
+        {
+            SaveState_PutU32(state, records[i].id);
+            removed++;
+        }
+    }
+    SaveState_SetU32(state, count_pos, removed);
+}
@@ -0,0 +1,75 @@
+#ifndef SAVE_STATE_FORMAT_H
+#define SAVE_STATE_FORMAT_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Byte level part of the binary snapshots: the growing write buffer, the
+ * bounds checked reader and the index of entity records delta saves are
+ * compared against. Values are stored in host byte order.
+ */
+
+typedef struct save_state_s
+{
+    uint8_t    *data;
+    uint32_t    size;
+    uint32_t    allocated_size;
+    int         error;              // a write did not fit in memory, the snapshot is not valid
+} save_state_t, *save_state_p;
+
+typedef struct save_reader_s
+{
+    const uint8_t  *data;
+    uint32_t        size;
+    uint32_t        pos;
+    int             error;
+} save_reader_t, *save_reader_p;
+
+// where one entity record lies inside a snapshot
+typedef struct save_record_s
+{
+    uint32_t        id;
+    uint32_t        offset;
+    uint32_t        size;
+} save_record_t, *save_record_p;
+
+// fills buf as strncpy does and returns the full length of the string
+typedef size_t (*save_string_getter_t)(void *arg, char *buf, size_t buf_size);
+
+void SaveState_Init(save_state_p state);
+void SaveState_Clear(save_state_p state);
+
+// returns the size free bytes at the end of data, or NULL (and sets the error) if they can not be had
+uint8_t *SaveState_Reserve(save_state_p state, uint32_t size);
+void SaveState_Put(save_state_p state, const void *src, uint32_t size);
+void SaveState_PutU32(save_state_p state, uint32_t value);
+void SaveState_PutI32(save_state_p state, int32_t value);
+void SaveState_PutFloats(save_state_p state, const float *values, uint32_t count);
+void SaveState_PutBlob(save_state_p state, const char *blob, uint32_t size);
+// a blob of the string the getter gives, whatever its length
+void SaveState_PutString(save_state_p state, save_string_getter_t getter, void *arg);
+// overwrites a value written before, counts known only later
+void SaveState_SetU32(save_state_p state, uint32_t pos, uint32_t value);
+
+const uint8_t *SaveState_Get(save_reader_p reader, uint32_t size);
+uint32_t SaveState_GetU32(save_reader_p reader);
+int32_t SaveState_GetI32(save_reader_p reader);
+void SaveState_GetFloats(save_reader_p reader, float *values, uint32_t count);
+const char *SaveState_GetBlob(save_reader_p reader, uint32_t *size);
+
+uint64_t SaveState_Hash(const uint8_t *data, uint32_t size);
+void SaveState_SortRecords(save_record_p records, uint32_t count);
+save_record_p SaveState_FindRecord(save_record_p records, uint32_t count, uint32_t id);
+// writes the count and the ids of the records not seen
+void SaveState_PutRemovedRecords(save_state_p state, const save_record_t *records, const uint8_t *seen, uint32_t count);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif  /* SAVE_STATE_FORMAT_H */
@@ -203,17 +203,6 @@ int Script_UseItem(lua_State *lua, int item_id, int activator_id)
 }
 
 
-int Script_DoTasks(lua_State *lua, float time)
-{
-    lua_pushnumber(lua, time);
-    lua_setglobal(lua, "frame_time");
-
-    Script_CallVoidFunc(lua, "doTasks");
-    Script_CallVoidFunc(lua, "clearKeys");
-
-    return 0;
-}
-
 void Script_AddKey(lua_State *lua, int keycode, int state)
 {
     int top = lua_gettop(lua);
@@ -824,7 +813,7 @@ void Script_LoadConstants(lua_State *lua)
 bool Script_LuaInit()
 {
     bool ret = false;
-    engine_lua = luaL_newstate();
+    engine_lua = Script_NewLuaState();
 
     if(engine_lua)
     {
@@ -859,7 +848,7 @@ void Script_LuaClearTasks()
     {
         int top = lua_gettop(engine_lua);
 
-        Script_CallVoidFunc(engine_lua, "clearTasks");
+        Script_ClearTasks(engine_lua);
 
         lua_getglobal(engine_lua, "tlist_Clear");
         if(lua_isfunction(engine_lua, -1))
@@ -909,4 +898,5 @@ void Script_LuaRegisterFuncs(lua_State *lua)
     Script_LuaRegisterCharacterFuncs(lua);
     Script_LuaRegisterWorldFuncs(lua);
     Script_LuaRegisterAudioFuncs(lua);
+    Script_LuaRegisterTaskFuncs(lua);
 }
@@ -2,6 +2,8 @@
 #ifndef ENGINE_SCRIPT_H
 #define ENGINE_SCRIPT_H
 
+#include <stdint.h>
+
 struct screen_info_s;
 struct entity_s;
 struct lua_State;
@@ -17,6 +19,46 @@ struct lua_State;
 #define TICK_STOPPED        (1)
 #define TICK_ACTIVE         (2)
 
+typedef struct script_task_stats_s
+{
+    uint32_t    tasks;          // alive
+    uint32_t    waiting;        // sleeping in the timer wheel
+    uint32_t    run;            // called during the last frame
+    uint32_t    cascaded;       // moved down the wheel, total
+}script_task_stats_t, *script_task_stats_p;
+
+// Lua time attribution
+#define SCRIPT_PROFILE_LOOP     (0)     // entity onLoop
+#define SCRIPT_PROFILE_EXEC     (1)     // entity callbacks, state control ones too
+#define SCRIPT_PROFILE_TASKS    (2)
+#define SCRIPT_PROFILE_GC       (3)
+#define SCRIPT_PROFILE_COUNT    (4)
+#define SCRIPT_GC_BUDGET_MS     (0.5f)  // default collector time per frame
+
+typedef struct script_profile_entry_s
+{
+    uint32_t    calls;
+    uint64_t    ticks;
+    uint64_t    bytes;          // allocated, what was freed is not taken off
+}script_profile_entry_t, *script_profile_entry_p;
+
+typedef struct script_profile_mark_s
+{
+    uint64_t    time;
+    uint64_t    bytes;
+    uint64_t    nested_ticks;
+}script_profile_mark_t, *script_profile_mark_p;
+
+typedef struct script_frame_stats_s
+{
+    uint32_t    frames;
+    uint32_t    gc_cycles;
+    int         memory_kb;
+    uint64_t    last_ticks;     // Lua time of a frame, callbacks and collector
+    uint64_t    worst_ticks;
+    uint64_t    total_ticks;
+}script_frame_stats_t, *script_frame_stats_p;
+
 extern lua_State *engine_lua;
 
 void Script_LoadConstants(lua_State *lua);
@@ -61,8 +103,23 @@ size_t Script_GetEntitySaveData(lua_State *lua, int id_entity, char *buf, size_t
 void Script_DoFlipEffect(lua_State *lua, int id_effect, int id_object, int param);
 size_t Script_GetFlipEffectsSaveData(lua_State *lua, char *buf, size_t buf_size);
 int  Script_DoTasks(lua_State *lua, float time);
+void Script_ClearTasks(lua_State *lua);
+void Script_GetTaskStats(lua_State *lua, struct script_task_stats_s *stats);
+void Script_LuaRegisterTaskFuncs(lua_State *lua);
 bool Script_CallVoidFunc(lua_State *lua, const char *func_name, bool destroy_after_call = false);
 
 void Script_AddKey(lua_State *lua, int keycode, int state);
 
+lua_State *Script_NewLuaState();
+void  Script_ProfileBegin(struct script_profile_mark_s *mark);
+void  Script_ProfileEnd(struct script_profile_mark_s *mark, int type, int model_id = -1);
+void  Script_FrameEnd(lua_State *lua);     // steps the collector for the budget time
+void  Script_LoadStep(lua_State *lua);     // steps the collector down to its limit, where no frame ends
+void  Script_SetGCBudget(lua_State *lua, float ms);    // 0 - Lua default collector
+float Script_GetGCBudget();
+void  Script_GetFrameStats(struct script_frame_stats_s *stats);
+void  Script_ProfileReset();
+void  Script_ProfilePrint(int top_models);
+int   Script_ProfileDumpCSV(const char *path);
+
 #endif
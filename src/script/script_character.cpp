@@ -392,7 +392,7 @@ int lua_AddCharacterHair(lua_State *lua)
             {
                 ent->character->hair_count++;
                 ent->character->hairs = (struct hair_s**)realloc(ent->character->hairs, (sizeof(struct hair_s*) * ent->character->hair_count));
-                ent->character->hairs[ent->character->hair_count - 1] = Hair_Create(hair_setup, ent->physics);
+                ent->character->hairs[ent->character->hair_count - 1] = Hair_Create(hair_setup, ent);
                 if(!ent->character->hairs[ent->character->hair_count - 1])
                 {
                     ent->character->hair_count--;
@@ -466,6 +466,7 @@ int lua_SetCharacterRagdollSetup(lua_State *lua)
             {
                 Ragdoll_DeleteSetup(ent->character->ragdoll);
                 ent->character->ragdoll = ragdoll_setup;
+                Ragdoll_Reserve(ent->bf, ragdoll_setup);
             }
             else
             {
@@ -497,6 +498,7 @@ int lua_SetCharacterDefaultRagdoll(lua_State *lua)
             {
                 Ragdoll_DeleteSetup(ent->character->ragdoll);
                 ent->character->ragdoll = ragdoll_setup;
+                Ragdoll_Reserve(ent->bf, ragdoll_setup);
             }
             else
             {
@@ -184,6 +184,10 @@ int Script_ParseRender(lua_State *lua, struct render_settings_s *rs)
         rs->texture_border = lua_tonumber(lua, -1);
         lua_pop(lua, 1);
 
+        lua_getfield(lua, -1, "texture_cache");
+        rs->texture_cache = lua_tonumber(lua, -1);
+        lua_pop(lua, 1);
+
         lua_getfield(lua, -1, "z_depth");
         rs->z_depth = lua_tonumber(lua, -1);
         lua_pop(lua, 1);
@@ -204,6 +208,13 @@ int Script_ParseRender(lua_State *lua, struct render_settings_s *rs)
         rs->show_fps = lua_tonumber(lua, -1);
         lua_pop(lua, 1);
 
+        lua_getfield(lua, -1, "occlusion_culling");
+        if(!lua_isnil(lua, -1))
+        {
+            rs->occlusion_culling = lua_tointeger(lua, -1);
+        }
+        lua_pop(lua, 1);
+
         lua_getfield(lua, -1, "fog_color");
         if(lua_istable(lua, -1))
         {
@@ -257,6 +268,13 @@ int Script_ParseAudio(lua_State *lua, struct audio_settings_s *as)
         as->listener_is_player = lua_tointeger(lua, -1);
         lua_pop(lua, 1);
 
+        lua_getfield(lua, -1, "use_pcm_cache");
+        if(!lua_isnil(lua, -1))
+        {
+            as->use_pcm_cache = lua_tointeger(lua, -1);
+        }
+        lua_pop(lua, 1);
+
         lua_settop(lua, top);
         return 1;
     }
@@ -350,6 +368,7 @@ void Script_ExportConfig(const char *path)
         fprintf(f, "    music_volume = %.2f;\n", audio_settings.music_volume);
         fprintf(f, "    use_effects = %d;\n", (int)audio_settings.use_effects);
         fprintf(f, "    listener_is_player = %d;\n", (int)audio_settings.listener_is_player);
+        fprintf(f, "    use_pcm_cache = %d;\n", (int)audio_settings.use_pcm_cache);
         fprintf(f, "}\n\n");
 
         fprintf(f, "render =\n{\n");
@@ -361,6 +380,7 @@ void Script_ExportConfig(const char *path)
         fprintf(f, "    antialias_samples = %d;\n", renderer.settings.antialias_samples);
         fprintf(f, "    z_depth = %d;\n", renderer.settings.z_depth);
         fprintf(f, "    texture_border = %d;\n", renderer.settings.texture_border);
+        fprintf(f, "    texture_cache = %d;\n", renderer.settings.texture_cache);
         {
             int r = renderer.settings.fog_color[0] * 255.5f;
             int g = renderer.settings.fog_color[1] * 255.5f;
@@ -368,6 +388,7 @@ void Script_ExportConfig(const char *path)
             fprintf(f, "    fog_color = {r = %d, g = %d, b = %d};\n", r, g, b);
         }
         fprintf(f, "    show_fps = %d;\n", renderer.settings.show_fps);
+        fprintf(f, "    occlusion_culling = %d;\n", renderer.settings.occlusion_culling);
         fprintf(f, "}\n\n");
 
         fprintf(f, "controls =\n{\n");
@@ -31,6 +31,8 @@ int Script_ExecEntity(lua_State *lua, int id_callback, int id_object, int id_act
 {
     int top = lua_gettop(lua);
     int ret = -1;
+    script_profile_mark_t mark;
+    entity_p ent;
 
     lua_getglobal(lua, "entity_funcs");
     if(!lua_istable(lua, -1))
@@ -98,10 +100,13 @@ int Script_ExecEntity(lua_State *lua, int id_callback, int id_object, int id_act
         lua_pushnil(lua);
     }
 
+    Script_ProfileBegin(&mark);
     if(lua_pcall(lua, 2, 1, 0) == LUA_OK)
     {
         ret = lua_tointeger(lua, -1);
     }
+    ent = World_GetEntityByID(id_object);
+    Script_ProfileEnd(&mark, SCRIPT_PROFILE_EXEC, (ent && ent->bf->animations.model) ? (ent->bf->animations.model->id) : (-1));
 
     lua_settop(lua, top);
 
@@ -179,6 +184,8 @@ void Script_LoopEntity(lua_State *lua, struct entity_s *ent)
     {
         int top = lua_gettop(lua);
         int tick_state = TICK_ACTIVE;
+        int model_id = (ent->bf->animations.model) ? (ent->bf->animations.model->id) : (-1);
+        script_profile_mark_t mark;
 
         if(ent->timer > 0.0f)
         {
@@ -218,7 +225,9 @@ void Script_LoopEntity(lua_State *lua, struct entity_s *ent)
 
         lua_pushinteger(lua, ent->id);
         lua_pushinteger(lua, tick_state);
+        Script_ProfileBegin(&mark);
         lua_CallAndLog(lua, 2, 0, 0);
+        Script_ProfileEnd(&mark, SCRIPT_PROFILE_LOOP, model_id);      // the entity may be gone by now
 
         lua_settop(lua, top);
     }
@@ -566,6 +575,221 @@ int lua_GetEntityVector(lua_State *lua)
 }
 
 
+/*
+ * Bulk entity query: positions, flags and distances of every entity that
+ * passes the filter, written into the column tables of one Lua table that the
+ * script keeps and passes again, so a frame costs one call and no lookups.
+ */
+#define ENTITY_QUERY_MAX_IDS        (32)
+#define ENTITY_QUERY_COLUMNS        (8)
+
+typedef struct entity_query_s
+{
+    lua_State      *lua;
+    int             columns;            // stack index of the first column table
+    int             count;
+    uint32_t        models[ENTITY_QUERY_MAX_IDS];
+    int             models_count;
+    uint32_t        rooms[ENTITY_QUERY_MAX_IDS];
+    int             rooms_count;
+    uint32_t        exclude_id;
+    uint16_t        state;
+    float           center[3];
+    float           radius;             // < 0 - no radius filter
+}entity_query_t, *entity_query_p;
+
+static const char *entity_query_columns[ENTITY_QUERY_COLUMNS] =
+{
+    "id", "x", "y", "z", "dist", "flags", "room", "model"
+};
+
+
+// < 0 - the list is longer than the query holds
+static int Script_ParseQueryIds(lua_State *lua, const char *field, uint32_t *ids)
+{
+    int count = 0;
+
+    lua_getfield(lua, 2, field);
+    if(lua_isinteger(lua, -1))
+    {
+        ids[count++] = lua_tointeger(lua, -1);
+    }
+    else if(lua_istable(lua, -1))
+    {
+        int n = luaL_len(lua, -1);
+        if(n > ENTITY_QUERY_MAX_IDS)
+        {
+            Con_Warning("queryEntities: more than %d ids in \"%s\"", ENTITY_QUERY_MAX_IDS, field);
+            lua_pop(lua, 1);
+            return -1;
+        }
+        for(int i = 1; i <= n; ++i)
+        {
+            lua_rawgeti(lua, -1, i);
+            ids[count++] = lua_tointeger(lua, -1);
+            lua_pop(lua, 1);
+        }
+    }
+    lua_pop(lua, 1);
+
+    return count;
+}
+
+
+static int Script_QueryEntity(entity_p ent, void *data)
+{
+    entity_query_p q = (entity_query_p)data;
+    uint32_t model_id = (ent->bf->animations.model) ? (ent->bf->animations.model->id) : (0xFFFFFFFF);
+    uint32_t room_id = (ent->self->room) ? (ent->self->room->id) : (0xFFFFFFFF);
+    uint32_t real_room_id = (ent->self->room && ent->self->room->real_room) ? (ent->self->room->real_room->id) : (room_id);
+    float *pos = ent->transform.M4x4 + 12;
+    float dist = 0.0f;
+    lua_State *lua = q->lua;
+    int i;
+
+    if((ent->id == q->exclude_id) || ((ent->state_flags & q->state) != q->state))
+    {
+        return 0;
+    }
+    for(i = 0; (i < q->models_count) && (q->models[i] != model_id); ++i);
+    if(q->models_count && (i == q->models_count))
+    {
+        return 0;
+    }
+    // an entity in a flipped room is in the room the script knows too
+    for(i = 0; (i < q->rooms_count) && (q->rooms[i] != room_id) && (q->rooms[i] != real_room_id); ++i);
+    if(q->rooms_count && (i == q->rooms_count))
+    {
+        return 0;
+    }
+    if(q->radius >= 0.0f)
+    {
+        dist = vec3_dist(q->center, pos);
+        if(dist > q->radius)
+        {
+            return 0;
+        }
+    }
+
+    q->count++;
+    lua_pushinteger(lua, ent->id);
+    lua_rawseti(lua, q->columns + 0, q->count);
+    lua_pushnumber(lua, pos[0]);
+    lua_rawseti(lua, q->columns + 1, q->count);
+    lua_pushnumber(lua, pos[1]);
+    lua_rawseti(lua, q->columns + 2, q->count);
+    lua_pushnumber(lua, pos[2]);
+    lua_rawseti(lua, q->columns + 3, q->count);
+    lua_pushnumber(lua, dist);
+    lua_rawseti(lua, q->columns + 4, q->count);
+    lua_pushinteger(lua, ent->state_flags);
+    lua_rawseti(lua, q->columns + 5, q->count);
+    lua_pushinteger(lua, (int32_t)room_id);
+    lua_rawseti(lua, q->columns + 6, q->count);
+    lua_pushinteger(lua, (int32_t)model_id);
+    lua_rawseti(lua, q->columns + 7, q->count);
+
+    return 0;
+}
+
+
+int lua_QueryEntities(lua_State *lua)
+{
+    entity_query_t q;
+    bool matches_none = false;
+
+    if(!lua_istable(lua, 1) || ((lua_gettop(lua) >= 2) && !lua_isnil(lua, 2) && !lua_istable(lua, 2)))
+    {
+        Con_Warning("queryEntities: expecting arguments (result_table, (filter_table))");
+        return 0;
+    }
+
+    q.lua = lua;
+    q.count = 0;
+    q.models_count = 0;
+    q.rooms_count = 0;
+    q.exclude_id = ENTITY_ID_NONE;
+    q.state = 0;
+    q.radius = -1.0f;
+    vec3_set_zero(q.center);
+
+    if(lua_istable(lua, 2))
+    {
+        q.models_count = Script_ParseQueryIds(lua, "model", q.models);
+        q.rooms_count = Script_ParseQueryIds(lua, "room", q.rooms);
+        matches_none = (q.models_count < 0) || (q.rooms_count < 0);
+
+        lua_getfield(lua, 2, "state");
+        q.state = lua_tointeger(lua, -1);
+        lua_pop(lua, 1);
+
+        lua_getfield(lua, 2, "exclude");
+        if(lua_isinteger(lua, -1))
+        {
+            q.exclude_id = lua_tointeger(lua, -1);
+        }
+        lua_pop(lua, 1);
+
+        lua_getfield(lua, 2, "from");
+        if(lua_isinteger(lua, -1))
+        {
+            entity_p ent = World_GetEntityByID(lua_tointeger(lua, -1));
+            if(ent)
+            {
+                vec3_copy(q.center, ent->transform.M4x4 + 12);
+            }
+            else
+            {
+                matches_none = true;    // nothing is near an entity that is gone
+            }
+            q.radius = 1.0e30f;     // distances are wanted even without a radius
+        }
+        lua_pop(lua, 1);
+
+        for(int i = 0; i < 3; ++i)
+        {
+            lua_getfield(lua, 2, entity_query_columns[1 + i]);
+            if(lua_isnumber(lua, -1))
+            {
+                q.center[i] = lua_tonumber(lua, -1);
+                q.radius = 1.0e30f;
+            }
+            lua_pop(lua, 1);
+        }
+
+        lua_getfield(lua, 2, "radius");
+        if(lua_isnumber(lua, -1))
+        {
+            q.radius = lua_tonumber(lua, -1);
+        }
+        lua_pop(lua, 1);
+    }
+
+    lua_settop(lua, 1);
+    q.columns = 2;
+    for(int i = 0; i < ENTITY_QUERY_COLUMNS; ++i)
+    {
+        if(lua_getfield(lua, 1, entity_query_columns[i]) != LUA_TTABLE)
+        {
+            lua_pop(lua, 1);
+            lua_newtable(lua);
+            lua_pushvalue(lua, -1);
+            lua_setfield(lua, 1, entity_query_columns[i]);
+        }
+    }
+
+    if(!matches_none)
+    {
+        World_IterateAllEntities(Script_QueryEntity, &q);
+    }
+
+    lua_pushinteger(lua, q.count);
+    lua_setfield(lua, 1, "count");
+    lua_pushinteger(lua, q.count);
+    return 1;
+}
+
+
 int lua_GetEntityDistance(lua_State *lua)
 {
     if(lua_gettop(lua) >= 2)
@@ -2667,6 +2891,7 @@ void Script_LuaRegisterEntityFuncs(lua_State *lua)
     lua_register(lua, "getEntityVector", lua_GetEntityVector);
     lua_register(lua, "getEntityDirDot", lua_GetEntityDirDot);
     lua_register(lua, "getEntityDistance", lua_GetEntityDistance);
+    lua_register(lua, "queryEntities", lua_QueryEntities);
     lua_register(lua, "getEntityRoom", lua_GetEntityRoom);
     lua_register(lua, "getEntityPos", lua_GetEntityPosition);
     lua_register(lua, "setEntityPos", lua_SetEntityPosition);
@@ -0,0 +1,305 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_timer.h>
+
+extern "C" {
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+}
+
+#include "script.h"
+
+#include "../core/system.h"
+#include "../core/console.h"
+
+/*
+ * Lua frame budget: time and allocated bytes of every callback, by callback
+ * type and by entity model, and the incremental collector stepped at the end
+ * of the frame for a fixed time, instead of full cycles at random frames.
+ * No frame ends while a level loads, there it is stepped between load stages.
+ */
+
+#define SCRIPT_GC_LIMIT_MIN_KB      (1024)      // stepping goes past the budget above twice the live size, or that
+#define SCRIPT_GC_OVERRUN_MAX       (4.0f)      // ...but no further than that many budgets, the rest waits for next frames
+
+typedef struct script_profile_model_s
+{
+    struct script_profile_entry_s   types[SCRIPT_PROFILE_COUNT];
+}script_profile_model_t, *script_profile_model_p;
+
+static struct
+{
+    uint64_t                        alloc_bytes;        // total, never goes down
+    uint64_t                        nested_ticks;       // callbacks inside callbacks, taken from the outer one
+    int                             depth;
+    uint64_t                        frame_ticks;
+    struct script_profile_entry_s   types[SCRIPT_PROFILE_COUNT];
+    script_profile_model_p          models;
+    uint32_t                        models_count;
+    struct script_frame_stats_s     frames;
+    int                             gc_limit_kb;
+} script_profile = {0};
+
+static float script_gc_budget_ms = SCRIPT_GC_BUDGET_MS;
+
+static const char *script_profile_names[SCRIPT_PROFILE_COUNT] =
+{
+    "loop",
+    "exec",
+    "tasks",
+    "gc"
+};
+
+
+static void *Script_LuaAlloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    if(nsize == 0)
+    {
+        free(ptr);
+        return NULL;
+    }
+    if(nsize > osize || !ptr)
+    {
+        script_profile.alloc_bytes += (ptr) ? (nsize - osize) : (nsize);
+    }
+    return realloc(ptr, nsize);
+}
+
+
+static void Script_ProfileAdd(struct script_profile_entry_s *e, uint64_t ticks, uint64_t bytes)
+{
+    e->calls++;
+    e->ticks += ticks;
+    e->bytes += bytes;
+}
+
+
+lua_State *Script_NewLuaState()
+{
+    lua_State *lua = lua_newstate(Script_LuaAlloc, NULL);
+    if(lua)
+    {
+        Script_SetGCBudget(lua, script_gc_budget_ms);
+    }
+    return lua;
+}
+
+
+void Script_ProfileBegin(struct script_profile_mark_s *mark)
+{
+    mark->nested_ticks = script_profile.nested_ticks;
+    mark->bytes = script_profile.alloc_bytes;
+    mark->time = SDL_GetPerformanceCounter();
+    script_profile.depth++;
+}
+
+
+void Script_ProfileEnd(struct script_profile_mark_s *mark, int type, int model_id)
+{
+    uint64_t ticks = SDL_GetPerformanceCounter() - mark->time;
+    uint64_t self = ticks - (script_profile.nested_ticks - mark->nested_ticks);
+    uint64_t bytes = script_profile.alloc_bytes - mark->bytes;
+
+    if(--script_profile.depth == 0)
+    {
+        script_profile.frame_ticks += ticks;
+    }
+    script_profile.nested_ticks = mark->nested_ticks + ticks;
+    Script_ProfileAdd(script_profile.types + type, self, bytes);
+
+    if(model_id >= 0)
+    {
+        if((uint32_t)model_id >= script_profile.models_count)
+        {
+            uint32_t new_count = model_id + 64;
+            script_profile.models = (script_profile_model_p)realloc(script_profile.models, new_count * sizeof(script_profile_model_t));
+            memset(script_profile.models + script_profile.models_count, 0, (new_count - script_profile.models_count) * sizeof(script_profile_model_t));
+            script_profile.models_count = new_count;
+        }
+        Script_ProfileAdd(script_profile.models[model_id].types + type, self, bytes);
+    }
+}
+
+
+// one small step; at the end of a cycle what is alive decides how far the next one may fall behind
+static int Script_GCStep(lua_State *lua)
+{
+    if(lua_gc(lua, LUA_GCSTEP, 0))
+    {
+        int kb = lua_gc(lua, LUA_GCCOUNT, 0);
+        script_profile.gc_limit_kb = (2 * kb > SCRIPT_GC_LIMIT_MIN_KB) ? (2 * kb) : (SCRIPT_GC_LIMIT_MIN_KB);
+        script_profile.frames.gc_cycles++;
+        return 1;
+    }
+    return 0;
+}
+
+
+void Script_FrameEnd(lua_State *lua)
+{
+    uint64_t t0 = SDL_GetPerformanceCounter();
+    uint64_t frame_ticks;
+
+    if(script_gc_budget_ms > 0.0f)
+    {
+        uint64_t budget = (uint64_t)(script_gc_budget_ms * 0.001f * SDL_GetPerformanceFrequency());
+        uint64_t deadline = t0 + budget;
+        uint64_t overrun_deadline = t0 + (uint64_t)(SCRIPT_GC_OVERRUN_MAX * budget);
+        while(!Script_GCStep(lua))
+        {
+            uint64_t now = SDL_GetPerformanceCounter();
+            if((now >= overrun_deadline) || ((now >= deadline) && (lua_gc(lua, LUA_GCCOUNT, 0) <= script_profile.gc_limit_kb)))
+            {
+                break;
+            }
+        }
+        t0 = SDL_GetPerformanceCounter() - t0;
+        script_profile.frame_ticks += t0;
+        Script_ProfileAdd(script_profile.types + SCRIPT_PROFILE_GC, t0, 0);
+    }
+
+    frame_ticks = script_profile.frame_ticks;
+    script_profile.frames.frames++;
+    script_profile.frames.total_ticks += frame_ticks;
+    script_profile.frames.last_ticks = frame_ticks;
+    script_profile.frames.worst_ticks = (frame_ticks > script_profile.frames.worst_ticks) ? (frame_ticks) : (script_profile.frames.worst_ticks);
+    script_profile.frames.memory_kb = lua_gc(lua, LUA_GCCOUNT, 0);
+    script_profile.frame_ticks = 0;
+    script_profile.nested_ticks = 0;
+}
+
+
+void Script_LoadStep(lua_State *lua)
+{
+    if(lua && (script_gc_budget_ms > 0.0f))
+    {
+        // the running cycle is finished; if it began before the garbage came, one more takes it
+        uint64_t t0 = SDL_GetPerformanceCounter();
+        int limit_kb = script_profile.gc_limit_kb;
+        if(lua_gc(lua, LUA_GCCOUNT, 0) > limit_kb)
+        {
+            while(!Script_GCStep(lua));
+            if(lua_gc(lua, LUA_GCCOUNT, 0) > limit_kb)
+            {
+                while(!Script_GCStep(lua));
+            }
+        }
+        Script_ProfileAdd(script_profile.types + SCRIPT_PROFILE_GC, SDL_GetPerformanceCounter() - t0, 0);
+    }
+}
+
+
+void Script_SetGCBudget(lua_State *lua, float ms)
+{
+    script_gc_budget_ms = ms;
+    script_profile.gc_limit_kb = SCRIPT_GC_LIMIT_MIN_KB;
+    if(lua)
+    {
+        lua_gc(lua, (ms > 0.0f) ? (LUA_GCSTOP) : (LUA_GCRESTART), 0);
+    }
+}
+
+
+float Script_GetGCBudget()
+{
+    return script_gc_budget_ms;
+}
+
+
+void Script_GetFrameStats(struct script_frame_stats_s *stats)
+{
+    *stats = script_profile.frames;
+}
+
+
+void Script_ProfileReset()
+{
+    memset(script_profile.types, 0, sizeof(script_profile.types));
+    memset(&script_profile.frames, 0, sizeof(script_profile.frames));
+    if(script_profile.models)
+    {
+        memset(script_profile.models, 0, script_profile.models_count * sizeof(script_profile_model_t));
+    }
+}
+
+
+void Script_ProfilePrint(int top_models)
+{
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    double frames = (script_profile.frames.frames) ? (script_profile.frames.frames) : (1);
+
+    Con_Printf("lua: %d frames, avg %.3f ms, worst %.3f ms, %d KB, gc budget %.2f ms, %d gc cycles",
+               script_profile.frames.frames, ms * script_profile.frames.total_ticks / frames, ms * script_profile.frames.worst_ticks,
+               script_profile.frames.memory_kb, script_gc_budget_ms, script_profile.frames.gc_cycles);
+    for(int i = 0; i < SCRIPT_PROFILE_COUNT; ++i)
+    {
+        struct script_profile_entry_s *e = script_profile.types + i;
+        Con_Printf("  %s: %d calls, %.3f ms per frame, %.1f KB per frame", script_profile_names[i], e->calls,
+                   ms * e->ticks / frames, e->bytes / (1024.0 * frames));
+    }
+
+    // the models that cost most, a few at a time, without sorting the whole table
+    for(uint64_t last = UINT64_MAX, last_id = 0; top_models > 0; --top_models)
+    {
+        uint64_t best = 0;
+        uint32_t best_id = 0;
+        for(uint32_t id = 0; id < script_profile.models_count; ++id)
+        {
+            uint64_t ticks = 0;
+            for(int i = 0; i < SCRIPT_PROFILE_COUNT; ++i)
+            {
+                ticks += script_profile.models[id].types[i].ticks;
+            }
+            if((ticks > best) && ((ticks < last) || ((ticks == last) && (id > last_id))))
+            {
+                best = ticks;
+                best_id = id;
+            }
+        }
+        if(!best)
+        {
+            break;
+        }
+        last = best;
+        last_id = best_id;
+        Con_Printf("  model %d: loop %.3f ms, exec %.3f ms per frame", best_id,
+                   ms * script_profile.models[best_id].types[SCRIPT_PROFILE_LOOP].ticks / frames,
+                   ms * script_profile.models[best_id].types[SCRIPT_PROFILE_EXEC].ticks / frames);
+    }
+}
+
+
+int Script_ProfileDumpCSV(const char *path)
+{
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    FILE *f = fopen(path, "wt");
+
+    if(!f)
+    {
+        return 0;
+    }
+
+    fprintf(f, "model,type,calls,time_ms,bytes\n");
+    for(int i = 0; i < SCRIPT_PROFILE_COUNT; ++i)
+    {
+        struct script_profile_entry_s *e = script_profile.types + i;
+        fprintf(f, "all,%s,%u,%.4f,%llu\n", script_profile_names[i], e->calls, ms * e->ticks, (unsigned long long)e->bytes);
+    }
+    for(uint32_t id = 0; id < script_profile.models_count; ++id)
+    {
+        for(int i = 0; i < SCRIPT_PROFILE_COUNT; ++i)
+        {
+            struct script_profile_entry_s *e = script_profile.models[id].types + i;
+            if(e->calls)
+            {
+                fprintf(f, "%u,%s,%u,%.4f,%llu\n", id, script_profile_names[i], e->calls, ms * e->ticks, (unsigned long long)e->bytes);
+            }
+        }
+    }
+    fclose(f);
+
+    return 1;
+}
@@ -0,0 +1,473 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+extern "C" {
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+}
+
+#include "script.h"
+
+#include "../core/console.h"
+
+/*
+ * Script task scheduler: Lua functions called every frame or after a delay.
+ * Tasks live in a table with generation counted handles; waiting tasks are
+ * kept in a two level timer wheel, so a frame costs only the tasks that are
+ * due, not the tasks that sleep.
+ */
+
+#define TASK_TICK_TIME          (1.0 / 60.0)
+#define TASK_WHEEL_BITS         (8)
+#define TASK_WHEEL_SIZE         (1 << TASK_WHEEL_BITS)
+#define TASK_WHEEL_MASK         (TASK_WHEEL_SIZE - 1)
+#define TASK_MAX_COUNT          (0x10000)       // index is the low 16 bits of a handle
+#define TASK_NONE               (-1)
+#define TASK_SLOT_FREE          (-2)
+#define TASK_SLOT_READY         (-1)
+#define TASK_REGISTRY_KEY       "script_tasks"
+
+typedef struct script_task_s
+{
+    int32_t     func_ref;
+    uint32_t    due_tick;
+    int32_t     next;
+    int32_t     prev;
+    int16_t     slot;           // TASK_SLOT_FREE, TASK_SLOT_READY or wheel slot
+    uint16_t    generation;
+}script_task_t, *script_task_p;
+
+typedef struct script_task_list_s
+{
+    int32_t     head;
+    int32_t     tail;
+}script_task_list_t, *script_task_list_p;
+
+typedef struct script_tasks_s
+{
+    script_task_p       tasks;
+    int32_t             tasks_size;
+    int32_t             free_head;
+    int32_t             cursor;         // next ready task of the running pass
+    int32_t             pass_end;       // first task made ready while the pass runs, the pass stops there
+    int                 pass_running;
+    uint32_t            tick;
+    double              time;           // not yet counted in ticks
+    script_task_list_t  ready;
+    script_task_list_t  wheel[2 * TASK_WHEEL_SIZE];
+    struct script_task_stats_s stats;
+}script_tasks_t, *script_tasks_p;
+
+
+static script_task_list_p Tasks_GetList(script_tasks_p s, int16_t slot)
+{
+    return (slot == TASK_SLOT_READY) ? (&s->ready) : (s->wheel + slot);
+}
+
+
+static void Tasks_Link(script_tasks_p s, int32_t i, int16_t slot)
+{
+    script_task_list_p list = Tasks_GetList(s, slot);
+    script_task_p t = s->tasks + i;
+
+    t->slot = slot;
+    t->next = TASK_NONE;
+    t->prev = list->tail;
+    if(list->tail != TASK_NONE)
+    {
+        s->tasks[list->tail].next = i;
+    }
+    else
+    {
+        list->head = i;
+    }
+    list->tail = i;
+}
+
+
+static void Tasks_Unlink(script_tasks_p s, int32_t i)
+{
+    script_task_p t = s->tasks + i;
+    script_task_list_p list = Tasks_GetList(s, t->slot);
+
+    if(s->cursor == i)
+    {
+        s->cursor = t->next;
+    }
+    if(s->pass_end == i)
+    {
+        s->pass_end = t->next;                  // only tasks added during the pass follow it
+    }
+    if(t->prev != TASK_NONE)
+    {
+        s->tasks[t->prev].next = t->next;
+    }
+    else
+    {
+        list->head = t->next;
+    }
+    if(t->next != TASK_NONE)
+    {
+        s->tasks[t->next].prev = t->prev;
+    }
+    else
+    {
+        list->tail = t->prev;
+    }
+    t->next = TASK_NONE;
+    t->prev = TASK_NONE;
+}
+
+
+static void Tasks_Schedule(script_tasks_p s, int32_t i)
+{
+    uint32_t due = s->tasks[i].due_tick;
+    uint32_t delta = due - s->tick;
+    uint32_t delta_hi = (due >> TASK_WHEEL_BITS) - (s->tick >> TASK_WHEEL_BITS);
+
+    if(delta < TASK_WHEEL_SIZE)
+    {
+        Tasks_Link(s, i, due & TASK_WHEEL_MASK);
+    }
+    else if(delta_hi < TASK_WHEEL_SIZE)
+    {
+        Tasks_Link(s, i, TASK_WHEEL_SIZE + ((due >> TASK_WHEEL_BITS) & TASK_WHEEL_MASK));
+    }
+    else
+    {
+        // further than the wheel reaches: parked in the last upper slot and scheduled again from there
+        Tasks_Link(s, i, TASK_WHEEL_SIZE + (((s->tick >> TASK_WHEEL_BITS) - 1) & TASK_WHEEL_MASK));
+    }
+    s->stats.waiting++;
+}
+
+
+static void Tasks_Free(lua_State *lua, script_tasks_p s, int32_t i)
+{
+    script_task_p t = s->tasks + i;
+
+    if(t->slot != TASK_SLOT_READY)
+    {
+        s->stats.waiting--;
+    }
+    Tasks_Unlink(s, i);
+    luaL_unref(lua, LUA_REGISTRYINDEX, t->func_ref);
+    t->func_ref = LUA_NOREF;
+    t->slot = TASK_SLOT_FREE;
+    t->generation++;
+    t->next = s->free_head;
+    s->free_head = i;
+    s->stats.tasks--;
+}
+
+
+static script_task_p Tasks_Get(script_tasks_p s, lua_Integer handle)
+{
+    int32_t i = handle & (TASK_MAX_COUNT - 1);
+    if((handle >= 0) && (i < s->tasks_size) && (s->tasks[i].slot != TASK_SLOT_FREE) &&
+       (s->tasks[i].generation == (uint16_t)(handle >> 16)))
+    {
+        return s->tasks + i;
+    }
+    return NULL;
+}
+
+
+static uint32_t Tasks_DelayToTicks(lua_Number delay)
+{
+    delay = ceil(delay / TASK_TICK_TIME);
+    return (delay > 0.0) ? ((delay < 4.0e9) ? ((uint32_t)delay) : (4000000000u)) : (0);
+}
+
+
+static void Tasks_Sleep(script_tasks_p s, int32_t i, uint32_t ticks)
+{
+    if(ticks == 0)
+    {
+        Tasks_Link(s, i, TASK_SLOT_READY);
+        if(s->pass_running && (s->pass_end == TASK_NONE))
+        {
+            s->pass_end = i;
+        }
+    }
+    else
+    {
+        s->tasks[i].due_tick = s->tick + ticks;
+        Tasks_Schedule(s, i);
+    }
+}
+
+
+static void Tasks_AdvanceTick(script_tasks_p s)
+{
+    script_task_list_p list;
+    int32_t i;
+
+    s->tick++;
+    if((s->tick & TASK_WHEEL_MASK) == 0)
+    {
+        // the upper slot that starts now is spread over the lower wheel
+        list = s->wheel + TASK_WHEEL_SIZE + ((s->tick >> TASK_WHEEL_BITS) & TASK_WHEEL_MASK);
+        i = list->head;
+        list->head = TASK_NONE;
+        list->tail = TASK_NONE;
+        while(i != TASK_NONE)
+        {
+            int32_t next = s->tasks[i].next;
+            s->stats.waiting--;
+            Tasks_Schedule(s, i);
+            s->stats.cascaded++;
+            i = next;
+        }
+    }
+
+    list = s->wheel + (s->tick & TASK_WHEEL_MASK);
+    i = list->head;
+    list->head = TASK_NONE;
+    list->tail = TASK_NONE;
+    while(i != TASK_NONE)
+    {
+        int32_t next = s->tasks[i].next;
+        s->stats.waiting--;
+        Tasks_Link(s, i, TASK_SLOT_READY);
+        i = next;
+    }
+}
+
+
+static script_tasks_p Tasks_GetScheduler(lua_State *lua)
+{
+    script_tasks_p s;
+
+    lua_getfield(lua, LUA_REGISTRYINDEX, TASK_REGISTRY_KEY);
+    s = (script_tasks_p)lua_touserdata(lua, -1);
+    lua_pop(lua, 1);
+
+    return s;
+}
+
+
+static int lua_TasksGC(lua_State *lua)
+{
+    script_tasks_p s = (script_tasks_p)lua_touserdata(lua, 1);
+    free(s->tasks);
+    s->tasks = NULL;
+    s->tasks_size = 0;
+    return 0;
+}
+
+
+/*
+ * Lua API
+ */
+int lua_AddTask(lua_State *lua)
+{
+    script_tasks_p s = (script_tasks_p)lua_touserdata(lua, lua_upvalueindex(1));
+    int32_t i;
+
+    if(!lua_isfunction(lua, 1))
+    {
+        Con_Warning("addTask: expecting arguments (function, (delay))");
+        return 0;
+    }
+
+    if(s->free_head == TASK_NONE)
+    {
+        int32_t new_size = (s->tasks_size) ? (2 * s->tasks_size) : (64);
+        if(s->tasks_size >= TASK_MAX_COUNT)
+        {
+            Con_Warning("addTask: too many tasks, max = %d", TASK_MAX_COUNT);
+            return 0;
+        }
+        new_size = (new_size > TASK_MAX_COUNT) ? (TASK_MAX_COUNT) : (new_size);
+        s->tasks = (script_task_p)realloc(s->tasks, new_size * sizeof(script_task_t));
+        for(i = new_size - 1; i >= s->tasks_size; --i)
+        {
+            s->tasks[i].func_ref = LUA_NOREF;
+            s->tasks[i].slot = TASK_SLOT_FREE;
+            s->tasks[i].generation = 0;
+            s->tasks[i].prev = TASK_NONE;
+            s->tasks[i].next = s->free_head;
+            s->free_head = i;
+        }
+        s->tasks_size = new_size;
+    }
+
+    i = s->free_head;
+    s->free_head = s->tasks[i].next;
+    lua_pushvalue(lua, 1);
+    s->tasks[i].func_ref = luaL_ref(lua, LUA_REGISTRYINDEX);
+    s->stats.tasks++;
+    Tasks_Sleep(s, i, (lua_isnumber(lua, 2)) ? (Tasks_DelayToTicks(lua_tonumber(lua, 2))) : (0));
+
+    lua_pushinteger(lua, ((lua_Integer)s->tasks[i].generation << 16) | i);
+    return 1;
+}
+
+
+int lua_RemoveTask(lua_State *lua)
+{
+    script_tasks_p s = (script_tasks_p)lua_touserdata(lua, lua_upvalueindex(1));
+    script_task_p t = (lua_isinteger(lua, 1)) ? (Tasks_Get(s, lua_tointeger(lua, 1))) : (NULL);
+
+    if(t)
+    {
+        Tasks_Free(lua, s, t - s->tasks);
+    }
+    lua_pushboolean(lua, t != NULL);
+    return 1;
+}
+
+
+int lua_ClearTasks(lua_State *lua)
+{
+    Script_ClearTasks(lua);
+    return 0;
+}
+
+
+int lua_GetTasksCount(lua_State *lua)
+{
+    script_tasks_p s = (script_tasks_p)lua_touserdata(lua, lua_upvalueindex(1));
+    lua_pushinteger(lua, s->stats.tasks);
+    lua_pushinteger(lua, s->stats.waiting);
+    return 2;
+}
+
+
+/*
+ * Engine side
+ */
+int Script_DoTasks(lua_State *lua, float time)
+{
+    script_tasks_p s = Tasks_GetScheduler(lua);
+    script_profile_mark_t mark;
+
+    if(!s)
+    {
+        return -1;
+    }
+
+    lua_pushnumber(lua, time);
+    lua_setglobal(lua, "frame_time");
+
+    s->stats.run = 0;
+    for(s->time += time; s->time >= TASK_TICK_TIME; s->time -= TASK_TICK_TIME)
+    {
+        Tasks_AdvanceTick(s);
+    }
+
+    // tasks added while the pass runs are linked after the ready ones, they wait for the next frame
+    Script_ProfileBegin(&mark);
+    s->cursor = s->ready.head;
+    s->pass_end = TASK_NONE;
+    s->pass_running = 1;
+    while((s->cursor != TASK_NONE) && (s->cursor != s->pass_end))
+    {
+        int32_t i = s->cursor;
+        uint16_t generation = s->tasks[i].generation;
+        int top = lua_gettop(lua);
+
+        s->cursor = s->tasks[i].next;
+        s->stats.run++;
+        lua_rawgeti(lua, LUA_REGISTRYINDEX, s->tasks[i].func_ref);
+        if(lua_CallAndLog(lua, 0, 1, 0))
+        {
+            // the task may have removed itself or cleared all tasks
+            if((s->tasks[i].slot == TASK_SLOT_READY) && (s->tasks[i].generation == generation))
+            {
+                if(lua_isnumber(lua, -1))
+                {
+                    uint32_t ticks = Tasks_DelayToTicks(lua_tonumber(lua, -1));
+                    if(ticks)
+                    {
+                        Tasks_Unlink(s, i);
+                        Tasks_Sleep(s, i, ticks);
+                    }
+                }
+                else if(!lua_toboolean(lua, -1))     // remove task, if it returns nil or false.
+                {
+                    Tasks_Free(lua, s, i);
+                }
+            }
+        }
+        else if((s->tasks[i].slot != TASK_SLOT_FREE) && (s->tasks[i].generation == generation))
+        {
+            Tasks_Free(lua, s, i);
+        }
+        lua_settop(lua, top);
+    }
+    s->cursor = TASK_NONE;
+    s->pass_end = TASK_NONE;
+    s->pass_running = 0;
+    Script_ProfileEnd(&mark, SCRIPT_PROFILE_TASKS);
+
+    Script_CallVoidFunc(lua, "clearKeys");
+
+    return 0;
+}
+
+
+void Script_ClearTasks(lua_State *lua)
+{
+    script_tasks_p s = Tasks_GetScheduler(lua);
+
+    if(s)
+    {
+        for(int32_t i = 0; i < s->tasks_size; ++i)
+        {
+            if(s->tasks[i].slot != TASK_SLOT_FREE)
+            {
+                Tasks_Free(lua, s, i);
+            }
+        }
+    }
+}
+
+
+void Script_GetTaskStats(lua_State *lua, struct script_task_stats_s *stats)
+{
+    script_tasks_p s = Tasks_GetScheduler(lua);
+    *stats = s->stats;
+}
+
+
+void Script_LuaRegisterTaskFuncs(lua_State *lua)
+{
+    script_tasks_p s = (script_tasks_p)lua_newuserdata(lua, sizeof(script_tasks_t));
+
+    memset(s, 0, sizeof(script_tasks_t));
+    s->free_head = TASK_NONE;
+    s->cursor = TASK_NONE;
+    s->pass_end = TASK_NONE;
+    s->ready.head = s->ready.tail = TASK_NONE;
+    for(int i = 0; i < 2 * TASK_WHEEL_SIZE; ++i)
+    {
+        s->wheel[i].head = s->wheel[i].tail = TASK_NONE;
+    }
+
+    lua_newtable(lua);
+    lua_pushcfunction(lua, lua_TasksGC);
+    lua_setfield(lua, -2, "__gc");
+    lua_setmetatable(lua, -2);
+
+    lua_pushvalue(lua, -1);
+    lua_setfield(lua, LUA_REGISTRYINDEX, TASK_REGISTRY_KEY);
+
+    lua_pushvalue(lua, -1);
+    lua_pushcclosure(lua, lua_AddTask, 1);
+    lua_setglobal(lua, "addTask");
+    lua_pushvalue(lua, -1);
+    lua_pushcclosure(lua, lua_RemoveTask, 1);
+    lua_setglobal(lua, "removeTask");
+    lua_pushvalue(lua, -1);
+    lua_pushcclosure(lua, lua_GetTasksCount, 1);
+    lua_setglobal(lua, "getTasksCount");
+    lua_pop(lua, 1);
+
+    lua_register(lua, "clearTasks", lua_ClearTasks);
+}
@@ -23,6 +23,7 @@
 
 #include <zlib.h>
 #include "l_main.h"
+#include "textile_convert.h"
 #include "tr_versions.h"
 #include "../core/system.h"
 
@@ -37,13 +38,10 @@ void TR_Level::read_tr4_vertex_float(SDL_RWops * const src, tr5_vertex_t & verte
 
 void TR_Level::read_tr4_textile32(SDL_RWops * const src, tr4_textile32_t & textile)
 {
-    for (int i = 0; i < 256; i++) {
-        if (SDL_RWread(src, textile.pixels[i], 4, 256) < 256)
-            Sys_extError("read_tr4_textile32");
+    if (SDL_RWread(src, textile.pixels, 4, 256 * 256) < 256 * 256)
+        Sys_extError("read_tr4_textile32");
 
-        for (int j = 0; j < 256; j++)
-            textile.pixels[i][j] = SDL_SwapLE32((textile.pixels[i][j] & 0xff00ff00) | ((textile.pixels[i][j] & 0x00ff0000) >> 16) | ((textile.pixels[i][j] & 0x000000ff) << 16));
-    }
+    Textile_SwapRB(&textile.pixels[0][0], 256 * 256);
 }
 
 void TR_Level::read_tr4_face3(SDL_RWops * const src, tr4_face3_t & meshface)
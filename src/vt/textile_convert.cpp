@@ -0,0 +1,306 @@
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_cpuinfo.h>
+#include <SDL2/SDL_endian.h>
+#include <SDL2/SDL_thread.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "textile_convert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TEXTILE_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define TEXTILE_HAVE_AVX2 1
+#define TEXTILE_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+#define TEXTILE_HAVE_AVX2 1
+#define TEXTILE_AVX2_TARGET
+#include <immintrin.h>
+#endif
+#endif
+
+#define TEXTILE_MAX_THREADS     (8)
+
+static int textile_kernel = TEXTILE_KERNEL_AUTO;
+
+
+int Textile_SetKernel(int kernel)
+{
+    int best = TEXTILE_KERNEL_SCALAR;
+#if TEXTILE_HAVE_SSE2
+    if(SDL_HasSSE2())
+    {
+        best = TEXTILE_KERNEL_SSE2;
+    }
+#if TEXTILE_HAVE_AVX2
+    if(SDL_HasAVX2())
+    {
+        best = TEXTILE_KERNEL_AVX2;
+    }
+#endif
+#endif
+    textile_kernel = ((kernel < 0) || (kernel > best)) ? (best) : (kernel);
+    return textile_kernel;
+}
+
+
+int Textile_GetKernel()
+{
+    return (textile_kernel < 0) ? (Textile_SetKernel(TEXTILE_KERNEL_AUTO)) : (textile_kernel);
+}
+
+
+const char *Textile_GetKernelName(int kernel)
+{
+    switch(kernel)
+    {
+        case TEXTILE_KERNEL_SSE2:
+            return "sse2";
+        case TEXTILE_KERNEL_AVX2:
+            return "avx2";
+    }
+    return "scalar";
+}
+
+
+void Textile_MakePalette32(const tr2_palette_t *pal, uint32_t palette32[256])
+{
+    palette32[0] = 0x00000000;
+    for(int i = 1; i < 256; i++)
+    {
+        palette32[i] = ((uint32_t)pal->colour[i].r) | ((uint32_t)pal->colour[i].g << 8) | ((uint32_t)pal->colour[i].b << 16) | 0xff000000;
+    }
+}
+
+/*
+ * Palette lookup.
+ */
+#if TEXTILE_HAVE_AVX2
+TEXTILE_AVX2_TARGET
+static size_t Textile_Palette8To32_AVX2(const uint8_t *src, const uint32_t palette32[256], uint32_t *dst, size_t count)
+{
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_i32gather_epi32((const int*)palette32, idx, 4));
+    }
+    return i;
+}
+#endif
+
+void Textile_Palette8To32(const uint8_t *src, const uint32_t palette32[256], uint32_t *dst, size_t count)
+{
+    size_t i = 0;
+#if TEXTILE_HAVE_AVX2
+    if(Textile_GetKernel() == TEXTILE_KERNEL_AVX2)
+    {
+        i = Textile_Palette8To32_AVX2(src, palette32, dst, count);
+    }
+#endif
+    // SSE2 has no gather, table lookup is as fast as it gets there
+    for(; i + 4 <= count; i += 4)
+    {
+        dst[i + 0] = palette32[src[i + 0]];
+        dst[i + 1] = palette32[src[i + 1]];
+        dst[i + 2] = palette32[src[i + 2]];
+        dst[i + 3] = palette32[src[i + 3]];
+    }
+    for(; i < count; i++)
+    {
+        dst[i] = palette32[src[i]];
+    }
+}
+
+/*
+ * 1555 -> 8888: r = (c >> 7) & 0xf8, g = (c << 6) & 0xf800, b = (c << 19) & 0xf80000
+ */
+#if TEXTILE_HAVE_SSE2
+static inline __m128i Textile_1555To8888_Vec(__m128i c)
+{
+    __m128i alpha = _mm_srai_epi32(_mm_slli_epi32(c, 16), 31);
+    __m128i r = _mm_and_si128(_mm_srli_epi32(c, 7), _mm_set1_epi32(0x000000f8));
+    __m128i g = _mm_and_si128(_mm_slli_epi32(c, 6), _mm_set1_epi32(0x0000f800));
+    __m128i b = _mm_and_si128(_mm_slli_epi32(c, 19), _mm_set1_epi32(0x00f80000));
+    __m128i rgba = _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, _mm_set1_epi32(0xff000000)));
+    return _mm_and_si128(rgba, alpha);
+}
+
+static size_t Textile_1555To8888_SSE2(const uint16_t *src, uint32_t *dst, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), Textile_1555To8888_Vec(_mm_unpacklo_epi16(c, zero)));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), Textile_1555To8888_Vec(_mm_unpackhi_epi16(c, zero)));
+    }
+    return i;
+}
+#endif
+
+#if TEXTILE_HAVE_AVX2
+TEXTILE_AVX2_TARGET
+static size_t Textile_1555To8888_AVX2(const uint16_t *src, uint32_t *dst, size_t count)
+{
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i c = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        __m256i alpha = _mm256_srai_epi32(_mm256_slli_epi32(c, 16), 31);
+        __m256i r = _mm256_and_si256(_mm256_srli_epi32(c, 7), _mm256_set1_epi32(0x000000f8));
+        __m256i g = _mm256_and_si256(_mm256_slli_epi32(c, 6), _mm256_set1_epi32(0x0000f800));
+        __m256i b = _mm256_and_si256(_mm256_slli_epi32(c, 19), _mm256_set1_epi32(0x00f80000));
+        __m256i rgba = _mm256_or_si256(_mm256_or_si256(r, g), _mm256_or_si256(b, _mm256_set1_epi32(0xff000000)));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_and_si256(rgba, alpha));
+    }
+    return i;
+}
+#endif
+
+void Textile_1555To8888(const uint16_t *src, uint32_t *dst, size_t count)
+{
+    size_t i = 0;
+    switch(Textile_GetKernel())
+    {
+#if TEXTILE_HAVE_AVX2
+        case TEXTILE_KERNEL_AVX2:
+            i = Textile_1555To8888_AVX2(src, dst, count);
+            break;
+#endif
+#if TEXTILE_HAVE_SSE2
+        case TEXTILE_KERNEL_SSE2:
+            i = Textile_1555To8888_SSE2(src, dst, count);
+            break;
+#endif
+    }
+
+    for(; i < count; i++)
+    {
+        uint32_t col = src[i];
+        if(col & 0x8000)
+        {
+            dst[i] = ((col & 0x00007c00) >> 7) | (((col & 0x000003e0) >> 2) << 8) | (((col & 0x0000001f) << 3) << 16) | 0xff000000;
+        }
+        else
+        {
+            dst[i] = 0x00000000;
+        }
+    }
+}
+
+/*
+ * Red / blue swap; SIMD versions are x86 only, so no endian swap is needed there.
+ */
+#if TEXTILE_HAVE_SSE2
+static size_t Textile_SwapRB_SSE2(uint32_t *pixels, size_t count)
+{
+    const __m128i ga = _mm_set1_epi32(0xff00ff00);
+    const __m128i mask = _mm_set1_epi32(0x000000ff);
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i*)(pixels + i));
+        __m128i rb = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), mask), _mm_slli_epi32(_mm_and_si128(p, mask), 16));
+        _mm_storeu_si128((__m128i*)(pixels + i), _mm_or_si128(_mm_and_si128(p, ga), rb));
+    }
+    return i;
+}
+#endif
+
+#if TEXTILE_HAVE_AVX2
+TEXTILE_AVX2_TARGET
+static size_t Textile_SwapRB_AVX2(uint32_t *pixels, size_t count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                             2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i p = _mm256_loadu_si256((const __m256i*)(pixels + i));
+        _mm256_storeu_si256((__m256i*)(pixels + i), _mm256_shuffle_epi8(p, shuffle));
+    }
+    return i;
+}
+#endif
+
+void Textile_SwapRB(uint32_t *pixels, size_t count)
+{
+    size_t i = 0;
+    switch(Textile_GetKernel())
+    {
+#if TEXTILE_HAVE_AVX2
+        case TEXTILE_KERNEL_AVX2:
+            i = Textile_SwapRB_AVX2(pixels, count);
+            break;
+#endif
+#if TEXTILE_HAVE_SSE2
+        case TEXTILE_KERNEL_SSE2:
+            i = Textile_SwapRB_SSE2(pixels, count);
+            break;
+#endif
+    }
+
+    for(; i < count; i++)
+    {
+        uint32_t p = pixels[i];
+        pixels[i] = SDL_SwapLE32((p & 0xff00ff00) | ((p & 0x00ff0000) >> 16) | ((p & 0x000000ff) << 16));
+    }
+}
+
+/*
+ * Small fork-join helper: textiles are independent, so each thread takes the next free index.
+ */
+typedef struct textile_job_s
+{
+    uint32_t        count;
+    SDL_atomic_t    next;
+    void          (*func)(uint32_t i, void *data);
+    void           *data;
+} textile_job_t, *textile_job_p;
+
+
+static int Textile_JobThread(void *data)
+{
+    textile_job_p job = (textile_job_p)data;
+    int i;
+    while((i = SDL_AtomicAdd(&job->next, 1)) < (int)job->count)
+    {
+        job->func(i, job->data);
+    }
+    return 0;
+}
+
+
+void Textile_ParallelFor(uint32_t count, void (*func)(uint32_t i, void *data), void *data)
+{
+    SDL_Thread *threads[TEXTILE_MAX_THREADS];
+    int threads_count = SDL_GetCPUCount() - 1;
+    textile_job_t job;
+
+    job.count = count;
+    job.func = func;
+    job.data = data;
+    SDL_AtomicSet(&job.next, 0);
+
+    // the kernel is picked on the first use; do it here, not in the workers at once
+    Textile_GetKernel();
+
+    threads_count = (threads_count > (int)count - 1) ? ((int)count - 1) : (threads_count);
+    threads_count = (threads_count > TEXTILE_MAX_THREADS) ? (TEXTILE_MAX_THREADS) : (threads_count);
+    for(int i = 0; i < threads_count; i++)
+    {
+        threads[i] = SDL_CreateThread(Textile_JobThread, "textile", &job);
+    }
+    Textile_JobThread(&job);
+    for(int i = 0; i < threads_count; i++)
+    {
+        if(threads[i])
+        {
+            SDL_WaitThread(threads[i], NULL);
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef _TEXTILE_CONVERT_H_
+#define _TEXTILE_CONVERT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "tr_types.h"
+
+/*
+ * Pixel conversion kernels used while loading textiles. Every kernel has
+ * a scalar version and, on x86, SSE2 and AVX2 versions; the best one
+ * supported by the CPU is selected on the first call.
+ */
+
+#define TEXTILE_KERNEL_AUTO     (-1)
+#define TEXTILE_KERNEL_SCALAR   (0)
+#define TEXTILE_KERNEL_SSE2     (1)
+#define TEXTILE_KERNEL_AVX2     (2)
+
+int  Textile_SetKernel(int kernel);         // returns the kernel really used, for benchmarking
+int  Textile_GetKernel();
+const char *Textile_GetKernelName(int kernel);
+
+// index 0 is transparent, others are opaque RGBA
+void Textile_MakePalette32(const tr2_palette_t *pal, uint32_t palette32[256]);
+void Textile_Palette8To32(const uint8_t *src, const uint32_t palette32[256], uint32_t *dst, size_t count);
+// A1R5G5B5 -> RGBA8888, pixels without alpha bit become 0
+void Textile_1555To8888(const uint16_t *src, uint32_t *dst, size_t count);
+// BGRA <-> RGBA, in place
+void Textile_SwapRB(uint32_t *pixels, size_t count);
+
+// calls func(i, data) for every i in [0, count) from several threads; the kernel is selected before they start
+void Textile_ParallelFor(uint32_t count, void (*func)(uint32_t i, void *data), void *data);
+
+#endif // _TEXTILE_CONVERT_H_
@@ -2,6 +2,7 @@
 #include <SDL2/SDL_endian.h>
 #include <stdio.h>
 #include "tr_versions.h"
+#include "textile_convert.h"
 #include "vt_level.h"
 #include <ctype.h>
 
@@ -139,10 +140,30 @@ int VT_Level::get_PC_level_version(const char *name)
     return ret;
 }
 
+typedef struct textile_convert_job_s
+{
+    VT_Level       *level;
+    uint32_t        palette32[256];
+} textile_convert_job_t;
+
+void VT_Level::convert_textile16_job(uint32_t i, void *data)
+{
+    VT_Level *level = ((textile_convert_job_t*)data)->level;
+    Textile_1555To8888(&level->textile16[i].pixels[0][0], &level->textile32[i].pixels[0][0], 256 * 256);
+}
+
+void VT_Level::convert_textile8_job(uint32_t i, void *data)
+{
+    textile_convert_job_t *job = (textile_convert_job_t*)data;
+    Textile_Palette8To32(&job->level->textile8[i].pixels[0][0], job->palette32, &job->level->textile32[i].pixels[0][0], 256 * 256);
+}
+
 void VT_Level::prepare_level()
 {
-    uint32_t i;
+    textile_convert_job_t job;
+    job.level = this;
 
+    // textiles are independent, convert them on all cores
     if ((game_version >= TR_II) && (game_version <= TR_V))
     {
         if (!read_32bit_textiles)
@@ -152,16 +173,15 @@ void VT_Level::prepare_level()
                 this->textile32_count = this->num_textiles;
                 this->textile32 = (tr4_textile32_t*)malloc(this->textile32_count * sizeof(tr4_textile32_t));
             }
-            for (i = 0; i < (num_textiles - num_misc_textiles); i++)
-                convert_textile16_to_textile32(textile16[i], textile32[i]);
+            Textile_ParallelFor(num_textiles - num_misc_textiles, convert_textile16_job, &job);
         }
     }
     else
     {
         this->textile32_count = this->num_textiles;
             this->textile32 = (tr4_textile32_t*)malloc(this->textile32_count * sizeof(tr4_textile32_t));
-        for (i = 0; i < num_textiles; i++)
-            convert_textile8_to_textile32(textile8[i], palette, textile32[i]);
+        Textile_MakePalette32(&palette, job.palette32);
+        Textile_ParallelFor(num_textiles, convert_textile8_job, &job);
     }
 }
 
@@ -200,38 +220,15 @@ tr_moveable_t *VT_Level::find_moveable_id(uint32_t object_id)
 
 void VT_Level::convert_textile8_to_textile32(tr_textile8_t & tex, tr2_palette_t & pal, tr4_textile32_t & dst)
 {
-    int x, y;
-
-    for (y = 0; y < 256; y++)
-    {
-        for (x = 0; x < 256; x++)
-        {
-            int col = tex.pixels[y][x];
+    uint32_t palette32[256];
 
-            if (col > 0)
-                dst.pixels[y][x] = ((int)pal.colour[col].r) | ((int)pal.colour[col].g << 8) | ((int)pal.colour[col].b << 16) | (0xff << 24);
-            else
-                dst.pixels[y][x] = 0x00000000;
-        }
-    }
+    Textile_MakePalette32(&pal, palette32);
+    Textile_Palette8To32(&tex.pixels[0][0], palette32, &dst.pixels[0][0], 256 * 256);
 }
 
 void VT_Level::convert_textile16_to_textile32(tr2_textile16_t & tex, tr4_textile32_t & dst)
 {
-    int x, y;
-
-    for (y = 0; y < 256; y++)
-    {
-        for (x = 0; x < 256; x++)
-        {
-            int col = tex.pixels[y][x];
-
-            if (col & 0x8000)
-                dst.pixels[y][x] = ((col & 0x00007c00) >> 7) | (((col & 0x000003e0) >> 2) << 8) | (((col & 0x0000001f) << 3) << 16) | 0xff000000;
-            else
-                dst.pixels[y][x] = 0x00000000;
-        }
-    }
+    Textile_1555To8888(&tex.pixels[0][0], &dst.pixels[0][0], 256 * 256);
 }
 
 void WriteTGAfile(const char *filename, const uint8_t *data, const int width, const int height, char invY)
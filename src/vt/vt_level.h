@@ -25,6 +25,8 @@ class VT_Level : public TR_Level
     protected:
     void convert_textile8_to_textile32(tr_textile8_t & tex, tr2_palette_t & pal, tr4_textile32_t & dst);
     void convert_textile16_to_textile32(tr2_textile16_t & tex, tr4_textile32_t & dst);
+    static void convert_textile8_job(uint32_t i, void *data);
+    static void convert_textile16_job(uint32_t i, void *data);
 };
 
 #endif // _VT_LEVEL_H_
\ No newline at end of file
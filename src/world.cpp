@@ -11,6 +11,7 @@ extern "C" {
 }
 
 #include "core/avl.h"
+#include "core/handle_table.h"
 #include "core/gl_util.h"
 #include "core/console.h"
 #include "core/system.h"
@@ -79,7 +80,7 @@ extern "C" {
     struct entity_s                *player;                 // this is an unique Lara's pointer =)
     struct skeletal_model_s        *sky_box;                // global skybox
 
-    struct avl_header_s             entity_tree;
+    struct handle_table_s           entity_table;
     struct avl_header_s             items_tree;
 
     uint32_t                        type;
@@ -105,7 +106,7 @@ float World_GetAnimatedTexturesFrameRate(class VT_Level *tr);
 bool Res_CreateEntityFunc(lua_State *lua, const char* func_name, int entity_id);
 
 
-void World_GenTextures(class VT_Level *tr);
+void World_GenTextures(class VT_Level *tr, const char *level_path);
 void World_GenAnimTextures(class VT_Level *tr);
 void World_GenMeshes(class VT_Level *tr);
 void World_GenSprites(class VT_Level *tr);
@@ -126,7 +127,7 @@ void World_FixRooms();
 void World_BuildNearRoomsList(struct room_s *room);
 void World_BuildOverlappedRoomsList(struct room_s *room);
 
-extern "C" void AVL_DeleteEntity(void *p) { Entity_Delete((entity_p)p); }
+extern "C" void HandleTable_DeleteEntity(void *p) { Entity_Delete((entity_p)p); }
 extern "C" void AVL_DeleteItem(void *p) { BaseItem_Delete((base_item_p)p); }
 
 void World_Prepare()
@@ -168,8 +169,8 @@ void World_Prepare()
     global_world.skeletal_models = NULL;
     global_world.skeletal_models_count = 0;
     global_world.sky_box = NULL;
-    AVL_Init(&global_world.entity_tree);
-    global_world.entity_tree.free_data = AVL_DeleteEntity;
+    HandleTable_Init(&global_world.entity_table);
+    global_world.entity_table.free_data = HandleTable_DeleteEntity;
     AVL_Init(&global_world.items_tree);
     global_world.items_tree.free_data = AVL_DeleteItem;
 }
@@ -182,13 +183,15 @@ void World_Open(const char *path, int trv)
     tr->prepare_level();
     //tr_level->dump_textures();
     World_Clear();
+    Physics_BvhCacheOpen(path);         // Room and static mesh BVHs of the last load.
 
     global_world.version = tr->game_version;
     
     World_ScriptsOpen(path);            // Open configuration scripts.
+    Script_LoadStep(engine_lua);        // The collector waits for frame ends, none come while loading.
     Gui_DrawLoadScreen(200);
 
-    World_GenTextures(tr);              // Generate OGL textures
+    World_GenTextures(tr, path);        // Generate OGL textures
     Gui_DrawLoadScreen(300);
 
     World_GenAnimTextures(tr);          // Generate animated textures
@@ -243,10 +246,17 @@ void World_Open(const char *path, int trv)
     Gui_DrawLoadScreen(860);
 
     // Generate entity functions.
-    for(avl_node_p p = global_world.entity_tree.list; p; p = p->next)
+    HandleTable_BeginIteration(&global_world.entity_table);
+    for(uint32_t i = global_world.entity_table.count; i > 0; --i)
     {
-        World_SetEntityFunction((entity_p)p->data);
+        entity_p ent = (entity_p)global_world.entity_table.data[i - 1];
+        if(ent)
+        {
+            World_SetEntityFunction(ent);
+            Script_LoadStep(engine_lua);
+        }
     }
+    HandleTable_EndIteration(&global_world.entity_table);
     Gui_DrawLoadScreen(910);
 
     // Load entity collision flags and ID overrides from script.
@@ -256,11 +266,18 @@ void World_Open(const char *path, int trv)
     // Process level autoexec loading.
     Audio_Init();
     World_AutoexecOpen();
+    Script_LoadStep(engine_lua);
     Gui_DrawLoadScreen(960);
 
     // Fix initial room states
     World_FixRooms();
     World_UpdateFlipCollisions();
+    Physics_BvhCacheFlush();
+    {
+        physics_bvh_cache_stats_t stats;
+        Physics_GetBvhCacheStats(&stats);
+        Sys_Log(SYS_LOG_DEBUG, SYS_LOG_CAT_LEVEL, "collision BVH: %d built, %d from cache, %d shared, %.2f ms", stats.built, stats.attached, stats.shared, stats.time_ms);
+    }
     Gui_DrawLoadScreen(970);
 
     // Free atlas textures
@@ -290,14 +307,16 @@ void World_Clear()
     {
         main_inventory_manager->setInventory(NULL, ENTITY_ID_NONE);
     }
+    Gui_InvalidateItemImpostors();
 
     global_world.player = NULL;
 
     /* entity empty must be done before rooms destroy */
-    AVL_MakeEmpty(&global_world.entity_tree);
+    HandleTable_MakeEmpty(&global_world.entity_table);
 
     /* Now we can delete physics misc objects */
     Physics_CleanUpObjects();
+    Ragdoll_ClearPool();
 
     for(uint32_t i = 0; i < global_world.rooms_count; i++)
     {
@@ -473,12 +492,7 @@ uint32_t World_SpawnEntity(uint32_t model_id, uint32_t room_id, float pos[3], fl
         entity = Entity_Create();
         if(id < 0)
         {
-            avl_node_p max = global_world.entity_tree.root;
-            while(max)
-            {
-                entity->id = max->key + 1;
-                max = max->right;
-            }
+            entity->id = HandleTable_GetMaxKey(&global_world.entity_table) + 1;
         }
         else
         {
@@ -527,7 +541,11 @@ uint32_t World_SpawnEntity(uint32_t model_id, uint32_t room_id, float pos[3], fl
         {
             Room_AddObject(entity->self->room, entity->self);
         }
-        World_AddEntity(entity);
+        if(!World_AddEntity(entity))
+        {
+            Entity_Delete(entity);
+            return ENTITY_ID_NONE;
+        }
         return entity->id;
     }
 
@@ -537,8 +555,19 @@ uint32_t World_SpawnEntity(uint32_t model_id, uint32_t room_id, float pos[3], fl
 
 struct entity_s *World_GetEntityByID(uint32_t id)
 {
-    avl_node_p p = AVL_SearchNode(&global_world.entity_tree, id);
-    return (p) ? ((entity_p)p->data) : (NULL);
+    return (entity_p)HandleTable_Get(&global_world.entity_table, id);
+}
+
+
+uint64_t World_GetEntityHandle(uint32_t id)
+{
+    return HandleTable_GetHandle(&global_world.entity_table, id);
+}
+
+
+struct entity_s *World_GetEntityByHandle(uint64_t handle)
+{
+    return (entity_p)HandleTable_GetByHandle(&global_world.entity_table, handle);
 }
 
 
@@ -567,22 +596,28 @@ struct entity_s *World_GetPlayer()
 
 void World_IterateAllEntities(int (*iterator)(struct entity_s *ent, void *data), void *data)
 {
-    for(avl_node_p p = global_world.entity_tree.list; p; )
+    handle_table_p table = &global_world.entity_table;
+    // newest entities first, as the old entity tree list did; while the
+    // iteration is open removed entities leave holes and new ones go to the
+    // end, so whatever the iterator deletes or spawns no entity is visited twice
+    HandleTable_BeginIteration(table);
+    for(uint32_t i = table->count; i > 0; --i)
     {
-        entity_p ent = (entity_p)p->data;
-        if(ent->state_flags & ENTITY_STATE_DELETED)
+        entity_p ent = (entity_p)table->data[i - 1];
+        if(!ent)
         {
-            avl_node_p next = p->next;
-            AVL_DeleteNode(&global_world.entity_tree, p);
-            p = next;
             continue;
         }
-        if(iterator(ent, data))
+        if(ent->state_flags & ENTITY_STATE_DELETED)
+        {
+            HandleTable_RemoveAt(table, i - 1);
+        }
+        else if(iterator(ent, data))
         {
             break;
         }
-        p = p->next;
     }
+    HandleTable_EndIteration(table);
 }
 
 
@@ -694,19 +729,13 @@ int World_AddAnimSeq(struct anim_seq_s *seq)
 
 int World_AddEntity(struct entity_s *entity)
 {
-    return (AVL_InsertReplace(&global_world.entity_tree, entity->id, entity)) ? (0x01) : (0x00);
+    return HandleTable_InsertReplace(&global_world.entity_table, entity->id, entity);
 }
 
 
 int World_DeleteEntity(uint32_t id)
 {
-    avl_node_p p = AVL_SearchNode(&global_world.entity_tree, id);
-    if(p)
-    {
-        AVL_DeleteNode(&global_world.entity_tree, p);
-        return 1;
-    }
-    return 0;
+    return HandleTable_Remove(&global_world.entity_table, id);
 }
 
 
@@ -725,6 +754,7 @@ int World_CreateItem(uint32_t item_id, uint32_t model_id, uint32_t world_model_i
         {
             strncpy(item->name, name, sizeof(item->name));
         }
+        Gui_InvalidateItemImpostors();
 
         return (AVL_InsertReplace(&global_world.items_tree, item_id, item)) ? (0x01) : (0x00);
     }
@@ -738,6 +768,7 @@ int World_DeleteItem(uint32_t item_id)
     if(p)
     {
         AVL_DeleteNode(&global_world.items_tree, p);
+        Gui_InvalidateItemImpostors();
         return 1;
     }
     return 0;
@@ -1336,18 +1367,37 @@ void World_SetEntityFunction(struct entity_s *ent)
 }
 
 // Functions setting parameters from configuration scripts.
-void World_GenTextures(class VT_Level *tr)
+void World_GenTextures(class VT_Level *tr, const char *level_path)
 {
+    char cache_path[1024];
     int border_size = renderer.settings.texture_border;
     border_size = (border_size < 0) ? (0) : (border_size);
     border_size = (border_size > 128) ? (128) : (border_size);
+
+    // atlas layout and packed pages are cached in the user cache dir, the data dir may be read only
+    cache_path[0] = 0;
+    if(renderer.settings.texture_cache)
+    {
+        uint64_t hash = 0xCBF29CE484222325;
+        char *pref_path = SDL_GetPrefPath("OpenTomb", "cache");
+        for(const char *ch = level_path; *ch; ++ch)
+        {
+            hash = (hash ^ (uint8_t)*ch) * 0x100000001B3;
+        }
+        if(pref_path)
+        {
+            snprintf(cache_path, sizeof(cache_path), "%satlas_%016llx.bin", pref_path, (unsigned long long)hash);
+            SDL_free(pref_path);
+        }
+    }
     global_world.tex_atlas = new bordered_texture_atlas(border_size,
                                                   tr->textile32_count,
                                                   tr->textile32,
                                                   tr->object_textures_count,
                                                   tr->object_textures,
                                                   tr->sprite_textures_count,
-                                                  tr->sprite_textures);
+                                                  tr->sprite_textures,
+                                                  (cache_path[0]) ? (cache_path) : (NULL));
 
     global_world.tex_count = (uint32_t) global_world.tex_atlas->getNumAtlasPages();
     global_world.textures = (GLuint*)malloc(global_world.tex_count * sizeof(GLuint));
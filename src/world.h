@@ -17,6 +17,8 @@ int32_t World_GetVersion();
 
 uint32_t World_SpawnEntity(uint32_t model_id, uint32_t room_id, float pos[3], float ang[3], int32_t id);
 struct entity_s *World_GetEntityByID(uint32_t id);
+uint64_t World_GetEntityHandle(uint32_t id);
+struct entity_s *World_GetEntityByHandle(uint64_t handle);
 void World_SetPlayer(struct entity_s *entity);
 struct entity_s *World_GetPlayer();
 void World_IterateAllEntities(int (*iterator)(struct entity_s *ent, void *data), void *data);
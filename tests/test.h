@@ -0,0 +1,26 @@
+#ifndef TEST_H
+#define TEST_H
+
+/*
+ * Minimal checks for the headless tests: every failed check is printed
+ * and counted, main() returns the count so CTest sees the failure.
+ */
+
+#include <stdio.h>
+
+static int test_failures = 0;
+
+#define TEST_CHECK(cond) \
+    do \
+    { \
+        if(!(cond)) \
+        { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while(0)
+
+#define TEST_RESULT() \
+    ((test_failures) ? (printf("%d checks failed\n", test_failures), 1) : (printf("all checks passed\n"), 0))
+
+#endif  /* TEST_H */
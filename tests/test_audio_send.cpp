@@ -0,0 +1,487 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include <al.h>
+#include <alc.h>
+#include <alext.h>
+#include "test.h"
+#include "core/vmath.h"
+}
+
+#include "core/system.h"
+#include "core/console.h"
+#include "script/script.h"
+#include "render/camera.h"
+#include "vt/vt_level.h"
+#include "entity.h"
+#include "room.h"
+#include "world.h"
+#include "audio/audio.h"
+
+// the two steps of Audio_Update the test drives, without the camera and streams
+void Audio_UpdateSources();
+void Audio_UpdateVoices(float time);
+
+#define TEST_SOURCES        (16)
+#define TEST_SAMPLES        (6)
+#define TEST_SAMPLE_RATE    (11025)
+#define TEST_EFFECTS        (12)
+#define TEST_ENTITIES       (32)
+#define TEST_SENDS          (500)
+#define TEST_SENDS_PER_FRAME (5)
+#define TEST_MIX_RATE       (22050)
+#define TEST_FRAME_TIME     (1.0f / 30.0f)
+#define TEST_MARGIN         (1.25f)         // TR_AUDIO_VOICE_STEAL_MARGIN
+#define TEST_SKIPPED        (77)            // no OpenAL device to run on, see SKIP_RETURN_CODE
+
+/*
+ * Effects are sent through the real Audio_Send / Audio_UpdateVoices on a
+ * loopback device; the level has generated 16 bit samples instead of the
+ * sample block, emitters are plain entities around the listener.
+ */
+static entity_t                     entities[TEST_ENTITIES];
+static LPALCRENDERSAMPLESSOFT       render_samples = NULL;
+static ALCdevice                   *device = NULL;
+
+/*
+ * What audio.cpp takes from the rest of the engine.
+ */
+lua_State                  *engine_lua = NULL;
+camera_t                    engine_camera;
+
+void Con_AddLine(const char *text, uint16_t font_style)
+{
+}
+
+void Con_Warning(const char *fmt, ...)
+{
+}
+
+void Con_Notify(const char *fmt, ...)
+{
+}
+
+void Sys_DebugLog(const char *file, const char *fmt, ...)
+{
+}
+
+void Sys_Log(int level, int category, const char *fmt, ...)
+{
+}
+
+int Sys_FileFound(const char *name, int checkWrite)
+{
+    return 0;
+}
+
+int Sys_ReplaceFile(const char *tmp_name, const char *name)
+{
+    return rename(tmp_name, name) == 0;
+}
+
+void *Sys_GetTempMem(size_t size)
+{
+    return malloc(size);
+}
+
+void Sys_ReturnTempMem(size_t size)
+{
+}
+
+bool Script_GetOverridedSamplesInfo(lua_State *lua, int *num_samples, int *num_sounds, char *sample_name_mask)
+{
+    return false;
+}
+
+bool Script_GetOverridedSample(lua_State *lua, int sound_id, int *first_sample_number, int *samples_count)
+{
+    return false;
+}
+
+int Script_GetSecretTrackNumber(lua_State *lua)
+{
+    return 0;
+}
+
+int Script_GetNumTracks(lua_State *lua)
+{
+    return 0;
+}
+
+bool Script_GetSoundtrack(lua_State *lua, int track_index, char *track_path, int file_path_len, int *load_method, int *stream_type)
+{
+    return false;
+}
+
+struct entity_s *World_GetEntityByID(uint32_t id)
+{
+    return (id < TEST_ENTITIES) ? (entities + id) : (NULL);
+}
+
+void World_GetRoomInfo(struct room_s **rooms, uint32_t *rooms_count)
+{
+    *rooms = NULL;
+    *rooms_count = 0;
+}
+
+struct room_s *World_FindRoomByPos(float pos[3])
+{
+    return NULL;
+}
+
+
+static uint32_t MakeWav(uint8_t *dst, uint32_t frames)
+{
+    uint32_t data_size = frames * 2, riff_size = 36 + data_size, fmt_size = 16, rate = TEST_SAMPLE_RATE, byte_rate = TEST_SAMPLE_RATE * 2;
+    uint16_t format = 1, channels = 1, align = 2, bits = 16;
+    int16_t *pcm = (int16_t*)(dst + 44);
+
+    memcpy(dst, "RIFF", 4);
+    memcpy(dst + 4, &riff_size, 4);
+    memcpy(dst + 8, "WAVEfmt ", 8);
+    memcpy(dst + 16, &fmt_size, 4);
+    memcpy(dst + 20, &format, 2);
+    memcpy(dst + 22, &channels, 2);
+    memcpy(dst + 24, &rate, 4);
+    memcpy(dst + 28, &byte_rate, 4);
+    memcpy(dst + 32, &align, 2);
+    memcpy(dst + 34, &bits, 2);
+    memcpy(dst + 36, "data", 4);
+    memcpy(dst + 40, &data_size, 4);
+    for(uint32_t i = 0; i < frames; i++)
+    {
+        pcm[i] = (int16_t)(8000.0f * sinf(0.1f * i));
+    }
+    return 44 + data_size;
+}
+
+static float SampleLength(uint32_t sample)
+{
+    return 0.5f + 0.25f * sample;
+}
+
+static float EffectGain(uint32_t effect)
+{
+    return (float)(128 + 10 * effect) / 255.0f;
+}
+
+static float EffectRange(uint32_t effect)
+{
+    return (float)(6 + effect) * 1024.0f;
+}
+
+static uint32_t EffectLoop(uint32_t effect)
+{
+    return effect % 4;                      // none, wait, rewind, looped
+}
+
+// TR4 level: a chain of (uncomp_size, comp_size, wav) samples, the effect i plays sample i % TEST_SAMPLES
+static void LoadLevel()
+{
+    VT_Level *tr = new VT_Level();
+    uint32_t size = 0;
+
+    tr->game_version = TR_IV;
+    tr->samples_count = TEST_SAMPLES;
+    for(uint32_t i = 0; i < TEST_SAMPLES; i++)
+    {
+        size += 8 + 44 + 2 * (uint32_t)(SampleLength(i) * TEST_SAMPLE_RATE);
+    }
+    tr->samples_data_size = size;
+    tr->samples_data = (uint8_t*)malloc(size);
+    size = 0;
+    for(uint32_t i = 0; i < TEST_SAMPLES; i++)
+    {
+        uint32_t uncomp_size = 0, comp_size = MakeWav(tr->samples_data + size + 8, (uint32_t)(SampleLength(i) * TEST_SAMPLE_RATE));
+        memcpy(tr->samples_data + size, &uncomp_size, 4);
+        memcpy(tr->samples_data + size + 4, &comp_size, 4);
+        size += 8 + comp_size;
+    }
+
+    tr->sound_details_count = TEST_EFFECTS;
+    tr->sound_details = (tr_sound_details_t*)calloc(TEST_EFFECTS, sizeof(tr_sound_details_t));
+    for(uint32_t i = 0; i < TEST_EFFECTS; i++)
+    {
+        tr->sound_details[i].sample = i % TEST_SAMPLES;
+        tr->sound_details[i].volume = 128 + 10 * i;
+        tr->sound_details[i].sound_range = 6 + i;
+        tr->sound_details[i].num_samples_and_flags_1 = (1 << 2) | EffectLoop(i);
+    }
+
+    tr->soundmap = (int16_t*)malloc(TR_AUDIO_MAP_SIZE_TR4 * sizeof(int16_t));
+    for(uint32_t i = 0; i < TR_AUDIO_MAP_SIZE_TR4; i++)
+    {
+        tr->soundmap[i] = (i < TEST_EFFECTS) ? (i) : (-1);
+    }
+
+    Audio_GenSamples(tr);
+    delete tr;
+}
+
+static void SetEntity(uint32_t id, float x, float y)
+{
+    memset(entities + id, 0, sizeof(entity_t));
+    entities[id].id = id;
+    entities[id].transform.M4x4[0] = 1.0f;
+    entities[id].transform.M4x4[5] = 1.0f;
+    entities[id].transform.M4x4[10] = 1.0f;
+    entities[id].transform.M4x4[12] = x;
+    entities[id].transform.M4x4[13] = y;
+    entities[id].transform.M4x4[15] = 1.0f;
+}
+
+static void SetListener(float x, float y)
+{
+    alListener3f(AL_POSITION, x, y, 0.0f);
+    Audio_UpdateSources();                  // takes the listener position
+}
+
+// mixes the time on the loopback device, sources play it
+static void Mix(float time)
+{
+    static int16_t out[TEST_MIX_RATE];
+    uint32_t frames = (uint32_t)(time * TEST_MIX_RATE + 0.5f);
+    while(frames > 0)
+    {
+        uint32_t n = (frames < TEST_MIX_RATE) ? (frames) : (TEST_MIX_RATE);
+        render_samples(device, out, n);
+        frames -= n;
+    }
+}
+
+static void Step(float time)
+{
+    for(; time > 0.5f * TEST_FRAME_TIME; time -= TEST_FRAME_TIME)
+    {
+        Audio_UpdateSources();
+        Audio_UpdateVoices(TEST_FRAME_TIME);
+    }
+}
+
+static bool IsNear(float a, float b)
+{
+    return fabsf(a - b) <= 0.03f * fabsf(b) + 1.0e-4f;
+}
+
+static void KillAll()
+{
+    for(int e = 0; e < TEST_EFFECTS; e++)
+    {
+        for(int id = 0; id < TEST_ENTITIES; id++)
+        {
+            Audio_Kill(e, TR_AUDIO_EMITTER_ENTITY, id);
+            Audio_Kill(e, TR_AUDIO_EMITTER_GLOBAL, id);
+        }
+    }
+}
+
+
+/* Global voices score double gain, entity ones 1.5 gain attenuated linearly past 1/6 of range, one-shots lose weight as they play. */
+static void TestScores()
+{
+    audio_voice_stats_t stats;
+    float range = EffectRange(3);
+
+    SetListener(0.0f, 0.0f);
+    TEST_CHECK(Audio_Send(3, TR_AUDIO_EMITTER_GLOBAL, 0) == TR_AUDIO_SEND_PROCESSED);
+    Audio_GetVoiceStats(&stats);
+    TEST_CHECK((stats.real_voices == 1) && (stats.virtual_voices == 0) && IsNear(stats.min_real_score, 2.0f * EffectGain(3)));
+    Audio_Kill(3, TR_AUDIO_EMITTER_GLOBAL, 0);
+
+    SetEntity(0, 0.5f * range, 0.0f);
+    TEST_CHECK(Audio_Send(3, TR_AUDIO_EMITTER_ENTITY, 0) == TR_AUDIO_SEND_PROCESSED);
+    Audio_GetVoiceStats(&stats);
+    TEST_CHECK((stats.real_voices == 1) && IsNear(stats.min_real_score, 1.5f * EffectGain(3) * 0.6f));
+    Audio_Kill(3, TR_AUDIO_EMITTER_ENTITY, 0);
+
+    // half of the sample played on the source
+    TEST_CHECK(Audio_Send(0, TR_AUDIO_EMITTER_GLOBAL, 0) == TR_AUDIO_SEND_PROCESSED);
+    Mix(0.5f * SampleLength(0));
+    Audio_GetVoiceStats(&stats);
+    TEST_CHECK((stats.real_voices == 1) && IsNear(stats.min_real_score, 2.0f * EffectGain(0) * 0.75f));
+    KillAll();
+    Audio_GetVoiceStats(&stats);
+    TEST_CHECK((stats.real_voices == 0) && (stats.virtual_voices == 0) && (stats.free_sources == TEST_SOURCES));
+}
+
+
+/*
+ * With all sources taken by louder looped voices, a one-shot waits virtual:
+ * its offset runs on, it gets a source at that offset when one frees up,
+ * and it ends after its length if none does; a looped one keeps waiting.
+ */
+static void TestVirtualVoices()
+{
+    audio_voice_stats_t stats;
+    float one_shot_score = 1.5f * EffectGain(4) * 0.6f;
+
+    SetListener(0.0f, 0.0f);
+    SetEntity(0, 0.5f * EffectRange(4), 0.0f);
+    SetEntity(1, 0.9f * EffectRange(7), 0.0f);
+    SetEntity(2, 0.0f, 0.5f * EffectRange(4));
+    for(int i = 0; i < TEST_SOURCES; i++)
+    {
+        TEST_CHECK(Audio_Send(3, TR_AUDIO_EMITTER_GLOBAL, i) == TR_AUDIO_SEND_PROCESSED);
+    }
+    TEST_CHECK(Audio_Send(4, TR_AUDIO_EMITTER_ENTITY, 0) == TR_AUDIO_SEND_PROCESSED);
+    TEST_CHECK(Audio_Send(7, TR_AUDIO_EMITTER_ENTITY, 1) == TR_AUDIO_SEND_PROCESSED);
+    Audio_GetVoiceStats(&stats);
+    TEST_CHECK((stats.real_voices == TEST_SOURCES) && (stats.virtual_voices == 2) && (stats.free_sources == 0));
+    TEST_CHECK(IsNear(stats.max_virtual_score, one_shot_score));
+    TEST_CHECK((Audio_IsEffectPlaying(4, TR_AUDIO_EMITTER_ENTITY, 0) >= 0) && (Audio_IsEffectPlaying(7, TR_AUDIO_EMITTER_ENTITY, 1) >= 0));
+
+    // past the looped sample length, short of the one-shot one
+    Step(0.6f * SampleLength(4));
+    Audio_GetVoiceStats(&stats);
+    TEST_CHECK((stats.real_voices == TEST_SOURCES) && (stats.virtual_voices == 2));
+    TEST_CHECK(IsNear(stats.max_virtual_score, one_shot_score * 0.7f));
+
+    // a freed source takes the one-shot on from where it is
+    Audio_Kill(3, TR_AUDIO_EMITTER_GLOBAL, 0);
+    Audio_UpdateVoices(0.0f);
+    Audio_GetVoiceStats(&stats);
+    TEST_CHECK((stats.real_voices == TEST_SOURCES) && (stats.virtual_voices == 1));
+    TEST_CHECK(IsNear(stats.min_real_score, one_shot_score * 0.7f));
+
+    Audio_Kill(4, TR_AUDIO_EMITTER_ENTITY, 0);
+    TEST_CHECK(Audio_IsEffectPlaying(4, TR_AUDIO_EMITTER_ENTITY, 0) == -1);
+    TEST_CHECK(Audio_Send(3, TR_AUDIO_EMITTER_GLOBAL, 0) == TR_AUDIO_SEND_PROCESSED);
+    Audio_UpdateVoices(0.0f);
+    TEST_CHECK(Audio_Send(4, TR_AUDIO_EMITTER_ENTITY, 2) == TR_AUDIO_SEND_PROCESSED);
+    Step(0.9f * SampleLength(4));
+    TEST_CHECK(Audio_IsEffectPlaying(4, TR_AUDIO_EMITTER_ENTITY, 2) >= 0);
+    Step(0.2f * SampleLength(4));
+    TEST_CHECK(Audio_IsEffectPlaying(4, TR_AUDIO_EMITTER_ENTITY, 2) == -1);
+    TEST_CHECK(Audio_IsEffectPlaying(7, TR_AUDIO_EMITTER_ENTITY, 1) >= 0);
+    Audio_GetVoiceStats(&stats);
+    TEST_CHECK((stats.real_voices == TEST_SOURCES) && (stats.virtual_voices == 1));
+    KillAll();
+}
+
+
+/*
+ * Effects fired at random emitters while the listener moves: every voice is
+ * found by its key and no two keys share one, re-sends follow the loop flags,
+ * and no waiting voice beats a playing one by the margin.
+ */
+static void TestSends()
+{
+    audio_voice_stats_t stats;
+    uint32_t sent = 0, processed = 0, resent = 0, max_virtual = 0;
+    uint32_t voices_count = TEST_SOURCES + TR_AUDIO_MAX_VIRTUAL_VOICES;
+    uint8_t *used = (uint8_t*)malloc(voices_count);
+
+    for(int i = 0; i < TEST_ENTITIES; i++)
+    {
+        float ang = 2.4f * i, dist = 1024.0f * (1 + (i * 7) % 20);
+        SetEntity(i, dist * cosf(ang), dist * sinf(ang));
+    }
+
+    for(int frame = 0; sent < TEST_SENDS; frame++)
+    {
+        uint32_t found = 0;
+        bool unique = true;
+
+        for(int k = 0; (k < TEST_SENDS_PER_FRAME) && (sent < TEST_SENDS); k++, sent++)
+        {
+            int effect = rand() % TEST_EFFECTS;
+            int type = (rand() % 8) ? (TR_AUDIO_EMITTER_ENTITY) : (TR_AUDIO_EMITTER_GLOBAL);
+            int id = (type == TR_AUDIO_EMITTER_ENTITY) ? (rand() % TEST_ENTITIES) : (0);
+            int voice = Audio_IsEffectPlaying(effect, type, id);
+            int ret = Audio_Send(effect, type, id);
+
+            if(voice >= 0)
+            {
+                bool kept = (EffectLoop(effect) == TR_AUDIO_LOOP_WAIT) || (EffectLoop(effect) == TR_AUDIO_LOOP_LOOPED);
+                TEST_CHECK(ret == ((kept) ? (TR_AUDIO_SEND_IGNORED) : (TR_AUDIO_SEND_PROCESSED)));
+                TEST_CHECK(Audio_IsEffectPlaying(effect, type, id) == voice);
+                resent++;
+            }
+            else if(ret == TR_AUDIO_SEND_PROCESSED)
+            {
+                TEST_CHECK(Audio_IsEffectPlaying(effect, type, id) >= 0);
+                processed++;
+            }
+        }
+
+        Mix(TEST_FRAME_TIME);
+        SetListener(4096.0f * sinf(0.05f * frame), 2048.0f * cosf(0.03f * frame));
+        Audio_UpdateVoices(TEST_FRAME_TIME);
+
+        Audio_GetVoiceStats(&stats);
+        TEST_CHECK(stats.real_voices + stats.free_sources == TEST_SOURCES);
+        TEST_CHECK(stats.real_voices + stats.virtual_voices <= voices_count);
+        TEST_CHECK((stats.max_virtual_score <= 0.0f) || (stats.free_sources == 0));
+        TEST_CHECK(!stats.real_voices || (stats.max_virtual_score <= stats.min_real_score * TEST_MARGIN * 1.0001f));
+        max_virtual = (stats.virtual_voices > max_virtual) ? (stats.virtual_voices) : (max_virtual);
+
+        memset(used, 0, voices_count);
+        for(int effect = 0; effect < TEST_EFFECTS; effect++)
+        {
+            for(int id = 0; id <= TEST_ENTITIES; id++)
+            {
+                int voice = (id < TEST_ENTITIES) ? (Audio_IsEffectPlaying(effect, TR_AUDIO_EMITTER_ENTITY, id)) : (Audio_IsEffectPlaying(effect, TR_AUDIO_EMITTER_GLOBAL, 0));
+                if(voice >= 0)
+                {
+                    unique = unique && ((uint32_t)voice < voices_count) && !used[voice];
+                    used[voice % voices_count] = 1;
+                    found++;
+                }
+            }
+        }
+        TEST_CHECK(unique && (found == stats.real_voices + stats.virtual_voices));
+    }
+
+    printf("%d sends: %d new voices, %d re-sends, up to %d virtual\n", sent, processed, resent, max_virtual);
+    TEST_CHECK((processed > TEST_SOURCES) && (resent > 0) && (max_virtual > 0));
+    KillAll();
+    free(used);
+}
+
+
+int main()
+{
+    ALCcontext *context;
+    ALCint attrs[] = { ALC_FORMAT_CHANNELS_SOFT, ALC_MONO_SOFT, ALC_FORMAT_TYPE_SOFT, ALC_SHORT_SOFT, ALC_FREQUENCY, TEST_MIX_RATE, 0 };
+
+    if(alcIsExtensionPresent(NULL, "ALC_SOFT_loopback"))
+    {
+        LPALCLOOPBACKOPENDEVICESOFT open_device = (LPALCLOOPBACKOPENDEVICESOFT)alcGetProcAddress(NULL, "alcLoopbackOpenDeviceSOFT");
+        render_samples = (LPALCRENDERSAMPLESSOFT)alcGetProcAddress(NULL, "alcRenderSamplesSOFT");
+        device = (open_device && render_samples) ? (open_device(NULL)) : (NULL);
+    }
+    if(!device)
+    {
+        printf("no OpenAL loopback device, skipped\n");
+        return TEST_SKIPPED;
+    }
+    context = alcCreateContext(device, attrs);
+    TEST_CHECK(context && alcMakeContextCurrent(context));
+    if(!context)
+    {
+        alcCloseDevice(device);
+        return TEST_RESULT();
+    }
+
+    Audio_InitGlobals();
+    audio_settings.use_effects = false;
+    audio_settings.use_pcm_cache = false;
+    LoadLevel();
+    Audio_Init(TEST_SOURCES + TR_AUDIO_STREAM_NUMSOURCES);
+    TEST_CHECK(alGetError() == AL_NO_ERROR);
+
+    srand(0xA0D1);
+    TestScores();
+    TestVirtualVoices();
+    TestSends();
+    TEST_CHECK(alGetError() == AL_NO_ERROR);
+
+    Audio_DeInit();
+    alcMakeContextCurrent(NULL);
+    alcDestroyContext(context);
+    alcCloseDevice(device);
+    return TEST_RESULT();
+}
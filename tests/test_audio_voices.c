@@ -0,0 +1,277 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <al.h>
+#include <alc.h>
+#include <alext.h>
+#include "audio/audio_voice_rank.h"
+#include "test.h"
+
+#define TEST_SOURCES        (8)
+#define TEST_VOICES         (40)
+#define TEST_FRAMES         (200)
+#define TEST_MARGIN         (1.25f)
+#define TEST_SKIPPED        (77)            // no OpenAL device to run on, see SKIP_RETURN_CODE
+
+/*
+ * Voices scored by the test instead of the listener distance, on a
+ * loopback device: nothing is played out loud, but the sources are real
+ * OpenAL sources started and stopped the way Audio_UpdateVoices does it.
+ */
+typedef struct test_voice_s
+{
+    int         used;
+    int32_t     source;
+    float       score;
+} test_voice_t, *test_voice_p;
+
+static ALuint       sources[TEST_SOURCES];
+static int32_t      free_sources[TEST_SOURCES];
+static uint32_t     free_count;
+static uint32_t     al_play_stop_calls;
+
+
+static ALCdevice *OpenLoopbackDevice()
+{
+    LPALCLOOPBACKOPENDEVICESOFT open_device;
+    if(!alcIsExtensionPresent(NULL, "ALC_SOFT_loopback"))
+    {
+        return NULL;
+    }
+    open_device = (LPALCLOOPBACKOPENDEVICESOFT)alcGetProcAddress(NULL, "alcLoopbackOpenDeviceSOFT");
+    return (open_device) ? (open_device(NULL)) : (NULL);
+}
+
+
+static void StopVoice(test_voice_p v)
+{
+    alSourceStop(sources[v->source]);
+    al_play_stop_calls++;
+    free_sources[free_count++] = v->source;
+    v->source = -1;
+}
+
+
+static void PlayVoice(test_voice_p v, int32_t source)
+{
+    alSourcePlay(sources[source]);
+    al_play_stop_calls++;
+    v->source = source;
+}
+
+
+/* The pass by pass allocation the ranks replace: rescore everything for every move. */
+static void ReferenceUpdate(test_voice_p voices, uint32_t free_sources_count)
+{
+    for(;;)
+    {
+        int32_t best = -1, weakest = -1;
+        for(int32_t i = 0; i < TEST_VOICES; ++i)
+        {
+            if(voices[i].used && (voices[i].source < 0) && (voices[i].score > 0.0f) && ((best < 0) || (voices[i].score > voices[best].score)))
+            {
+                best = i;
+            }
+        }
+        if(best < 0)
+        {
+            return;
+        }
+        if(free_sources_count > 0)
+        {
+            voices[best].source = --free_sources_count;
+            continue;
+        }
+        for(int32_t i = 0; i < TEST_VOICES; ++i)
+        {
+            if(voices[i].used && (voices[i].source >= 0) && (voices[i].score < voices[best].score / TEST_MARGIN) &&
+               ((weakest < 0) || (voices[i].score < voices[weakest].score)))
+            {
+                weakest = i;
+            }
+        }
+        if(weakest < 0)
+        {
+            return;
+        }
+        voices[best].source = voices[weakest].source;
+        voices[weakest].source = -1;
+    }
+}
+
+
+static uint32_t UpdateVoices(test_voice_p voices, audio_voice_rank_p ranks)
+{
+    audio_voice_move_t moves[TEST_VOICES];
+    uint32_t ranks_count = 0, moves_count;
+
+    for(uint32_t i = 0; i < TEST_VOICES; ++i)
+    {
+        if(voices[i].used)
+        {
+            ranks[ranks_count].voice = i;
+            ranks[ranks_count].source = voices[i].source;
+            ranks[ranks_count].score = voices[i].score;
+            ranks_count++;
+        }
+    }
+    Audio_SortVoiceRanks(ranks, ranks_count);
+    for(uint32_t i = 1; i < ranks_count; ++i)
+    {
+        TEST_CHECK(ranks[i - 1].score >= ranks[i].score);
+    }
+
+    moves_count = Audio_PlanVoiceMoves(ranks, ranks_count, free_count, TEST_MARGIN, moves);
+    for(uint32_t i = 0; i < moves_count; ++i)
+    {
+        test_voice_p v = voices + ranks[moves[i].rank].voice;
+        TEST_CHECK(v->source < 0);
+        if(moves[i].victim >= 0)
+        {
+            TEST_CHECK((uint32_t)moves[i].victim > moves[i].rank);
+            TEST_CHECK(voices[ranks[moves[i].victim].voice].source >= 0);
+            StopVoice(voices + ranks[moves[i].victim].voice);
+            ranks[moves[i].victim].source = -1;
+        }
+        TEST_CHECK(free_count > 0);
+        PlayVoice(v, free_sources[--free_count]);
+        ranks[moves[i].rank].source = v->source;
+    }
+    return ranks_count;
+}
+
+
+/* Every source plays exactly when a voice holds it. */
+static void CheckSources(test_voice_p voices)
+{
+    int held[TEST_SOURCES];
+    memset(held, 0, sizeof(held));
+    for(uint32_t i = 0; i < TEST_VOICES; ++i)
+    {
+        if(voices[i].used && (voices[i].source >= 0))
+        {
+            held[voices[i].source]++;
+        }
+    }
+    for(uint32_t i = 0; i < TEST_SOURCES; ++i)
+    {
+        ALint state = AL_STOPPED;
+        alGetSourcei(sources[i], AL_SOURCE_STATE, &state);
+        TEST_CHECK(held[i] <= 1);
+        TEST_CHECK((state == AL_PLAYING) == (held[i] == 1));
+    }
+}
+
+
+static void TestFrames()
+{
+    test_voice_t voices[TEST_VOICES], reference[TEST_VOICES];
+    audio_voice_rank_t ranks[TEST_VOICES];
+
+    memset(voices, 0, sizeof(voices));
+    for(uint32_t frame = 0; frame < TEST_FRAMES; ++frame)
+    {
+        uint32_t ranks_count, cursor;
+        double held = 0.0, held_reference = 0.0;
+        int32_t r;
+
+        // Voices come and go, their scores change; the low bits keep scores distinct.
+        for(uint32_t i = 0; i < TEST_VOICES; ++i)
+        {
+            test_voice_p v = voices + i;
+            int roll = rand() % 16;
+            if(v->used && (roll == 0))
+            {
+                if(v->source >= 0)
+                {
+                    StopVoice(v);
+                }
+                v->used = 0;
+            }
+            else if(!v->used && (roll < 4))
+            {
+                v->used = 1;
+                v->source = -1;
+            }
+            if(v->used && (roll < 8))
+            {
+                v->score = (float)((rand() % 1024) * 64 + i) * ((rand() % 8) ? (1.0f) : (0.0f));
+            }
+        }
+
+        memcpy(reference, voices, sizeof(voices));
+        ReferenceUpdate(reference, free_count);
+        ranks_count = UpdateVoices(voices, ranks);
+        // Silent voices tie, which of them loses its source does not matter.
+        for(uint32_t i = 0; i < TEST_VOICES; ++i)
+        {
+            TEST_CHECK(!voices[i].used || (voices[i].score == 0.0f) || ((voices[i].source >= 0) == (reference[i].source >= 0)));
+            held += (voices[i].used && (voices[i].source >= 0)) ? (1000000.0 + voices[i].score) : (0.0);
+            held_reference += (reference[i].used && (reference[i].source >= 0)) ? (1000000.0 + reference[i].score) : (0.0);
+        }
+        TEST_CHECK(held == held_reference);
+        CheckSources(voices);
+
+        // A steal between updates takes the weakest real voice first, without rescoring.
+        cursor = ranks_count;
+        r = Audio_FindWeakestRank(ranks, &cursor, 1.0e9f);
+        for(uint32_t i = 0; i < ranks_count; ++i)
+        {
+            TEST_CHECK((ranks[i].source < 0) || ((r >= 0) && (ranks[i].score >= ranks[r].score)));
+        }
+        if(r >= 0)
+        {
+            TEST_CHECK(cursor == (uint32_t)r);
+            cursor = ranks_count;
+            TEST_CHECK(Audio_FindWeakestRank(ranks, &cursor, ranks[r].score) == -1);
+            TEST_CHECK(cursor == (uint32_t)r + 1);      // Left for the next, stronger score.
+        }
+    }
+}
+
+
+int main()
+{
+    ALCdevice *device = OpenLoopbackDevice();
+    ALCcontext *context;
+    ALCint attrs[] = { ALC_FORMAT_CHANNELS_SOFT, ALC_MONO_SOFT, ALC_FORMAT_TYPE_SOFT, ALC_SHORT_SOFT, ALC_FREQUENCY, 22050, 0 };
+    int16_t silence[22050];
+    ALuint buffer;
+
+    if(!device)
+    {
+        printf("no OpenAL loopback device, skipped\n");
+        return TEST_SKIPPED;
+    }
+    context = alcCreateContext(device, attrs);
+    TEST_CHECK(context && alcMakeContextCurrent(context));
+    if(!context)
+    {
+        alcCloseDevice(device);
+        return TEST_RESULT();
+    }
+
+    memset(silence, 0, sizeof(silence));
+    alGenBuffers(1, &buffer);
+    alBufferData(buffer, AL_FORMAT_MONO16, silence, sizeof(silence), 22050);
+    alGenSources(TEST_SOURCES, sources);
+    for(uint32_t i = 0; i < TEST_SOURCES; ++i)
+    {
+        alSourcei(sources[i], AL_BUFFER, buffer);
+        alSourcei(sources[i], AL_LOOPING, AL_TRUE);
+        free_sources[free_count++] = TEST_SOURCES - 1 - i;
+    }
+    TEST_CHECK(alGetError() == AL_NO_ERROR);
+
+    srand(0x5EED);
+    TestFrames();
+    TEST_CHECK(alGetError() == AL_NO_ERROR);
+    printf("%d frames, %d source starts and stops\n", TEST_FRAMES, al_play_stop_calls);
+
+    alDeleteSources(TEST_SOURCES, sources);
+    alDeleteBuffers(1, &buffer);
+    alcMakeContextCurrent(NULL);
+    alcDestroyContext(context);
+    alcCloseDevice(device);
+    return TEST_RESULT();
+}
@@ -0,0 +1,117 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fmv/codecs/color_convert.h"
+#include "test.h"
+
+#define TEST_PIXELS     (1024)
+
+static const uint8_t chroma_vals[32] = {
+     20,  28,  36,  44,  52,  60,  68,  76,  84,  92, 100, 106, 112, 116, 120, 124,
+    128, 132, 136, 140, 144, 150, 156, 164, 172, 180, 188, 196, 204, 212, 220, 228
+};
+
+
+static void TestRGB555()
+{
+    static const uint16_t known[4] = { 0x0000, 0x7FFF, 0x8000 | 0x7C00, 0x03E0 | 0x001F };
+    static const uint8_t known_rgba[16] = { 0, 0, 0, 0xFF,  248, 248, 248, 0xFF,  248, 0, 0, 0xFF,  0, 248, 248, 0xFF };
+    uint16_t src[TEST_PIXELS + 1];
+    uint8_t reference[4 * (TEST_PIXELS + 1)];
+    uint8_t out[4 * (TEST_PIXELS + 1)];
+
+    color_convert_set_kernel(COLOR_KERNEL_SCALAR);
+    color_convert_rgb555_to_rgba(known, out, 4);
+    TEST_CHECK(0 == memcmp(out, known_rgba, sizeof(known_rgba)));
+
+    for(int i = 0; i <= TEST_PIXELS; ++i)
+    {
+        src[i] = rand() & 0xFFFF;
+    }
+
+    // every length checks the tail after the vector part, odd offsets check unaligned rows
+    for(size_t count = 0; count <= 40; ++count)
+    {
+        for(size_t offset = 0; offset < 2; ++offset)
+        {
+            memset(reference, 0xAA, sizeof(reference));
+            memset(out, 0xAA, sizeof(out));
+            color_convert_set_kernel(COLOR_KERNEL_SCALAR);
+            color_convert_rgb555_to_rgba(src + offset, reference, count);
+            color_convert_set_kernel(COLOR_KERNEL_SIMD);
+            color_convert_rgb555_to_rgba(src + offset, out, count);
+            TEST_CHECK(0 == memcmp(out, reference, sizeof(out)));
+        }
+    }
+
+    color_convert_set_kernel(COLOR_KERNEL_SCALAR);
+    color_convert_rgb555_to_rgba(src, reference, TEST_PIXELS);
+    color_convert_set_kernel(COLOR_KERNEL_SIMD);
+    color_convert_rgb555_to_rgba(src, out, TEST_PIXELS);
+    TEST_CHECK(0 == memcmp(out, reference, 4 * TEST_PIXELS));
+}
+
+
+static void TestYUV()
+{
+    uint8_t y[TEST_PIXELS + 1];
+    uint8_t cb[TEST_PIXELS / 2 + 1];
+    uint8_t cr[TEST_PIXELS / 2 + 1];
+    uint8_t reference[4 * (TEST_PIXELS + 1)];
+    uint8_t out[4 * (TEST_PIXELS + 1)];
+    color_yuv_table_t yuv;
+
+    for(int i = 0; i <= TEST_PIXELS; ++i)
+    {
+        y[i] = rand() & 0xFF;
+    }
+    for(int i = 0; i <= TEST_PIXELS / 2; ++i)
+    {
+        cb[i] = rand() & 0xFF;                          // high bits must be ignored
+        cr[i] = rand() & 0xFF;
+    }
+
+    for(int y_shift = 0; y_shift <= 2; ++y_shift)
+    {
+        color_convert_yuv_table_init(&yuv, chroma_vals, y_shift);
+        for(size_t count = 0; count <= 40; count += 2)
+        {
+            memset(reference, 0xAA, sizeof(reference));
+            memset(out, 0xAA, sizeof(out));
+            color_convert_set_kernel(COLOR_KERNEL_SCALAR);
+            color_convert_yuv_to_rgba(&yuv, y + 1, cb, cr, reference, count);
+            color_convert_set_kernel(COLOR_KERNEL_SIMD);
+            color_convert_yuv_to_rgba(&yuv, y + 1, cb, cr, out, count);
+            TEST_CHECK(0 == memcmp(out, reference, sizeof(out)));
+        }
+
+        color_convert_set_kernel(COLOR_KERNEL_SCALAR);
+        color_convert_yuv_to_rgba(&yuv, y, cb, cr, reference, TEST_PIXELS);
+        color_convert_set_kernel(COLOR_KERNEL_SIMD);
+        color_convert_yuv_to_rgba(&yuv, y, cb, cr, out, TEST_PIXELS);
+        TEST_CHECK(0 == memcmp(out, reference, 4 * TEST_PIXELS));
+    }
+
+    // grey chroma leaves the luma as it is
+    memset(cb, 16, sizeof(cb));
+    memset(cr, 16, sizeof(cr));
+    color_convert_yuv_table_init(&yuv, chroma_vals, 0);
+    color_convert_set_kernel(COLOR_KERNEL_SIMD);
+    color_convert_yuv_to_rgba(&yuv, y, cb, cr, out, TEST_PIXELS);
+    for(int i = 0; i < TEST_PIXELS; ++i)
+    {
+        TEST_CHECK(out[4 * i] == y[i] && out[4 * i + 1] == y[i] && out[4 * i + 2] == y[i] && out[4 * i + 3] == 0xFF);
+    }
+}
+
+
+int main()
+{
+    int best_kernel = color_convert_set_kernel(COLOR_KERNEL_AUTO);
+    printf("best kernel: %s\n", color_convert_kernel_name(best_kernel));
+
+    srand(0x1234);
+    TestRGB555();
+    TestYUV();
+    return TEST_RESULT();
+}
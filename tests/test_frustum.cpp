@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "test.h"
+#include "core/vmath.h"
+#include "core/polygon.h"
+#include "core/obb.h"
+}
+
+#include "core/system.h"
+#include "render/frustum.h"
+#include "render/camera.h"
+
+#define TEST_BOXES          (20000)
+#define TEST_BATCH          (256)
+
+/*
+ * What frustum.cpp takes from the rest of the engine.
+ */
+void *Sys_GetTempMem(size_t size)
+{
+    return malloc(size);
+}
+
+void Sys_ReturnTempMem(size_t size)
+{
+}
+
+
+static float Rand(float min, float max)
+{
+    return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+/* The box faces clipped by the frustum planes: something is left when the box is in. */
+static bool IsOBBInFrustum(obb_p obb, frustum_p f)
+{
+    float buf[2][3 * 64];
+
+    if(f->vertex_count > 60)
+    {
+        return true;                // each plane adds one vertex at most
+    }
+    for(int i = 0; i < 6; ++i)
+    {
+        int n = obb->polygons[i].vertex_count, src = 0;
+        for(int j = 0; j < n; ++j)
+        {
+            vec3_copy(buf[0] + 3 * j, obb->polygons[i].vertices[j].position);
+        }
+        for(uint16_t k = 0; (k < f->vertex_count) && (n > 0); ++k)
+        {
+            float *plane = f->planes + 4 * k, *in = buf[src], *out = buf[src ^ 1];
+            int m = 0;
+            for(int j = 0; j < n; ++j)
+            {
+                float *v0 = in + 3 * j, *v1 = in + 3 * ((j + 1) % n);
+                float d0 = vec3_plane_dist(plane, v0) + SPLIT_EPSILON;
+                float d1 = vec3_plane_dist(plane, v1) + SPLIT_EPSILON;
+                if(d0 >= 0.0f)
+                {
+                    vec3_copy(out + 3 * m, v0);
+                    m++;
+                }
+                if((d0 >= 0.0f) != (d1 >= 0.0f))
+                {
+                    float t = d0 / (d0 - d1);
+                    out[3 * m + 0] = v0[0] + (v1[0] - v0[0]) * t;
+                    out[3 * m + 1] = v0[1] + (v1[1] - v0[1]) * t;
+                    out[3 * m + 2] = v0[2] + (v1[2] - v0[2]) * t;
+                    m++;
+                }
+            }
+            n = m;
+            src ^= 1;
+        }
+        if(n > 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static void SetCamera(camera_p cam, float x, float y, float z, float ang[3])
+{
+    cam->transform.M4x4[12] = x;
+    cam->transform.M4x4[13] = y;
+    cam->transform.M4x4[14] = z;
+    Cam_SetRotation(cam, ang);
+    Cam_RecalcClipPlanes(cam);
+}
+
+
+static void SetBox(obb_p obb, float *tr, float bb_min[3], float bb_max[3], float ang[3], float pos[3])
+{
+    OBB_Rebuild(obb, bb_min, bb_max);
+    Mat4_E(tr);
+    Mat4_SetAnglesZXY(tr, ang);
+    vec3_copy(tr + 12, pos);
+    obb->transform = tr;
+    OBB_Transform(obb);
+}
+
+
+/* Boxes straight ahead, behind and around the camera. */
+static void TestKnownBoxes(camera_p cam)
+{
+    obb_p obb = OBB_Create();
+    float tr[16], ang[3] = {0.0f, 0.0f, 0.0f}, pos[3];
+    float bb_min[3] = {-64.0f, -64.0f, -64.0f}, bb_max[3] = {64.0f, 64.0f, 64.0f};
+
+    SetCamera(cam, 0.0f, 0.0f, 0.0f, ang);
+    vec3_mul_scalar(pos, cam->transform.M4x4 + 8, 1024.0f);
+    SetBox(obb, tr, bb_min, bb_max, ang, pos);
+    TEST_CHECK(Frustum_IsOBBVisible(obb, cam->frustum));
+
+    vec3_mul_scalar(pos, cam->transform.M4x4 + 8, -1024.0f);
+    SetBox(obb, tr, bb_min, bb_max, ang, pos);
+    TEST_CHECK(!Frustum_IsOBBVisible(obb, cam->frustum));
+
+    vec3_mul_scalar(pos, cam->transform.M4x4 + 0, 4096.0f);
+    vec3_add_mul(pos, pos, cam->transform.M4x4 + 8, 256.0f);
+    SetBox(obb, tr, bb_min, bb_max, ang, pos);
+    TEST_CHECK(!Frustum_IsOBBVisible(obb, cam->frustum));
+
+    // the camera is in the box
+    vec3_mul_scalar(pos, cam->transform.M4x4 + 8, -16.0f);
+    SetBox(obb, tr, bb_min, bb_max, ang, pos);
+    TEST_CHECK(Frustum_IsOBBVisible(obb, cam->frustum));
+
+    obb->transform = NULL;
+    OBB_Delete(obb);
+}
+
+
+/*
+ * Random boxes around random cameras, some of them across the camera: the
+ * box test may keep a box that is out (it is conservative at the frustum
+ * edges), but must never drop one that is in and that the clip test keeps.
+ */
+static void TestRandomBoxes(camera_p cam)
+{
+    obb_p obb = OBB_Create();
+    float tr[16];
+    int lost = 0, extra = 0, differ = 0;
+
+    for(int i = 0; i < TEST_BOXES; i += TEST_BATCH)
+    {
+        float cam_ang[3] = {Rand(0.0f, 360.0f), Rand(0.0f, 360.0f), Rand(0.0f, 360.0f)};
+        SetCamera(cam, Rand(-256.0f, 256.0f), Rand(-256.0f, 256.0f), Rand(-256.0f, 256.0f), cam_ang);
+        for(int j = 0; j < TEST_BATCH; ++j)
+        {
+            float ang[3], pos[3], bb_min[3], bb_max[3];
+            float range = (j % 8) ? (8192.0f) : (512.0f);
+            bool box, clip, exact;
+
+            bb_max[0] = Rand(8.0f, 1024.0f);
+            bb_max[1] = Rand(8.0f, 1024.0f);
+            bb_max[2] = Rand(8.0f, 1024.0f);
+            vec3_mul_scalar(bb_min, bb_max, -Rand(0.0f, 1.0f));
+            ang[0] = Rand(0.0f, 360.0f);
+            ang[1] = Rand(0.0f, 360.0f);
+            ang[2] = Rand(0.0f, 360.0f);
+            pos[0] = Rand(-range, range);
+            pos[1] = Rand(-range, range);
+            pos[2] = Rand(-range, range);
+            SetBox(obb, tr, bb_min, bb_max, ang, pos);
+
+            box = Frustum_IsOBBVisible(obb, cam->frustum);
+            clip = Frustum_IsOBBVisibleClip(obb, cam->frustum);
+            exact = IsOBBInFrustum(obb, cam->frustum);
+            TEST_CHECK(box == Frustum_IsOBBVisibleInFrustumList(obb, cam->frustum));
+            lost += (exact && clip && !box) ? (1) : (0);
+            extra += (!exact && box) ? (1) : (0);
+            differ += (clip != box) ? (1) : (0);
+        }
+    }
+    printf("%d boxes: %d differ from the clip test, %d kept out of the frustum, %d lost\n", TEST_BOXES, differ, extra, lost);
+    TEST_CHECK(lost == 0);
+
+    obb->transform = NULL;
+    OBB_Delete(obb);
+}
+
+
+/* A list goes through the frustums in turn, padding planes never cull. */
+static void TestFrustumList(camera_p cam)
+{
+    obb_p obb = OBB_Create();
+    frustum_t narrow;
+    float planes[4 * 5], packed[16 * 2];
+    float tr[16], ang[3] = {0.0f, 0.0f, 0.0f}, pos[3];
+    float bb_min[3] = {-32.0f, -32.0f, -32.0f}, bb_max[3] = {32.0f, 32.0f, 32.0f};
+
+    SetCamera(cam, 0.0f, 0.0f, 0.0f, ang);
+    // the camera frustum and a fifth plane that keeps only the right half of it
+    narrow = *cam->frustum;
+    memcpy(planes, cam->frustum->planes, 4 * 4 * sizeof(float));
+    vec3_copy(planes + 16, cam->transform.M4x4 + 0);
+    planes[19] = 0.0f;
+    narrow.planes = planes;
+    narrow.vertex_count = 5;
+    narrow.next = NULL;
+    Frustum_PackPlanes(&narrow, packed);
+    TEST_CHECK(packed[16 + 12 + 1] == 1.0f);
+
+    vec3_mul_scalar(pos, cam->transform.M4x4 + 0, -256.0f);
+    vec3_add_mul(pos, pos, cam->transform.M4x4 + 8, 1024.0f);
+    SetBox(obb, tr, bb_min, bb_max, ang, pos);
+    TEST_CHECK(!Frustum_IsOBBVisible(obb, &narrow));
+    TEST_CHECK(!Frustum_IsOBBVisibleInFrustumList(obb, &narrow));
+    narrow.next = cam->frustum;
+    TEST_CHECK(Frustum_IsOBBVisibleInFrustumList(obb, &narrow));
+    cam->frustum->next = NULL;
+
+    vec3_mul_scalar(pos, cam->transform.M4x4 + 0, 256.0f);
+    vec3_add_mul(pos, pos, cam->transform.M4x4 + 8, 1024.0f);
+    SetBox(obb, tr, bb_min, bb_max, ang, pos);
+    TEST_CHECK(Frustum_IsOBBVisible(obb, &narrow));
+
+    obb->transform = NULL;
+    OBB_Delete(obb);
+}
+
+
+int main()
+{
+    camera_t cam;
+
+    srand(0xF00D);
+    memset(&cam, 0, sizeof(cam));
+    Cam_Init(&cam);
+
+    TestKnownBoxes(&cam);
+    TestRandomBoxes(&cam);
+    TestFrustumList(&cam);
+
+    free(cam.frustum->vertex);
+    free(cam.frustum);
+    return TEST_RESULT();
+}
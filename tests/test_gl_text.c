@@ -0,0 +1,248 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "core/gl_util.h"
+#include "core/gl_font.h"
+#include "core/gl_text.h"
+#include "test.h"
+
+#define TEST_CHAR_WIDTH     (8 * 64)            // every glyph is 8 px wide
+
+/*
+ * What gl_text.c takes from the font code and from GL: every glyph is one
+ * quad on the first atlas texture of its font, draws are only recorded.
+ */
+static uint32_t shape_calls = 0;
+static char     shaped_text[64];
+static GLuint   bound_textures[32];
+static GLsizei  drawn_counts[32];
+static uint32_t draws_count = 0;
+
+gl_tex_font_p glf_create_font(const char *file_name, uint16_t font_size)
+{
+    gl_tex_font_p glf = (gl_tex_font_p)calloc(1, sizeof(gl_tex_font_t));
+    glf->font_size = font_size;
+    glf->generation = 1;
+    glf->gl_tex_indexes_count = 1;
+    glf->gl_tex_indexes = (GLuint*)malloc(sizeof(GLuint));
+    glf->gl_tex_indexes[0] = 10 * font_size;
+    return glf;
+}
+
+void glf_free_font(gl_tex_font_p glf)
+{
+    if(glf)
+    {
+        free(glf->gl_tex_indexes);
+        free(glf);
+    }
+}
+
+void glf_resize(gl_tex_font_p glf, uint16_t font_size)
+{
+    glf->font_size = font_size;
+    glf->generation++;
+}
+
+char *glf_get_string_for_width(gl_tex_font_p glf, char *text, int32_t w_pt, int *n_sym)
+{
+    int n = w_pt / TEST_CHAR_WIDTH, len = strlen(text);
+    n = (n > 0) ? (n) : (1);
+    *n_sym = (n < len) ? (n) : (len);
+    return text + *n_sym;
+}
+
+int32_t glf_get_ascender(gl_tex_font_p glf)
+{
+    return 12 * 64;
+}
+
+int32_t glf_get_descender(gl_tex_font_p glf)
+{
+    return -4 * 64;
+}
+
+uint32_t glf_shape_str(gl_tex_font_p glf, const char *text, int n, gl_glyph_quad_p quads, int32_t *x0, int32_t *x1)
+{
+    uint32_t count = (n < 0) ? (strlen(text)) : (n);
+    shape_calls++;
+    memset(shaped_text, 0, sizeof(shaped_text));
+    strncpy(shaped_text, text, (count < sizeof(shaped_text) - 1) ? (count) : (sizeof(shaped_text) - 1));
+    for(uint32_t i = 0; i < count; i++)
+    {
+        memset(quads + i, 0, sizeof(gl_glyph_quad_t));
+        quads[i].x0 = 8.0f * i;
+        quads[i].x1 = 8.0f * (i + 1);
+        quads[i].y1 = 12.0f;
+        quads[i].tex_index = glf->gl_tex_indexes[0];
+    }
+    *x0 = 0;
+    *x1 = count * TEST_CHAR_WIDTH;
+    return count;
+}
+
+static void APIENTRY StubBindTexture(GLenum target, GLuint texture)
+{
+    if(draws_count < 32)
+    {
+        bound_textures[draws_count] = texture;
+    }
+}
+
+static void APIENTRY StubDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    if(draws_count < 32)
+    {
+        drawn_counts[draws_count] = count;
+    }
+    draws_count++;
+}
+
+static void APIENTRY StubGenBuffers(GLsizei n, GLuint *buffers)
+{
+    buffers[0] = 1;
+}
+
+static void APIENTRY StubBindBuffer(GLenum target, GLuint buffer) {}
+static void APIENTRY StubDeleteBuffers(GLsizei n, const GLuint *buffers) {}
+static void APIENTRY StubBufferData(GLenum target, GLsizeiptrARB size, const void *data, GLenum usage) {}
+static void APIENTRY StubBufferSubData(GLenum target, GLintptrARB offset, GLsizeiptrARB size, const void *data) {}
+static void APIENTRY StubPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer) {}
+static void APIENTRY StubBlendFunc(GLenum sfactor, GLenum dfactor) {}
+
+PFNGLBINDTEXTUREPROC qglBindTexture = StubBindTexture;
+PFNGLDRAWARRAYSPROC qglDrawArrays = StubDrawArrays;
+PFNGLGENBUFFERSARBPROC qglGenBuffersARB = StubGenBuffers;
+PFNGLBINDBUFFERARBPROC qglBindBufferARB = StubBindBuffer;
+PFNGLDELETEBUFFERSARBPROC qglDeleteBuffersARB = StubDeleteBuffers;
+PFNGLBUFFERDATAARBPROC qglBufferDataARB = StubBufferData;
+PFNGLBUFFERSUBDATAARBPROC qglBufferSubDataARB = StubBufferSubData;
+PFNGLVERTEXPOINTERPROC qglVertexPointer = StubPointer;
+PFNGLTEXCOORDPOINTERPROC qglTexCoordPointer = StubPointer;
+PFNGLCOLORPOINTERPROC qglColorPointer = StubPointer;
+PFNGLBLENDFUNCPROC qglBlendFunc = StubBlendFunc;
+
+
+static void InitLine(gl_text_line_p l, char *text, uint16_t font_id)
+{
+    memset(l, 0, sizeof(gl_text_line_t));
+    l->text = text;
+    l->text_size = strlen(text) + 1;
+    l->font_id = font_id;
+    l->style_id = 0;
+    l->line_width = -1.0f;
+    l->line_height = 1.0f;
+    l->show = 1;
+}
+
+static uint32_t Hash(const char *text)
+{
+    uint32_t hash = 2166136261u;
+    for(const uint8_t *ch = (const uint8_t*)text; *ch; ++ch)
+    {
+        hash = (hash ^ *ch) * 16777619u;
+    }
+    return hash;
+}
+
+
+/* A run is shaped once, kept while the line moves, and shaped again when the text, width or font changes. */
+static void TestRunReuse()
+{
+    char text[16] = "hello";
+    gl_text_line_t l;
+
+    InitLine(&l, text, 0);
+    shape_calls = 0;
+    GLText_RenderStringLine(&l);
+    GLText_RenderStringLine(&l);
+    TEST_CHECK(shape_calls == 1);
+
+    l.x = 100.0f;
+    l.y = 50.0f;
+    l.x_align = GLTEXT_ALIGN_CENTER;
+    GLText_RenderStringLine(&l);
+    TEST_CHECK(shape_calls == 1);
+
+    text[4] = 'p';
+    GLText_RenderStringLine(&l);
+    TEST_CHECK((shape_calls == 2) && !strcmp(shaped_text, "hellp"));
+
+    // wrapped at two glyphs: three lines
+    l.line_width = 2.0f * TEST_CHAR_WIDTH / 64.0f;
+    GLText_RenderStringLine(&l);
+    TEST_CHECK((shape_calls == 5) && (l.run->lines_count == 3));
+    GLText_RenderStringLine(&l);
+    TEST_CHECK(shape_calls == 5);
+
+    GLText_UpdateResize(2.0f);
+    GLText_RenderStringLine(&l);
+    TEST_CHECK(shape_calls == 8);
+
+    GLText_DeleteLine(&l);
+    TEST_CHECK(l.run == NULL);
+}
+
+
+/* Two texts of the same length and hash are still told apart. */
+static void TestHashCollision()
+{
+    char text[16] = "vdvjjha";
+    gl_text_line_t l;
+
+    TEST_CHECK(Hash("vdvjjha") == Hash("pejdwbm"));
+    InitLine(&l, text, 0);
+    shape_calls = 0;
+    GLText_RenderStringLine(&l);
+    strcpy(text, "pejdwbm");
+    GLText_RenderStringLine(&l);
+    TEST_CHECK((shape_calls == 2) && !strcmp(shaped_text, "pejdwbm"));
+    GLText_DeleteLine(&l);
+}
+
+
+/* Strings are drawn in the order they come, even when a later one goes back to an earlier atlas. */
+static void TestDrawOrder()
+{
+    char text_a[] = "first", text_b[] = "second", text_c[] = "third";
+    gl_text_line_t a, b, c;
+
+    InitLine(&a, text_a, 0);
+    InitLine(&b, text_b, 1);
+    InitLine(&c, text_c, 0);
+    GLText_AddLine(&c);                 // lines are added in front
+    GLText_AddLine(&b);
+    GLText_AddLine(&a);
+
+    draws_count = 0;
+    GLText_RenderStrings();
+    TEST_CHECK(draws_count == 3);
+    TEST_CHECK((bound_textures[0] == GLText_GetFont(0)->gl_tex_indexes[0]) && (drawn_counts[0] == 6 * 5));
+    TEST_CHECK((bound_textures[1] == GLText_GetFont(1)->gl_tex_indexes[0]) && (drawn_counts[1] == 6 * 6));
+    TEST_CHECK((bound_textures[2] == GLText_GetFont(0)->gl_tex_indexes[0]) && (drawn_counts[2] == 6 * 5));
+
+    // the same atlas one after another is one draw
+    b.font_id = 0;
+    draws_count = 0;
+    GLText_RenderStrings();
+    TEST_CHECK((draws_count == 1) && (drawn_counts[0] == 6 * 16));
+
+    GLText_DeleteLine(&a);
+    GLText_DeleteLine(&b);
+    GLText_DeleteLine(&c);
+}
+
+
+int main()
+{
+    GLText_Init();
+    TEST_CHECK(GLText_AddFont(0, 10, "a.ttf") && GLText_AddFont(1, 12, "b.ttf"));
+    TEST_CHECK(GLText_AddFontStyle(0, 1.0f, 1.0f, 1.0f, 1.0f, 0));
+
+    TestRunReuse();
+    TestHashCollision();
+    TestDrawOrder();
+
+    GLText_Destroy();
+    return TEST_RESULT();
+}
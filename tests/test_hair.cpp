@@ -0,0 +1,285 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+#include "test.h"
+#include "core/vmath.h"
+}
+
+#include "core/base_types.h"
+#include "mesh.h"
+#include "skeletal_model.h"
+#include "entity.h"
+#include "world.h"
+#include "physics/physics.h"
+#include "physics/hair.h"
+
+#define TEST_ELEMENTS       (6)
+#define TEST_FRAMES         (600)
+#define TEST_TOLERANCE      (0.001f)
+#define TEST_FLOOR          (100.0f)
+#define TEST_TIP_RADIUS     (6.0f)              // inner radius of the tail mesh
+#define TEST_BODY_RADIUS    (64.0f)             // inner radius of both body meshes
+
+static const float test_steps[4] = {1.0f / 60.0f, 1.0f / 30.0f, 0.0f, 0.5f};
+
+/*
+ * A hair model of equal elements on a body of two bones, the head on top of
+ * the torso; the tip falls on a floor at the hips.
+ */
+static base_mesh_t          hair_meshes[TEST_ELEMENTS];
+static mesh_tree_tag_t      hair_tree[TEST_ELEMENTS];
+static skeletal_model_t     hair_model;
+static base_mesh_t          body_meshes[2];
+static ss_bone_tag_t        bone_tags[2];
+static ss_bone_frame_t      bone_frame;
+static engine_container_t   self;
+static entity_t             entity;
+static uint32_t             floor_hits;
+
+/*
+ * What hair.cpp takes from the rest of the engine.
+ */
+extern "C" engine_container_p Container_Create()
+{
+    return (engine_container_p)calloc(1, sizeof(engine_container_t));
+}
+
+struct skeletal_model_s *World_GetModelByID(uint32_t id)
+{
+    return (id == hair_model.id) ? (&hair_model) : (NULL);
+}
+
+void Physics_GetGravity(float g[3])
+{
+    g[0] = 0.0f;
+    g[1] = 0.0f;
+    g[2] = -5000.0f;
+}
+
+int Physics_SphereTest(struct collision_result_s *result, float from[3], float to[3], float R, struct engine_container_s *cont, int16_t filter)
+{
+    float top = TEST_FLOOR + R;
+    if((from[2] >= top) && (to[2] < top))
+    {
+        memset(result, 0, sizeof(collision_result_t));
+        result->hit = 1;
+        result->fraction = (from[2] - top) / (from[2] - to[2]);
+        result->normale[2] = 1.0f;
+        floor_hits++;
+        return 1;
+    }
+    return 0;
+}
+
+
+static void SetBox(base_mesh_p mesh, float x, float y, float z)
+{
+    mesh->vertex_count = 8;
+    mesh->bb_min[0] = -x; mesh->bb_min[1] = 0.0f; mesh->bb_min[2] = -z;
+    mesh->bb_max[0] = x;  mesh->bb_max[1] = y;    mesh->bb_max[2] = z;
+    mesh->centre[0] = 0.0f;
+    mesh->centre[1] = 0.5f * y;
+    mesh->centre[2] = 0.0f;
+}
+
+static void InitBody()
+{
+    hair_model.id = 2;
+    hair_model.mesh_count = TEST_ELEMENTS;
+    hair_model.mesh_tree = hair_tree;
+    for(int i = 0; i < TEST_ELEMENTS; i++)
+    {
+        SetBox(hair_meshes + i, 6.0f, 48.0f, 6.0f);
+        hair_tree[i].mesh_base = hair_meshes + i;
+    }
+
+    // the torso stands up along z, the head is on it
+    SetBox(body_meshes + 0, 96.0f, 256.0f, 64.0f);
+    SetBox(body_meshes + 1, 64.0f, 128.0f, 64.0f);
+    for(int i = 0; i < 2; i++)
+    {
+        Mat4_E(bone_tags[i].current_transform);
+        Mat4_RotateX_SinCos(bone_tags[i].current_transform, 1.0f, 0.0f);
+        bone_tags[i].mesh_base = body_meshes + i;
+    }
+    bone_tags[1].current_transform[14] = 256.0f;
+    bone_frame.bone_tag_count = 2;
+    bone_frame.bone_tags = bone_tags;
+
+    Mat4_E(entity.transform.M4x4);
+    entity.self = &self;
+    entity.bf = &bone_frame;
+}
+
+static hair_setup_p GetSetup(lua_State *lua)
+{
+    hair_setup_p setup;
+    TEST_CHECK(luaL_dostring(lua,
+        "return {\n"
+        "    props = { root_weight = 10.0, tail_weight = 1.0, hair_damping = {0.15, 0.80}, hair_inertia = 100.0,\n"
+        "              hair_friction = 0.3, hair_bouncing = 0.0, joint_cfm = 0.1, joint_erp = 0.9, joint_overlap = 0.9 },\n"
+        "    model = 2,\n"
+        "    link_body = 1,\n"
+        "    v_count = 4,\n"
+        "    v_index = { 52, 55, 51, 48 },\n"
+        "    offset = { 0.0, -48.0, 16.0 },\n"
+        "    root_angle = { -3.141592653 / 2, 0.0, -3.141592653 }\n"
+        "}\n") == LUA_OK);
+    setup = Hair_GetSetup(lua, lua_gettop(lua));
+    lua_pop(lua, 1);
+    return setup;
+}
+
+// runs, turns and stops, faster than the animations would
+static void MoveBody(int frame)
+{
+    float a = 0.05f * frame;
+    Mat4_E(entity.transform.M4x4);
+    Mat4_RotateZ_SinCos(entity.transform.M4x4, sinf(2.0f * sinf(0.7f * a)), cosf(2.0f * sinf(0.7f * a)));
+    entity.transform.M4x4[12] = 512.0f * sinf(a);
+    entity.transform.M4x4[13] = 256.0f * sinf(2.7f * a);
+    entity.transform.M4x4[14] = 64.0f * sinf(5.0f * a);
+}
+
+// the tail end: the last element frame goes along it
+static void GetTip(struct hair_s *hair, hair_setup_p setup, float tip[3])
+{
+    struct base_mesh_s *mesh;
+    float tr[16];
+    Hair_GetElementInfo(hair, TEST_ELEMENTS - 1, &mesh, tr);
+    vec3_add_mul(tip, tr + 12, tr + 4, (mesh->bb_max[1] - mesh->bb_min[1]) * setup->joint_overlap);
+}
+
+
+/* The element lengths hold after every step, whatever the body does and however long the frame. */
+static void TestStretch(hair_setup_p setup)
+{
+    struct hair_s *hair = Hair_Create(setup, &entity);
+    float worst = 0.0f;
+
+    TEST_CHECK(hair != NULL);
+    if(!hair)
+    {
+        return;
+    }
+    TEST_CHECK(Hair_GetElementsCount(hair) == TEST_ELEMENTS);
+    TEST_CHECK(Hair_GetMaxStretch(hair) <= TEST_TOLERANCE);
+
+    for(int f = 0; f < TEST_FRAMES; f++)
+    {
+        float s;
+        MoveBody(f);
+        Hair_Update(hair, &entity, test_steps[(f / 50) % 4]);
+        s = Hair_GetMaxStretch(hair);
+        worst = (s > worst) ? (s) : (worst);
+        TEST_CHECK(s == s);
+    }
+    printf("%d frames, worst element stretch %.4f%%, %d floor hits\n", TEST_FRAMES, 100.0f * worst, floor_hits);
+    TEST_CHECK(worst <= TEST_TOLERANCE);
+    Hair_Delete(hair);
+}
+
+
+/*
+ * After the last pass the tip is out of the body spheres, and a tip that was
+ * on or over the floor is still there: nothing pulls it back through.
+ */
+static void TestTipPenetration(hair_setup_p setup)
+{
+    struct hair_s *hair = Hair_Create(setup, &entity);
+    float tip[3], prev_tip[3], floor_depth = 0.0f, body_depth = 0.0f;
+
+    TEST_CHECK(hair != NULL);
+    if(!hair)
+    {
+        return;
+    }
+    GetTip(hair, setup, prev_tip);
+    for(int f = 0; f < TEST_FRAMES; f++)
+    {
+        float time = test_steps[(f / 50) % 4];
+        MoveBody(f);
+        Hair_Update(hair, &entity, time);
+        GetTip(hair, setup, tip);
+
+        if((time > 0.0f) && (prev_tip[2] >= TEST_FLOOR + TEST_TIP_RADIUS - TEST_TOLERANCE))
+        {
+            float d = TEST_FLOOR + TEST_TIP_RADIUS - tip[2];
+            floor_depth = (d > floor_depth) ? (d) : (floor_depth);
+        }
+        for(int i = 0; i < 2; i++)
+        {
+            float tr[16], centre[3], d;
+            Mat4_Mat4_mul(tr, entity.transform.M4x4, bone_tags[i].current_transform);
+            Mat4_vec3_mul(centre, tr, body_meshes[i].centre);
+            d = TEST_BODY_RADIUS - vec3_dist(centre, tip);
+            body_depth = (d > body_depth) ? (d) : (body_depth);
+        }
+        vec3_copy(prev_tip, tip);
+    }
+    printf("tip: %.3f under the floor, %.3f in the body at worst\n", floor_depth, body_depth);
+    TEST_CHECK(floor_depth <= 0.01f);
+    TEST_CHECK(body_depth <= 0.01f);
+    Hair_Delete(hair);
+}
+
+
+/* The first element hangs from the head bone, at the set-up offset. */
+static void TestRoot(hair_setup_p setup)
+{
+    struct hair_s *hair;
+    struct base_mesh_s *mesh;
+    float tr[16], head[16], root[3];
+
+    Mat4_E(entity.transform.M4x4);
+    entity.transform.M4x4[12] = 1000.0f;
+    hair = Hair_Create(setup, &entity);
+    TEST_CHECK(hair != NULL);
+    if(!hair)
+    {
+        return;
+    }
+    for(int f = 0; f < 10; f++)
+    {
+        Hair_Update(hair, &entity, 1.0f / 60.0f);
+    }
+    Mat4_Mat4_mul(head, entity.transform.M4x4, bone_tags[1].current_transform);
+    Mat4_vec3_mul(root, head, setup->head_offset);
+    Hair_GetElementInfo(hair, 0, &mesh, tr);
+    TEST_CHECK(mesh == hair_meshes);
+    TEST_CHECK(vec3_dist(root, tr + 12) < 0.01f);
+    Hair_Delete(hair);
+
+    // no such bone, no such model
+    setup->link_body = 2;
+    TEST_CHECK(Hair_Create(setup, &entity) == NULL);
+    setup->link_body = 1;
+    setup->model_id = 3;
+    TEST_CHECK(Hair_Create(setup, &entity) == NULL);
+    setup->model_id = 2;
+}
+
+
+int main()
+{
+    lua_State *lua = luaL_newstate();
+    hair_setup_p setup;
+
+    InitBody();
+    setup = GetSetup(lua);
+    TEST_CHECK(setup && (setup->model_id == 2) && (setup->link_body == 1) && (setup->vertex_map_count == 4));
+    if(setup)
+    {
+        TestStretch(setup);
+        TestTipPenetration(setup);
+        TestRoot(setup);
+        Hair_DeleteSetup(setup);
+    }
+    lua_close(lua);
+    return TEST_RESULT();
+}
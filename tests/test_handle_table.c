@@ -0,0 +1,181 @@
+#include <stdint.h>
+#include <string.h>
+#include "core/handle_table.h"
+#include "test.h"
+
+typedef struct object_s
+{
+    uint32_t    key;
+    uint32_t    freed;
+    uint32_t    visits;
+} object_t, *object_p;
+
+static uint32_t freed_count = 0;
+
+static void FreeObject(void *data)
+{
+    ((object_p)data)->freed++;
+    freed_count++;
+}
+
+
+static void TestLookup()
+{
+    handle_table_t table;
+    object_t objects[8];
+    const uint32_t keys[8] = { 0, 1, 5, 4000, HANDLE_TABLE_DIRECT_KEYS, 1u << 20, 0x80000000u, 0xFFFFFFFEu };
+    uint64_t handle;
+
+    memset(objects, 0, sizeof(objects));
+    HandleTable_Init(&table);
+    table.free_data = FreeObject;
+    for(int i = 0; i < 8; ++i)
+    {
+        objects[i].key = keys[i];
+        TEST_CHECK(HandleTable_InsertReplace(&table, keys[i], objects + i));
+    }
+    TEST_CHECK(!HandleTable_InsertReplace(&table, HANDLE_TABLE_NONE, objects));
+    TEST_CHECK(table.count == 8);
+    for(int i = 0; i < 8; ++i)
+    {
+        TEST_CHECK(HandleTable_Get(&table, keys[i]) == objects + i);
+    }
+    TEST_CHECK(HandleTable_Get(&table, 2) == NULL);
+    TEST_CHECK(HandleTable_Get(&table, 0x80000001u) == NULL);
+    TEST_CHECK(HandleTable_GetMaxKey(&table) == 0xFFFFFFFEu);
+
+    // handles die with the object under the key
+    handle = HandleTable_GetHandle(&table, 0x80000000u);
+    TEST_CHECK(HandleTable_GetByHandle(&table, handle) == objects + 6);
+    TEST_CHECK(HandleTable_Remove(&table, 0x80000000u));
+    TEST_CHECK(objects[6].freed == 1);
+    TEST_CHECK(HandleTable_GetByHandle(&table, handle) == NULL);
+    TEST_CHECK(HandleTable_InsertReplace(&table, 0x80000000u, objects + 6));
+    TEST_CHECK(HandleTable_GetByHandle(&table, handle) == NULL);
+    TEST_CHECK(HandleTable_GetByHandle(&table, HandleTable_GetHandle(&table, 0x80000000u)) == objects + 6);
+
+    handle = HandleTable_GetHandle(&table, 5);
+    TEST_CHECK(HandleTable_InsertReplace(&table, 5, objects + 3));
+    TEST_CHECK(objects[2].freed == 1);
+    TEST_CHECK(HandleTable_GetByHandle(&table, handle) == NULL);
+    TEST_CHECK(HandleTable_GetHandle(&table, 2) == HANDLE_TABLE_NO_HANDLE);
+    TEST_CHECK(HandleTable_GetByHandle(&table, HANDLE_TABLE_NO_HANDLE) == NULL);
+
+    TEST_CHECK(HandleTable_Remove(&table, 0xFFFFFFFEu));
+    TEST_CHECK(HandleTable_GetMaxKey(&table) == 0x80000000u);
+
+    HandleTable_Destroy(&table);
+    TEST_CHECK(HandleTable_GetMaxKey(&table) == HANDLE_TABLE_NONE);
+}
+
+
+static void TestRemoveMany()
+{
+    handle_table_t table;
+    static object_t objects[10000];
+
+    memset(objects, 0, sizeof(objects));
+    HandleTable_Init(&table);
+    for(uint32_t i = 0; i < 10000; ++i)
+    {
+        objects[i].key = i * 7;
+        TEST_CHECK(HandleTable_InsertReplace(&table, i * 7, objects + i));
+    }
+    for(uint32_t i = 0; i < 10000; i += 3)
+    {
+        TEST_CHECK(HandleTable_Remove(&table, i * 7));
+    }
+    TEST_CHECK(table.count - table.holes == 10000 - 3334);
+    for(uint32_t i = 0; i < 10000; ++i)
+    {
+        TEST_CHECK(HandleTable_Get(&table, i * 7) == ((i % 3) ? (objects + i) : (NULL)));
+    }
+
+    // compaction keeps the insertion order
+    {
+        uint32_t last = 0;
+        int ordered = 1;
+        for(uint32_t i = 0; i < table.count; ++i)
+        {
+            object_p obj = (object_p)table.data[i];
+            if(obj)
+            {
+                ordered &= (obj->key >= last);
+                last = obj->key;
+            }
+        }
+        TEST_CHECK(ordered);
+    }
+    HandleTable_Destroy(&table);
+}
+
+
+/* every object is visited once, whatever the visit removes or inserts */
+static void TestIterationRemoval()
+{
+    handle_table_t table;
+    object_t objects[64];
+    object_t spawned[16];
+    uint32_t spawned_count = 0;
+
+    memset(objects, 0, sizeof(objects));
+    memset(spawned, 0, sizeof(spawned));
+    freed_count = 0;
+    HandleTable_Init(&table);
+    table.free_data = FreeObject;
+    for(uint32_t i = 0; i < 64; ++i)
+    {
+        objects[i].key = i;
+        HandleTable_InsertReplace(&table, i, objects + i);
+    }
+
+    HandleTable_BeginIteration(&table);
+    for(uint32_t i = table.count; i > 0; --i)
+    {
+        object_p obj = (object_p)table.data[i - 1];
+        if(!obj)
+        {
+            continue;
+        }
+        obj->visits++;
+        if(obj->key % 4 == 0)
+        {
+            // older ones, already visited and not visited yet
+            HandleTable_Remove(&table, obj->key / 2);
+            HandleTable_Remove(&table, obj->key + 1);
+        }
+        if((obj->key % 8 == 0) && (spawned_count < 16))
+        {
+            spawned[spawned_count].key = 1000 + spawned_count;
+            HandleTable_InsertReplace(&table, 1000 + spawned_count, spawned + spawned_count);
+            spawned_count++;
+        }
+    }
+    HandleTable_EndIteration(&table);
+
+    for(uint32_t i = 0; i < 64; ++i)
+    {
+        TEST_CHECK(objects[i].visits <= 1);
+        TEST_CHECK(objects[i].visits || objects[i].freed);
+        TEST_CHECK(objects[i].freed <= 1);
+    }
+    for(uint32_t i = 0; i < spawned_count; ++i)
+    {
+        TEST_CHECK(spawned[i].visits == 0);
+        TEST_CHECK(HandleTable_Get(&table, 1000 + i) == spawned + i);
+    }
+
+    HandleTable_MakeEmpty(&table);
+    TEST_CHECK(table.count == 0);
+    TEST_CHECK(freed_count == 64 + spawned_count);
+    HandleTable_Destroy(&table);
+}
+
+
+int main()
+{
+    TestLookup();
+    TestRemoveMany();
+    TestIterationRemoval();
+    return TEST_RESULT();
+}
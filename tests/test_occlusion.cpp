@@ -0,0 +1,304 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "test.h"
+#include "core/vmath.h"
+#include "core/polygon.h"
+#include "core/obb.h"
+}
+
+#include "core/system.h"
+#include "render/frustum.h"
+#include "render/camera.h"
+#include "render/occlusion.h"
+
+#define TEST_MAX_TRIANGLES  (512)
+#define TEST_SCENES         (100)
+#define TEST_SCENE_QUADS    (30)
+#define TEST_SCENE_BOXES    (100)
+#define TEST_BOX_SAMPLES    (1000)
+
+/*
+ * What occlusion.cpp and camera.cpp take from the rest of the engine.
+ */
+void *Sys_GetTempMem(size_t size)
+{
+    return malloc(size);
+}
+
+void Sys_ReturnTempMem(size_t size)
+{
+}
+
+
+/*
+ * The camera stands at the origin and looks along +y, with a 2:1 view like
+ * the buffer; the occluders are quads made of two triangles.
+ */
+static camera_t             cam;
+static occluder_triangle_t  triangles[TEST_MAX_TRIANGLES];
+static uint32_t             triangles_count;
+
+static float Rand(float min, float max)
+{
+    return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+static void AddQuad(const float a[3], const float b[3], const float c[3], const float d[3], uint32_t double_side)
+{
+    const float *v[4] = {a, b, c, d};
+    float e1[3], e2[3], n[3], len;
+
+    vec3_sub(e1, b, a);
+    vec3_sub(e2, c, a);
+    vec3_cross(n, e1, e2);
+    vec3_norm(n, len);
+    for(int k = 1; (k < 3) && (triangles_count < TEST_MAX_TRIANGLES); k++)
+    {
+        occluder_triangle_p t = triangles + triangles_count++;
+        vec3_copy(t->vertices + 0, v[0]);
+        vec3_copy(t->vertices + 3, v[k]);
+        vec3_copy(t->vertices + 6, v[k + 1]);
+        vec3_copy(t->plane, n);
+        t->plane[3] = -vec3_dot(n, a);
+        t->double_side = double_side;
+    }
+}
+
+// a wall across the view at depth y, split in nx by nz tiles; the front faces the camera
+static void AddWall(float x0, float x1, float z0, float z1, float y, int nx, int nz, bool back)
+{
+    for(int i = 0; i < nx; i++)
+    {
+        for(int j = 0; j < nz; j++)
+        {
+            float xa = x0 + (x1 - x0) * i / nx, xb = x0 + (x1 - x0) * (i + 1) / nx;
+            float za = z0 + (z1 - z0) * j / nz, zb = z0 + (z1 - z0) * (j + 1) / nz;
+            float a[3] = {xa, y, za}, b[3] = {xb, y, za}, c[3] = {xb, y, zb}, d[3] = {xa, y, zb};
+            if(back)
+            {
+                AddQuad(a, d, c, b, 0);
+            }
+            else
+            {
+                AddQuad(a, b, c, d, 0);
+            }
+        }
+    }
+}
+
+static void Draw(COcclusionBuffer *buf)
+{
+    occluder_list_t list = {NULL, triangles_count, triangles};
+
+    Occlusion_LinkOccluders(triangles, triangles_count);
+    buf->Begin(cam.gl_view_proj_mat, cam.transform.M4x4 + 12);
+    buf->AddOccluders(&list);
+    buf->End();
+}
+
+static bool IsBoxVisible(COcclusionBuffer *buf, float x, float y, float z, float extent)
+{
+    obb_t obb;
+
+    memset(&obb, 0, sizeof(obb));
+    obb.centre[0] = x;
+    obb.centre[1] = y;
+    obb.centre[2] = z;
+    vec3_set_one(obb.extent);
+    vec3_mul_scalar(obb.extent, obb.extent, extent);
+    return buf->IsOBBVisible(&obb);
+}
+
+static float ScreenX(const float v[3])
+{
+    float p[4] = {v[0], v[1], v[2], 1.0f}, c[4];
+    Mat4_vec4_mul_macro(c, cam.gl_view_proj_mat, p);
+    return (c[0] / c[3] * 0.5f + 0.5f) * (float)OCCLUSION_WIDTH;
+}
+
+// a ray from the camera to p goes through a drawn occluder
+static bool IsPointBlocked(const float p[3])
+{
+    for(uint32_t i = 0; i < triangles_count; i++)
+    {
+        occluder_triangle_p t = triangles + i;
+        float e1[3], e2[3], h[3], s[3], q[3], a, u, v, d;
+        if(!t->double_side && (vec3_plane_dist(t->plane, cam.transform.M4x4 + 12) < 0.0f))
+        {
+            continue;
+        }
+        vec3_sub(e1, t->vertices + 3, t->vertices);
+        vec3_sub(e2, t->vertices + 6, t->vertices);
+        vec3_sub(s, cam.transform.M4x4 + 12, t->vertices);
+        vec3_cross(h, p, e2);
+        a = vec3_dot(e1, h);
+        if(fabsf(a) < 1.0e-9f)
+        {
+            continue;
+        }
+        // a ray along a diagonal must not slip between the two halves of a quad
+        u = vec3_dot(s, h) / a;
+        vec3_cross(q, s, e1);
+        v = vec3_dot(p, q) / a;
+        d = vec3_dot(e2, q) / a;
+        if((u >= -1.0e-5f) && (v >= -1.0e-5f) && (u + v <= 1.00001f) && (d > 1.0e-4f) && (d < 1.0f - 1.0e-4f))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool IsPointOnScreen(const float p[3])
+{
+    float v[4] = {p[0], p[1], p[2], 1.0f}, c[4];
+    Mat4_vec4_mul_macro(c, cam.gl_view_proj_mat, v);
+    return (c[3] > 0.0f) && (fabsf(c[0]) < 0.99f * c[3]) && (fabsf(c[1]) < 0.99f * c[3]);
+}
+
+
+/* A wall seen from its front and from its back, with boxes behind it, in front of it and beside it. */
+static void TestKnownWall(COcclusionBuffer *buf)
+{
+    static const struct
+    {
+        float   centre[3];
+        bool    visible;
+    }boxes[4] = {{{0.0f, 2048.0f, 0.0f}, false}, {{0.0f, 1280.0f, 0.0f}, false}, {{0.0f, 512.0f, 0.0f}, true}, {{2048.0f, 4096.0f, 0.0f}, true}};
+
+    TEST_CHECK(IsBoxVisible(buf, 0.0f, 2048.0f, 0.0f, 128.0f));                // nothing is drawn yet
+    for(int back = 0; back < 2; ++back)
+    {
+        triangles_count = 0;
+        AddWall(-512.0f, 512.0f, -512.0f, 512.0f, 1024.0f, 1, 1, back);
+        Draw(buf);
+        for(int i = 0; i < 4; ++i)
+        {
+            TEST_CHECK(IsBoxVisible(buf, boxes[i].centre[0], boxes[i].centre[1], boxes[i].centre[2], 128.0f) == (boxes[i].visible || back));
+        }
+    }
+
+    // a polygon window past the wall, and one around it
+    {
+        const float hidden[12] = {-100.0f, 1500.0f, -100.0f, 100.0f, 1500.0f, -100.0f, 100.0f, 1500.0f, 100.0f, -100.0f, 1500.0f, 100.0f};
+        const float around[12] = {-600.0f, 1024.0f, -600.0f, 600.0f, 1024.0f, -600.0f, 600.0f, 1024.0f, 600.0f, -600.0f, 1024.0f, 600.0f};
+        triangles_count = 0;
+        AddWall(-512.0f, 512.0f, -512.0f, 512.0f, 1024.0f, 1, 1, false);
+        Draw(buf);
+        TEST_CHECK(!buf->IsPolygonVisible(hidden, 4));
+        TEST_CHECK(buf->IsPolygonVisible(around, 4));
+    }
+}
+
+
+/* The tiles of a wall join without cracks, and two walls with a gap narrower than a pixel leave it open. */
+static void TestJoins(COcclusionBuffer *buf)
+{
+    const float left[3] = {-2.0f, 1024.0f, 0.0f}, right[3] = {2.0f, 1024.0f, 0.0f};
+    uint32_t hidden = 0, count = 0;
+
+    triangles_count = 0;
+    AddWall(-2048.0f, 2048.0f, -1024.0f, 1024.0f, 1024.0f, 16, 12, false);
+    Draw(buf);
+    for(float x = -1000.0f; x <= 1000.0f; x += 37.0f)
+    {
+        for(float z = -500.0f; z <= 500.0f; z += 29.0f)
+        {
+            hidden += IsBoxVisible(buf, 3.0f * x, 3072.0f, 3.0f * z, 20.0f) ? (0) : (1);
+            count++;
+        }
+    }
+    TEST_CHECK(hidden == count);
+
+    // the gap is on the border of the two middle pixels, so both their centres are covered
+    TEST_CHECK(ScreenX(right) - ScreenX(left) < 0.5f);
+    triangles_count = 0;
+    AddWall(-512.0f, left[0], -512.0f, 512.0f, 1024.0f, 1, 1, false);
+    AddWall(right[0], 512.0f, -512.0f, 512.0f, 1024.0f, 1, 1, false);
+    Draw(buf);
+    TEST_CHECK(IsBoxVisible(buf, 0.0f, 8192.0f, 0.0f, 64.0f));
+    TEST_CHECK(!IsBoxVisible(buf, 1024.0f, 8192.0f, 0.0f, 64.0f));
+}
+
+
+/*
+ * Random scenes of quads turned every way: a box the buffer hides must have
+ * no point on its surface that a ray from the camera reaches.
+ */
+static void TestRandomScenes(COcclusionBuffer *buf)
+{
+    uint32_t tested = 0, culled = 0, wrong = 0;
+
+    for(int scene = 0; scene < TEST_SCENES; scene++)
+    {
+        triangles_count = 0;
+        for(int k = 0; k < TEST_SCENE_QUADS; k++)
+        {
+            float cx = Rand(-4000.0f, 4000.0f), cy = Rand(600.0f, 8000.0f), cz = Rand(-2000.0f, 2000.0f);
+            float sx = Rand(100.0f, 1500.0f), sz = Rand(100.0f, 1500.0f);
+            float ang = Rand(-0.8f, 0.8f), ca = cosf(ang), sa = sinf(ang);
+            float a[3] = {cx - sx * ca, cy - sx * sa, cz - sz}, b[3] = {cx + sx * ca, cy + sx * sa, cz - sz};
+            float c[3] = {cx + sx * ca, cy + sx * sa, cz + sz}, d[3] = {cx - sx * ca, cy - sx * sa, cz + sz};
+            if(rand() & 1)
+            {
+                AddQuad(a, b, c, d, 0);
+            }
+            else
+            {
+                AddQuad(a, d, c, b, (rand() % 3) == 0);
+            }
+        }
+        Draw(buf);
+
+        for(int k = 0; k < TEST_SCENE_BOXES; k++)
+        {
+            float centre[3] = {Rand(-6000.0f, 6000.0f), Rand(500.0f, 12000.0f), Rand(-3000.0f, 3000.0f)};
+            float e = Rand(20.0f, 300.0f);
+            uint32_t seen = 0;
+
+            tested++;
+            if(IsBoxVisible(buf, centre[0], centre[1], centre[2], e))
+            {
+                continue;
+            }
+            culled++;
+            for(int s = 0; s < TEST_BOX_SAMPLES; s++)
+            {
+                float p[3] = {centre[0] + Rand(-e, e), centre[1] + Rand(-e, e), centre[2] + Rand(-e, e)};
+                int axis = rand() % 3;
+                p[axis] = centre[axis] + ((rand() & 1) ? (e) : (-e));
+                seen += (IsPointOnScreen(p) && !IsPointBlocked(p)) ? (1) : (0);
+            }
+            wrong += (seen) ? (1) : (0);
+        }
+    }
+    printf("%d boxes: %d hidden, %d of them with points in sight\n", tested, culled, wrong);
+    TEST_CHECK(culled > tested / 3);
+    TEST_CHECK(wrong == 0);
+}
+
+
+int main()
+{
+    COcclusionBuffer *buf = new COcclusionBuffer();
+    float ang[3] = {0.0f, 0.0f, 0.0f};
+
+    srand(0x0CC1);
+    memset(&cam, 0, sizeof(cam));
+    Cam_Init(&cam);
+    Cam_SetFovAspect(&cam, 75.0f, 2.0f);
+    Cam_SetRotation(&cam, ang);                                                 // looks along +y
+    Cam_Apply(&cam);
+
+    TestKnownWall(buf);
+    TestJoins(buf);
+    TestRandomScenes(buf);
+
+    free(cam.frustum->vertex);
+    free(cam.frustum);
+    delete buf;
+    return TEST_RESULT();
+}
@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "test.h"
+#include "core/vmath.h"
+}
+
+#include "render/render.h"
+#include "render/shader_manager.h"
+#include "room.h"
+#include "mesh.h"
+
+/*
+ * What render_lights.cpp takes from the rest of the engine: the tint only
+ * has to be seen on the right lights.
+ */
+void CalculateWaterTint(GLfloat *tint, uint8_t fixed_colour)
+{
+    tint[0] *= 0.5f;
+}
+
+
+/* A room with its own lights and one near room. */
+typedef struct test_rooms_s
+{
+    room_t              rooms[2];
+    room_content_t      contents[2];
+    room_p              near_room;
+    light_t             lights[2][32];
+}test_rooms_t, *test_rooms_p;
+
+static float Rand(float min, float max)
+{
+    return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+static void SetLight(light_p light, int type, float x, float y, float z, float colour, float outer)
+{
+    memset(light, 0, sizeof(light_t));
+    light->light_type = (enum LightType)type;
+    light->pos[0] = x;
+    light->pos[1] = y;
+    light->pos[2] = z;
+    light->colour[0] = light->colour[1] = light->colour[2] = colour;
+    light->colour[3] = 1.0f;
+    light->inner = 0.5f * outer;
+    light->outer = outer;
+}
+
+static void InitRooms(test_rooms_p b, uint32_t own_count, uint32_t near_count)
+{
+    memset(b, 0, sizeof(test_rooms_t));
+    for(int i = 0; i < 2; i++)
+    {
+        b->rooms[i].id = i;
+        b->rooms[i].content = b->contents + i;
+        b->contents[i].lights = b->lights[i];
+    }
+    b->near_room = b->rooms + 1;
+    b->contents[0].lights_count = own_count;
+    b->contents[0].near_room_list_size = 1;
+    b->contents[0].near_room_list = &b->near_room;
+    b->contents[1].lights_count = near_count;
+}
+
+// every light in reach by its contribution, stable; the order the selection must give
+static uint16_t SelectReference(render_room_lights_p list, const float pos[3], float radius, uint16_t *index, uint16_t max_count)
+{
+    float score[64];
+    uint16_t order[64];
+    uint16_t count = 0;
+
+    for(uint32_t i = 0; i < list->count; i++)
+    {
+        render_light_p l = list->lights + i;
+        float d[3], dist, t;
+        vec3_sub(d, pos, l->pos);
+        dist = vec3_abs(d);
+        if(dist <= l->reach)
+        {
+            t = (dist > radius) ? (1.0f - (dist - radius) / l->outer) : (1.0f);
+            score[i] = l->strength * ((t > 0.0f) ? (t) : (0.0f));
+            order[count++] = i;
+        }
+    }
+    for(uint16_t i = 1; i < count; i++)
+    {
+        for(uint16_t j = i; (j > 0) && (score[order[j - 1]] < score[order[j]]); j--)
+        {
+            uint16_t t = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = t;
+        }
+    }
+    count = (count < max_count) ? (count) : (max_count);
+    memcpy(index, order, count * sizeof(uint16_t));
+
+    return count;
+}
+
+static void CheckSelection(test_rooms_p b, const float pos[3], const int *expected, uint16_t expected_count)
+{
+    render_room_lights_t list = {NULL, 0, NULL};
+    uint16_t index[MAX_NUM_LIGHTS];
+    uint16_t count;
+
+    Render_BuildRoomLights(&list, b->rooms);
+    count = Render_SelectLights(&list, pos, 0.0f, index, MAX_NUM_LIGHTS);
+    TEST_CHECK(count == expected_count);
+    for(uint16_t i = 0; (i < count) && (i < expected_count); i++)
+    {
+        TEST_CHECK(index[i] == expected[i]);
+    }
+    Render_FreeRoomLights(&list);
+}
+
+
+/* The 8 nearest of 12 equal lights, given in a shuffled order. */
+static void TestNearestOfEqual()
+{
+    static const int dist[12] = {700, 300, 1200, 100, 900, 1100, 200, 500, 1000, 400, 800, 600};
+    static const int expected[8] = {3, 6, 1, 9, 7, 11, 0, 10};
+    const float pos[3] = {0.0f, 0.0f, 0.0f};
+    test_rooms_t b;
+
+    InitRooms(&b, 12, 0);
+    for(int i = 0; i < 12; i++)
+    {
+        SetLight(b.lights[0] + i, LT_POINT, dist[i], 0.0f, 0.0f, 1.0f, 4096.0f);
+    }
+    CheckSelection(&b, pos, expected, 8);
+}
+
+
+/* A bright far light wins over a dim near one, one out of reach is left. */
+static void TestBrightFarLight()
+{
+    static const int expected[2] = {1, 0};
+    const float pos[3] = {0.0f, 0.0f, 0.0f};
+    test_rooms_t b;
+
+    InitRooms(&b, 3, 0);
+    SetLight(b.lights[0] + 0, LT_POINT, 200.0f, 0.0f, 0.0f, 0.1f, 1024.0f);
+    SetLight(b.lights[0] + 1, LT_SHADOW, 0.0f, 3000.0f, 0.0f, 1.0f, 8192.0f);
+    SetLight(b.lights[0] + 2, LT_POINT, 0.0f, 0.0f, 2500.0f, 1.0f, 1000.0f);
+    CheckSelection(&b, pos, expected, 2);
+}
+
+
+/* The own sun always, near rooms give point lights only, and only the own ones are tinted in water. */
+static void TestNearRooms()
+{
+    static const int expected[3] = {1, 2, 0};
+    const float pos[3] = {0.0f, 0.0f, 0.0f};
+    render_room_lights_t list = {NULL, 0, NULL};
+    test_rooms_t b;
+
+    InitRooms(&b, 1, 4);
+    SetLight(b.lights[0] + 0, LT_SUN, 1.0e6f, 0.0f, 0.0f, 0.5f, 0.0f);
+    SetLight(b.lights[1] + 0, LT_SUN, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+    SetLight(b.lights[1] + 1, LT_POINT, 500.0f, 0.0f, 0.0f, 1.0f, 2048.0f);
+    SetLight(b.lights[1] + 2, LT_SPOTLIGHT, 100.0f, 0.0f, 0.0f, 1.0f, 2048.0f);
+    SetLight(b.lights[1] + 3, LT_POINT, 900.0f, 0.0f, 0.0f, 1.0f, 2048.0f);
+    CheckSelection(&b, pos, expected, 3);
+
+    b.contents[0].room_flags = TR_ROOM_FLAG_WATER;
+    b.lights[0][0].colour[1] = 2.0f;
+    Render_BuildRoomLights(&list, b.rooms);
+    TEST_CHECK(list.count == 3);
+    TEST_CHECK((list.lights[0].colour[0] == 0.25f) && (list.lights[0].colour[1] == 1.0f));
+    TEST_CHECK(list.lights[1].colour[0] == 1.0f);
+    TEST_CHECK(list.lights[0].reach > 1.0e20f);
+    Render_FreeRoomLights(&list);
+    TEST_CHECK(!list.lights && !list.count && !list.content);
+}
+
+
+/* A flipped room has other content: the list no longer matches it and is built again over the old one. */
+static void TestFlippedRoom()
+{
+    render_room_lights_t list = {NULL, 0, NULL};
+    room_content_t alt_content;
+    light_t alt_lights[2];
+    test_rooms_t b;
+
+    InitRooms(&b, 1, 0);
+    SetLight(b.lights[0] + 0, LT_POINT, 100.0f, 0.0f, 0.0f, 1.0f, 2048.0f);
+    Render_BuildRoomLights(&list, b.rooms);
+    TEST_CHECK((list.content == b.rooms[0].content) && (list.count == 1));
+
+    alt_content = b.contents[0];
+    alt_content.lights = alt_lights;
+    alt_content.lights_count = 2;
+    SetLight(alt_lights + 0, LT_POINT, 0.0f, 700.0f, 0.0f, 1.0f, 2048.0f);
+    SetLight(alt_lights + 1, LT_SHADOW, 0.0f, 0.0f, 900.0f, 1.0f, 2048.0f);
+    b.rooms[0].content = &alt_content;
+    TEST_CHECK(list.content != b.rooms[0].content);
+
+    Render_BuildRoomLights(&list, b.rooms);
+    TEST_CHECK((list.content == &alt_content) && (list.count == 2));
+    TEST_CHECK((list.lights[0].pos[1] == 700.0f) && (list.lights[1].pos[2] == 900.0f));
+
+    // and back
+    b.rooms[0].content = b.contents + 0;
+    Render_BuildRoomLights(&list, b.rooms);
+    TEST_CHECK((list.content == b.contents + 0) && (list.count == 1) && (list.lights[0].pos[0] == 100.0f));
+    Render_FreeRoomLights(&list);
+}
+
+
+/* Random rooms against the stable sort of every light in reach. */
+static void TestRandomRooms()
+{
+    for(int i = 0; i < 1000; i++)
+    {
+        render_room_lights_t list = {NULL, 0, NULL};
+        test_rooms_t b;
+        uint16_t index[MAX_NUM_LIGHTS], ref[MAX_NUM_LIGHTS];
+        uint16_t count, ref_count, max_count = 1 + i % MAX_NUM_LIGHTS;
+        float pos[3] = {Rand(-4096.0f, 4096.0f), Rand(-4096.0f, 4096.0f), Rand(-4096.0f, 4096.0f)};
+        float radius = Rand(0.0f, 512.0f);
+
+        InitRooms(&b, rand() % 32, rand() % 32);
+        for(int r = 0; r < 2; r++)
+        {
+            for(uint32_t j = 0; j < b.contents[r].lights_count; j++)
+            {
+                SetLight(b.lights[r] + j, 1 + rand() % 4, Rand(-8192.0f, 8192.0f), Rand(-8192.0f, 8192.0f),
+                         Rand(-8192.0f, 8192.0f), Rand(-0.2f, 1.2f), Rand(512.0f, 8192.0f));
+                b.lights[r][j].colour[rand() % 3] = ((rand() % 4) == 0) ? (b.lights[r][j].colour[0]) : (Rand(0.0f, 1.0f));
+            }
+        }
+        Render_BuildRoomLights(&list, b.rooms);
+        count = Render_SelectLights(&list, pos, radius, index, max_count);
+        ref_count = SelectReference(&list, pos, radius, ref, max_count);
+        TEST_CHECK(count == ref_count);
+        TEST_CHECK((count != ref_count) || !memcmp(index, ref, count * sizeof(uint16_t)));
+        Render_FreeRoomLights(&list);
+    }
+}
+
+
+int main()
+{
+    srand(0x11647);
+    TestNearestOfEqual();
+    TestBrightFarLight();
+    TestNearRooms();
+    TestFlippedRoom();
+    TestRandomRooms();
+    return TEST_RESULT();
+}
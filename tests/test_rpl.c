@@ -0,0 +1,140 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "fmv/tiny_codec.h"
+#include "test.h"
+#include "test_rpl.h"
+
+#define TEST_MAX_PACKETS    (2 * RPL_FRAMES)
+
+/*
+ * Counts the calls that reach the file.
+ */
+typedef struct test_rw_s
+{
+    SDL_RWops  *rw;
+    uint32_t    reads;
+    uint32_t    seeks;
+} test_rw_t, *test_rw_p;
+
+static Sint64 SDLCALL Test_RWSize(SDL_RWops *context)
+{
+    return SDL_RWsize(((test_rw_p)context->hidden.unknown.data1)->rw);
+}
+
+static Sint64 SDLCALL Test_RWSeek(SDL_RWops *context, Sint64 offset, int whence)
+{
+    test_rw_p t = (test_rw_p)context->hidden.unknown.data1;
+    t->seeks++;
+    return SDL_RWseek(t->rw, offset, whence);
+}
+
+static size_t SDLCALL Test_RWRead(SDL_RWops *context, void *ptr, size_t size, size_t maxnum)
+{
+    test_rw_p t = (test_rw_p)context->hidden.unknown.data1;
+    t->reads++;
+    return SDL_RWread(t->rw, ptr, size, maxnum);
+}
+
+static size_t SDLCALL Test_RWWrite(SDL_RWops *context, const void *ptr, size_t size, size_t num)
+{
+    return 0;
+}
+
+static int SDLCALL Test_RWClose(SDL_RWops *context)
+{
+    test_rw_p t = (test_rw_p)context->hidden.unknown.data1;
+    int ret = SDL_RWclose(t->rw);
+    SDL_FreeRW(context);
+    return ret;
+}
+
+
+/*
+ * Reads every packet in the order the decoder thread does, video and audio
+ * in turn, and hashes it with its pts; returns the number of packets.
+ */
+static uint32_t ReadPackets(uint8_t *file, size_t size, uint32_t read_ahead, uint64_t *hashes, test_rw_p counter)
+{
+    tiny_codec_t codec;
+    SDL_RWops *rw = SDL_AllocRW();
+    uint32_t count = 0, old_read_ahead;
+    int video_end = 0, audio_end = 0;
+
+    counter->rw = SDL_RWFromMem(file, size);
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->size = Test_RWSize;
+    rw->seek = Test_RWSeek;
+    rw->read = Test_RWRead;
+    rw->write = Test_RWWrite;
+    rw->close = Test_RWClose;
+    rw->hidden.unknown.data1 = counter;
+
+    old_read_ahead = codec_set_rpl_read_ahead(read_ahead);
+    codec_init(&codec, rw);
+    TEST_CHECK(0 == codec_open_rpl(&codec));
+    counter->reads = 0;
+    counter->seeks = 0;
+    while((!video_end || !audio_end) && (count < TEST_MAX_PACKETS))
+    {
+        for(int stream = 0; stream < 2; ++stream)
+        {
+            AVPacket *pkt = (stream) ? (&codec.audio.pkt) : (&codec.video.pkt);
+            int *end = (stream) ? (&audio_end) : (&video_end);
+            if(!*end && (count < TEST_MAX_PACKETS))
+            {
+                if(codec.packet(&codec, pkt) >= 0)
+                {
+                    uint64_t hash = 0xcbf29ce484222325 ^ (uint64_t)pkt->pts ^ ((uint64_t)stream << 63);
+                    for(int i = 0; i < pkt->size; ++i)
+                    {
+                        hash = (hash ^ pkt->data[i]) * 0x100000001b3;
+                    }
+                    hashes[count++] = hash;
+                }
+                else
+                {
+                    *end = 1;
+                }
+            }
+        }
+    }
+    codec_clear(&codec);
+    codec_set_rpl_read_ahead(old_read_ahead);
+
+    return count;
+}
+
+
+int main()
+{
+    size_t size;
+    uint8_t *file = Test_MakeRPL(&size);
+    uint64_t direct[TEST_MAX_PACKETS], buffered[TEST_MAX_PACKETS], small[TEST_MAX_PACKETS];
+    test_rw_t rw_direct, rw_buffered, rw_small;
+    uint32_t n_direct, n_buffered, n_small;
+
+    n_direct = ReadPackets(file, size, 0, direct, &rw_direct);
+    n_buffered = ReadPackets(file, size, RPL_READ_AHEAD_SIZE, buffered, &rw_buffered);
+    // smaller than one audio packet: the window has to grow
+    n_small = ReadPackets(file, size, 16, small, &rw_small);
+    printf("seek per packet: %d reads, %d seeks\n", rw_direct.reads, rw_direct.seeks);
+    printf("read-ahead: %d reads, %d seeks\n", rw_buffered.reads, rw_buffered.seeks);
+    printf("small read-ahead: %d reads, %d seeks\n", rw_small.reads, rw_small.seeks);
+
+    TEST_CHECK(n_direct == RPL_FRAMES + RPL_CHUNKS);
+    TEST_CHECK(n_buffered == n_direct);
+    TEST_CHECK(n_small == n_direct);
+    TEST_CHECK(0 == memcmp(direct, buffered, n_direct * sizeof(uint64_t)));
+    TEST_CHECK(0 == memcmp(direct, small, n_direct * sizeof(uint64_t)));
+
+    // the whole file fits the window: one seek to its start and a read to fill it
+    TEST_CHECK(rw_buffered.seeks <= 1);
+    TEST_CHECK(rw_buffered.reads <= 2);
+    TEST_CHECK(rw_direct.seeks >= n_direct);
+    TEST_CHECK(rw_small.reads < rw_direct.reads);
+
+    free(file);
+    return TEST_RESULT();
+}
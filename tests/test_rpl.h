@@ -0,0 +1,66 @@
+#ifndef TEST_RPL_H
+#define TEST_RPL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A small ARMovie file made in memory: Escape 124 video whose frames only
+ * repeat the last picture, and 16-bit PCM mono sound with exactly
+ * RATE / FPS samples per frame. Every sample of a chunk holds its chunk number.
+ */
+#define RPL_WIDTH               (64)
+#define RPL_HEIGHT              (32)
+#define RPL_FPS                 (15)
+#define RPL_RATE                (15000)
+#define RPL_FRAMES_PER_CHUNK    (2)
+#define RPL_CHUNKS              (10)
+#define RPL_FRAMES              (RPL_CHUNKS * RPL_FRAMES_PER_CHUNK)
+#define RPL_SAMPLES_PER_FRAME   (RPL_RATE / RPL_FPS)
+#define RPL_VIDEO_SIZE          (8 * RPL_FRAMES_PER_CHUNK)
+#define RPL_AUDIO_SIZE          (2 * RPL_SAMPLES_PER_FRAME * RPL_FRAMES_PER_CHUNK)
+
+static uint8_t *Test_MakeRPL(size_t *size)
+{
+    char header[512];
+    char catalog[64 * RPL_CHUNKS];
+    size_t header_size, catalog_size = 0, data_offset;
+    uint8_t *file, *p;
+
+    // the catalog offset has a fixed width, so the header length does not depend on it
+    header_size = snprintf(header, sizeof(header),
+        "ARMovie\nsynthetic\n2026\ntest\n124\n%d\n%d\n16\n%d\n1\n%d\n1\n16\n%d\n%d\n0\n0\n%06d\n0\n0\n0\n",
+        RPL_WIDTH, RPL_HEIGHT, RPL_FPS, RPL_RATE, RPL_FRAMES_PER_CHUNK, RPL_CHUNKS - 1, 0);
+    snprintf(header, sizeof(header),
+        "ARMovie\nsynthetic\n2026\ntest\n124\n%d\n%d\n16\n%d\n1\n%d\n1\n16\n%d\n%d\n0\n0\n%06d\n0\n0\n0\n",
+        RPL_WIDTH, RPL_HEIGHT, RPL_FPS, RPL_RATE, RPL_FRAMES_PER_CHUNK, RPL_CHUNKS - 1, (int)header_size);
+
+    data_offset = header_size + RPL_CHUNKS * 25;
+    for(int i = 0; i < RPL_CHUNKS; ++i)
+    {
+        catalog_size += snprintf(catalog + catalog_size, sizeof(catalog) - catalog_size, "%08d , %04d ; %06d\n",
+                                 (int)(data_offset + i * (RPL_VIDEO_SIZE + RPL_AUDIO_SIZE)), RPL_VIDEO_SIZE, RPL_AUDIO_SIZE);
+    }
+
+    *size = data_offset + RPL_CHUNKS * (RPL_VIDEO_SIZE + RPL_AUDIO_SIZE);
+    file = (uint8_t*)calloc(*size, 1);
+    memcpy(file, header, header_size);
+    memcpy(file + header_size, catalog, catalog_size);
+    p = file + data_offset;
+    for(int i = 0; i < RPL_CHUNKS; ++i)
+    {
+        for(int j = 0; j < RPL_FRAMES_PER_CHUNK; ++j, p += 8)
+        {
+            p[4] = 8;                                   // flags 0, frame size 8: keep the last picture
+        }
+        for(int j = 0; j < RPL_AUDIO_SIZE / 2; ++j, p += 2)
+        {
+            p[0] = i;
+        }
+    }
+    return file;
+}
+
+#endif  /* TEST_RPL_H */
@@ -0,0 +1,176 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "save_state_format.h"
+#include "test.h"
+
+typedef struct lua_data_s
+{
+    char       *text;
+    size_t      length;
+    uint32_t    calls;
+} lua_data_t, *lua_data_p;
+
+/* the way Script_GetEntitySaveData hands the string out */
+static size_t GetLuaData(void *arg, char *buf, size_t buf_size)
+{
+    lua_data_p data = (lua_data_p)arg;
+    data->calls++;
+    strncpy(buf, data->text, buf_size);
+    return data->length;
+}
+
+
+static void TestPrimitives()
+{
+    save_state_t state;
+    save_reader_t reader;
+    const float floats[3] = { 1.5f, -2.0f, 1.0e-7f };
+    float floats_read[3];
+    uint32_t size;
+    const char *blob;
+
+    SaveState_Init(&state);
+    SaveState_PutU32(&state, 0xDEADBEEF);
+    SaveState_PutI32(&state, -5);
+    SaveState_PutFloats(&state, floats, 3);
+    SaveState_PutBlob(&state, "level.tr2", 9);
+    SaveState_PutU32(&state, 0);
+    SaveState_SetU32(&state, state.size - 4, 77);
+    SaveState_SetU32(&state, state.size - 3, 1);        // past the end, ignored
+    TEST_CHECK(!state.error);
+
+    reader.data = state.data;
+    reader.size = state.size;
+    reader.pos = 0;
+    reader.error = 0;
+    TEST_CHECK(SaveState_GetU32(&reader) == 0xDEADBEEF);
+    TEST_CHECK(SaveState_GetI32(&reader) == -5);
+    SaveState_GetFloats(&reader, floats_read, 3);
+    TEST_CHECK(0 == memcmp(floats, floats_read, sizeof(floats)));
+    blob = SaveState_GetBlob(&reader, &size);
+    TEST_CHECK(blob && (size == 9) && !memcmp(blob, "level.tr2", 9));
+    TEST_CHECK(SaveState_GetU32(&reader) == 77);
+    TEST_CHECK(!reader.error && (reader.pos == state.size));
+
+    // nothing is read past the end, the error sticks
+    TEST_CHECK(SaveState_GetU32(&reader) == 0);
+    TEST_CHECK(reader.error);
+
+    // a blob size that points past the end
+    reader.pos = 4 + 4 + sizeof(floats);
+    reader.size = reader.pos + 4 + 8;
+    reader.error = 0;
+    TEST_CHECK(SaveState_GetBlob(&reader, &size) == NULL);
+    TEST_CHECK(reader.error);
+    reader.pos = 4 + 4 + sizeof(floats);
+    reader.size = state.size;
+    reader.error = 0;
+    memset(state.data + reader.pos, 0xFF, 4);
+    TEST_CHECK(SaveState_GetBlob(&reader, &size) == NULL);
+    TEST_CHECK(reader.error);
+
+    SaveState_Clear(&state);
+    TEST_CHECK(!state.data && !state.size && !state.error);
+}
+
+
+/* Lua data of any length is stored whole, the big one costs a second call */
+static void TestLuaData()
+{
+    const size_t lengths[] = { 0, 100, 32767, 32768, 32769, 65536, 200000 };
+    save_state_t state;
+    save_reader_t reader;
+    lua_data_t data;
+
+    data.text = (char*)malloc(200001);
+    for(size_t i = 0; i < 200000; ++i)
+    {
+        data.text[i] = 'a' + i % 26;
+    }
+
+    SaveState_Init(&state);
+    for(size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i)
+    {
+        data.length = lengths[i];
+        data.text[lengths[i]] = 0;
+        data.calls = 0;
+        SaveState_PutString(&state, GetLuaData, &data);
+        SaveState_PutU32(&state, 0x12345678);
+        TEST_CHECK(data.calls == ((lengths[i] > 32768) ? (2) : (1)));
+        data.text[lengths[i]] = 'a' + lengths[i] % 26;
+    }
+    TEST_CHECK(!state.error);
+
+    reader.data = state.data;
+    reader.size = state.size;
+    reader.pos = 0;
+    reader.error = 0;
+    for(size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i)
+    {
+        uint32_t size;
+        const char *blob = SaveState_GetBlob(&reader, &size);
+        TEST_CHECK(size == lengths[i]);
+        TEST_CHECK(blob && !memcmp(blob, data.text, size));
+        TEST_CHECK(SaveState_GetU32(&reader) == 0x12345678);
+    }
+    TEST_CHECK(!reader.error && (reader.pos == state.size));
+
+    SaveState_Clear(&state);
+    free(data.text);
+}
+
+
+/* a write that can not be had fails the whole snapshot */
+static void TestError()
+{
+    save_state_t state;
+    lua_data_t data;
+
+    data.text = (char*)"";
+    data.length = 0xF0000000;
+    data.calls = 0;
+
+    SaveState_Init(&state);
+    SaveState_PutU32(&state, 1);
+    TEST_CHECK(SaveState_Reserve(&state, 0xF0000000) == NULL);
+    TEST_CHECK(state.error);
+    SaveState_PutU32(&state, 2);
+    TEST_CHECK(state.size == 4);
+    SaveState_Clear(&state);
+
+    SaveState_Init(&state);
+    SaveState_PutString(&state, GetLuaData, &data);
+    TEST_CHECK(state.error);
+    SaveState_Clear(&state);
+}
+
+
+static void TestRecords()
+{
+    save_record_t records[100];
+    for(uint32_t i = 0; i < 100; ++i)
+    {
+        records[i].id = (i * 37) % 100 * 3;
+        records[i].offset = i;
+        records[i].size = 1;
+    }
+    SaveState_SortRecords(records, 100);
+    for(uint32_t i = 0; i < 300; ++i)
+    {
+        save_record_p rec = SaveState_FindRecord(records, 100, i);
+        TEST_CHECK((rec != NULL) == (i % 3 == 0));
+        TEST_CHECK(!rec || (rec->id == i));
+    }
+    TEST_CHECK(SaveState_FindRecord(records, 0, 0) == NULL);
+}
+
+
+int main()
+{
+    TestPrimitives();
+    TestLuaData();
+    TestError();
+    TestRecords();
+    return TEST_RESULT();
+}
@@ -0,0 +1,438 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+#include "test.h"
+#include "core/vmath.h"
+}
+
+#include "core/base_types.h"
+#include "core/console.h"
+#include "script/script.h"
+#include "physics/physics.h"
+#include "mesh.h"
+#include "skeletal_model.h"
+#include "room.h"
+#include "entity.h"
+#include "inventory.h"
+#include "world.h"
+#include "gameflow.h"
+#include "save_state.h"
+
+#define TEST_ENTITIES       (32)
+#define TEST_LEVEL_ENTITIES (12)
+#define TEST_FLIPS          (4)
+
+/*
+ * A level of plain entities in two rooms that are alternates of each other,
+ * with flip maps and entity script data kept in a Lua table.
+ */
+static entity_t             entities[TEST_ENTITIES];
+static ss_bone_frame_t      bone_frames[TEST_ENTITIES];
+static engine_container_t   containers[TEST_ENTITIES];
+static uint8_t              exists[TEST_ENTITIES];
+static int                  script_value[TEST_ENTITIES];
+static room_t               rooms[2];
+static room_content_t       room_contents[2];
+static uint8_t              flip_map[TEST_FLIPS];
+static uint8_t              flip_state[TEST_FLIPS];
+static uint32_t             level_loads = 0;
+static uint32_t             level_version = 0;
+lua_State                  *engine_lua = NULL;
+
+/*
+ * What save_state.cpp takes from the rest of the engine.
+ */
+void Con_Warning(const char *fmt, ...)
+{
+}
+
+bool lua_CallWithError(lua_State *lua, int nargs, int nresults, int errfunc, const char *cfile, int cline)
+{
+    return lua_pcall(lua, nargs, nresults, errfunc) == LUA_OK;
+}
+
+size_t Script_GetEntitySaveData(lua_State *lua, int id_entity, char *buf, size_t buf_size)
+{
+    return snprintf(buf, buf_size, "restored[%d] = %d", id_entity, script_value[id_entity]);
+}
+
+size_t Script_GetFlipEffectsSaveData(lua_State *lua, char *buf, size_t buf_size)
+{
+    buf[0] = 0;
+    return 0;
+}
+
+void Script_LuaClearTasks()
+{
+}
+
+const char *Gameflow_GetCurrentLevelPathLocal()
+{
+    return "data/test.tr2";
+}
+
+uint8_t Gameflow_GetCurrentGameID()
+{
+    return 2;
+}
+
+uint8_t Gameflow_GetCurrentLevelID()
+{
+    return 5;
+}
+
+static void LoadLevel();
+
+bool Gameflow_SetMap(const char* filePath, int game_id, int level_id)
+{
+    LoadLevel();
+    SaveState_SetBaseline();
+    return !strcmp(filePath, Gameflow_GetCurrentLevelPathLocal()) && (game_id == 2) && (level_id == 5);
+}
+
+int32_t World_GetVersion()
+{
+    return TR_II;
+}
+
+uint16_t World_GetGlobalFlipState()
+{
+    return 0;
+}
+
+void World_SetGlobalFlipState(int flip_state)
+{
+}
+
+void World_GetFlipInfo(uint8_t **map, uint8_t **state, uint32_t *count)
+{
+    *map = flip_map;
+    *state = flip_state;
+    *count = TEST_FLIPS;
+}
+
+int World_SetFlipMap(uint32_t flip_index, uint8_t flip_mask, uint8_t flip_operation)
+{
+    flip_map[flip_index] = flip_mask;
+    return 1;
+}
+
+int World_SetFlipState(uint32_t flip_index, uint32_t flip_state_value)
+{
+    flip_state[flip_index] = flip_state_value;
+    return 1;
+}
+
+void World_GetRoomInfo(struct room_s **r, uint32_t *count)
+{
+    *r = rooms;
+    *count = 2;
+}
+
+struct room_s *World_GetRoomByID(uint32_t id)
+{
+    return (id < 2) ? (rooms + id) : (NULL);
+}
+
+void Room_SetActiveContent(struct room_s *room, struct room_s *room_with_content_from)
+{
+    room->content = room_with_content_from->original_content;
+}
+
+int Room_AddObject(struct room_s *room, struct engine_container_s *cont)
+{
+    cont->room = room;
+    return 1;
+}
+
+int Room_RemoveObject(struct room_s *room, struct engine_container_s *cont)
+{
+    cont->room = NULL;
+    return 1;
+}
+
+struct entity_s *World_GetEntityByID(uint32_t id)
+{
+    return ((id < TEST_ENTITIES) && exists[id]) ? (entities + id) : (NULL);
+}
+
+struct entity_s *World_GetPlayer()
+{
+    return entities;
+}
+
+void World_IterateAllEntities(int (*iterator)(struct entity_s *ent, void *data), void *data)
+{
+    for(uint32_t id = 0; id < TEST_ENTITIES; ++id)
+    {
+        if(exists[id] && iterator(entities + id, data))
+        {
+            break;
+        }
+    }
+}
+
+static void InitEntity(uint32_t id)
+{
+    entity_p ent = entities + id;
+    memset(ent, 0, sizeof(entity_t));
+    memset(bone_frames + id, 0, sizeof(ss_bone_frame_t));
+    memset(containers + id, 0, sizeof(engine_container_t));
+    ent->id = id;
+    ent->bf = bone_frames + id;
+    ent->self = containers + id;
+    ent->self->object = ent;
+    ent->self->room = rooms + id % 2;
+    ent->state_flags = ENTITY_STATE_ENABLED | ENTITY_STATE_ACTIVE | ENTITY_STATE_VISIBLE;
+    vec3_set_zero(ent->transform.M4x4 + 12);
+    vec3_set_zero(ent->transform.angles);
+    exists[id] = 1;
+}
+
+uint32_t World_SpawnEntity(uint32_t model_id, uint32_t room_id, float pos[3], float ang[3], int32_t id)
+{
+    InitEntity(id);
+    entities[id].type_flags |= ENTITY_TYPE_SPAWNED;
+    entities[id].self->room = World_GetRoomByID(room_id);
+    vec3_copy(entities[id].transform.M4x4 + 12, pos);
+    vec3_copy(entities[id].transform.angles, ang);
+    return id;
+}
+
+int World_DeleteEntity(uint32_t id)
+{
+    if(World_GetEntityByID(id))
+    {
+        Inventory_RemoveAllItems(&entities[id].inventory);
+        exists[id] = 0;
+        return 1;
+    }
+    return 0;
+}
+
+struct skeletal_model_s *World_GetModelByID(uint32_t id)
+{
+    return NULL;
+}
+
+struct base_mesh_s *World_GetMeshByID(uint32_t ID)
+{
+    return NULL;
+}
+
+int32_t Inventory_AddItem(struct inventory_node_s **root, uint32_t item_id, int32_t count)
+{
+    inventory_node_p node = (inventory_node_p)calloc(1, sizeof(inventory_node_t));
+    node->id = item_id;
+    node->count = count;
+    node->next = *root;
+    *root = node;
+    return count;
+}
+
+int32_t Inventory_RemoveAllItems(struct inventory_node_s **root)
+{
+    while(*root)
+    {
+        inventory_node_p next = (*root)->next;
+        free(*root);
+        *root = next;
+    }
+    return 0;
+}
+
+void Entity_UpdateTransform(entity_p entity) {}
+void Entity_UpdateRigidBody(struct entity_s *ent, int force) {}
+void Entity_UpdateRoomPos(entity_p ent) {}
+void Entity_InitActivationPoint(entity_p entity) {}
+void Entity_EnableCollision(entity_p ent) {}
+void Entity_DisableCollision(entity_p ent) {}
+int  Physics_GetBodiesCount(struct physics_data_s *physics) { return 0; }
+void SSBoneFrame_Update(struct ss_bone_frame_s *bf, float time) {}
+void SSBoneFrame_SetTarget(struct ss_bone_tag_s *b_tag, const float target_pos[3], const float bone_dir[3]) {}
+void SSBoneFrame_SetTargetingAxisMod(struct ss_bone_tag_s *b_tag, const float mod[3]) {}
+void SSBoneFrame_SetTargetingLimit(struct ss_bone_tag_s *b_tag, const float limit[4]) {}
+struct ss_animation_s *SSBoneFrame_AddOverrideAnim(struct ss_bone_frame_s *bf, struct skeletal_model_s *sm, uint16_t anim_type_id) { return NULL; }
+struct ss_animation_s *SSBoneFrame_GetOverrideAnim(struct ss_bone_frame_s *bf, uint16_t anim_type) { return NULL; }
+void SSBoneFrame_EnableOverrideAnimByType(struct ss_bone_frame_s *bf, uint16_t anim_type) {}
+void SSBoneFrame_DisableOverrideAnimByType(struct ss_bone_frame_s *bf, uint16_t anim_type) {}
+void Anim_SetAnimation(struct ss_animation_s *ss_anim, int animation, int frame) {}
+
+
+/* The level as the loader leaves it: the baseline every delta is made against. */
+static void LoadLevel()
+{
+    for(uint32_t id = 0; id < TEST_ENTITIES; ++id)
+    {
+        Inventory_RemoveAllItems(&entities[id].inventory);
+        exists[id] = 0;
+        script_value[id] = 0;
+    }
+    for(uint32_t id = 0; id < TEST_LEVEL_ENTITIES; ++id)
+    {
+        InitEntity(id);
+        entities[id].transform.M4x4[12] = 1024.0f * id;
+        entities[id].transform.angles[0] = 10.0f * id + level_version;
+        script_value[id] = id;
+    }
+    Inventory_AddItem(&entities[0].inventory, 1, 1);
+
+    memset(rooms, 0, sizeof(rooms));
+    for(uint32_t i = 0; i < 2; ++i)
+    {
+        rooms[i].id = i;
+        room_contents[i].original_room_id = i;
+        rooms[i].content = rooms[i].original_content = room_contents + i;
+    }
+    rooms[0].alternate_room_next = rooms + 1;
+    rooms[1].alternate_room_prev = rooms + 0;
+    memset(flip_map, 0, sizeof(flip_map));
+    memset(flip_state, 0, sizeof(flip_state));
+
+    lua_newtable(engine_lua);
+    lua_setglobal(engine_lua, "restored");
+    level_loads++;
+}
+
+static void Play()
+{
+    float pos[3] = {1.0f, 2.0f, 3.0f}, ang[3] = {90.0f, 0.0f, 0.0f};
+
+    entities[0].transform.M4x4[13] = 512.0f;                // the player walks
+    Inventory_AddItem(&entities[0].inventory, 7, 3);        // and picks up
+    World_DeleteEntity(3);
+    entities[5].transform.M4x4[14] = -256.0f;               // pushed
+    entities[5].self->room = rooms + 0;
+    entities[6].timer = 2.5f;
+    entities[6].state_flags &= ~ENTITY_STATE_ACTIVE;
+    script_value[8] = 100;                                  // only the script side changed
+    World_SpawnEntity(0, 1, pos, ang, 20);
+    flip_map[2] = 0x1F;
+    flip_state[2] = 1;
+    rooms[0].content = rooms[1].original_content;           // room 0 is flipped
+}
+
+static int RestoredValue(uint32_t id)
+{
+    int ret;
+    lua_getglobal(engine_lua, "restored");
+    lua_rawgeti(engine_lua, -1, id);
+    ret = (lua_isinteger(engine_lua, -1)) ? ((int)lua_tointeger(engine_lua, -1)) : (-1);
+    lua_pop(engine_lua, 2);
+    return ret;
+}
+
+static int CountItems(entity_p ent)
+{
+    int ret = 0;
+    for(inventory_node_p i = ent->inventory; i; i = i->next)
+    {
+        ret += i->count;
+    }
+    return ret;
+}
+
+/* The played level and the one restored from a save: the same entities, in the same state. */
+static void CheckRestored(const entity_t *played, const uint8_t *played_exists)
+{
+    TEST_CHECK(0 == memcmp(exists, played_exists, TEST_ENTITIES));
+    for(uint32_t id = 0; id < TEST_ENTITIES; ++id)
+    {
+        if(exists[id] && played_exists[id])
+        {
+            entity_p ent = entities + id;
+            TEST_CHECK(vec3_dist_sq(ent->transform.M4x4 + 12, played[id].transform.M4x4 + 12) == 0.0f);
+            TEST_CHECK(vec3_dist_sq(ent->transform.angles, played[id].transform.angles) == 0.0f);
+            TEST_CHECK(ent->self->room == played[id].self->room);
+            TEST_CHECK(ent->timer == played[id].timer);
+            TEST_CHECK((ent->state_flags == played[id].state_flags) && (ent->type_flags == played[id].type_flags));
+        }
+    }
+    TEST_CHECK(CountItems(entities) == 4);
+    TEST_CHECK((flip_map[2] == 0x1F) && (flip_state[2] == 1));
+    TEST_CHECK(rooms[0].content == rooms[1].original_content);
+}
+
+
+/*
+ * A level is loaded, played and saved; loading it again and applying the
+ * full or the delta snapshot gives the played level back.
+ */
+static void TestRoundTrip()
+{
+    static entity_t played[TEST_ENTITIES];
+    static engine_container_t played_containers[TEST_ENTITIES];
+    uint8_t played_exists[TEST_ENTITIES];
+    save_state_t full, delta;
+
+    LoadLevel();
+    SaveState_SetBaseline();
+    TEST_CHECK(SaveState_GetBaselineSize() > 0);
+    Play();
+
+    SaveState_Init(&full);
+    SaveState_Init(&delta);
+    TEST_CHECK(SaveState_Capture(&full) && SaveState_CaptureDelta(&delta));
+    TEST_CHECK(SaveState_IsSnapshot(full.data, full.size) && SaveState_IsSnapshot(delta.data, delta.size));
+    TEST_CHECK(delta.size < full.size);
+    printf("baseline %d bytes, full save %d bytes, delta %d bytes\n", SaveState_GetBaselineSize(), full.size, delta.size);
+
+    memcpy(played, entities, sizeof(played));
+    memcpy(played_containers, containers, sizeof(played_containers));
+    memcpy(played_exists, exists, sizeof(played_exists));
+    for(uint32_t id = 0; id < TEST_ENTITIES; ++id)
+    {
+        played[id].self = played_containers + id;
+    }
+
+    LoadLevel();
+    TEST_CHECK(SaveState_Apply(delta.data, delta.size));
+    CheckRestored(played, played_exists);
+    TEST_CHECK((RestoredValue(8) == 100) && (RestoredValue(1) == -1));     // unchanged records stay out of the delta
+
+    LoadLevel();
+    TEST_CHECK(SaveState_Apply(full.data, full.size));
+    CheckRestored(played, played_exists);
+    TEST_CHECK((RestoredValue(8) == 100) && (RestoredValue(1) == 1));
+
+    // the way a save is loaded from the menu: the level is loaded again first
+    level_loads = 0;
+    TEST_CHECK(SaveState_Restore(delta.data, delta.size));
+    TEST_CHECK(level_loads == 1);
+    CheckRestored(played, played_exists);
+
+    // a delta made against another state of the level is refused, a full save still loads
+    level_version = 1;
+    TEST_CHECK(!SaveState_Restore(delta.data, delta.size));
+    TEST_CHECK(exists[3] && !exists[20] && (RestoredValue(8) == -1));
+    TEST_CHECK(SaveState_Restore(full.data, full.size));
+    CheckRestored(played, played_exists);
+    level_version = 0;
+
+    // a damaged snapshot is refused
+    TEST_CHECK(!SaveState_Apply(delta.data, delta.size - 5));
+
+    // nothing changed since the load: only the player and the header go in
+    LoadLevel();
+    SaveState_SetBaseline();
+    SaveState_Clear(&delta);
+    TEST_CHECK(SaveState_CaptureDelta(&delta));
+    TEST_CHECK(delta.size < full.size / 4);
+
+    SaveState_Clear(&full);
+    SaveState_Clear(&delta);
+}
+
+
+int main()
+{
+    engine_lua = luaL_newstate();
+    TestRoundTrip();
+    lua_close(engine_lua);
+    return TEST_RESULT();
+}
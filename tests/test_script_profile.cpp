@@ -0,0 +1,132 @@
+#include <stdio.h>
+
+extern "C" {
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+#include <SDL2/SDL_timer.h>
+#include "test.h"
+}
+
+#include "script/script.h"
+#include "core/console.h"
+
+#define TEST_BUDGET_MS      (0.2f)
+#define TEST_OVERRUN_MAX    (4.0f)      // SCRIPT_GC_OVERRUN_MAX
+#define TEST_SLACK_MS       (3.0f)      // one step past the deadline and the scheduler
+#define TEST_FRAMES         (300)
+#define TEST_LOAD_STAGES    (50)
+
+/*
+ * What script_profile.cpp takes from the rest of the engine.
+ */
+void Con_Printf(const char *fmt, ...)
+{
+}
+
+
+static const char *test_script =
+    "live = {}\n"
+    "function garbage(n) for i = 1, n do local t = {i, i + 1, tostring(i)} end end\n"
+    "function keep(n) for i = 1, n do live[#live + 1] = {i} end end\n";
+
+static lua_State *NewState()
+{
+    lua_State *lua = Script_NewLuaState();
+    luaL_openlibs(lua);
+    if(luaL_dostring(lua, test_script) != LUA_OK)
+    {
+        printf("%s\n", lua_tostring(lua, -1));
+        TEST_CHECK(0);
+    }
+    return lua;
+}
+
+static void Call(lua_State *lua, const char *func, int n)
+{
+    lua_getglobal(lua, func);
+    lua_pushinteger(lua, n);
+    TEST_CHECK(lua_pcall(lua, 1, 0, 0) == LUA_OK);
+}
+
+static double TicksToMs(uint64_t ticks)
+{
+    return 1000.0 * (double)ticks / (double)SDL_GetPerformanceFrequency();
+}
+
+
+/*
+ * A burst of garbage far over the limit is paid off over several frames,
+ * none of them going past the overrun cap; steady garbage stays bounded.
+ */
+static void TestFramePacing()
+{
+    lua_State *lua = NewState();
+    script_frame_stats_t stats;
+    double max_ms = TEST_OVERRUN_MAX * TEST_BUDGET_MS + TEST_SLACK_MS, worst_ms = 0.0;
+    int frames = 0, peak_kb = 0;
+
+    Script_SetGCBudget(lua, TEST_BUDGET_MS);
+    Script_ProfileReset();
+    Call(lua, "keep", 10000);
+    Call(lua, "garbage", 200000);
+    for(frames = 0; frames < 10 * TEST_FRAMES; frames++)
+    {
+        Script_FrameEnd(lua);
+        Script_GetFrameStats(&stats);
+        worst_ms = (TicksToMs(stats.last_ticks) > worst_ms) ? (TicksToMs(stats.last_ticks)) : (worst_ms);
+        if(stats.gc_cycles > 0)
+        {
+            break;
+        }
+    }
+    printf("burst: %d KB after %d frames, worst %.2f ms\n", stats.memory_kb, frames + 1, worst_ms);
+    TEST_CHECK((stats.gc_cycles > 0) && (frames > 1) && (worst_ms <= max_ms));
+    TEST_CHECK(stats.memory_kb < 4096);
+
+    for(int i = 0; i < TEST_FRAMES; i++)
+    {
+        Call(lua, "garbage", 2000);
+        Script_FrameEnd(lua);
+        Script_GetFrameStats(&stats);
+        peak_kb = (stats.memory_kb > peak_kb) ? (stats.memory_kb) : (peak_kb);
+    }
+    printf("steady: %d gc cycles, peak %d KB, worst %.2f ms\n", stats.gc_cycles, peak_kb, TicksToMs(stats.worst_ticks));
+    TEST_CHECK((stats.gc_cycles > 2) && (peak_kb < 8192) && (TicksToMs(stats.worst_ticks) <= max_ms));
+    lua_close(lua);
+}
+
+
+/* While loading no frame ends, the collector is stepped between the stages and keeps the heap down. */
+static void TestLoadSteps()
+{
+    lua_State *lua = NewState();
+    int peak_kb = 0;
+
+    Script_SetGCBudget(lua, TEST_BUDGET_MS);            // stops the collector
+    Call(lua, "keep", 10000);
+    for(int i = 0; i < TEST_LOAD_STAGES; i++)
+    {
+        Call(lua, "garbage", 20000);
+        Script_LoadStep(lua);
+        peak_kb = (lua_gc(lua, LUA_GCCOUNT, 0) > peak_kb) ? (lua_gc(lua, LUA_GCCOUNT, 0)) : (peak_kb);
+    }
+    printf("load: %d stages, peak %d KB\n", TEST_LOAD_STAGES, peak_kb);
+    TEST_CHECK(peak_kb < 16384);
+
+    // Lua's own collector is not held back, nothing to step
+    Script_SetGCBudget(lua, 0.0f);
+    Call(lua, "garbage", 20000);
+    Script_LoadStep(lua);
+    TEST_CHECK(lua_gc(lua, LUA_GCISRUNNING, 0));
+    lua_close(lua);
+    Script_SetGCBudget(NULL, SCRIPT_GC_BUDGET_MS);
+}
+
+
+int main()
+{
+    TestFramePacing();
+    TestLoadSteps();
+    return TEST_RESULT();
+}
@@ -0,0 +1,241 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+extern "C" {
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+#include "test.h"
+}
+
+#include "script/script.h"
+#include "core/console.h"
+
+/*
+ * What script_tasks.cpp takes from the rest of the engine.
+ */
+extern "C" void Con_Warning(const char *fmt, ...)
+{
+    va_list argptr;
+    va_start(argptr, fmt);
+    vprintf(fmt, argptr);
+    va_end(argptr);
+    printf("\n");
+}
+
+bool lua_CallWithError(lua_State *lua, int nargs, int nresults, int errfunc, const char *cfile, int cline)
+{
+    if(lua_pcall(lua, nargs, nresults, errfunc) != LUA_OK)
+    {
+        printf("Lua error: %s (called from %s:%d)\n", lua_tostring(lua, -1), cfile, cline);
+        lua_pop(lua, 1);
+        return false;
+    }
+    return true;
+}
+
+bool Script_CallVoidFunc(lua_State *lua, const char *func_name, bool destroy_after_call)
+{
+    return true;
+}
+
+void Script_ProfileBegin(struct script_profile_mark_s *mark)
+{
+}
+
+void Script_ProfileEnd(struct script_profile_mark_s *mark, int type, int model_id)
+{
+}
+
+
+static lua_State *NewState(const char *script)
+{
+    lua_State *lua = luaL_newstate();
+    luaL_openlibs(lua);
+    Script_LuaRegisterTaskFuncs(lua);
+    if(luaL_dostring(lua, script) != LUA_OK)
+    {
+        printf("%s\n", lua_tostring(lua, -1));
+        TEST_CHECK(0);
+    }
+    return lua;
+}
+
+
+static lua_Integer GetInteger(lua_State *lua, const char *name)
+{
+    lua_Integer ret;
+    lua_getglobal(lua, name);
+    ret = lua_tointeger(lua, -1);
+    lua_pop(lua, 1);
+    return ret;
+}
+
+
+static void Frame(lua_State *lua)
+{
+    TEST_CHECK(0 == Script_DoTasks(lua, 1.0f / 60.0f));
+}
+
+
+/* A task added during the pass waits for the next frame, whatever the pass removes before it. */
+static void TestAddedDuringPass()
+{
+    lua_State *lua = NewState(
+        "added_runs = 0\n"
+        "later_runs = 0\n"
+        "addTask(function()\n"
+        "    if(not added) then\n"
+        "        added = addTask(function() added_runs = added_runs + 1; return true; end)\n"
+        "        removeTask(later)\n"
+        "    end\n"
+        "    return true\n"
+        "end)\n"
+        "later = addTask(function() later_runs = later_runs + 1; return true; end)\n");
+
+    Frame(lua);
+    TEST_CHECK(GetInteger(lua, "added_runs") == 0);
+    TEST_CHECK(GetInteger(lua, "later_runs") == 0);
+    Frame(lua);
+    TEST_CHECK(GetInteger(lua, "added_runs") == 1);
+    Frame(lua);
+    TEST_CHECK(GetInteger(lua, "added_runs") == 2);
+    lua_close(lua);
+}
+
+
+/* The first added task is where the pass ends; removing it moves the end to the next added one. */
+static void TestPassEndRemoved()
+{
+    lua_State *lua = NewState(
+        "runs = { 0, 0, 0 }\n"
+        "addTask(function()\n"
+        "    if(not first) then\n"
+        "        first = addTask(function() runs[1] = runs[1] + 1; return true; end)\n"
+        "        second = addTask(function() runs[2] = runs[2] + 1; return true; end)\n"
+        "    end\n"
+        "    return true\n"
+        "end)\n"
+        "addTask(function()\n"
+        "    runs[3] = runs[3] + 1\n"
+        "    if(runs[3] == 1) then removeTask(first); end\n"
+        "    return true\n"
+        "end)\n");
+
+    Frame(lua);
+    TEST_CHECK(luaL_dostring(lua, "r1, r2, r3 = runs[1], runs[2], runs[3]") == LUA_OK);
+    TEST_CHECK(GetInteger(lua, "r1") == 0);
+    TEST_CHECK(GetInteger(lua, "r2") == 0);
+    TEST_CHECK(GetInteger(lua, "r3") == 1);
+    Frame(lua);
+    TEST_CHECK(luaL_dostring(lua, "r1, r2, r3 = runs[1], runs[2], runs[3]") == LUA_OK);
+    TEST_CHECK(GetInteger(lua, "r1") == 0);
+    TEST_CHECK(GetInteger(lua, "r2") == 1);
+    TEST_CHECK(GetInteger(lua, "r3") == 2);
+    lua_close(lua);
+}
+
+
+/* The last task of the pass removes itself and adds another one. */
+static void TestLastRemovesItself()
+{
+    lua_State *lua = NewState(
+        "next_runs = 0\n"
+        "addTask(function()\n"
+        "    addTask(function() next_runs = next_runs + 1; return true; end)\n"
+        "    return false\n"
+        "end)\n");
+
+    Frame(lua);
+    TEST_CHECK(GetInteger(lua, "next_runs") == 0);
+    Frame(lua);
+    TEST_CHECK(GetInteger(lua, "next_runs") == 1);
+    lua_close(lua);
+}
+
+
+/* Delays are in 1/60 s ticks: a task due in 0.1 s runs on the 6th frame, then every 3rd as it asks. */
+static void TestDelays()
+{
+    lua_State *lua = NewState(
+        "frame = 0\n"
+        "runs = {}\n"
+        "addTask(function() frame = frame + 1; return true; end)\n"
+        "addTask(function() runs[#runs + 1] = frame; return 0.05; end, 0.1)\n"
+        "addTask(function() return false; end)\n");
+    script_task_stats_t stats;
+
+    Script_GetTaskStats(lua, &stats);
+    TEST_CHECK((stats.tasks == 3) && (stats.waiting == 1));
+    for(int i = 0; i < 12; ++i)
+    {
+        Frame(lua);
+    }
+    TEST_CHECK(luaL_dostring(lua, "runs_count, run1, run2, run3 = #runs, runs[1], runs[2], runs[3]") == LUA_OK);
+    TEST_CHECK(GetInteger(lua, "runs_count") == 3);
+    TEST_CHECK(GetInteger(lua, "run1") == 6);
+    TEST_CHECK(GetInteger(lua, "run2") == 9);
+    TEST_CHECK(GetInteger(lua, "run3") == 12);
+    Script_GetTaskStats(lua, &stats);
+    TEST_CHECK((stats.tasks == 2) && (stats.waiting == 1));
+
+    Script_ClearTasks(lua);
+    Script_GetTaskStats(lua, &stats);
+    TEST_CHECK((stats.tasks == 0) && (stats.waiting == 0));
+    lua_close(lua);
+}
+
+
+/*
+ * Many tasks over both wheel levels and past them, some sleeping again after
+ * they run: none may run before its time or a frame late, so the due times
+ * come in order.
+ */
+static void TestWheel()
+{
+    lua_State *lua = NewState(
+        "now, early, late, runs, last_due, out_of_order = 0, 0, 0, 0, 0, 0\n"
+        "for i = 1, 3000 do\n"
+        "    local d = ((i * 7919) % 1500) / 60.0\n"
+        "    if(i % 10 == 0) then d = d + 300.0; end\n"
+        "    local due, k = now + d, (i % 7 == 0) and 3 or 0\n"
+        "    addTask(function()\n"
+        "        if(now + 1.0e-6 < due) then early = early + 1; end\n"
+        "        if(now > due + 1.0 / 60.0 + 1.0e-6) then late = late + 1; end\n"
+        "        if(due < last_due - 1.0 / 60.0) then out_of_order = out_of_order + 1; end\n"
+        "        last_due = due\n"
+        "        runs = runs + 1\n"
+        "        if(k > 0) then k = k - 1; due = now + 0.5; return 0.5; end\n"
+        "    end, d)\n"
+        "end\n");
+    script_task_stats_t stats;
+    uint32_t frames = 0;
+
+    do
+    {
+        lua_pushnumber(lua, (double)(++frames) / 60.0);
+        lua_setglobal(lua, "now");
+        Frame(lua);
+        Script_GetTaskStats(lua, &stats);
+    }
+    while(stats.tasks && (frames < 60 * 60 * 10));
+
+    TEST_CHECK(stats.tasks == 0);
+    TEST_CHECK(stats.cascaded > 0);
+    TEST_CHECK(GetInteger(lua, "runs") == 3000 + 3 * (3000 / 7));
+    TEST_CHECK(GetInteger(lua, "early") == 0);
+    TEST_CHECK(GetInteger(lua, "late") == 0);
+    TEST_CHECK(GetInteger(lua, "out_of_order") == 0);
+    lua_close(lua);
+}
+
+
+int main()
+{
+    TestAddedDuringPass();
+    TestPassEndRemoved();
+    TestLastRemovesItself();
+    TestDelays();
+    TestWheel();
+    return TEST_RESULT();
+}
@@ -0,0 +1,159 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "fmv/stream_codec.h"
+#include "test.h"
+#include "test_rpl.h"
+
+// what the main thread may spend on a frame on average: picking a decoded frame and the sound blocks, no decoding
+#define TEST_MAIN_THREAD_MS     (1.0)
+
+
+static void WaitDecoded(stream_codec_p s)
+{
+    while(!SDL_AtomicGet(&s->video_end) &&
+          (SDL_AtomicGet(&s->video_head) - SDL_AtomicGet(&s->video_tail) < STREAM_CODEC_VIDEO_FRAMES))
+    {
+        SDL_Delay(1);
+    }
+}
+
+
+/* the sound clock sets the frame, the frame time passed is ignored while it plays */
+static void TestAudioClock(uint8_t *file, size_t size)
+{
+    stream_codec_t video;
+    int64_t queued = 0, played = 0, last_pts = -1;
+    int blocks = 0, block_errors = 0, out_of_sync = 0, steps = 0;
+    uint64_t main_ticks = 0, worst_ticks = 0;
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+    stream_codec_init(&video);
+    TEST_CHECK(!stream_codec_is_open(&video));
+    TEST_CHECK(0 == stream_codec_open_rpl(&video, SDL_RWFromMem(file, size)));
+    TEST_CHECK(stream_codec_is_open(&video));
+    TEST_CHECK(video.audio_sample_rate == RPL_RATE);
+    TEST_CHECK(video.audio_bits_per_sample == 16);
+    TEST_CHECK(video.audio_channels == 1);
+
+    for(int step = 0; !stream_codec_is_finished(&video) && (step < 1000); ++step)
+    {
+        stream_codec_video_frame_p frame;
+        int64_t target = step * RPL_SAMPLES_PER_FRAME * 3 / 2;
+        uint64_t t0, t;
+
+        // the device plays what was queued, one and a half frames per step
+        t = 0;
+        while((queued < target) && !(SDL_AtomicGet(&video.audio_end) && !stream_codec_peek_audio(&video)))
+        {
+            stream_codec_audio_block_p block;
+            t0 = SDL_GetPerformanceCounter();
+            block = stream_codec_peek_audio(&video);
+            if(!block)
+            {
+                SDL_Delay(1);
+                continue;
+            }
+            block_errors += ((block->size != RPL_AUDIO_SIZE) || (block->data[0] != blocks) || (block->data[block->size - 2] != blocks)) ? (1) : (0);
+            queued += block->size / 2;
+            blocks++;
+            stream_codec_pop_audio(&video);
+            t += SDL_GetPerformanceCounter() - t0;
+        }
+        played = (target < queued) ? (target) : (queued);
+
+        WaitDecoded(&video);
+        t0 = SDL_GetPerformanceCounter();
+        frame = stream_codec_get_video(&video, 1000000000, (played < target) ? (-1) : (played));
+        t += SDL_GetPerformanceCounter() - t0;
+        main_ticks += t;
+        worst_ticks = (t > worst_ticks) ? (t) : (worst_ticks);
+        steps++;
+        if(frame)
+        {
+            out_of_sync += ((played == target) && ((int64_t)frame->pts != played / RPL_SAMPLES_PER_FRAME)) ? (1) : (0);
+            TEST_CHECK((int64_t)frame->pts > last_pts);
+            TEST_CHECK(frame->width == RPL_WIDTH && frame->height == RPL_HEIGHT);
+            last_pts = frame->pts;
+        }
+    }
+
+    TEST_CHECK(stream_codec_is_finished(&video));
+    TEST_CHECK(out_of_sync == 0);
+    TEST_CHECK(blocks == RPL_CHUNKS);
+    TEST_CHECK(block_errors == 0);
+    TEST_CHECK(last_pts == RPL_FRAMES - 1);
+    // 1.5 frames per step: every other frame is late when it is picked
+    TEST_CHECK(video.frames_shown + video.frames_dropped == RPL_FRAMES);
+    TEST_CHECK(video.frames_dropped == RPL_FRAMES / 3);
+    // the decoding is on the worker, the main thread only picks what is ready
+    printf("main thread per frame: %.4f ms average, %.4f ms worst\n", ms * main_ticks / steps, ms * worst_ticks);
+    TEST_CHECK(ms * main_ticks / steps < TEST_MAIN_THREAD_MS);
+
+    stream_codec_stop(&video);
+    TEST_CHECK(!stream_codec_is_open(&video));
+}
+
+
+/* without sound the frame time drives the clock, and a late sound clock does not move it back */
+static void TestFrameClock(uint8_t *file, size_t size)
+{
+    stream_codec_t video;
+    uint64_t step_ns = (2 * 1000000000ull + RPL_FPS - 1) / RPL_FPS;
+    int64_t last_pts = -1;
+
+    stream_codec_init(&video);
+    TEST_CHECK(0 == stream_codec_open_rpl(&video, SDL_RWFromMem(file, size)));
+    for(int step = 0; !stream_codec_is_finished(&video) && (step < 1000); ++step)
+    {
+        stream_codec_video_frame_p frame;
+        while(stream_codec_peek_audio(&video))
+        {
+            stream_codec_pop_audio(&video);
+        }
+        WaitDecoded(&video);
+        frame = stream_codec_get_video(&video, (step) ? (step_ns) : (0), -1);
+        if(frame)
+        {
+            TEST_CHECK((int64_t)frame->pts == ((2 * step < RPL_FRAMES) ? (2 * step) : (RPL_FRAMES - 1)));
+            last_pts = frame->pts;
+        }
+        if(step == 3)
+        {
+            TEST_CHECK(stream_codec_get_video(&video, 0, 0) == NULL);
+            TEST_CHECK(video.frame == 6);
+        }
+    }
+    // the last frame is shown late rather than dropped
+    TEST_CHECK(last_pts == RPL_FRAMES - 1);
+    TEST_CHECK(video.frames_shown == RPL_FRAMES / 2 + 1);
+    TEST_CHECK(video.frames_dropped == RPL_FRAMES / 2 - 1);
+    stream_codec_stop(&video);
+}
+
+
+int main()
+{
+    size_t size;
+    uint8_t *file = Test_MakeRPL(&size);
+    uint8_t *broken = (uint8_t*)malloc(size);
+    stream_codec_t video;
+
+    TestAudioClock(file, size);
+    TestFrameClock(file, size);
+
+    codec_set_rpl_read_ahead(0);
+    TestAudioClock(file, size);
+    codec_set_rpl_read_ahead(RPL_READ_AHEAD_SIZE);
+
+    memcpy(broken, file, size);
+    broken[0] = 'X';
+    stream_codec_init(&video);
+    TEST_CHECK(0 != stream_codec_open_rpl(&video, SDL_RWFromMem(broken, size)));
+    TEST_CHECK(!stream_codec_is_open(&video));
+
+    free(broken);
+    free(file);
+    return TEST_RESULT();
+}